@@ -0,0 +1,208 @@
+//Byte stuffing throughput, byte at a time vs word at a time
+//
+//First checks that ByteStuffCopy and ReverseByteStuffCopy are bit-exact with
+//the byte at a time versions they replaced: random messages of every length
+//and escape density, decoded from every source alignment, plus corrupted
+//streams (bad escapes, truncated escapes, over-long frames) that must be
+//rejected the same way, each frame decoded from a buffer of its own size.
+//Then reports MB/s of payload for both directions.
+//
+//build: g++ -O2 -IInc Bench/bench_byte_stuffing.cpp Src/serial_protocol.c -o bench_byte_stuffing
+//usage: ./bench_byte_stuffing [fuzz rounds] [MB per measurement]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "serial_protocol.h"
+
+using namespace std;
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t seed = 12345;
+
+static uint32_t rnd()
+{
+	seed = seed * 1103515245u + 12345u;
+	return seed >> 8;
+}
+
+//ByteStuffCopy and ReverseByteStuffCopy before the word at a time fast path,
+//not inlined to pay for a call as they do
+static __attribute__((noinline)) int ref_stuff(uint8_t *Dest, TMsg *Source)
+{
+	int32_t count = 0;
+	for(uint32_t i = 0; i < Source->Len; i++)
+		count += ByteStuffCopyByte(&Dest[count], Source->Data[i]);
+	Dest[count] = TMsg_EOF;
+	return count + 1;
+}
+
+static __attribute__((noinline)) int ref_unstuff(TMsg *Dest, uint8_t *Source)
+{
+	uint32_t count = 0;
+	int32_t state = 0;
+
+	while(*Source != TMsg_EOF) {
+		if(count >= TMsg_MaxLen)
+			return 0;	//the original wrote past Data here
+		if(state == 0) {
+			if(*Source == TMsg_BS)
+				state = 1;
+			else
+				Dest->Data[count++] = *Source;
+		}
+		else {
+			if(*Source == TMsg_BS)
+				Dest->Data[count++] = TMsg_BS;
+			else if(*Source == TMsg_BS_EOF)
+				Dest->Data[count++] = TMsg_EOF;
+			else
+				return 0;
+			state = 0;
+		}
+		Source++;
+	}
+	if(state != 0)
+		return 0;
+	Dest->Len = count;
+	return 1;
+}
+
+static void fill(TMsg &msg, uint32_t len, uint32_t density)
+{
+	msg.Len = len;
+	for(uint32_t i=0; i<len; i++) {
+		uint32_t r = rnd();
+		if(r % 100 < density) {
+			//the escape bytes and their neighbours
+			static const uint8_t special[] = { TMsg_EOF, TMsg_BS, TMsg_BS_EOF, 0xEF, 0xF3 };
+			msg.Data[i] = special[(r >> 8) % sizeof(special)];
+		}
+		else
+			msg.Data[i] = (uint8_t)(r >> 4);
+	}
+}
+
+static int fuzz(size_t rounds)
+{
+	static uint8_t a[2 * TMsg_MaxLen + 16], b[2 * TMsg_MaxLen + 16];
+	static uint8_t src[2 * TMsg_MaxLen + 64] __attribute__((aligned(16)));
+	TMsg msg, ra, rb, rc;
+	size_t failures = 0;
+
+	for(size_t r=0; r<rounds; r++) {
+		fill(msg, rnd() % TMsg_MaxLen, rnd() % 101);
+		int na = ref_stuff(a, &msg);
+		int nb = ByteStuffCopy(b, &msg);
+		if(na != nb || memcmp(a, b, na) != 0) {
+			fprintf(stderr, "stuff mismatch: len %u\n", msg.Len);
+			failures++;
+			continue;
+		}
+
+		//decode from every alignment, sometimes after corrupting the stream
+		size_t off = rnd() % 16;
+		memcpy(src + off, a, na);
+		memset(src + off + na, rnd() & 0xFF, sizeof(src) - off - na);
+		switch(rnd() % 4) {
+		case 0:	//random byte replaced, may break an escape or end the frame early
+			src[off + rnd() % na] = (uint8_t)rnd();
+			break;
+		case 1:	//escape right before TMsg_EOF
+			if(na > 1)
+				src[off + na - 2] = TMsg_BS;
+			break;
+		case 2:	//frame longer than TMsg_MaxLen
+			if(rnd() % 8 == 0) {
+				memset(src + off, 0x55, TMsg_MaxLen + 8);
+				src[off + TMsg_MaxLen + 8] = TMsg_EOF;
+			}
+			break;
+		default:
+			break;
+		}
+		memset(&ra, 0, sizeof(ra));
+		memset(&rb, 0, sizeof(rb));
+		memset(&rc, 0, sizeof(rc));
+		int oka = ref_unstuff(&ra, src + off);
+
+		//the frame alone in a buffer of its size, up to the first TMsg_EOF
+		//if corrupting the stream moved it, so reading past it is caught
+		//by -fsanitize=address; without one, the rest of the stream
+		uint8_t *eof = (uint8_t *)memchr(src + off, TMsg_EOF, sizeof(src) - off);
+		uint32_t len = eof != NULL ? (uint32_t)(eof + 1 - (src + off)) : (uint32_t)(sizeof(src) - off);
+		vector<uint8_t> frame(src + off, src + off + len);
+		if(eof == NULL)
+			frame.push_back(TMsg_EOF);	//for ReverseByteStuffCopy only
+		int okb = ReverseByteStuffCopy(&rb, frame.data());
+		int okc = ReverseByteStuffCopyLen(&rc, frame.data(), len);
+		if(oka != okb || (oka && (ra.Len != rb.Len || memcmp(ra.Data, rb.Data, ra.Len) != 0)) ||
+		   oka != okc || (oka && (ra.Len != rc.Len || memcmp(ra.Data, rc.Data, ra.Len) != 0))) {
+			fprintf(stderr, "unstuff mismatch: len %u, offset %zu, ref %d new %d with length %d\n", msg.Len, off, oka, okb, okc);
+			failures++;
+		}
+
+		//a length that stops short of TMsg_EOF is rejected
+		if(len > 1 && ReverseByteStuffCopyLen(&rc, frame.data(), len - 1)) {
+			fprintf(stderr, "unstuff read past its length: len %u\n", msg.Len);
+			failures++;
+		}
+	}
+	return failures == 0;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t rounds = argc > 1 ? strtoul(argv[1], NULL, 0) : 1000000;
+	size_t mb = argc > 2 ? strtoul(argv[2], NULL, 0) : 64;
+	const uint32_t densities[] = { 0, 1, 5, 20 };
+
+	if(!fuzz(rounds)) {
+		printf("fuzz: FAILED\n");
+		return 1;
+	}
+	printf("fuzz: %zu random messages bit-exact\n", rounds);
+
+	//a full TMsg down to a status frame, unstuffed with the frame length
+	const uint32_t lens[] = { TMsg_MaxLen - 1, 64, 32, 15 };
+	printf("len  escapes%%   stuff MB/s (byte -> word)   unstuff MB/s (byte -> word)\n");
+	for(uint32_t len : lens)
+	for(uint32_t d : densities) {
+		TMsg msg, out;
+		static uint8_t wire[2 * TMsg_MaxLen + 16] __attribute__((aligned(16)));
+		fill(msg, len, d);
+		size_t iters = mb * 1000000 / len;
+		volatile int sink = 0;
+
+		uint64_t t0 = now_ns();
+		for(size_t i=0; i<iters; i++)
+			sink += ref_stuff(wire, &msg);
+		double refStuff = (double)(now_ns() - t0);
+		t0 = now_ns();
+		int wireLen = 0;
+		for(size_t i=0; i<iters; i++)
+			sink += wireLen = ByteStuffCopy(wire, &msg);
+		double newStuff = (double)(now_ns() - t0);
+
+		t0 = now_ns();
+		for(size_t i=0; i<iters; i++)
+			sink += ref_unstuff(&out, wire);
+		double refUnstuff = (double)(now_ns() - t0);
+		t0 = now_ns();
+		for(size_t i=0; i<iters; i++)
+			sink += ReverseByteStuffCopyLen(&out, wire, (uint32_t)wireLen);
+		double newUnstuff = (double)(now_ns() - t0);
+
+		double bytes = (double)iters * len * 1e3;	//MB/s from ns
+		printf("%-4u %-10u %7.0f -> %-17.0f %7.0f -> %.0f\n", len, d, bytes / refStuff, bytes / newStuff,
+			bytes / refUnstuff, bytes / newUnstuff);
+	}
+	return 0;
+}
@@ -0,0 +1,436 @@
+//Flash datalog, page ring against the old linear log
+//
+//Runs both datalog layouts on a file-backed model of the L476 flash, mapped
+//at its real address like the host simulation does: records are logged every
+//day in DATABYTE_LEN chunks, the board reboots a few times a day and the log
+//is uploaded and dropped once a day.  Reports page erases, erase wear per
+//page, programmed double words per record and the flash busy time the erases
+//and programming cost on the target (the ring stages records in RAM and fast
+//programs whole rows), then the boot-time recovery of the write pointer
+//against how full the log is.  The uploaded records are checked against
+//what was logged, and an interrupted page open is injected into the ring to
+//check that recovery ignores it.
+//
+//build: g++ -O2 -DUSE_HOST_SIM -DUSE_STM32L4XX_NUCLEO -DUSE_IKS01A2 -IHost/Inc -IInc Bench/bench_datalog_ring.cpp Src/DemoDatalog.c Src/activity_log.c -o bench_datalog_ring
+//usage: ./bench_datalog_ring [days] [records per day] [reboots per day] [flash file]
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <vector>
+#include "main.h"
+#include "DemoDatalog.h"
+
+using namespace std;
+
+#define REGION_PAGES  (FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE)
+
+//the flash model, same rules as Host/Src/sim_hal.c
+static uint8_t *flash;
+static int locked = 1;
+static uint64_t programs, rows, erases, errors;
+static uint32_t tick;
+static uint32_t pageErases[FLASH_SIZE / FLASH_PAGE_SIZE];
+
+SYSCFG_TypeDef SIM_SYSCFG;
+
+void Error_Handler(void)
+{
+	fprintf(stderr, "Error_Handler called\n");
+	exit(1);
+}
+
+//the datalog flushes from the main loop with the interrupt API, here the
+//operations end at once and the callback comes before the call returns
+uint32_t HAL_GetTick(void) { return tick; }
+void HAL_Delay(uint32_t Delay) { tick += Delay; }
+void HAL_NVIC_SetPriority(IRQn_Type, uint32_t, uint32_t) {}
+void HAL_NVIC_EnableIRQ(IRQn_Type) {}
+
+//only the activity log anchors read it, this bench saves records directly
+void RTC_GetDateTime(uint8_t *Date, uint8_t *Time)
+{
+	memset(Date, 0, 3);
+	memset(Time, 0, 3);
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void) { locked = 0; return HAL_OK; }
+HAL_StatusTypeDef HAL_FLASH_Lock(void) { locked = 1; return HAL_OK; }
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data)
+{
+	uint64_t current;
+
+	if(locked || TypeProgram != FLASH_TYPEPROGRAM_DOUBLEWORD || (Address & 7) != 0
+	   || Address < FLASH_BASE || Address > FLASH_BASE + FLASH_SIZE - 8) {
+		errors++;
+		return HAL_ERROR;
+	}
+	memcpy(&current, flash + (Address - FLASH_BASE), 8);
+	if(current != UINT64_MAX && Data != 0) {
+		errors++;
+		return HAL_ERROR;
+	}
+	memcpy(flash + (Address - FLASH_BASE), &Data, 8);
+	programs++;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *PageError)
+{
+	uint32_t first = (pEraseInit->Banks == FLASH_BANK_2 ? FLASH_BANK_SIZE / FLASH_PAGE_SIZE : 0) + pEraseInit->Page;
+
+	if(locked || pEraseInit->Page + pEraseInit->NbPages > FLASH_BANK_SIZE / FLASH_PAGE_SIZE)
+		return HAL_ERROR;
+	for(uint32_t p = first; p < first + pEraseInit->NbPages; p++) {
+		memset(flash + p * FLASH_PAGE_SIZE, 0xFF, FLASH_PAGE_SIZE);
+		pageErases[p]++;
+		erases++;
+	}
+	*PageError = 0xFFFFFFFFU;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program_IT(uint32_t TypeProgram, uint32_t Address, uint64_t Data)
+{
+	HAL_StatusTypeDef ret = HAL_OK;
+
+	if(TypeProgram == FLASH_TYPEPROGRAM_DOUBLEWORD)
+		ret = HAL_FLASH_Program(TypeProgram, Address, Data);
+	else {
+		const uint8_t *row = (const uint8_t *)(uintptr_t)Data;
+		if(locked || (Address & (FLASH_FAST_ROW_SIZE - 1)) != 0)
+			ret = HAL_ERROR;
+		for(uint32_t i = 0; ret == HAL_OK && i < FLASH_FAST_ROW_SIZE; i++)
+			if(flash[Address - FLASH_BASE + i] != 0xFF)
+				ret = HAL_ERROR;
+		if(ret == HAL_OK) {
+			memcpy(flash + (Address - FLASH_BASE), row, FLASH_FAST_ROW_SIZE);
+			programs += FLASH_FAST_ROW_SIZE / 8;
+			rows++;
+		}
+		else
+			errors++;
+	}
+	if(ret == HAL_OK)
+		HAL_FLASH_EndOfOperationCallback(Address);
+	else
+		HAL_FLASH_OperationErrorCallback(Address);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase_IT(FLASH_EraseInitTypeDef *pEraseInit)
+{
+	uint32_t err;
+	if(HAL_FLASHEx_Erase(pEraseInit, &err) == HAL_OK)
+		HAL_FLASH_EndOfOperationCallback(0xFFFFFFFFU);
+	else
+		HAL_FLASH_OperationErrorCallback(err);
+	return HAL_OK;
+}
+
+static void flash_open(const char *path)
+{
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0 || ftruncate(fd, FLASH_SIZE) != 0) {
+		perror(path);
+		exit(1);
+	}
+	void *mem = mmap((void *)FLASH_BASE, FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+	if(mem != (void *)FLASH_BASE) {
+		perror("mmap");
+		exit(1);
+	}
+	close(fd);
+	flash = (uint8_t *)mem;
+}
+
+static void flash_reset()
+{
+	memset(flash, 0xFF, FLASH_SIZE);
+	memset(pageErases, 0, sizeof(pageErases));
+	programs = rows = erases = errors = 0;
+}
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//the old DemoDatalog.c, L4 branch: one flat log, linear search for the end, erased all at once
+static uint32_t legacyAddress2F = FLASH_ADDRESS;
+
+static uint32_t legacy_search(uint32_t *FlashSectorBaseAddress)
+{
+	uint64_t tmp;
+	uint32_t sector_offset = 0, delta = 0;
+
+	tmp = *(volatile uint64_t *)(uintptr_t)(*FlashSectorBaseAddress + (FLASH_SECTOR_SIZE / 2U));
+	if(tmp != 0xFFFFFFFFFFFFFFFFU) {
+		*FlashSectorBaseAddress += FLASH_SECTOR_SIZE / 2U;
+		delta = FLASH_SECTOR_SIZE >> 1;
+	}
+	for(uint32_t i = 0; i < (FLASH_SECTOR_SIZE >> 1); i += FLASH_ITEM_SIZE) {
+		tmp = *(volatile uint64_t *)(uintptr_t)(*FlashSectorBaseAddress + i);
+		if(tmp == 0xFFFFFFFFFFFFFFFFU) {
+			sector_offset = i;
+			break;
+		}
+		sector_offset = FLASH_SECTOR_SIZE / 2U;
+	}
+	return sector_offset + delta;
+}
+
+static void legacy_set_address()
+{
+	uint32_t sector = FLASH_ADDRESS;
+	legacyAddress2F = FLASH_ADDRESS + legacy_search(&sector);
+}
+
+static size_t legacy_save(const DataByte_t *records, uint8_t n)
+{
+	size_t saved = 0;
+	HAL_FLASH_Unlock();
+	for(uint8_t i = 0; i < n; i++) {
+		if(legacyAddress2F < (uint32_t)(0x80FF800 - n * sizeof(DataByte_t))) {
+			uint64_t v;
+			memcpy(&v, &records[i], 8);
+			HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, legacyAddress2F, v);
+			legacyAddress2F += 8;
+			saved++;
+		}
+	}
+	HAL_FLASH_Lock();
+	return saved;
+}
+
+static void legacy_erase()
+{
+	FLASH_EraseInitTypeDef e;
+	uint32_t err;
+	e.TypeErase = FLASH_TYPEERASE_PAGES;
+	e.Banks = FLASH_BANK_2;
+	e.Page = (FLASH_ADDRESS - FLASH_BASE - FLASH_BANK_SIZE) / FLASH_PAGE_SIZE;
+	e.NbPages = 64;
+	HAL_FLASH_Unlock();
+	HAL_FLASHEx_Erase(&e, &err);
+	HAL_FLASH_Lock();
+	legacyAddress2F = FLASH_ADDRESS;
+}
+
+struct Result {
+	uint64_t logged = 0, lost = 0, uploaded = 0;
+	bool ok = true;
+};
+
+static DataByte_t make_record(uint64_t n)
+{
+	DataByte_t r;
+	//BCD date and time, a record is never all ones
+	r.date_time.date[0] = (uint8_t)(((n / 86400) % 28 / 10) << 4 | ((n / 86400) % 28 % 10));
+	r.date_time.date[1] = 0x01;
+	r.date_time.date[2] = 0x24;
+	r.date_time.time[0] = (uint8_t)(((n / 3600) % 24 / 10) << 4 | ((n / 3600) % 24 % 10));
+	r.date_time.time[1] = (uint8_t)(((n / 60) % 60 / 10) << 4 | ((n / 60) % 60 % 10));
+	r.date_time.time[2] = (uint8_t)((n % 60 / 10) << 4 | (n % 60 % 10));
+	r.data_valid = 1;
+	r.activity_type = (uint8_t)(n % 9);
+	return r;
+}
+
+//boot-time search of the write pointer with the log filled to a given number of records
+static void recovery_table()
+{
+	const uint32_t capacity = REGION_PAGES * DATALOG_PAGE_RECORDS;
+	const double fills[] = { 0.0, 0.1, 0.25, 0.5, 0.75, 1.0 };
+	const int reps = 2000;
+
+	printf("\nboot-time recovery of the write pointer, ns per boot\n");
+	printf("records   linear     ring\n");
+	for(double f : fills) {
+		uint32_t records = (uint32_t)(f * capacity);
+		DataByte_t chunk[DATABYTE_LEN];
+
+		flash_reset();
+		legacyAddress2F = FLASH_ADDRESS;
+		for(uint32_t i = 0; i < records; i += DATABYTE_LEN) {
+			uint8_t len = (uint8_t)min<uint32_t>(DATABYTE_LEN, records - i);
+			for(uint8_t j = 0; j < len; j++)
+				chunk[j] = make_record(i + j);
+			legacy_save(chunk, len);
+		}
+		uint64_t t0 = now_ns();
+		for(int i = 0; i < reps; i++)
+			legacy_set_address();
+		double linear = (double)(now_ns() - t0) / reps;
+
+		flash_reset();
+		(void)Datalog_SetAddress();
+		for(uint32_t i = 0; i < records; i += DATABYTE_LEN) {
+			uint8_t len = (uint8_t)min<uint32_t>(DATABYTE_LEN, records - i);
+			for(uint8_t j = 0; j < len; j++)
+				DataByte[j] = make_record(i + j);
+			(void)Datalog_SaveData2Mem(len);
+		}
+		(void)Datalog_Flush();
+		t0 = now_ns();
+		for(int i = 0; i < reps; i++)
+			(void)Datalog_SetAddress();
+		double ring = (double)(now_ns() - t0) / reps;
+
+		printf("%-9u %-10.0f %.0f\n", records, linear, ring);
+	}
+}
+
+static Result run_ring(int days, int perDay, int reboots)
+{
+	Result r;
+	vector<DataByte_t> pending;
+	uint64_t n = 0;
+
+	flash_reset();
+	(void)Datalog_SetAddress();
+	for(int d = 0; d < days; d++) {
+		for(int k = 0; k < reboots; k++) {
+			for(int i = 0; i < perDay / reboots; i += DATABYTE_LEN) {
+				uint8_t len = (uint8_t)min<int>(DATABYTE_LEN, perDay / reboots - i);
+				for(uint8_t j = 0; j < len; j++)
+					DataByte[j] = make_record(n++);
+				uint32_t before = Datalog_RecordCount();
+				(void)Datalog_SaveData2Mem(len);
+				uint32_t saved = Datalog_RecordCount() - before;
+				pending.insert(pending.end(), DataByte, DataByte + saved);
+				r.lost += len - saved;
+				r.logged += len;
+				//the main loop goes round many times between two chunks
+				tick += 1000;
+				for(uint32_t k = 0; k < 2 * DATALOG_STAGE_RECORDS; k++)
+					Datalog_Process();
+			}
+			//a clean shutdown, staged records are lost on a power cut
+			(void)Datalog_Flush();
+			(void)Datalog_SetAddress();
+		}
+
+		//an open interrupted by a power cut: the page after the head is half erased,
+		//unless that page still holds records to upload, it is never opened then
+		if(d == days / 2 && Datalog_RecordCount() / DATALOG_PAGE_RECORDS + 2 < REGION_PAGES) {
+			uint32_t count = Datalog_RecordCount();
+			uint8_t *region = flash + (FLASH_ADDRESS - FLASH_BASE);
+			uint32_t head = 0, headSeq = 0;
+			for(uint32_t p = 0; p < REGION_PAGES; p++) {
+				DatalogPage_t h;
+				memcpy(&h, region + p * FLASH_PAGE_SIZE, sizeof(h));
+				if(h.Magic == DATALOG_PAGE_MAGIC && h.Seq >= headSeq) {
+					head = p;
+					headSeq = h.Seq;
+				}
+			}
+			uint8_t *torn = region + ((head + 1) % REGION_PAGES) * FLASH_PAGE_SIZE;
+			memset(torn + FLASH_PAGE_SIZE / 2, 0xFF, FLASH_PAGE_SIZE / 2);
+			torn[3] ^= 0x40;
+			(void)Datalog_SetAddress();
+			if(Datalog_RecordCount() != count) {
+				fprintf(stderr, "ring: torn page open changed the record count %u -> %u\n", count, Datalog_RecordCount());
+				r.ok = false;
+			}
+		}
+
+		//daily upload, oldest first
+		(void)Datalog_Flush();
+		uint32_t count = Datalog_RecordCount();
+		for(uint32_t i = 0; i < count; i += DATABYTE_LEN) {
+			uint8_t len = (uint8_t)min<uint32_t>(DATABYTE_LEN, count - i);
+			Datalog_FillBuffer2BSent(i, len);
+			if(i + len > pending.size() || memcmp(DataByte, &pending[i], len * sizeof(DataByte_t)) != 0)
+				r.ok = false;
+		}
+		if(count != pending.size())
+			r.ok = false;
+		r.uploaded += count;
+		pending.clear();
+		(void)Datalog_FlashErase();
+	}
+	return r;
+}
+
+static Result run_legacy(int days, int perDay, int reboots)
+{
+	Result r;
+	uint64_t n = 0;
+	DataByte_t chunk[DATABYTE_LEN];
+
+	flash_reset();
+	for(int d = 0; d < days; d++) {
+		uint64_t first = n;
+		for(int k = 0; k < reboots; k++) {
+			for(int i = 0; i < perDay / reboots; i += DATABYTE_LEN) {
+				uint8_t len = (uint8_t)min<int>(DATABYTE_LEN, perDay / reboots - i);
+				for(uint8_t j = 0; j < len; j++)
+					chunk[j] = make_record(n++);
+				size_t saved = legacy_save(chunk, len);
+				r.lost += len - saved;
+				r.logged += len;
+			}
+			legacy_set_address();
+		}
+
+		uint32_t count = (legacyAddress2F - FLASH_ADDRESS) / sizeof(DataByte_t);
+		for(uint32_t i = 0; i < count; i++) {
+			DataByte_t expect = make_record(first + i);
+			if(memcmp(flash + (FLASH_ADDRESS - FLASH_BASE) + i * 8, &expect, 8) != 0) {
+				r.ok = false;
+				break;
+			}
+		}
+		r.uploaded += count;
+		legacy_erase();
+	}
+	return r;
+}
+
+static void report(const char *name, const Result &r, int days)
+{
+	uint32_t firstPage = (FLASH_ADDRESS - FLASH_BASE) / FLASH_PAGE_SIZE;
+	uint32_t maxWear = 0;
+	uint64_t sumWear = 0;
+	for(uint32_t p = firstPage; p < firstPage + REGION_PAGES; p++) {
+		maxWear = max(maxWear, pageErases[p]);
+		sumWear += pageErases[p];
+	}
+	double busyS = ((programs - rows * (FLASH_FAST_ROW_SIZE / 8)) * SIM_FLASH_PROGRAM_US + rows * SIM_FLASH_FAST_ROW_US
+		+ erases * (double)SIM_FLASH_PAGE_ERASE_US) / 1e6;
+	printf("%-7s %-8llu %-5u %-6.1f %-12.3f %-12.2f %-7.2f %llu/%llu%s\n", name, (unsigned long long)erases, maxWear, (double)sumWear / REGION_PAGES,
+		(double)programs / r.logged, (double)erases * FLASH_PAGE_SIZE / (r.logged * sizeof(DataByte_t)),
+		busyS / days, (unsigned long long)r.uploaded, (unsigned long long)r.logged, r.ok ? "" : "  MISMATCH");
+}
+
+int main(int argc, char *argv[])
+{
+	int days = argc > 1 ? atoi(argv[1]) : 30;
+	int perDay = argc > 2 ? atoi(argv[2]) : 2000;
+	int reboots = argc > 3 ? atoi(argv[3]) : 4;
+	const char *path = argc > 4 ? argv[4] : "bench_flash.bin";
+
+	if(days <= 0 || perDay <= 0 || reboots <= 0) {
+		fprintf(stderr, "days, records and reboots must be positive\n");
+		return 1;
+	}
+	flash_open(path);
+	printf("%d days, %d records/day, %d reboots/day, upload daily, %u pages of %u records\n", days, perDay, reboots,
+		(unsigned)REGION_PAGES, (unsigned)DATALOG_PAGE_RECORDS);
+	printf("layout  erases   wear  wear   programs     erased B     busy    uploaded/\n");
+	printf("                 max   mean   per record   per logged B s/day   logged\n");
+
+	Result legacy = run_legacy(days, perDay, reboots);
+	report("linear", legacy, days);
+	Result ring = run_ring(days, perDay, reboots);
+	report("ring", ring, days);
+	recovery_table();
+	return legacy.ok && ring.ok ? 0 : 1;
+}
@@ -0,0 +1,246 @@
+//Storing statuses: the old ctime and flushed cout line per status against the
+//event log, and the device and time range queries it answers
+//
+//Appends a synthetic recording of several devices at 16 Hz, with a share of
+//statuses replayed from relay backlogs up to 2 min late, in three ways: a text
+//line per status with ctime and endl as display.cpp used to, the event log
+//with group commit, and the event log synced after every status.  Then times
+//device queries over windows of a minute, an hour and a day against a scan of
+//all records, and reopening the log after a crash cut the last record and
+//lost the index of the last segment.  Queries made while the writer thread
+//commits are checked to find every record kept exactly once.
+//
+//build: g++ -O2 -I. -IInc Bench/bench_event_log.cpp event_log.cpp status_decoder.cpp -lpthread -o bench_event_log
+//usage: ./bench_event_log [directory] [statuses] [devices]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "event_log.h"
+#include "status_decoder.h"
+
+using namespace std;
+
+#define STEP_MS		62	//16 Hz per device
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//The recording: devices round robin, every 50th status made up to 2 min
+//before it arrived
+static void make_records(vector<EventRecord> &recs, size_t count, int devices, int64_t startMs)
+{
+	unsigned short xsubi[3] = { 1, 2, 3 };
+
+	recs.resize(count);
+	for(size_t i=0; i<count; i++) {
+		EventRecord &rec = recs[i];
+		rec.device = (uint16_t)(i % devices);
+		rec.ms = startMs + (int64_t)(i / devices) * STEP_MS;
+		if(i % 50 == 0)
+			rec.ms -= (int64_t)(erand48(xsubi) * 120000);
+		rec.seq = (uint16_t)(i / devices);
+		rec.state = (uint8_t)(i / devices / 1000 % ST_COUNT);
+		rec.flags = 0;
+		rec.reserved = 0;
+	}
+}
+
+static bool by_time(const EventRecord &a, const EventRecord &b)
+{
+	return a.ms < b.ms;
+}
+
+static void remove_log(const string &dir)
+{
+	string cmd = "rm -rf " + dir;
+	if(system(cmd.c_str()) != 0)
+		exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	string dir = argc > 1 ? argv[1] : "/tmp/bench_event_log";
+	size_t count = argc > 2 ? atol(argv[2]) : 2000000;
+	int devices = argc > 3 ? atoi(argv[3]) : 8;
+	int64_t startMs = 1700000000000LL;
+	vector<EventRecord> recs;
+	uint64_t t0, t1;
+
+	make_records(recs, count, devices, startMs);
+	printf("%zu statuses from %d devices, %.1f h\n", count, devices, count / devices * STEP_MS / 3.6e6);
+	printf("%-24s %12s %10s %8s\n", "store", "statuses/s", "syncs", "MB");
+
+	//what on_message did for every status
+	{
+		string path = dir + ".txt";
+		ofstream out(path.c_str());
+		t0 = now_ns();
+		for(size_t i=0; i<count; i++) {
+			time_t ticks = (time_t)(recs[i].ms / 1000);
+			string strtime = ctime(&ticks);
+			strtime.erase(strtime.size()-1);
+			out<<strtime<<" ["<<recs[i].device<<"]: "<<status_name(recs[i].state)<<endl;
+		}
+		t1 = now_ns();
+		printf("%-24s %12.0f %10s %8.2f\n", "text, ctime + endl", count / ((t1 - t0) / 1e9), "-",
+			(double)out.tellp() / 1e6);
+		out.close();
+		unlink(path.c_str());
+	}
+
+	//every status on disk before the next, for comparison, on a short run
+	{
+		EventLog *log = new EventLog();
+		size_t n = min(count, (size_t)2000);
+		remove_log(dir);
+		event_log_open(*log, dir.c_str(), true);
+		t0 = now_ns();
+		for(size_t i=0; i<n; i++) {
+			event_log_append(*log, recs[i], recs[i].ms);
+			event_log_commit(*log);
+		}
+		t1 = now_ns();
+		printf("%-24s %12.0f %10llu %8.2f\n", "event log, sync each", n / ((t1 - t0) / 1e9),
+			(unsigned long long)log->commits, n * sizeof(EventRecord) / 1e6);
+		event_log_close(*log);
+		delete log;
+	}
+
+	//device queries while the writer thread commits: every record of the
+	//window kept found, none twice, whether it is on disk, queued or pending
+	{
+		EventLog *live = new EventLog();
+		const int liveDevices = 4;
+		size_t n = min(count, (size_t)liveDevices * 65536);
+		vector<bool> kept(n);
+		uint64_t queries = 0;
+		remove_log(dir);
+		event_log_open(*live, dir.c_str(), true);
+		for(size_t i=0; i<n; i++) {
+			EventRecord rec;
+			rec.ms = startMs + (int64_t)i;
+			rec.device = (uint16_t)(i % liveDevices);
+			rec.seq = (uint16_t)(i / liveDevices);
+			rec.state = 0;
+			rec.flags = 0;
+			rec.reserved = 0;
+			uint64_t dropped = live->dropped;
+			event_log_append(*live, rec, rec.ms);
+			kept[i] = live->dropped == dropped;
+			event_log_tick(*live, rec.ms);
+			if(i % 8 != 0)
+				continue;
+
+			//the last 5 s of one device against the records it kept
+			vector<EventRecord> out;
+			uint16_t device = (uint16_t)(i / 8 % liveDevices);
+			size_t from = i > 5000 ? i - 5000 : 0;
+			event_log_query(*live, device, startMs + (int64_t)from, startMs + (int64_t)i + 1, out);
+			size_t found = 0, expected = 0;
+			for(size_t j=from; j<=i; j++) {
+				if(j % liveDevices != device || !kept[j])
+					continue;
+				found += found < out.size() && out[found].seq == (uint16_t)(j / liveDevices);
+				expected++;
+			}
+			if(found != expected || out.size() != expected) {
+				printf("query during commits found %zu records, %zu of the %zu expected\n", out.size(), found, expected);
+				return 1;
+			}
+			queries++;
+		}
+		event_log_commit(*live);
+		printf("%-24s %12llu %10llu %8s\n", "queries during commits", (unsigned long long)queries,
+			(unsigned long long)live->commits, "ok");
+		event_log_close(*live);
+		delete live;
+	}
+
+	//group commit as the ingest thread runs it, ticked with the real clock
+	EventLog *log = new EventLog();
+	remove_log(dir);
+	event_log_open(*log, dir.c_str(), true);
+	t0 = now_ns();
+	for(size_t i=0; i<count; i++) {
+		int64_t nowMs = (int64_t)(now_ns() / 1000000);
+		event_log_append(*log, recs[i], nowMs);
+		if(i % 64 == 0)
+			event_log_tick(*log, nowMs);
+	}
+	event_log_commit(*log);
+	t1 = now_ns();
+	printf("%-24s %12.0f %10llu %8.2f\n", "event log, group commit", count / ((t1 - t0) / 1e9),
+		(unsigned long long)log->commits, count * sizeof(EventRecord) / 1e6);
+
+	//device queries at random places in the recording
+	static const struct { const char *name; int64_t ms; } windows[] = {
+		{ "1 min", 60000LL }, { "1 h", 3600000LL }, { "1 day", 86400000LL },
+	};
+	int64_t spanMs = (int64_t)(count / devices) * STEP_MS;
+	unsigned short xsubi[3] = { 4, 5, 6 };
+	printf("\n%-8s %10s %12s %12s %12s\n", "window", "statuses", "blocks", "query us", "scan us");
+	for(size_t w=0; w<sizeof(windows)/sizeof(windows[0]); w++) {
+		const int rounds = 50;
+		uint64_t queryNs = 0, scanNs = 0, found = 0, blocks = log->blocksRead;
+		for(int r=0; r<rounds; r++) {
+			uint16_t device = (uint16_t)(erand48(xsubi) * devices);
+			int64_t from = startMs + (int64_t)(erand48(xsubi) * max(spanMs - windows[w].ms, (int64_t)1));
+			int64_t to = from + windows[w].ms;
+			vector<EventRecord> out;
+
+			t0 = now_ns();
+			found += event_log_query(*log, device, from, to, out);
+			queryNs += now_ns() - t0;
+
+			//the same answer without the index
+			vector<EventRecord> scanned;
+			t0 = now_ns();
+			for(size_t s=0; s<log->segments.size(); s++)
+				for(uint32_t i=0; i<log->segments[s].count; i++) {
+					const EventRecord &rec = log->segments[s].map[i];
+					if(rec.device == device && rec.ms >= from && rec.ms < to)
+						scanned.push_back(rec);
+				}
+			stable_sort(scanned.begin(), scanned.end(), by_time);
+			scanNs += now_ns() - t0;
+			if(scanned.size() != out.size() || (!out.empty() && memcmp(&scanned[0], &out[0], out.size() * sizeof(EventRecord)) != 0)) {
+				printf("query found %zu, scan %zu\n", out.size(), scanned.size());
+				return 1;
+			}
+		}
+		printf("%-8s %10.0f %12.1f %12.1f %12.1f\n", windows[w].name, (double)found / rounds,
+			(double)(log->blocksRead - blocks) / rounds, queryNs / 1e3 / rounds, scanNs / 1e3 / rounds);
+	}
+	uint32_t last = log->segments.back().number;
+	event_log_close(*log);
+
+	//a crash: the last record torn, the index of the last segment gone
+	char name[64];
+	snprintf(name, sizeof(name), "/%08u.idx", last);
+	unlink((dir + name).c_str());
+	snprintf(name, sizeof(name), "/%08u.log", last);
+	if(truncate((dir + name).c_str(), (count % EVENT_SEGMENT_RECORDS) * sizeof(EventRecord) - 7) < 0)
+		perror("truncate");
+	t0 = now_ns();
+	event_log_open(*log, dir.c_str(), true);
+	t1 = now_ns();
+	uint64_t records = 0;
+	for(size_t s=0; s<log->segments.size(); s++)
+		records += log->segments[s].count;
+	printf("\nreopen after a crash: %.1f ms, %llu records, %llu torn bytes and index entries recovered\n",
+		(t1 - t0) / 1e6, (unsigned long long)records, (unsigned long long)log->recovered);
+	event_log_close(*log);
+	delete log;
+	remove_log(dir);
+	return 0;
+}
@@ -0,0 +1,185 @@
+//Load test for the recorder server reactor
+//
+//Starts the reactor on a local port with an ack-only handler and opens N
+//simulated relays that each send M statuses, waiting for the "Hello" ack like
+//Socket/client.cpp does. Reports messages/sec and the ingest latency
+//distribution (send -> ack).
+//With flooders, that many more relays send as fast as they can and never
+//read their acks, the others' latency shows whether they still get their
+//turn; the server hangs up on a flooder once its acks pile up past
+//REACTOR_OUT_MAX, and it connects again.
+//
+//build: g++ -O2 -I. Bench/bench_reactor.cpp reactor.cpp -lpthread -o bench_reactor
+//usage: ./bench_reactor [clients] [messages per client] [port] [flooders]
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+#include "reactor.h"
+
+using namespace std;
+
+static volatile bool running = true;
+static volatile bool flooding = true;
+static int nMessages = 1000;
+static uint16_t port = 65432;
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void ack_handler(Connection &conn, const char *, size_t, void *)
+{
+	reactor_send(conn, "Hello", 5);
+}
+
+static void *server_thread(void *arg)
+{
+	Reactor *reactor = (Reactor*)arg;
+	while(running)
+		reactor_poll(*reactor, 10);
+	return NULL;
+}
+
+static void *client_thread(void *arg)
+{
+	vector<uint64_t> *lat = (vector<uint64_t>*)arg;
+	struct sockaddr_in addr;
+	const char *msg = "no sleeping, walking";
+	char buf[64];
+	int one = 1;
+
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+		perror("connect");
+		close(fd);
+		return NULL;
+	}
+
+	lat->reserve(nMessages);
+	for(int i=0; i<nMessages; i++) {
+		uint64_t t0 = now_ns();
+		if(send(fd, msg, strlen(msg), 0) <= 0)
+			break;
+		if(recv(fd, buf, sizeof(buf), 0) <= 0)
+			break;
+		lat->push_back(now_ns() - t0);
+	}
+	close(fd);
+	return NULL;
+}
+
+//A relay that sends without reading, again after each hang up
+struct Flooder
+{
+	uint64_t bytes;
+	int connections;
+};
+
+static void *flood_thread(void *arg)
+{
+	Flooder *f = (Flooder*)arg;
+	static char block[65536];
+	struct sockaddr_in addr;
+
+	memset(block, 'x', sizeof(block));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	while(flooding) {
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+		struct timeval tv = { 0, 100000 };
+		int rcvbuf = 4096;	//a relay has little room for acks
+		setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+		setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+		if(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+			close(fd);
+			usleep(10000);
+			continue;
+		}
+		f->connections++;
+		while(flooding) {
+			ssize_t n = send(fd, block, sizeof(block), MSG_NOSIGNAL);
+			if(n < 0 && errno != EAGAIN)
+				break;
+			if(n > 0)
+				f->bytes += n;
+		}
+		close(fd);
+	}
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	int nClients = argc > 1 ? atoi(argv[1]) : 100;
+	nMessages = argc > 2 ? atoi(argv[2]) : 1000;
+	port = argc > 3 ? atoi(argv[3]) : 65432;
+	int nFlooders = argc > 4 ? atoi(argv[4]) : 0;
+
+	Reactor reactor;
+	if(!reactor_open(reactor, port, ack_handler, NULL))
+		return 1;
+
+	pthread_t server;
+	pthread_create(&server, NULL, server_thread, &reactor);
+
+	vector<pthread_t> flooders(nFlooders);
+	vector<Flooder> flood(nFlooders);
+	for(int i=0; i<nFlooders; i++)
+		pthread_create(&flooders[i], NULL, flood_thread, &flood[i]);
+
+	vector<pthread_t> threads(nClients);
+	vector< vector<uint64_t> > lat(nClients);
+	uint64_t t0 = now_ns();
+	for(int i=0; i<nClients; i++)
+		pthread_create(&threads[i], NULL, client_thread, &lat[i]);
+	for(int i=0; i<nClients; i++)
+		pthread_join(threads[i], NULL);
+	double elapsed = (now_ns() - t0) / 1e9;
+
+	flooding = false;
+	for(int i=0; i<nFlooders; i++)
+		pthread_join(flooders[i], NULL);
+	running = false;
+	pthread_join(server, NULL);
+	reactor_close(reactor);
+
+	vector<uint64_t> all;
+	for(int i=0; i<nClients; i++)
+		all.insert(all.end(), lat[i].begin(), lat[i].end());
+	if(all.empty()) {
+		printf("no messages acknowledged\n");
+		return 1;
+	}
+	sort(all.begin(), all.end());
+
+	printf("clients      %d\n", nClients);
+	printf("messages     %zu\n", all.size());
+	printf("elapsed      %.3f s\n", elapsed);
+	printf("throughput   %.0f msg/s\n", all.size() / elapsed);
+	printf("latency p50  %.1f us\n", all[all.size()/2] / 1e3);
+	printf("latency p99  %.1f us\n", all[all.size()*99/100] / 1e3);
+	printf("latency max  %.1f us\n", all.back() / 1e3);
+	for(int i=0; i<nFlooders; i++)
+		printf("flooder %-4d %.1f MB in %d connections\n", i, flood[i].bytes / 1e6, flood[i].connections);
+	return 0;
+}
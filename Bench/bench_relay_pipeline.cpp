@@ -0,0 +1,310 @@
+//Relay to server link: send and wait for "Hello" against the pipelined relay
+//
+//Runs the reactor on a local port with the server's ack policy (a "Hello" per
+//frame, or one cumulative CMD_Relay_Ack per read once the relay sent
+//CMD_Relay_Hello) and a relay built like Socket/client.cpp: a producer thread
+//stands in for the UART interrupt and pushes status frames at a fixed rate
+//into the RelayPipe, the network loop sends what it hands out on a
+//non-blocking socket. The server holds every frame for half the RTT before it
+//counts as delivered and every ack for a whole RTT, as a Wi-Fi link would.
+//Reports frames delivered, dropped by the bounded queue, sends per frame and
+//the production to delivery latency.
+//At 5 ms RTT, where send and wait keeps up, it also runs the pipelined relay
+//against a server from before CMD_Relay_Hello ("/old") and both relays with
+//every 25th frame damaged on the way ("/bad"). These runs and the pipelined
+//ones have to end with all frames acknowledged and the ones neither dropped
+//nor damaged delivered, the exit status is 1 otherwise.
+//
+//build: g++ -O2 -I. -IInc -ISocket Bench/bench_relay_pipeline.cpp reactor.cpp Src/status_frame.c Src/serial_protocol.c -lpthread -o bench_relay_pipeline
+//usage: ./bench_relay_pipeline [seconds per run] [port]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <time.h>
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+#include "reactor.h"
+#include "relay_pipe.h"
+
+using namespace std;
+
+#define MAX_FRAMES	65536	//status frame Seq is 16 bit
+
+static volatile bool running = true;
+static double seconds = 2.0;
+static uint16_t port = 65433;
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t now_ms()
+{
+	return (uint32_t)(now_ns() / 1000000ULL);
+}
+
+//Ack due on a connection once the RTT has passed
+struct Delayed
+{
+	uint64_t due;
+	int fd;
+	string bytes;
+};
+
+struct BenchServer
+{
+	uint64_t rtt_ns;
+	bool old;			//ignores CMD_Relay_Hello
+	int corrupt_every;		//0: none damaged
+	int seen;
+	int corrupted;
+	deque<Delayed> acks;
+	uint64_t delivered[MAX_FRAMES];	//[ns] 0 until the frame arrived
+};
+
+//Same policy as on_message in display.cpp for binary relays
+static void frame_handler(Connection &conn, const char *data, size_t len, void *ctx)
+{
+	BenchServer *server = (BenchServer*)ctx;
+	uint64_t arrival = now_ns() + server->rtt_ns / 2;
+	uint32_t received = conn.frames;
+	string out;
+	size_t pos;
+
+	conn.in.append(data, len);
+	while((pos = conn.in.find((char)TMsg_EOF)) != string::npos) {
+		uint8_t wire[STATUS_FRAME_WIRE_MAX];
+		TStatusFrame status;
+		bool valid = false;
+		uint8_t cmd;
+		uint32_t flags;
+
+		if(pos < sizeof(wire)) {
+			memcpy(wire, conn.in.data(), pos+1);
+			if(wire[0] != STATUS_SERVER_ADDR && server->corrupt_every != 0 && ++server->seen % server->corrupt_every == 0) {
+				wire[pos/2] ^= 0x5a;
+				server->corrupted++;
+			}
+			valid = StatusFrame_Decode(&status, wire) != 0;
+			if(!valid && StatusFrame_DecodeControl(wire, &cmd, &flags)) {
+				if(cmd == CMD_Relay_Hello && !server->old)
+					conn.pipelined = (flags & RELAY_HELLO_PIPELINE) != 0;
+				conn.in.erase(0, pos+1);
+				continue;
+			}
+		}
+		bool control = pos > 0 && (uint8_t)conn.in[0] == STATUS_SERVER_ADDR;
+		conn.in.erase(0, pos+1);
+		if(!valid && control)
+			continue;
+		conn.frames++;
+		if(!conn.pipelined)
+			out.append("Hello");
+		if(valid)
+			server->delivered[status.Seq] = arrival;
+	}
+	if(conn.pipelined && conn.frames != received) {
+		uint8_t ack[STATUS_CONTROL_WIRE_MAX];
+		out.append((const char*)ack, StatusFrame_EncodeControl(ack, CMD_Relay_Ack, conn.frames));
+	}
+	if(!out.empty()) {
+		Delayed d = { now_ns() + server->rtt_ns, conn.fd, out };
+		server->acks.push_back(d);
+	}
+}
+
+struct ServerArgs
+{
+	Reactor *reactor;
+	BenchServer *server;
+};
+
+static void *server_thread(void *arg)
+{
+	ServerArgs *a = (ServerArgs*)arg;
+	while(running) {
+		reactor_poll(*a->reactor, 1);
+		while(!a->server->acks.empty() && a->server->acks.front().due <= now_ns()) {
+			Delayed &d = a->server->acks.front();
+			unordered_map<int, Connection*>::iterator it = a->reactor->conns.find(d.fd);
+			if(it != a->reactor->conns.end())
+				reactor_send(*it->second, d.bytes.data(), d.bytes.size());
+			a->server->acks.pop_front();
+		}
+	}
+	return NULL;
+}
+
+//The UART side: one status frame every period, never waits for the network
+struct Producer
+{
+	RelayPipe *pipe;
+	int rate;
+	int count;
+	uint64_t produced[MAX_FRAMES];
+};
+
+static void *producer_thread(void *arg)
+{
+	Producer *p = (Producer*)arg;
+	uint64_t period = 1000000000ULL / p->rate;
+	uint64_t next = now_ns();
+
+	for(int i=0; i<p->count; i++) {
+		TStatusFrame s;
+
+		memset(&s, 0, sizeof(s));
+		s.DeviceId = 1;
+		s.Seq = (uint16_t)i;
+		s.TimeStamp = i;
+		s.Activity = STATUS_ACT_WALKING;
+		p->produced[i] = now_ns();
+		p->pipe->push(s, now_ms());
+
+		next += period;
+		struct timespec ts = { (time_t)(next / 1000000000ULL), (long)(next % 1000000000ULL) };
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+	}
+	return NULL;
+}
+
+//The network loop of Socket/client.cpp on a POSIX socket. When checked,
+//false if frames were lost or never acknowledged.
+static bool run(bool pipelined, int rate, int rtt_ms, bool checked, bool old = false, int corrupt_every = 0)
+{
+	static BenchServer server;
+	static Producer producer;
+	RelayPipe *pipe = pipelined ? new RelayPipe() : new RelayPipe(1, STATUS_FRAME_WIRE_MAX, RELAY_LATENCY_MS, false);
+	bool done = false;
+	char buf[256];
+
+	server.rtt_ns = (uint64_t)rtt_ms * 1000000ULL;
+	server.old = old;
+	server.corrupt_every = corrupt_every;
+	server.seen = 0;
+	server.corrupted = 0;
+	server.acks.clear();
+	memset(server.delivered, 0, sizeof(server.delivered));
+
+	Reactor reactor;
+	if(!reactor_open(reactor, port, frame_handler, &server))
+		exit(1);
+	running = true;
+	ServerArgs args = { &reactor, &server };
+	pthread_t st;
+	pthread_create(&st, NULL, server_thread, &args);
+
+	struct sockaddr_in addr;
+	int one = 1;
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+		perror("connect");
+		exit(1);
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+	producer.pipe = pipe;
+	producer.rate = rate;
+	producer.count = min((int)(seconds * rate), MAX_FRAMES);
+	pthread_t pt;
+	pthread_create(&pt, NULL, producer_thread, &producer);
+
+	uint64_t deadline = now_ns() + (uint64_t)((seconds + 5.0) * 1e9);
+	while(now_ns() < deadline) {
+		bool idle = true;
+		const uint8_t *data;
+		size_t n = pipe->ready(now_ms(), &data);
+		if(n != 0) {
+			ssize_t r = send(fd, data, n, MSG_NOSIGNAL);
+			if(r > 0) {
+				pipe->sent(r);
+				idle = false;
+			}
+		}
+		ssize_t r = recv(fd, buf, sizeof(buf), 0);
+		if(r > 0) {
+			idle = false;
+			pipe->received((const uint8_t*)buf, r);
+		}
+		if(pipe->queued + pipe->dropped == (uint32_t)producer.count && pipe->backlog() == 0 && pipe->unacked() == 0) {
+			done = true;
+			break;
+		}
+		if(idle)
+			usleep(100);
+	}
+	pthread_join(pt, NULL);
+	close(fd);
+	running = false;
+	pthread_join(st, NULL);
+	reactor_close(reactor);
+
+	vector<uint64_t> lat;
+	for(int i=0; i<producer.count; i++) {
+		if(server.delivered[i] != 0)
+			lat.push_back(server.delivered[i] - producer.produced[i]);
+	}
+	sort(lat.begin(), lat.end());
+	string mode = pipelined ? "pipelined" : "wait ack";
+	if(old)
+		mode += "/old";
+	if(corrupt_every != 0)
+		mode += "/bad";
+	printf("%-14s %6d %5d %9zu/%-6d %7u %7u %6.2f",
+		mode.c_str(), rate, rtt_ms, lat.size(), producer.count,
+		(unsigned)pipe->dropped, (unsigned)pipe->batches,
+		pipe->batches ? (double)pipe->frames / pipe->batches : 0.0);
+	if(lat.empty())
+		printf("\n");
+	else
+		printf(" %8.1f %8.1f %8.1f\n", lat[lat.size()/2] / 1e6, lat[lat.size()*99/100] / 1e6, lat.back() / 1e6);
+	bool ok = done && lat.size() == (size_t)(producer.count - pipe->dropped - server.corrupted)
+		&& pipe->fallbacks == (old ? 1U : 0U);
+	if(checked && !ok)
+		printf("  FAILED: %s, %d damaged, %u fallbacks\n", done ? "frames lost" : "frames never acknowledged",
+			server.corrupted, (unsigned)pipe->fallbacks);
+	delete pipe;
+	return ok || !checked;
+}
+
+int main(int argc, char *argv[])
+{
+	static const int rates[] = { 16, 200, 2000 };
+	static const int rtts[] = { 5, 50, 200 };
+
+	seconds = argc > 1 ? atof(argv[1]) : 2.0;
+	port = argc > 2 ? atoi(argv[2]) : 65433;
+
+	printf("%-14s %6s %5s %16s %7s %7s %6s %8s %8s %8s\n", "mode", "fps", "rtt", "delivered", "dropped",
+		"sends", "f/send", "p50 ms", "p99 ms", "max ms");
+	bool ok = true;
+	for(size_t r=0; r<sizeof(rtts)/sizeof(rtts[0]); r++)
+		for(size_t f=0; f<sizeof(rates)/sizeof(rates[0]); f++) {
+			//one frame per RTT falls behind the faster rates, that is the point
+			run(false, rates[f], rtts[r], false);
+			ok &= run(true, rates[f], rtts[r], true);
+		}
+	for(size_t f=0; f<2; f++) {
+		ok &= run(true, rates[f], 5, true, true);
+		ok &= run(false, rates[f], 5, true, false, 25);
+		ok &= run(true, rates[f], 5, true, false, 25);
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,344 @@
+//Relay reconnect and backlog replay against a server that drops connections
+//
+//Runs the reactor on a local port with the server's handling of binary relays
+//(acks, CMD_Relay_Age, status_track dropping the frames sent again) and a
+//relay built like Socket/client.cpp: a producer thread stands in for the UART
+//and pushes status frames at a fixed rate into the RelayPipe, the network
+//loop connects without blocking, backs off with RelayBackoff when the server
+//is gone and replays the backlog once it is back. The server either hangs
+//up on every connection once it lasted drop_ms, right after a read and
+//before its ack, or stops listening for an outage.
+//Reports frames delivered once, missing, sent twice, dropped by the full
+//backlog, connections, the largest backlog, latency, and how far the time the
+//server gives each frame is from when it was made.
+//
+//build: g++ -O2 -I. -IInc -ISocket Bench/bench_relay_reconnect.cpp reactor.cpp status_decoder.cpp Src/status_frame.c Src/serial_protocol.c -lpthread -o bench_relay_reconnect
+//usage: ./bench_relay_reconnect [port]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "reactor.h"
+#include "status_decoder.h"
+#include "relay_pipe.h"
+
+using namespace std;
+
+#define MAX_FRAMES	65536	//status frame Seq is 16 bit
+
+static volatile bool running = true;
+static uint16_t port = 65434;
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t now_ms()
+{
+	return (uint32_t)(now_ns() / 1000000ULL);
+}
+
+struct Scenario
+{
+	const char *name;
+	int rate;		//[frames/s]
+	int seconds;		//of production
+	int drop_ms;		//cut every connection this often, 0 never
+	int outage_at_ms;	//stop listening then, for outage_ms
+	int outage_ms;
+};
+
+struct BenchServer
+{
+	DeviceTrack device;
+	uint32_t copies[MAX_FRAMES];	//logged, 1 each when nothing is lost or doubled
+	int64_t wall[MAX_FRAMES];	//[ms] the server's time for the frame
+	uint64_t arrival[MAX_FRAMES];	//[ns]
+	uint32_t duplicates;
+	int drop_ms;			//connections last this long, 0 for ever
+	uint32_t conn_id;		//of the relay connection
+	uint64_t conn_start;		//[ns] its first read
+};
+
+//Same handling as on_message in display.cpp for binary relays
+static void frame_handler(Connection &conn, const char *data, size_t len, void *ctx)
+{
+	BenchServer *server = (BenchServer*)ctx;
+	uint32_t received = conn.frames;
+	size_t pos;
+
+	conn.in.append(data, len);
+	while((pos = conn.in.find((char)TMsg_EOF)) != string::npos) {
+		uint8_t wire[STATUS_FRAME_WIRE_MAX];
+		TStatusFrame status;
+		uint8_t cmd;
+		uint32_t value;
+		int64_t wallMs;
+
+		if(pos < sizeof(wire)) {
+			memcpy(wire, conn.in.data(), pos+1);
+			if(StatusFrame_Decode(&status, wire)) {
+				conn.frames++;
+				if(status_track(server->device, status, now_ms(), conn.age, wallMs)) {
+					server->copies[status.Seq]++;
+					server->wall[status.Seq] = wallMs;
+					server->arrival[status.Seq] = now_ns();
+				}
+				else
+					server->duplicates++;
+				conn.age = -1;
+			}
+			else if(StatusFrame_DecodeControl(wire, &cmd, &value)) {
+				if(cmd == CMD_Relay_Hello)
+					conn.pipelined = (value & RELAY_HELLO_PIPELINE) != 0;
+				else if(cmd == CMD_Relay_Age)
+					conn.age = (int32_t)value;
+			}
+		}
+		conn.in.erase(0, pos+1);
+	}
+	if(conn.id != server->conn_id) {
+		server->conn_id = conn.id;
+		server->conn_start = now_ns();
+	}
+	if(server->drop_ms != 0 && now_ns() - server->conn_start >= (uint64_t)server->drop_ms * 1000000ULL) {
+		//the frames were logged and the relay never hears of it: it sends
+		//them again on the next connection; the reactor sees the hang up
+		shutdown(conn.fd, SHUT_RDWR);
+		return;
+	}
+	if(conn.pipelined && conn.frames != received) {
+		uint8_t ack[STATUS_CONTROL_WIRE_MAX];
+		reactor_send(conn, (const char*)ack, StatusFrame_EncodeControl(ack, CMD_Relay_Ack, conn.frames));
+	}
+}
+
+struct ServerArgs
+{
+	const Scenario *scenario;
+	BenchServer *server;
+	uint64_t start;
+};
+
+//Serves, and is away for the outage
+static void *server_thread(void *arg)
+{
+	ServerArgs *a = (ServerArgs*)arg;
+	const Scenario *sc = a->scenario;
+	uint64_t outage = a->start + (uint64_t)sc->outage_at_ms * 1000000ULL;
+	Reactor reactor;
+
+	if(!reactor_open(reactor, port, frame_handler, a->server))
+		exit(1);
+	while(running) {
+		reactor_poll(reactor, 1);
+		if(sc->outage_ms != 0 && now_ns() >= outage) {
+			reactor_close(reactor);
+			usleep(sc->outage_ms * 1000);
+			if(!reactor_open(reactor, port, frame_handler, a->server))
+				exit(1);
+			outage = ~0ULL;
+		}
+	}
+	reactor_close(reactor);
+	return NULL;
+}
+
+//The UART side: one status frame every period, never waits for the network
+struct Producer
+{
+	RelayPipe *pipe;
+	int rate;
+	int count;
+	uint64_t start;
+	uint64_t produced[MAX_FRAMES];
+};
+
+static void *producer_thread(void *arg)
+{
+	Producer *p = (Producer*)arg;
+	uint64_t period = 1000000000ULL / p->rate;
+	uint64_t next = p->start;
+
+	for(int i=0; i<p->count; i++) {
+		TStatusFrame s;
+
+		memset(&s, 0, sizeof(s));
+		s.DeviceId = 1;
+		s.Seq = (uint16_t)i;
+		p->produced[i] = now_ns();
+		s.TimeStamp = (uint32_t)((p->produced[i] - p->start) / 1000000ULL);	//the nucleo clock
+		s.Activity = STATUS_ACT_WALKING;
+		p->pipe->push(s, now_ms());
+
+		next += period;
+		struct timespec ts = { (time_t)(next / 1000000000ULL), (long)(next % 1000000000ULL) };
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+	}
+	return NULL;
+}
+
+enum LinkState { LINK_DOWN, LINK_CONNECTING, LINK_UP };
+
+//The network loop of Socket/client.cpp on a POSIX socket
+static void run(const Scenario &sc)
+{
+	static BenchServer server;
+	static Producer producer;
+	RelayPipe &pipe = *new RelayPipe();
+	RelayBackoff backoff;
+	char buf[256];
+	int fd = -1;
+	LinkState state = LINK_DOWN;
+	uint32_t retry_ms = 0;
+	uint32_t connections = 0;
+	struct sockaddr_in addr;
+
+	memset(server.copies, 0, sizeof(server.copies));
+	server.device = DeviceTrack();
+	server.duplicates = 0;
+	server.drop_ms = sc.drop_ms;
+	server.conn_id = ~0U;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	running = true;
+	uint64_t start = now_ns();
+	ServerArgs args = { &sc, &server, start };
+	pthread_t st;
+	pthread_create(&st, NULL, server_thread, &args);
+	usleep(10000);
+
+	producer.pipe = &pipe;
+	producer.rate = sc.rate;
+	producer.count = min(sc.rate * sc.seconds, MAX_FRAMES);
+	producer.start = start;
+	pthread_t pt;
+	pthread_create(&pt, NULL, producer_thread, &producer);
+
+	uint64_t deadline = start + (uint64_t)(sc.seconds + sc.outage_ms / 1000 + 30) * 1000000000ULL;
+	while(now_ns() < deadline) {
+		uint32_t now = now_ms();
+		bool idle = true;
+		bool lost = false;
+
+		if(state == LINK_DOWN && (int32_t)(now - retry_ms) >= 0) {
+			int one = 1;
+			fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+			state = LINK_CONNECTING;
+		}
+		if(state == LINK_CONNECTING) {
+			//called again until done, as the mbed socket is
+			if(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0 || errno == EISCONN) {
+				pipe.reconnect();
+				connections++;
+				state = LINK_UP;
+			}
+			else if(errno != EINPROGRESS && errno != EALREADY)
+				lost = true;
+		}
+		if(state == LINK_UP) {
+			const uint8_t *data;
+			size_t n = pipe.ready(now, &data);
+			if(n != 0) {
+				ssize_t r = send(fd, data, n, MSG_NOSIGNAL);
+				if(r > 0) {
+					pipe.sent(r);
+					idle = false;
+				}
+				else if(errno != EAGAIN)
+					lost = true;
+			}
+		}
+		if(state == LINK_UP && !lost) {
+			ssize_t r = recv(fd, buf, sizeof(buf), 0);
+			if(r > 0) {
+				backoff.reset();
+				idle = false;
+				pipe.received((const uint8_t*)buf, r);
+			}
+			else if(r == 0 || errno != EAGAIN)
+				lost = true;
+		}
+		if(lost) {
+			close(fd);
+			state = LINK_DOWN;
+			retry_ms = now + backoff.failed(rand());
+		}
+
+		if(state == LINK_UP && pipe.queued + pipe.dropped == (uint32_t)producer.count
+			&& pipe.backlog() == 0 && pipe.unacked() == 0)
+			break;
+		if(idle)
+			usleep(100);
+	}
+	pthread_join(pt, NULL);
+	if(state != LINK_DOWN)
+		close(fd);
+	running = false;
+	pthread_join(st, NULL);
+
+	uint32_t once = 0, twice = 0, missing = 0;
+	vector<uint64_t> lat;
+	int64_t skew = 0;
+	for(int i=0; i<producer.count; i++) {
+		if(server.copies[i] == 0) {
+			missing++;
+			continue;
+		}
+		if(server.copies[i] == 1)
+			once++;
+		else
+			twice++;
+		lat.push_back(server.arrival[i] - producer.produced[i]);
+		int64_t made = (int64_t)(producer.produced[i] / 1000000ULL);
+		if(llabs(server.wall[i] - made) > skew)
+			skew = llabs(server.wall[i] - made);
+	}
+	sort(lat.begin(), lat.end());
+	printf("%-12s %5d %7d/%-6d %7u %7u %7u %7u %5u %7u %6zu",
+		sc.name, sc.rate, once, producer.count, missing, twice, (unsigned)server.duplicates,
+		(unsigned)pipe.dropped, connections, (unsigned)pipe.resent, pipe.backlog_max);
+	if(lat.empty())
+		printf("\n");
+	else
+		printf(" %8.1f %8.1f %6lld\n", lat[lat.size()/2] / 1e6, lat.back() / 1e6, (long long)skew);
+	delete &pipe;
+}
+
+int main(int argc, char *argv[])
+{
+	static const Scenario scenarios[] = {
+		{ "steady",       200, 3,   0,    0,    0 },
+		{ "up 250ms",      200, 3, 250,    0,    0 },
+		{ "up 100ms",      200, 3, 100,    0,    0 },
+		{ "away 3s",      200, 6,   0, 1000, 3000 },
+		{ "away 8s",      400, 10,  0, 1000, 8000 },
+	};
+
+	port = argc > 1 ? atoi(argv[1]) : 65434;
+	srand(1);
+
+	printf("%-12s %5s %14s %7s %7s %7s %7s %5s %7s %6s %8s %8s %6s\n", "server", "fps", "delivered",
+		"missing", "twice", "resends", "dropped", "conns", "resent", "held", "p50 ms", "max ms", "skew");
+	for(size_t i=0; i<sizeof(scenarios)/sizeof(scenarios[0]); i++)
+		run(scenarios[i]);
+	return 0;
+}
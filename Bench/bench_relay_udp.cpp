@@ -0,0 +1,469 @@
+//Relay to live display over a lossy link: TCP with the RelayPipe against UDP
+//datagrams with a heartbeat
+//
+//Runs the reactor on a local port with the display's handling of both
+//transports (acks and status_track for TCP, recvmmsg batches, datagram_track
+//and the heartbeat for UDP) and a relay built like Socket/client.cpp fed by a
+//producer thread at a fixed rate. Between them a link emulator plays netem:
+//every datagram or TCP segment is delayed by the one way delay plus jitter and
+//lost with the given probability. A lost datagram is gone; a lost segment
+//comes again after the retransmission timeout, doubled at each further loss,
+//and holds up everything sent after it, as TCP delivers in order. Reports
+//statuses shown on the display, never shown, shown out of order (not applied)
+//and the production to display latency.
+//
+//build: g++ -O2 -I. -IInc -ISocket Bench/bench_relay_udp.cpp reactor.cpp status_decoder.cpp Src/status_frame.c Src/serial_protocol.c -lpthread -o bench_relay_udp
+//usage: ./bench_relay_udp [seconds per run] [frames/s] [port]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <time.h>
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+#include "reactor.h"
+#include "status_decoder.h"
+#include "relay_pipe.h"
+
+using namespace std;
+
+#define MAX_FRAMES	65536	//status frame Seq is 16 bit
+#define RTO_MS		200	//Linux minimum retransmission timeout
+
+static volatile bool running = true;
+static double seconds = 5.0;
+static int rate = 200;
+static uint16_t port = 65435;
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t now_ms()
+{
+	return (uint32_t)(now_ns() / 1000000ULL);
+}
+
+struct Scenario
+{
+	bool udp;
+	double loss;
+	int delay_ms;		//one way
+	int jitter_ms;		//added, uniform
+};
+
+//What the display did with each status
+struct BenchServer
+{
+	DeviceTrack device;
+	DatagramTrack relay;
+	uint64_t shown[MAX_FRAMES];	//[ns] 0 if never
+	uint32_t outOfOrder;
+	uint32_t heartbeats;
+};
+
+static void show(BenchServer *server, const TStatusFrame &status)
+{
+	int64_t wallMs;
+	if(status_track(server->device, status, now_ms(), -1, wallMs))
+		server->shown[status.Seq] = now_ns();
+}
+
+//Same handling as on_message in display.cpp for binary relays
+static void frame_handler(Connection &conn, const char *data, size_t len, void *ctx)
+{
+	BenchServer *server = (BenchServer*)ctx;
+	uint32_t received = conn.frames;
+	size_t pos;
+
+	conn.in.append(data, len);
+	while((pos = conn.in.find((char)TMsg_EOF)) != string::npos) {
+		uint8_t wire[STATUS_FRAME_WIRE_MAX];
+		TStatusFrame status;
+		uint8_t cmd;
+		uint32_t value;
+
+		if(pos < sizeof(wire)) {
+			memcpy(wire, conn.in.data(), pos+1);
+			if(StatusFrame_Decode(&status, wire)) {
+				conn.frames++;
+				show(server, status);
+			}
+			else if(StatusFrame_DecodeControl(wire, &cmd, &value) && cmd == CMD_Relay_Hello)
+				conn.pipelined = (value & RELAY_HELLO_PIPELINE) != 0;
+		}
+		conn.in.erase(0, pos+1);
+	}
+	if(conn.pipelined && conn.frames != received) {
+		uint8_t ack[STATUS_CONTROL_WIRE_MAX];
+		reactor_send(conn, (const char*)ack, StatusFrame_EncodeControl(ack, CMD_Relay_Ack, conn.frames));
+	}
+}
+
+//Same handling as on_datagram in display.cpp
+static void datagram_handler(const struct sockaddr_in &, const char *data, size_t len, void *ctx)
+{
+	BenchServer *server = (BenchServer*)ctx;
+	uint8_t kind;
+	uint32_t seq;
+	TStatusFrame status;
+
+	if(!StatusFrame_DecodeDatagram((const uint8_t*)data, len, &kind, &seq, &status))
+		return;
+	if(kind == CMD_Relay_Heartbeat) {
+		server->heartbeats++;
+		if(server->relay.seen && (int32_t)(seq - server->relay.highest) <= 0)
+			return;
+	}
+	DatagramOrder order = datagram_track(server->relay, seq);
+	if(order == DG_REORDERED)
+		server->outOfOrder++;
+	if(order == DG_NEW)
+		show(server, status);
+}
+
+static void *server_thread(void *arg)
+{
+	Reactor *reactor = (Reactor*)arg;
+	while(running)
+		reactor_poll(*reactor, 1);
+	return NULL;
+}
+
+//A datagram or a TCP segment on its way
+struct Packet
+{
+	uint64_t due;
+	string bytes;
+};
+
+//netem in user space, relay side on port+1, server side on port
+struct Link
+{
+	const Scenario *sc;
+	unsigned short xsubi[3];
+	int udp_in;		//relay datagrams
+	int udp_out;		//to the server
+	int listenfd;
+	int relayfd;		//TCP from the relay
+	int serverfd;		//TCP to the server
+	deque<Packet> up;	//to the server
+	deque<Packet> down;	//to the relay
+	uint32_t lost;
+};
+
+static uint64_t one_way(Link &l)
+{
+	return now_ns() + (uint64_t)(l.sc->delay_ms * 1000000.0 + erand48(l.xsubi) * l.sc->jitter_ms * 1000000.0);
+}
+
+static void *link_thread(void *arg)
+{
+	Link &l = *(Link*)arg;
+	struct sockaddr_in server;
+	char buf[4096];
+	uint64_t last_up = 0;	//TCP is in order, nothing overtakes a late segment
+
+	memset(&server, 0, sizeof(server));
+	server.sin_family = AF_INET;
+	server.sin_port = htons(port);
+	server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	while(running) {
+		struct pollfd fds[3];
+		int n = 0;
+		fds[n].fd = l.sc->udp ? l.udp_in : (l.relayfd >= 0 ? l.relayfd : l.listenfd);
+		fds[n++].events = POLLIN;
+		if(l.serverfd >= 0) {
+			fds[n].fd = l.serverfd;
+			fds[n++].events = POLLIN;
+		}
+		poll(fds, n, 1);
+
+		if(l.sc->udp) {
+			ssize_t r;
+			while((r = recv(l.udp_in, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+				if(erand48(l.xsubi) < l.sc->loss) {
+					l.lost++;
+					continue;
+				}
+				Packet p = { one_way(l), string(buf, r) };
+				//jitter reorders datagrams, keep the queue sorted by due time
+				deque<Packet>::iterator it = l.up.end();
+				while(it != l.up.begin() && (it-1)->due > p.due)
+					--it;
+				l.up.insert(it, p);
+			}
+		}
+		else if(l.relayfd < 0) {
+			int one = 1;
+			l.relayfd = accept(l.listenfd, NULL, NULL);
+			if(l.relayfd >= 0) {
+				setsockopt(l.relayfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+				l.serverfd = socket(AF_INET, SOCK_STREAM, 0);
+				setsockopt(l.serverfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+				connect(l.serverfd, (struct sockaddr*)&server, sizeof(server));
+			}
+		}
+		else {
+			ssize_t r;
+			while((r = recv(l.relayfd, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+				//each lost copy costs a retransmission timeout, doubled every time
+				uint64_t due = one_way(l);
+				uint64_t rto = (uint64_t)RTO_MS * 1000000ULL;
+				while(erand48(l.xsubi) < l.sc->loss) {
+					l.lost++;
+					due += rto;
+					rto *= 2;
+				}
+				due = max(due, last_up);
+				last_up = due;
+				Packet p = { due, string(buf, r) };
+				l.up.push_back(p);
+			}
+			while((r = recv(l.serverfd, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+				Packet p = { now_ns() + (uint64_t)l.sc->delay_ms * 1000000ULL, string(buf, r) };
+				l.down.push_back(p);
+			}
+		}
+
+		while(!l.up.empty() && l.up.front().due <= now_ns()) {
+			if(l.sc->udp)
+				sendto(l.udp_out, l.up.front().bytes.data(), l.up.front().bytes.size(), 0,
+					(struct sockaddr*)&server, sizeof(server));
+			else
+				send(l.serverfd, l.up.front().bytes.data(), l.up.front().bytes.size(), MSG_NOSIGNAL);
+			l.up.pop_front();
+		}
+		while(!l.down.empty() && l.down.front().due <= now_ns()) {
+			send(l.relayfd, l.down.front().bytes.data(), l.down.front().bytes.size(), MSG_NOSIGNAL);
+			l.down.pop_front();
+		}
+	}
+	return NULL;
+}
+
+//The UART side: one status every period into the ring the relay reads
+struct Producer
+{
+	SpscRing<TStatusFrame, 4096> uart;
+	int count;
+	uint64_t produced[MAX_FRAMES];
+};
+
+static void *producer_thread(void *arg)
+{
+	Producer *p = (Producer*)arg;
+	uint64_t period = 1000000000ULL / rate;
+	uint64_t start = now_ns();
+	uint64_t next = start;
+
+	for(int i=0; i<p->count; i++) {
+		TStatusFrame s;
+
+		memset(&s, 0, sizeof(s));
+		s.DeviceId = 1;
+		s.Seq = (uint16_t)i;
+		s.TimeStamp = (uint32_t)((now_ns() - start) / 1000000ULL);
+		s.Activity = (uint8_t)(i % STATUS_ACT_COUNT);
+		p->produced[i] = now_ns();
+		p->uart.push(s);
+
+		next += period;
+		struct timespec ts = { (time_t)(next / 1000000000ULL), (long)(next % 1000000000ULL) };
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+	}
+	return NULL;
+}
+
+static int bind_local(int type, uint16_t p)
+{
+	struct sockaddr_in addr;
+	int one = 1;
+	int fd = socket(AF_INET, type, 0);
+
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(p);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if(bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+		perror("bind");
+		exit(1);
+	}
+	return fd;
+}
+
+//The relay loops of Socket/client.cpp on POSIX sockets
+static void run(const Scenario &sc)
+{
+	static BenchServer server;
+	static Producer producer;
+	static Link link;
+	struct sockaddr_in addr;
+
+	memset(server.shown, 0, sizeof(server.shown));
+	server.device = DeviceTrack();
+	server.relay = DatagramTrack();
+	server.outOfOrder = 0;
+	server.heartbeats = 0;
+	while(producer.uart.size() != 0) {
+		TStatusFrame s;
+		producer.uart.pop(s);
+	}
+	producer.count = min((int)(seconds * rate), MAX_FRAMES);
+
+	Reactor reactor;
+	if(!reactor_open(reactor, port, frame_handler, &server) || !reactor_open_udp(reactor, port, datagram_handler))
+		exit(1);
+
+	link.sc = &sc;
+	link.xsubi[0] = 1;
+	link.xsubi[1] = 2;
+	link.xsubi[2] = 3;
+	link.relayfd = -1;
+	link.serverfd = -1;
+	link.up.clear();
+	link.down.clear();
+	link.lost = 0;
+	link.udp_in = bind_local(SOCK_DGRAM, port + 1);
+	link.udp_out = socket(AF_INET, SOCK_DGRAM, 0);
+	link.listenfd = bind_local(SOCK_STREAM, port + 1);
+	listen(link.listenfd, 1);
+
+	running = true;
+	pthread_t st, lt, pt;
+	pthread_create(&st, NULL, server_thread, &reactor);
+	pthread_create(&lt, NULL, link_thread, &link);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port + 1);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	int fd = socket(AF_INET, sc.udp ? SOCK_DGRAM : SOCK_STREAM, 0);
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	if(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+		perror("connect");
+		exit(1);
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+	pthread_create(&pt, NULL, producer_thread, &producer);
+
+	RelayPipe *pipe = new RelayPipe();
+	uint32_t seq = 0;
+	uint32_t beat_ms = now_ms();
+	TStatusFrame last;
+	int taken = 0;
+	uint64_t end = now_ns() + (uint64_t)((seconds + 2.0) * 1e9);
+
+	while(now_ns() < end) {
+		TStatusFrame status;
+		bool idle = true;
+
+		while(producer.uart.pop(status)) {
+			idle = false;
+			taken++;
+			if(sc.udp) {
+				uint8_t dgram[STATUS_DATAGRAM_LEN];
+				send(fd, dgram, StatusFrame_EncodeDatagram(dgram, CMD_Status_Frame, seq, &status), 0);
+				last = status;
+				seq++;
+			}
+			else
+				pipe->push(status, now_ms());
+		}
+		if(sc.udp) {
+			if(seq != 0 && now_ms() - beat_ms >= RELAY_HEARTBEAT_MS) {
+				uint8_t dgram[STATUS_DATAGRAM_LEN];
+				send(fd, dgram, StatusFrame_EncodeDatagram(dgram, CMD_Relay_Heartbeat, seq - 1, &last), 0);
+				beat_ms = now_ms();
+			}
+		}
+		else {
+			const uint8_t *data;
+			size_t n = pipe->ready(now_ms(), &data);
+			if(n != 0) {
+				ssize_t r = send(fd, data, n, MSG_NOSIGNAL);
+				if(r > 0) {
+					pipe->sent(r);
+					idle = false;
+				}
+			}
+			char buf[256];
+			ssize_t r = recv(fd, buf, sizeof(buf), 0);
+			if(r > 0)
+				pipe->received((const uint8_t*)buf, r);
+		}
+		if(taken == producer.count && !sc.udp && pipe->backlog() == 0 && pipe->unacked() == 0)
+			break;
+		if(idle)
+			usleep(100);
+	}
+	//datagrams still in the link
+	usleep((sc.delay_ms + sc.jitter_ms + 10) * 1000);
+	pthread_join(pt, NULL);
+	running = false;
+	pthread_join(lt, NULL);
+	pthread_join(st, NULL);
+	close(fd);
+	if(link.relayfd >= 0)
+		close(link.relayfd);
+	if(link.serverfd >= 0)
+		close(link.serverfd);
+	close(link.listenfd);
+	close(link.udp_in);
+	close(link.udp_out);
+
+	vector<uint64_t> lat;
+	for(int i=0; i<producer.count; i++) {
+		if(server.shown[i] != 0)
+			lat.push_back(server.shown[i] - producer.produced[i]);
+	}
+	sort(lat.begin(), lat.end());
+	printf("%-4s %5.1f %4d %9zu/%-6d %6zu %6u %6u %6.2f",
+		sc.udp ? "udp" : "tcp", sc.loss * 100, sc.delay_ms, lat.size(), producer.count,
+		producer.count - lat.size(), (unsigned)server.outOfOrder, (unsigned)link.lost,
+		sc.udp ? (double)reactor.datagrams / max<uint64_t>(reactor.datagramReads, 1) : 0.0);
+	if(lat.empty())
+		printf("\n");
+	else
+		printf(" %8.1f %8.1f %8.1f %8.1f\n", lat[lat.size()/2] / 1e6, lat[lat.size()*99/100] / 1e6,
+			lat[lat.size()*999/1000] / 1e6, lat.back() / 1e6);
+	reactor_close(reactor);
+	delete pipe;
+}
+
+int main(int argc, char *argv[])
+{
+	static const double losses[] = { 0.0, 0.01, 0.05, 0.2 };
+
+	seconds = argc > 1 ? atof(argv[1]) : 5.0;
+	rate = argc > 2 ? atoi(argv[2]) : 200;
+	port = argc > 3 ? atoi(argv[3]) : 65435;
+
+	printf("%d statuses/s, %d ms RTO\n", rate, RTO_MS);
+	printf("%-4s %5s %4s %16s %6s %6s %6s %6s %8s %8s %8s %8s\n", "link", "loss%", "ms", "shown", "never",
+		"order", "lost", "dg/rd", "p50 ms", "p99 ms", "p99.9", "max ms");
+	for(size_t i=0; i<sizeof(losses)/sizeof(losses[0]); i++) {
+		Scenario tcp = { false, losses[i], 5, 10 };
+		Scenario udp = { true, losses[i], 5, 10 };
+		run(tcp);
+		run(udp);
+	}
+	return 0;
+}
@@ -0,0 +1,199 @@
+//Daily activity reports from the rollups against rescanning the event log
+//
+//Records a synthetic day of several devices at 16 Hz into the event log and
+//the rollups the way display.cpp does: asleep with turn overs at night in SM
+//mode, changing activities in the day.  Times the rollup update per status,
+//then the report a dashboard asks for, minutes in each state and turn overs
+//per night hour for one device and day, read from the rollup file and
+//computed from the event log, and checks the two agree.
+//Then one more device sends ten minutes of live statuses interleaved with
+//ones a relay replays from across the midnight two days before: each of the
+//three days has to be mapped once.
+//
+//build: g++ -O2 -I. -IInc Bench/bench_rollup.cpp rollup.cpp event_log.cpp status_decoder.cpp -lpthread -o bench_rollup
+//usage: ./bench_rollup [directory] [devices] [hours]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "event_log.h"
+#include "rollup.h"
+#include "status_decoder.h"
+
+using namespace std;
+
+#define STEP_MS		62	//16 Hz per device
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void remove_dir(const string &dir)
+{
+	string cmd = "rm -rf " + dir;
+	if(system(cmd.c_str()) != 0)
+		exit(1);
+}
+
+//What a device does at a time of day: asleep from 23 to 7 with a turn over
+//now and then, otherwise an activity held for a few minutes
+struct Wearer
+{
+	unsigned short xsubi[3];
+	uint8_t state;
+	int64_t untilMs;
+};
+
+static void next_status(Wearer &w, int64_t ms, int64_t dayMs, EventRecord &rec)
+{
+	int hour = (int)((ms - dayMs) / ROLLUP_HOUR_MS);
+	bool night = hour >= 23 || hour < 7;
+
+	if(ms >= w.untilMs) {
+		if(night)
+			w.state = (erand48(w.xsubi) < 0.9) ? ST_SLEEPING : ST_NS_LYING;
+		else
+			w.state = (uint8_t)(ST_STATIONARY + (int)(erand48(w.xsubi) * (ST_BIKING - ST_STATIONARY + 1)));
+		w.untilMs = ms + 60000 + (int64_t)(erand48(w.xsubi) * 600000);
+	}
+	rec.ms = ms;
+	rec.state = w.state;
+	rec.flags = (night && erand48(w.xsubi) < 1.0 / (16 * 1200)) ? STATUS_FLAG_TURNOVER : 0;
+	rec.reserved = 0;
+}
+
+int main(int argc, char *argv[])
+{
+	string dir = argc > 1 ? argv[1] : "/tmp/bench_rollup";
+	int devices = argc > 2 ? atoi(argv[2]) : 4;
+	int hours = argc > 3 ? atoi(argv[3]) : 24;
+	//a day starts at midnight UTC+1
+	setenv("TZ", "UTC-1", 1);
+	tzset();
+	int64_t dayMs = rollup_day(1700000000000LL);
+	string events = dir + "/events", rollups = dir + "/rollups";
+	uint64_t t0, addNs = 0;
+
+	remove_dir(dir);
+	if(system(("mkdir -p " + dir).c_str()) != 0)
+		return 1;
+	EventLog *log = new EventLog();
+	Rollups r;
+	if(!event_log_open(*log, events.c_str(), true) || !rollup_open(r, rollups.c_str()))
+		return 1;
+
+	vector<Wearer> wearers(devices);
+	for(int d=0; d<devices; d++) {
+		wearers[d].xsubi[0] = (unsigned short)d;
+		wearers[d].xsubi[1] = 7;
+		wearers[d].xsubi[2] = 11;
+		wearers[d].untilMs = 0;
+	}
+	uint64_t count = 0;
+	for(int64_t ms = dayMs; ms < dayMs + hours * ROLLUP_HOUR_MS; ms += STEP_MS) {
+		for(int d=0; d<devices; d++) {
+			EventRecord rec;
+			rec.device = (uint16_t)d;
+			rec.seq = (uint16_t)count;
+			next_status(wearers[d], ms, dayMs, rec);
+			event_log_append(*log, rec, ms);
+
+			t0 = now_ns();
+			rollup_add(r, rec);
+			addNs += now_ns() - t0;
+			count++;
+		}
+		event_log_tick(*log, ms);
+		rollup_tick(r, ms);
+
+		//a day goes by in seconds here, much faster than the writer thread
+		//syncs: wait for it once a minute so it drops nothing
+		if((ms - dayMs) % ROLLUP_MINUTE_MS < STEP_MS)
+			event_log_commit(*log);
+	}
+	event_log_commit(*log);
+
+	//live and replayed statuses taking turns
+	uint64_t mapped = r.mapped;
+	Wearer replayed = wearers[0];
+	for(int i=0; i<10000; i++) {
+		EventRecord rec;
+		int64_t ms = dayMs + hours * ROLLUP_HOUR_MS - ROLLUP_HOUR_MS + i * STEP_MS;
+		int64_t replayMs = dayMs - 2 * ROLLUP_DAY_MS - 5 * ROLLUP_MINUTE_MS + i * STEP_MS;
+		rec.device = (uint16_t)devices;
+		rec.seq = (uint16_t)i;
+		next_status(replayed, (i % 2) ? replayMs : ms, dayMs, rec);
+		rollup_add(r, rec);
+	}
+	mapped = r.mapped - mapped;
+	rollup_close(r);
+	printf("%llu statuses from %d devices over %d h: rollup update %.1f ns per status, %llu day files mapped\n",
+		(unsigned long long)count, devices, hours, (double)addNs / count, (unsigned long long)r.mapped);
+	printf("live statuses interleaved with replayed days: %llu day files mapped\n", (unsigned long long)mapped);
+	if(mapped != 3)
+		return 1;
+
+	//the report from the rollups
+	const int rounds = 20;
+	RollupDay *day = new RollupDay;
+	uint32_t nightTurnOvers = 0;
+	t0 = now_ns();
+	for(int i=0; i<rounds; i++) {
+		if(!rollup_read(rollups.c_str(), 0, dayMs, *day)) {
+			printf("no rollup for device 0\n");
+			return 1;
+		}
+		nightTurnOvers = 0;
+		for(int h=0; h<24; h++)
+			if(h >= 23 || h < 7)
+				nightTurnOvers += day->hours[h].turnOvers;
+	}
+	double rollupUs = (now_ns() - t0) / 1e3 / rounds;
+
+	//the same report from the raw statuses
+	vector<uint64_t> stateMs(ST_COUNT);
+	uint32_t scanTurnOvers = 0;
+	size_t found = 0;
+	t0 = now_ns();
+	for(int i=0; i<rounds; i++) {
+		vector<EventRecord> recs;
+		found = event_log_query(*log, 0, dayMs, dayMs + ROLLUP_DAY_MS, recs);
+		fill(stateMs.begin(), stateMs.end(), 0);
+		scanTurnOvers = 0;
+		for(size_t k=0; k<recs.size(); k++) {
+			if(k > 0 && recs[k-1].state < ST_COUNT)
+				stateMs[recs[k-1].state] += min(recs[k].ms - recs[k-1].ms, (int64_t)ROLLUP_GAP_MS);
+			int h = (int)((recs[k].ms - dayMs) / ROLLUP_HOUR_MS);
+			if((recs[k].flags & STATUS_FLAG_TURNOVER) && (h >= 23 || h < 7))
+				scanTurnOvers++;
+		}
+	}
+	double scanUs = (now_ns() - t0) / 1e3 / rounds;
+
+	printf("\n%-22s %10s %10s\n", "device 0, one day", "rollup", "event log");
+	int mismatches = 0;
+	for(int st=0; st<ST_COUNT; st++) {
+		if(day->day.stateMs[st] == 0 && stateMs[st] == 0)
+			continue;
+		printf("%-22s %8.1f m %8.1f m\n", status_name(st), day->day.stateMs[st] / 60000.0, stateMs[st] / 60000.0);
+		mismatches += day->day.stateMs[st] != stateMs[st];
+	}
+	printf("%-22s %10u %10u\n", "night turn overs", nightTurnOvers, scanTurnOvers);
+	printf("%-22s %10.1f %10.1f   (%zu statuses scanned)\n", "report us", rollupUs, scanUs, found);
+	if(mismatches != 0 || nightTurnOvers != scanTurnOvers) {
+		printf("rollup and event log disagree, %llu statuses dropped by the event log\n", (unsigned long long)log->dropped);
+		return 1;
+	}
+
+	event_log_close(*log);
+	delete log;
+	delete day;
+	remove_dir(dir);
+	return 0;
+}
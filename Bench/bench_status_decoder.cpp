@@ -0,0 +1,146 @@
+//Status decode throughput, string chain vs perfect hash
+//
+//Replays a recorded message stream, or a synthetic one when no log is given,
+//through the old std::string compare chain and through status_split.  The
+//new path gets the messages packed back to back, 1 to 4 per read, the way
+//they show up when the relay sends faster than the server acks.
+//
+//build: g++ -O2 -I. -IInc Bench/bench_status_decoder.cpp status_decoder.cpp -o bench_status_decoder
+//usage: ./bench_status_decoder [logfile] [rounds]
+//       logfile is the output of ./display -v | tee logfile
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include "status_decoder.h"
+
+using namespace std;
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//what socket_server used to run for every message
+static int chain_decode(const string &msg)
+{
+	static const char *const names[] = {
+		"no activity", "stationary", "standing", "sitting", "lying", "walking",
+		"fast walking", "jogging", "biking", "turn over", "sleeping",
+		"no sleeping, no activity", "no sleeping, stationary", "no sleeping, standing",
+		"no sleeping, sitting", "no sleeping, lying", "no sleeping, walking",
+		"no sleeping, fast walking", "no sleeping, jogging", "no sleeping, biking",
+	};
+	for(size_t i=0; i<sizeof(names)/sizeof(names[0]); i++)
+		if(msg == names[i])
+			return (int)i;
+	return -1;
+}
+
+//status names from a server log, text and frame lines alike
+static void load_log(const char *path, vector<string> &msgs)
+{
+	FILE *f = fopen(path, "r");
+	char line[256];
+
+	if(f == NULL) {
+		perror(path);
+		exit(1);
+	}
+	while(fgets(line, sizeof(line), f) != NULL) {
+		line[strcspn(line, "\r\n")] = '\0';
+		char *msg = strstr(line, ": ");
+		char *next;
+		if(msg == NULL)
+			continue;
+		while((next = strstr(msg + 2, ": ")) != NULL)
+			msg = next;
+		msg += 2;
+
+		bool turnOver = false;
+		size_t len = strlen(msg);
+		if(len > 11 && strcmp(msg + len - 11, ", turn over") == 0) {
+			msg[len - 11] = '\0';
+			turnOver = true;
+		}
+		if(status_lookup(msg, strlen(msg)) != ST_UNKNOWN)
+			msgs.push_back(msg);
+		if(turnOver)
+			msgs.push_back("turn over");
+	}
+	fclose(f);
+}
+
+int main(int argc, char *argv[])
+{
+	int rounds = argc > 2 ? atoi(argv[2]) : 20;
+	vector<string> msgs;
+
+	if(!status_decoder_init()) {
+		printf("no perfect hash seed\n");
+		return 1;
+	}
+
+	if(argc > 1)
+		load_log(argv[1], msgs);
+	else {
+		//SM and AW runs with a turn over now and then
+		uint32_t seed = 12345;
+		for(int i=0; i<100000; i++) {
+			seed = seed * 1103515245u + 12345u;
+			int act = (seed >> 16) % 9;
+			if((i / 1000) & 1)
+				msgs.push_back((seed >> 8) & 1 ? "sleeping" : string("no sleeping, ") + status_name(act));
+			else
+				msgs.push_back(status_name(act));
+			if(i % 200 == 0)
+				msgs.push_back("turn over");
+		}
+	}
+	if(msgs.empty()) {
+		printf("no status messages in %s\n", argv[1]);
+		return 1;
+	}
+
+	//pack the stream into reads
+	vector<string> reads;
+	uint32_t seed = 777;
+	for(size_t i=0; i<msgs.size(); ) {
+		seed = seed * 1103515245u + 12345u;
+		size_t n = 1 + (seed >> 16) % 4;
+		string r;
+		for(size_t k=0; k<n && i<msgs.size(); k++, i++)
+			r += msgs[i];
+		reads.push_back(r);
+	}
+
+	volatile int sink = 0;
+	uint64_t t0 = now_ns();
+	for(int r=0; r<rounds; r++)
+		for(size_t i=0; i<msgs.size(); i++) {
+			string msg(msgs[i].data(), msgs[i].size());
+			sink += chain_decode(msg);
+		}
+	double chainNs = (double)(now_ns() - t0) / ((double)msgs.size() * rounds);
+
+	vector<StatusState> states;
+	size_t decoded = 0;
+	t0 = now_ns();
+	for(int r=0; r<rounds; r++)
+		for(size_t i=0; i<reads.size(); i++) {
+			states.clear();
+			status_split(reads[i].data(), reads[i].size(), states);
+			decoded += states.size();
+		}
+	double splitNs = (double)(now_ns() - t0) / ((double)msgs.size() * rounds);
+
+	printf("messages        %zu in %zu reads, %d rounds\n", msgs.size(), reads.size(), rounds);
+	printf("decoded         %zu of %zu\n", decoded / rounds, msgs.size());
+	printf("string chain    %6.1f ns/msg  %7.2f Mmsg/s  (one message per read only)\n", chainNs, 1000.0 / chainNs);
+	printf("status_split    %6.1f ns/msg  %7.2f Mmsg/s\n", splitNs, 1000.0 / splitNs);
+	return 0;
+}
@@ -0,0 +1,124 @@
+//Binary status frame vs the text path
+//
+//Replays a synthetic status stream (AW and SM mode, with turn overs) through
+//both encodings and reports bytes per event on the UART and TCP legs and the
+//server side decode cost per event.
+//
+//build: g++ -O2 -IInc Bench/bench_status_frame.cpp Src/status_frame.c Src/serial_protocol.c -o bench_status_frame
+//usage: ./bench_status_frame [events]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include "status_frame.h"
+
+using namespace std;
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//the string chain display.cpp runs for every text status
+static int text_decode(const string &msg)
+{
+	static const char *const names[] = {
+		"no activity", "stationary", "standing", "sitting", "lying", "walking",
+		"fast walking", "jogging", "biking", "turn over", "sleeping",
+		"no sleeping, no activity", "no sleeping, stationary", "no sleeping, standing",
+		"no sleeping, sitting", "no sleeping, lying", "no sleeping, walking",
+		"no sleeping, fast walking", "no sleeping, jogging", "no sleeping, biking",
+	};
+	for(size_t i=0; i<sizeof(names)/sizeof(names[0]); i++)
+		if(msg == names[i])
+			return (int)i;
+	return -1;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t n = argc > 1 ? strtoul(argv[1], NULL, 0) : 1000000;
+	vector<TStatusFrame> events(n);
+	vector<string> text;
+	vector< vector<uint8_t> > wire;
+	uint64_t uartText = 0, uartFrame = 0, tcpText = 0, tcpFrame = 0;
+	uint32_t seed = 12345;
+
+	//half AW, half SM; one turn over every 200 SM ticks
+	for(size_t i=0; i<n; i++) {
+		seed = seed * 1103515245u + 12345u;
+		TStatusFrame &s = events[i];
+		s.DeviceId = 0x1234;
+		s.Seq = (uint16_t)i;
+		s.TimeStamp = (uint32_t)(i * 62);
+		s.Mode = ((i / 1000) & 1) ? STATUS_MODE_SM : STATUS_MODE_AW;
+		s.Activity = (seed >> 16) % 9;
+		s.Flags = 0;
+		if(s.Mode == STATUS_MODE_SM) {
+			if((seed >> 8) & 1) {
+				s.Flags |= STATUS_FLAG_SLEEP;
+				s.Activity = STATUS_ACT_UNKNOWN;
+			}
+			if(i % 200 == 0)
+				s.Flags |= STATUS_FLAG_TURNOVER;
+		}
+
+		//text path: 1 letter per status ('n' + activity when awake in SM), ten 'q' per turn over
+		string t;
+		if(s.Mode == STATUS_MODE_SM && (s.Flags & STATUS_FLAG_SLEEP)) {
+			t = "sleeping";
+			uartText += 1;
+		}
+		else if(s.Mode == STATUS_MODE_SM) {
+			t = string("no sleeping, ") + StatusFrame_ActivityName(s.Activity);
+			uartText += 2;
+		}
+		else {
+			t = StatusFrame_ActivityName(s.Activity);
+			uartText += 1;
+		}
+		tcpText += t.size();
+		text.push_back(t);
+		if(s.Flags & STATUS_FLAG_TURNOVER) {
+			uartText += 10;
+			for(int k=0; k<10; k++) {
+				text.push_back("turn over");
+				tcpText += 9;
+			}
+		}
+
+		vector<uint8_t> w(STATUS_FRAME_WIRE_MAX);
+		w.resize(StatusFrame_Encode(&w[0], &s));
+		uartFrame += w.size();
+		tcpFrame += w.size();
+		wire.push_back(w);
+	}
+
+	//server side decode
+	volatile int sink = 0;
+	uint64_t t0 = now_ns();
+	for(size_t i=0; i<text.size(); i++) {
+		string msg(text[i].data(), text[i].size());
+		sink += text_decode(msg);
+	}
+	double textNs = (double)(now_ns() - t0) / n;
+
+	t0 = now_ns();
+	for(size_t i=0; i<n; i++) {
+		TStatusFrame s;
+		if(StatusFrame_Decode(&s, &wire[i][0]))
+			sink += s.Activity;
+	}
+	double frameNs = (double)(now_ns() - t0) / n;
+
+	printf("events                %zu\n", n);
+	printf("                      text     frame\n");
+	printf("uart bytes/event      %-8.2f %.2f\n", (double)uartText / n, (double)uartFrame / n);
+	printf("tcp bytes/event       %-8.2f %.2f\n", (double)tcpText / n, (double)tcpFrame / n);
+	printf("decode ns/event       %-8.1f %.1f\n", textNs, frameNs);
+	return 0;
+}
@@ -0,0 +1,142 @@
+//Batched sensor streaming, wire bytes per sample and host unpack throughput
+//
+//Encodes a synthetic walk (accelerometer, gyroscope, pressure at a fixed
+//ODR) with the nucleo's batch encoder for every batch size from one sample
+//per frame up to a full TMsg, checks that the host decoder gives the samples
+//back bit-exact in its columns, and reports the wire bytes per sample, the
+//UART time per sample at 115200 baud and the decode rate.
+//
+//build: g++ -O2 -IInc Bench/bench_stream_batch.cpp Src/stream_batch.c Src/serial_protocol.c -o bench_stream_batch
+//usage: ./bench_stream_batch [samples] [ODR Hz]
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "stream_batch.h"
+
+using namespace std;
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static vector<TStreamSample> make_samples(size_t count, uint32_t odr)
+{
+	vector<TStreamSample> out(count);
+	for(size_t i=0; i<count; i++) {
+		TStreamSample &s = out[i];
+		float t = (float)i / odr;
+		s.TimeMs = (uint32_t)(i * 1000 / odr);
+		//2 Hz steps with some noise, so the escape bytes show up now and then
+		s.Acc[0] = (int16_t)(300.0f * sinf(12.566f * t) + (rand() % 32));
+		s.Acc[1] = (int16_t)(rand() % 64 - 32);
+		s.Acc[2] = (int16_t)(1000.0f + 250.0f * sinf(12.566f * t + 1.0f));
+		s.Gyr[0] = (int16_t)(rand() % 64 - 32);
+		s.Gyr[1] = (int16_t)(400.0f * sinf(12.566f * t));
+		s.Gyr[2] = (int16_t)(rand() % 64 - 32);
+		s.Pressure = (uint32_t)(1013.25f * 4096.0f) + rand() % 256;
+	}
+	return out;
+}
+
+//encodes the samples as the firmware does, full batches go out stuffed
+static vector<uint8_t> encode(const vector<TStreamSample> &samples, uint8_t sensors, uint8_t n, size_t &frames)
+{
+	static TStreamBatch batch;
+	vector<uint8_t> wire;
+	uint8_t out[2 * TMsg_MaxLen + 1];
+
+	frames = 0;
+	StreamBatch_Start(&batch, 2, sensors, n);
+	auto send = [&]() {
+		CHK_ComputeAndAdd(&batch.Msg);
+		int len = ByteStuffCopy(out, &batch.Msg);
+		wire.insert(wire.end(), out, out + len);
+		StreamBatch_Next(&batch);
+		frames++;
+	};
+	for(const TStreamSample &s : samples) {
+		if(!StreamBatch_Add(&batch, &s)) {
+			send();
+			StreamBatch_Add(&batch, &s);
+		}
+		if(batch.Count == batch.Max)
+			send();
+	}
+	if(batch.Count != 0)
+		send();
+	return wire;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t count = argc > 1 ? strtoul(argv[1], NULL, 0) : 1000000;
+	uint32_t odr = argc > 2 ? strtoul(argv[2], NULL, 0) : 104;
+	const uint8_t sensors = STREAM_BATCH_ACC | STREAM_BATCH_GYR | STREAM_BATCH_PRESSURE;
+	const uint8_t max = StreamBatch_MaxSamples(sensors);
+
+	if(odr == 0 || odr > 1000) {
+		fprintf(stderr, "ODR must be 1..1000 Hz\n");
+		return 1;
+	}
+	vector<TStreamSample> samples = make_samples(count, odr);
+
+	//the columns the host keeps
+	vector<uint32_t> time(count), pres(count);
+	vector<int16_t> acc[3], gyr[3];
+	for(int a=0; a<3; a++) {
+		acc[a].resize(count);
+		gyr[a].resize(count);
+	}
+
+	printf("%zu samples at %u Hz, acc+gyr+pressure, %u samples fit in one TMsg\n", count, odr, max);
+	printf("samples/batch   wire B/sample   uart us/sample   max ODR @115200   unpack Msamples/s\n");
+	const uint8_t sizes[] = { 1, 2, 4, 8, max };
+	for(uint8_t n : sizes) {
+		size_t frames;
+		vector<uint8_t> wire = encode(samples, sensors, n, frames);
+
+		TStreamColumns cols;
+		cols.Capacity = (uint32_t)count;
+		cols.Count = 0;
+		cols.TimeMs = time.data();
+		cols.Pressure = pres.data();
+		for(int a=0; a<3; a++) {
+			cols.Acc[a] = acc[a].data();
+			cols.Gyr[a] = gyr[a].data();
+		}
+
+		uint64_t t0 = now_ns();
+		size_t start = 0, decoded = 0;
+		TStreamBatchHeader header;
+		for(size_t i=0; i<wire.size(); i++) {
+			if(wire[i] != TMsg_EOF)
+				continue;
+			decoded += StreamBatch_Decode(&header, &cols, &wire[start], (uint32_t)(i + 1 - start));
+			start = i + 1;
+		}
+		double ns = (double)(now_ns() - t0);
+
+		bool same = decoded == count;
+		for(size_t i=0; same && i<count; i++) {
+			const TStreamSample &s = samples[i];
+			same = time[i] == s.TimeMs && pres[i] == s.Pressure;
+			for(int a=0; a<3; a++)
+				same = same && acc[a][i] == s.Acc[a] && gyr[a][i] == s.Gyr[a];
+		}
+		if(!same) {
+			fprintf(stderr, "round trip mismatch at %u samples/batch (%zu of %zu decoded)\n", n, decoded, count);
+			return 1;
+		}
+
+		double perSample = (double)wire.size() / count;
+		double uartUs = perSample * 10.0 * 1e6 / 115200.0;
+		printf("%-15u %-15.2f %-16.1f %-17.0f %.1f\n", n, perSample, uartUs, 1e6 / uartUs, count / ns * 1e3);
+	}
+	return 0;
+}
@@ -0,0 +1,190 @@
+//UART receive decoder throughput, rescan vs single pass
+//
+//Feeds a synthetic stream of stuffed frames into the DMA receive ring the way
+//the USART does, a chunk at a time, and polls the old rescanning decoder and
+//the incremental UART_ReceivedView after each chunk.  The payload bytes are
+//TMsg_EOF/TMsg_BS with the given probability, so escape density goes from
+//none (every frame handed out in place) to one in two.
+//
+//build: g++ -O2 -DUSE_HOST_SIM -DUSE_STM32L4XX_NUCLEO -DUSE_IKS01A2 -IHost/Inc -IInc Bench/bench_uart_decoder.cpp Src/com.c Src/serial_protocol.c -o bench_uart_decoder
+//usage: ./bench_uart_decoder [frames] [chunk bytes]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "cube_hal.h"
+#include "com.h"
+
+using namespace std;
+
+//where the DMA has written up to, Get_DMA_Counter counts down from the ring size
+static uint16_t dmaPos = 0;
+
+//the HAL pieces com.c links against; nothing is transmitted here
+GPIO_TypeDef SIM_GPIOB;
+GPIO_TypeDef SIM_GPIOC;
+USART_TypeDef SIM_USART3;
+uint32_t Get_DMA_Flag_Status(DMA_HandleTypeDef *) { return RESET; }
+uint32_t Get_DMA_Counter(DMA_HandleTypeDef *) { return UART_RxBufferSize - dmaPos; }
+void Config_DMA_Handler(DMA_HandleTypeDef *) {}
+void Config_DMA_TxHandler(DMA_HandleTypeDef *) {}
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *) { return HAL_OK; }
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *) { return HAL_OK; }
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *, uint8_t *, uint16_t) { return HAL_OK; }
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef *, uint8_t *, uint16_t) { return HAL_OK; }
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef *) { return HAL_OK; }
+void HAL_GPIO_Init(GPIO_TypeDef *, GPIO_InitTypeDef *) {}
+void HAL_GPIO_DeInit(GPIO_TypeDef *, uint32_t) {}
+void HAL_NVIC_SetPriority(IRQn_Type, uint32_t, uint32_t) {}
+void HAL_NVIC_EnableIRQ(IRQn_Type) {}
+void HAL_Delay(uint32_t) {}
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//UART_ReceivedMSG before the incremental decoder, with its own start index
+static uint16_t legacyStart = 0;
+
+static int legacy_received(TMsg *Msg)
+{
+	uint16_t i, j, k, j2;
+	uint16_t dma_counter, length;
+	uint8_t data;
+	uint16_t source = 0;
+	uint8_t inc;
+
+	dma_counter = dmaPos;
+	if(dma_counter >= legacyStart)
+		length = dma_counter - legacyStart;
+	else
+		length = UART_RxBufferSize + dma_counter - legacyStart;
+	j = legacyStart;
+
+	for(k = 0; k < length; k++) {
+		data = UartRxBuffer[j];
+		j++;
+		if(j >= UART_RxBufferSize)
+			j = 0;
+		if(data == TMsg_EOF) {
+			j = legacyStart;
+			for(i = 0; i < k; i += inc) {
+				j2 = (j + 1U) % UART_RxBufferSize;
+				inc = (uint8_t)ReverseByteStuffCopyByte2(UartRxBuffer[j], UartRxBuffer[j2], &Msg->Data[source]);
+				if(inc == 0) {
+					legacyStart = j2;
+					return 0;
+				}
+				j = (j + inc) % UART_RxBufferSize;
+				source++;
+			}
+			Msg->Len = source;
+			j = (j + 1U) % UART_RxBufferSize;
+			legacyStart = j;
+			if(CHK_CheckAndRemove(Msg) != 0)
+				return 1;
+		}
+	}
+	if(length > TMsg_MaxLen)
+		legacyStart = dma_counter;
+	return 0;
+}
+
+static vector<uint8_t> make_stream(size_t frames, double density, uint32_t &payloadSum)
+{
+	vector<uint8_t> out;
+	uint32_t seed = 12345;
+	TMsg msg;
+	uint8_t wire[TMsg_MaxLen * 2];
+
+	payloadSum = 0;
+	for(size_t f=0; f<frames; f++) {
+		seed = seed * 1103515245u + 12345u;
+		msg.Len = 8 + (seed >> 16) % 57;	//8..64 bytes, status frames to sensor dumps
+		for(uint32_t i=0; i<msg.Len; i++) {
+			seed = seed * 1103515245u + 12345u;
+			if((double)(seed >> 8) / (double)(1u << 24) < density)
+				msg.Data[i] = (seed & 1) ? TMsg_EOF : TMsg_BS;
+			else
+				msg.Data[i] = (uint8_t)((seed >> 16) % 0xF0);
+			payloadSum += msg.Data[i];
+		}
+		CHK_ComputeAndAdd(&msg);
+		int n = ByteStuffCopy(wire, &msg);
+		out.insert(out.end(), wire, wire + n);
+	}
+	return out;
+}
+
+//copies the stream into the ring chunk by chunk, polling after each one
+template <typename Poll>
+static double run(const vector<uint8_t> &stream, size_t chunk, Poll poll)
+{
+	dmaPos = 0;
+	memset((void *)UartRxBuffer, 0, sizeof(UartRxBuffer));
+	uint64_t t0 = now_ns();
+	for(size_t off=0; off<stream.size(); off+=chunk) {
+		size_t n = min(chunk, stream.size() - off);
+		for(size_t i=0; i<n; i++) {
+			UartRxBuffer[dmaPos] = stream[off + i];
+			dmaPos = (dmaPos + 1) % UART_RxBufferSize;
+		}
+		while(poll())
+			;
+	}
+	return (double)(now_ns() - t0);
+}
+
+int main(int argc, char *argv[])
+{
+	size_t frames = argc > 1 ? strtoul(argv[1], NULL, 0) : 200000;
+	size_t chunk = argc > 2 ? strtoul(argv[2], NULL, 0) : 64;
+	const double densities[] = { 0.0, 0.01, 0.05, 0.2, 0.5 };
+
+	if(chunk == 0 || chunk > UART_RxBufferSize / 2) {
+		fprintf(stderr, "chunk must be 1..%u\n", (unsigned)UART_RxBufferSize / 2);
+		return 1;
+	}
+	printf("%zu frames, %zu byte chunks, %u byte ring\n", frames, chunk, (unsigned)UART_RxBufferSize);
+	printf("escapes   wire B/frame   rescan frames/s   single pass frames/s   in place\n");
+	for(double d : densities) {
+		uint32_t expect;
+		vector<uint8_t> stream = make_stream(frames, d, expect);
+		TMsg msg;
+		TMsgView view;
+		size_t nLegacy = 0, nNew = 0, inPlace = 0;
+		uint32_t sumLegacy = 0, sumNew = 0;
+
+		legacyStart = 0;
+		double tLegacy = run(stream, chunk, [&]() {
+			if(!legacy_received(&msg))
+				return false;
+			nLegacy++;
+			for(uint32_t i=0; i<msg.Len; i++)
+				sumLegacy += msg.Data[i];
+			return true;
+		});
+
+		memset(&UartEngine, 0, sizeof(UartEngine));
+		double tNew = run(stream, chunk, [&]() {
+			if(!UART_ReceivedView(&view))
+				return false;
+			nNew++;
+			if(view.Data >= (const uint8_t *)UartRxBuffer && view.Data < (const uint8_t *)UartRxBuffer + UART_RxBufferSize)
+				inPlace++;
+			for(uint32_t i=0; i<view.Len; i++)
+				sumNew += view.Data[i];
+			return true;
+		});
+
+		if(nLegacy != frames || nNew != frames || sumLegacy != expect || sumNew != expect)
+			fprintf(stderr, "mismatch at %.2f: rescan %zu frames, single pass %zu frames\n", d, nLegacy, nNew);
+		printf("%-9.2f %-14.1f %-17.0f %-22.0f %.1f%%\n", d, (double)stream.size() / frames,
+			frames / (tLegacy / 1e9), frames / (tNew / 1e9), 100.0 * inPlace / frames);
+	}
+	return 0;
+}
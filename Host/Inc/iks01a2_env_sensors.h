@@ -0,0 +1,46 @@
+/**
+ *******************************************************************************
+ * @file    iks01a2_env_sensors.h
+ * @brief   Host stand-in for the IKS01A2 environmental sensor BSP, values come
+ *          from the simulator sensor feed (sim_sensors.c).
+ *******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef IKS01A2_ENV_SENSORS_H
+#define IKS01A2_ENV_SENSORS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "nucleo_l476rg_errno.h"
+
+/* Exported defines ----------------------------------------------------------*/
+#define IKS01A2_HTS221_0              0
+#define IKS01A2_LPS22HB_0             1
+
+#define ENV_TEMPERATURE               1U
+#define ENV_PRESSURE                  2U
+#define ENV_HUMIDITY                  4U
+
+/* LPS22HB registers, as in lps22hb_reg.h */
+#define LPS22HB_I2C_ADD_H             0xBBU
+#define LPS22HB_PRESS_OUT_XL          0x28U
+
+/* Exported functions ------------------------------------------------------- */
+int32_t IKS01A2_ENV_SENSOR_Init(uint32_t Instance, uint32_t Functions);
+int32_t IKS01A2_ENV_SENSOR_DeInit(uint32_t Instance);
+int32_t IKS01A2_ENV_SENSOR_Enable(uint32_t Instance, uint32_t Function);
+int32_t IKS01A2_ENV_SENSOR_Disable(uint32_t Instance, uint32_t Function);
+int32_t IKS01A2_ENV_SENSOR_GetValue(uint32_t Instance, uint32_t Function, float *Value);
+int32_t IKS01A2_ENV_SENSOR_GetOutputDataRate(uint32_t Instance, uint32_t Function, float *Odr);
+int32_t IKS01A2_ENV_SENSOR_SetOutputDataRate(uint32_t Instance, uint32_t Function, float Odr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IKS01A2_ENV_SENSORS_H */
@@ -0,0 +1,26 @@
+/**
+ *******************************************************************************
+ * @file    iks01a2_env_sensors_ex.h
+ * @brief   Host stand-in for the IKS01A2 environmental sensor BSP extensions.
+ *******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef IKS01A2_ENV_SENSORS_EX_H
+#define IKS01A2_ENV_SENSORS_EX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "iks01a2_env_sensors.h"
+
+/* Exported functions ------------------------------------------------------- */
+int32_t IKS01A2_ENV_SENSOR_Get_DRDY_Status(uint32_t Instance, uint32_t Function, uint8_t *Status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IKS01A2_ENV_SENSORS_EX_H */
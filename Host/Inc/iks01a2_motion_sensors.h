@@ -0,0 +1,70 @@
+/**
+ *******************************************************************************
+ * @file    iks01a2_motion_sensors.h
+ * @brief   Host stand-in for the IKS01A2 motion sensor BSP, values come from
+ *          the simulator sensor feed (sim_sensors.c).
+ *******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef IKS01A2_MOTION_SENSORS_H
+#define IKS01A2_MOTION_SENSORS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "nucleo_l476rg_errno.h"
+
+/* Exported defines ----------------------------------------------------------*/
+#define IKS01A2_LSM6DSL_0             0
+#define IKS01A2_LSM303AGR_ACC_0       1
+#define IKS01A2_LSM303AGR_MAG_0       2
+
+#define MOTION_GYRO                   1U
+#define MOTION_ACCELERO               2U
+#define MOTION_MAGNETO                4U
+
+/* LSM6DSL registers and settings, as in lsm6dsl_reg.h */
+#define LSM6DSL_I2C_ADD_H             0xD7U
+#define LSM6DSL_INT1_CTRL             0x0DU
+#define LSM6DSL_CTRL6_C               0x15U
+#define LSM6DSL_OUTX_L_G              0x22U
+#define LSM6DSL_OUTX_L_XL             0x28U
+#define LSM6DSL_FIFO_STATUS1          0x3AU
+#define LSM6DSL_FIFO_DATA_OUT_L       0x3EU
+#define LSM6DSL_TAP_CFG               0x58U
+#define LSM6DSL_WAKE_UP_THS           0x5BU
+#define LSM6DSL_WAKE_UP_DUR           0x5CU
+#define LSM6DSL_MD1_CFG               0x5EU
+#define LSM6DSL_BYPASS_MODE           0U
+#define LSM6DSL_STREAM_MODE           6U
+#define LSM6DSL_FIFO_XL_NO_DEC        1U
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct
+{
+  int32_t x;
+  int32_t y;
+  int32_t z;
+} IKS01A2_MOTION_SENSOR_Axes_t;
+
+/* Exported functions ------------------------------------------------------- */
+int32_t IKS01A2_MOTION_SENSOR_Init(uint32_t Instance, uint32_t Functions);
+int32_t IKS01A2_MOTION_SENSOR_DeInit(uint32_t Instance);
+int32_t IKS01A2_MOTION_SENSOR_Enable(uint32_t Instance, uint32_t Function);
+int32_t IKS01A2_MOTION_SENSOR_Disable(uint32_t Instance, uint32_t Function);
+int32_t IKS01A2_MOTION_SENSOR_GetAxes(uint32_t Instance, uint32_t Function, IKS01A2_MOTION_SENSOR_Axes_t *Axes);
+int32_t IKS01A2_MOTION_SENSOR_GetOutputDataRate(uint32_t Instance, uint32_t Function, float *Odr);
+int32_t IKS01A2_MOTION_SENSOR_SetOutputDataRate(uint32_t Instance, uint32_t Function, float Odr);
+int32_t IKS01A2_MOTION_SENSOR_GetFullScale(uint32_t Instance, uint32_t Function, int32_t *Fullscale);
+int32_t IKS01A2_MOTION_SENSOR_SetFullScale(uint32_t Instance, uint32_t Function, int32_t Fullscale);
+int32_t IKS01A2_MOTION_SENSOR_GetSensitivity(uint32_t Instance, uint32_t Function, float *Sensitivity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IKS01A2_MOTION_SENSORS_H */
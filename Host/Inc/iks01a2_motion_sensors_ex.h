@@ -0,0 +1,31 @@
+/**
+ *******************************************************************************
+ * @file    iks01a2_motion_sensors_ex.h
+ * @brief   Host stand-in for the IKS01A2 motion sensor BSP extensions.
+ *******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef IKS01A2_MOTION_SENSORS_EX_H
+#define IKS01A2_MOTION_SENSORS_EX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "iks01a2_motion_sensors.h"
+
+/* Exported functions ------------------------------------------------------- */
+int32_t IKS01A2_MOTION_SENSOR_Get_DRDY_Status(uint32_t Instance, uint32_t Function, uint8_t *Status);
+int32_t IKS01A2_MOTION_SENSOR_Write_Register(uint32_t Instance, uint8_t Reg, uint8_t Data);
+int32_t IKS01A2_MOTION_SENSOR_FIFO_Set_ODR_Value(uint32_t Instance, float Odr);
+int32_t IKS01A2_MOTION_SENSOR_FIFO_Set_Decimation(uint32_t Instance, uint32_t Function, uint8_t Decimation);
+int32_t IKS01A2_MOTION_SENSOR_FIFO_Set_Watermark_Level(uint32_t Instance, uint16_t Watermark);
+int32_t IKS01A2_MOTION_SENSOR_FIFO_Set_Mode(uint32_t Instance, uint8_t Mode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IKS01A2_MOTION_SENSORS_EX_H */
@@ -0,0 +1,59 @@
+/**
+ *******************************************************************************
+ * @file    motion_aw.h
+ * @brief   Host stand-in for the MotionAW library. Same API as the ST library,
+ *          backed by a simple deterministic heuristic (sim_motion.c) so the
+ *          pipeline can run without the Cortex-M4 binary.
+ *******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef MOTION_AW_H
+#define MOTION_AW_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct
+{
+  float AccX;  /* [g] */
+  float AccY;  /* [g] */
+  float AccZ;  /* [g] */
+} MAW_input_t;
+
+typedef enum
+{
+  MAW_NOACTIVITY   = 0x00,
+  MAW_STATIONARY   = 0x01,
+  MAW_STANDING     = 0x02,
+  MAW_SITTING      = 0x03,
+  MAW_LYING        = 0x04,
+  MAW_WALKING      = 0x05,
+  MAW_FASTWALKING  = 0x06,
+  MAW_JOGGING      = 0x07,
+  MAW_BIKING       = 0x08
+} MAW_activity_t;
+
+typedef struct
+{
+  MAW_activity_t current_activity;
+  int32_t confidence;
+} MAW_output_t;
+
+/* Exported functions ------------------------------------------------------- */
+void MotionAW_Initialize(void);
+void MotionAW_SetOrientation_Acc(const char *acc_orientation);
+void MotionAW_Update(MAW_input_t *data_in, MAW_output_t *data_out, int64_t timestamp);
+void MotionAW_Reset(void);
+uint8_t MotionAW_GetLibVersion(char *version);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MOTION_AW_H */
@@ -0,0 +1,51 @@
+/**
+ *******************************************************************************
+ * @file    motion_sm.h
+ * @brief   Host stand-in for the MotionSM sleep monitoring library, backed by
+ *          a simple deterministic heuristic (sim_motion.c).
+ *******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef MOTION_SM_H
+#define MOTION_SM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct
+{
+  float AccX;  /* [g] */
+  float AccY;  /* [g] */
+  float AccZ;  /* [g] */
+} MSM_input_t;
+
+typedef enum
+{
+  MSM_NOSLEEP = 0,
+  MSM_SLEEP   = 1
+} MSM_sleep_flag_t;
+
+typedef struct
+{
+  MSM_sleep_flag_t SleepFlag;
+  uint32_t StillTime;  /* [samples] without significant movement */
+} MSM_output_t;
+
+/* Exported functions ------------------------------------------------------- */
+void MotionSM_Initialize(void);
+void MotionSM_SetOrientation_Acc(const char *acc_orientation);
+void MotionSM_Update(MSM_input_t *data_in, MSM_output_t *data_out);
+void MotionSM_Reset(void);
+uint8_t MotionSM_GetLibVersion(char *version);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MOTION_SM_H */
@@ -0,0 +1,678 @@
+/**
+ *******************************************************************************
+ * @file    sim_hal.h
+ * @brief   Host stand-in for the STM32L4 HAL and Nucleo BSP subset used by the
+ *          firmware, plus the simulator control API. Included by cube_hal.h
+ *          when USE_HOST_SIM is defined.
+ *******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef SIM_HAL_H
+#define SIM_HAL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/* Exported defines ----------------------------------------------------------*/
+#define __IO    volatile
+#define __weak  __attribute__((weak))
+
+#define READ_BIT(REG, BIT)    ((REG) & (BIT))
+#define SET_BIT(REG, BIT)     ((REG) |= (BIT))
+#define CLEAR_BIT(REG, BIT)   ((REG) &= ~(BIT))
+
+/* Clock gates have nothing to do on the host */
+#define __CRC_CLK_ENABLE()      do {} while (0)
+#define __DMA1_CLK_ENABLE()     do {} while (0)
+#define __GPIOB_CLK_ENABLE()    do {} while (0)
+#define __GPIOC_CLK_ENABLE()    do {} while (0)
+#define __USART3_CLK_ENABLE()   do {} while (0)
+#define __USART3_FORCE_RESET()  do {} while (0)
+#define __USART3_RELEASE_RESET() do {} while (0)
+#define __TIM3_CLK_ENABLE()     do {} while (0)
+#define __TIM3_CLK_DISABLE()    do {} while (0)
+#define __HAL_RCC_DMA1_CLK_ENABLE()  do {} while (0)
+#define __HAL_RCC_I2C1_CLK_ENABLE()  do {} while (0)
+#define __HAL_RCC_I2C1_CLK_DISABLE() do {} while (0)
+
+/* No transfer errors on the host */
+#define __HAL_DMA_GET_TE_FLAG_INDEX(__HANDLE__)  0U
+#define __HAL_DMA_GET_FLAG(__HANDLE__, __FLAG__) ((uint32_t)RESET)
+
+#define __HAL_LINKDMA(__HANDLE__, __PPP_DMA_FIELD__, __DMA_HANDLE__) \
+  do {                                                              \
+    (__HANDLE__)->__PPP_DMA_FIELD__ = &(__DMA_HANDLE__);            \
+    (__DMA_HANDLE__).Parent = (__HANDLE__);                         \
+  } while (0)
+
+/* Flash geometry of the STM32L476RG */
+#define FLASH_BASE                    0x08000000UL
+#define FLASH_SIZE                    0x00100000UL
+#define FLASH_BANK_SIZE               (FLASH_SIZE >> 1)
+#define FLASH_PAGE_SIZE               0x00000800UL
+#define FLASH_BANK_1                  0x00000001U
+#define FLASH_BANK_2                  0x00000002U
+#define FLASH_TYPEERASE_PAGES         0x00000000U
+#define FLASH_TYPEERASE_MASSERASE     0x00000001U
+#define FLASH_TYPEPROGRAM_DOUBLEWORD  0x00000000U
+#define FLASH_TYPEPROGRAM_FAST        0x00000001U
+#define FLASH_TYPEPROGRAM_FAST_AND_LAST 0x00000002U
+#define FLASH_FAST_ROW_SIZE           256U
+#define FLASH_FLAG_ALL_ERRORS         0x0000C3FAU
+#define FLASH_LATENCY_4               0x00000004U
+#define __HAL_FLASH_CLEAR_FLAG(__FLAG__)  ((void)(__FLAG__))
+
+#define SYSCFG_MEMRMP_FB_MODE         0x00000100U
+
+#define DEFAULT_POLYNOMIAL_ENABLE     ((uint8_t)0x00)
+#define DEFAULT_INIT_VALUE_ENABLE     ((uint8_t)0x00)
+#define CRC_INPUTDATA_INVERSION_NONE  0x00000000U
+#define CRC_INPUTDATA_INVERSION_BYTE  0x00000020U
+#define CRC_OUTPUTDATA_INVERSION_DISABLE 0x00000000U
+#define CRC_OUTPUTDATA_INVERSION_ENABLE  0x00000080U
+#define CRC_INPUTDATA_FORMAT_BYTES    0x00000001U
+#define CRC_INPUTDATA_FORMAT_WORDS    0x00000003U
+
+/* Flash timings from the STM32L476 datasheet, typical values [us] */
+#define SIM_FLASH_PROGRAM_US          82U
+#define SIM_FLASH_PAGE_ERASE_US       22000U
+#define SIM_FLASH_FAST_ROW_US         1910U      /* 32 double words in fast mode */
+
+/* Sensor register reads on I2C1 at 400 kHz: device address, register, repeated
+   start with the address, then the data, 9 bit times each [us] */
+#define SIM_I2C_READ_US(__LEN__)      ((((__LEN__) + 3U) * 9U * 1000000U) / 400000U)
+/* and writes: device address, register, then the data */
+#define SIM_I2C_WRITE_US(__LEN__)     ((((__LEN__) + 2U) * 9U * 1000000U) / 400000U)
+
+#define GPIO_PIN_5                    ((uint16_t)0x0020)
+#define GPIO_PIN_8                    ((uint16_t)0x0100)
+#define GPIO_PIN_9                    ((uint16_t)0x0200)
+#define GPIO_PIN_10                   ((uint16_t)0x0400)
+#define GPIO_PIN_11                   ((uint16_t)0x0800)
+#define GPIO_PIN_13                   ((uint16_t)0x2000)
+#define GPIO_PIN_14                   ((uint16_t)0x4000)
+#define GPIO_MODE_AF_PP               0x00000002U
+#define GPIO_MODE_AF_OD               0x00000012U
+#define GPIO_MODE_IT_RISING           0x10110000U
+#define GPIO_MODE_IT_FALLING          0x10210000U
+#define GPIO_NOPULL                   0x00000000U
+#define GPIO_PULLUP                   0x00000001U
+#define GPIO_SPEED_FREQ_LOW           0x00000000U
+#define GPIO_SPEED_FREQ_HIGH          0x00000002U
+#define GPIO_SPEED_FREQ_VERY_HIGH     0x00000003U
+#define GPIO_AF4_I2C1                 ((uint8_t)0x04)
+#define GPIO_AF7_USART3               ((uint8_t)0x07)
+
+#define KEY_BUTTON_PIN                GPIO_PIN_13
+
+#define UART_WORDLENGTH_8B            0x00000000U
+#define UART_STOPBITS_1               0x00000000U
+#define UART_PARITY_NONE              0x00000000U
+#define UART_HWCONTROL_NONE           0x00000000U
+#define UART_HWCONTROL_RTS_CTS        0x00000300U
+#define UART_MODE_TX_RX               0x0000000CU
+#define HAL_UART_ERROR_NONE           0x00000000U
+#define HAL_UART_ERROR_DMA            0x00000010U
+#define HAL_UART_STATE_READY          0x00000020U
+#define HAL_UART_STATE_BUSY_TX        0x00000021U
+#define HAL_UART_STATE_BUSY_RX        0x00000022U
+#define UART_IT_IDLE                  0x00100404U
+
+/* The pty bytes are picked up by SIM_Idle, the line idle interrupt has nothing to add */
+#define __HAL_UART_ENABLE_IT(__HANDLE__, __INTERRUPT__)  ((void)(__HANDLE__), (void)(__INTERRUPT__))
+
+#define DMA_PERIPH_TO_MEMORY          0x00000000U
+#define DMA_MEMORY_TO_PERIPH          0x00000010U
+#define DMA_PINC_DISABLE              0x00000000U
+#define DMA_MINC_ENABLE               0x00000080U
+#define DMA_PDATAALIGN_BYTE           0x00000000U
+#define DMA_MDATAALIGN_BYTE           0x00000000U
+#define DMA_NORMAL                    0x00000000U
+#define DMA_CIRCULAR                  0x00000020U
+#define DMA_PRIORITY_LOW              0x00000000U
+#define DMA_PRIORITY_HIGH             0x00002000U
+#define DMA_PRIORITY_VERY_HIGH        0x00003000U
+#define DMA_REQUEST_2                 0x00000002U
+#define DMA_REQUEST_3                 0x00000003U
+
+#define I2C_ADDRESSINGMODE_7BIT       0x00000001U
+#define I2C_DUALADDRESS_DISABLE       0x00000000U
+#define I2C_OA2_NOMASK                ((uint8_t)0x00U)
+#define I2C_GENERALCALL_DISABLE       0x00000000U
+#define I2C_NOSTRETCH_DISABLE         0x00000000U
+#define I2C_ANALOGFILTER_ENABLE       0x00000000U
+#define I2C_MEMADD_SIZE_8BIT          0x00000001U
+#define I2C_MEMADD_SIZE_16BIT         0x00000002U
+#define HAL_I2C_ERROR_NONE            0x00000000U
+
+#define TIM_COUNTERMODE_UP            0x00000000U
+#define TIM_CLOCKDIVISION_DIV1        0x00000000U
+#define TIM_CLOCKSOURCE_INTERNAL      0x00001000U
+#define TIM_TRGO_RESET                0x00000000U
+#define TIM_MASTERSLAVEMODE_DISABLE   0x00000000U
+
+#define __HAL_TIM_GET_COUNTER(__HANDLE__)                 SIM_TimGetCounter(__HANDLE__)
+#define __HAL_TIM_SET_COUNTER(__HANDLE__, __COUNTER__)    SIM_TimSetCounter((__HANDLE__), (__COUNTER__))
+#define __HAL_TIM_SET_AUTORELOAD(__HANDLE__, __AUTORELOAD__)  SIM_TimSetAutoreload((__HANDLE__), (__AUTORELOAD__))
+
+#define RCC_OSCILLATORTYPE_NONE       0x00000000U
+#define RCC_OSCILLATORTYPE_LSE        0x00000004U
+#define RCC_OSCILLATORTYPE_LSI        0x00000008U
+#define RCC_OSCILLATORTYPE_MSI        0x00000010U
+#define RCC_LSE_OFF                   0x00000000U
+#define RCC_LSE_ON                    0x00000001U
+#define RCC_LSI_OFF                   0x00000000U
+#define RCC_LSI_ON                    0x00000001U
+#define RCC_MSI_ON                    0x00000001U
+#define RCC_MSIRANGE_6                0x00000060U
+#define RCC_MSICALIBRATION_DEFAULT    0U
+#define RCC_PLL_NONE                  0x00000000U
+#define RCC_PLL_ON                    0x00000002U
+#define RCC_PLLSOURCE_MSI             0x00000001U
+#define RCC_CLOCKTYPE_SYSCLK          0x00000001U
+#define RCC_CLOCKTYPE_HCLK            0x00000002U
+#define RCC_CLOCKTYPE_PCLK1           0x00000004U
+#define RCC_CLOCKTYPE_PCLK2           0x00000008U
+#define RCC_SYSCLKSOURCE_PLLCLK       0x00000003U
+#define RCC_SYSCLK_DIV1               0x00000000U
+#define RCC_HCLK_DIV1                 0x00000000U
+
+#define RTC_HOURFORMAT_12             0x00000040U
+#define RTC_HOURFORMAT12_AM           ((uint8_t)0x00)
+#define RTC_OUTPUT_DISABLE            0x00000000U
+#define RTC_OUTPUT_POLARITY_HIGH      0x00000000U
+#define RTC_OUTPUT_TYPE_OPENDRAIN     0x00000000U
+#define RTC_MONTH_JANUARY             ((uint8_t)0x01)
+#define RTC_WEEKDAY_MONDAY            ((uint8_t)0x01)
+#define RTC_DAYLIGHTSAVING_NONE       0x00000000U
+#define RTC_STOREOPERATION_RESET      0x00000000U
+#define RTC_FORMAT_BIN                0x00000000U
+#define RTC_FORMAT_BCD                0x00000001U
+#define FORMAT_BIN                    RTC_FORMAT_BIN
+#define FORMAT_BCD                    RTC_FORMAT_BCD
+
+/* Exported types ------------------------------------------------------------*/
+typedef enum
+{
+  HAL_OK       = 0x00,
+  HAL_ERROR    = 0x01,
+  HAL_BUSY     = 0x02,
+  HAL_TIMEOUT  = 0x03
+} HAL_StatusTypeDef;
+
+typedef enum
+{
+  RESET = 0,
+  SET = !RESET
+} FlagStatus;
+
+typedef enum
+{
+  SysTick_IRQn = -1,
+  EXTI9_5_IRQn = 23,
+  EXTI15_10_IRQn = 40,
+  TIM3_IRQn = 29,
+  USART3_IRQn = 39,
+  DMA1_Channel2_IRQn = 12,
+  DMA1_Channel6_IRQn = 16,
+  DMA1_Channel7_IRQn = 17,
+  I2C1_EV_IRQn = 31,
+  I2C1_ER_IRQn = 32,
+  FLASH_IRQn = 4
+} IRQn_Type;
+
+typedef enum
+{
+  GPIO_PIN_RESET = 0,
+  GPIO_PIN_SET
+} GPIO_PinState;
+
+/* Peripheral register blocks, only the fields the firmware touches */
+typedef struct
+{
+  __IO uint32_t CNDTR;
+} DMA_Channel_TypeDef;
+
+typedef struct
+{
+  __IO uint32_t CNT;
+} TIM_TypeDef;
+
+typedef struct
+{
+  __IO uint32_t ISR;
+} USART_TypeDef;
+
+typedef struct
+{
+  __IO uint32_t IDR;
+} GPIO_TypeDef;
+
+typedef struct
+{
+  __IO uint32_t ISR;
+} RTC_TypeDef;
+
+typedef struct
+{
+  __IO uint32_t ISR;
+} I2C_TypeDef;
+
+typedef struct
+{
+  __IO uint32_t MEMRMP;
+} SYSCFG_TypeDef;
+
+typedef struct
+{
+  __IO uint32_t DR;
+} CRC_TypeDef;
+
+typedef struct
+{
+  uint32_t Pin;
+  uint32_t Mode;
+  uint32_t Pull;
+  uint32_t Speed;
+  uint32_t Alternate;
+} GPIO_InitTypeDef;
+
+typedef struct
+{
+  uint32_t Request;
+  uint32_t Direction;
+  uint32_t PeriphInc;
+  uint32_t MemInc;
+  uint32_t PeriphDataAlignment;
+  uint32_t MemDataAlignment;
+  uint32_t Mode;
+  uint32_t Priority;
+} DMA_InitTypeDef;
+
+typedef struct __DMA_HandleTypeDef
+{
+  DMA_Channel_TypeDef *Instance;
+  DMA_InitTypeDef Init;
+  void *Parent;
+} DMA_HandleTypeDef;
+
+typedef struct
+{
+  uint32_t Timing;
+  uint32_t OwnAddress1;
+  uint32_t AddressingMode;
+  uint32_t DualAddressMode;
+  uint32_t OwnAddress2;
+  uint32_t OwnAddress2Masks;
+  uint32_t GeneralCallMode;
+  uint32_t NoStretchMode;
+} I2C_InitTypeDef;
+
+typedef enum
+{
+  HAL_I2C_STATE_RESET   = 0x00U,
+  HAL_I2C_STATE_READY   = 0x20U,
+  HAL_I2C_STATE_BUSY_TX = 0x21U,
+  HAL_I2C_STATE_BUSY_RX = 0x22U
+} HAL_I2C_StateTypeDef;
+
+typedef struct __I2C_HandleTypeDef
+{
+  I2C_TypeDef *Instance;
+  I2C_InitTypeDef Init;
+  uint8_t *pBuffPtr;
+  uint16_t XferSize;
+  DMA_HandleTypeDef *hdmatx;
+  DMA_HandleTypeDef *hdmarx;
+  __IO HAL_I2C_StateTypeDef State;
+  __IO uint32_t ErrorCode;
+} I2C_HandleTypeDef;
+
+typedef struct
+{
+  uint32_t BaudRate;
+  uint32_t WordLength;
+  uint32_t StopBits;
+  uint32_t Parity;
+  uint32_t Mode;
+  uint32_t HwFlowCtl;
+  uint32_t OverSampling;
+} UART_InitTypeDef;
+
+typedef struct __UART_HandleTypeDef
+{
+  USART_TypeDef *Instance;
+  UART_InitTypeDef Init;
+  uint8_t *pTxBuffPtr;
+  uint16_t TxXferSize;
+  uint8_t *pRxBuffPtr;
+  uint16_t RxXferSize;
+  DMA_HandleTypeDef *hdmatx;
+  DMA_HandleTypeDef *hdmarx;
+  __IO uint32_t gState;       /* HAL_UART_STATE_xx of the transmit side */
+  __IO uint32_t RxState;      /* HAL_UART_STATE_xx of the receive side */
+  __IO uint32_t ErrorCode;
+} UART_HandleTypeDef;
+
+typedef struct
+{
+  uint32_t Prescaler;
+  uint32_t CounterMode;
+  uint32_t Period;
+  uint32_t ClockDivision;
+  uint32_t RepetitionCounter;
+  uint32_t AutoReloadPreload;
+} TIM_Base_InitTypeDef;
+
+typedef struct
+{
+  TIM_TypeDef *Instance;
+  TIM_Base_InitTypeDef Init;
+} TIM_HandleTypeDef;
+
+typedef struct
+{
+  uint32_t ClockSource;
+  uint32_t ClockPolarity;
+  uint32_t ClockPrescaler;
+  uint32_t ClockFilter;
+} TIM_ClockConfigTypeDef;
+
+typedef struct
+{
+  uint32_t MasterOutputTrigger;
+  uint32_t MasterSlaveMode;
+} TIM_MasterConfigTypeDef;
+
+typedef struct
+{
+  uint32_t PLLState;
+  uint32_t PLLSource;
+  uint32_t PLLM;
+  uint32_t PLLN;
+  uint32_t PLLP;
+  uint32_t PLLQ;
+  uint32_t PLLR;
+} RCC_PLLInitTypeDef;
+
+typedef struct
+{
+  uint32_t OscillatorType;
+  uint32_t HSEState;
+  uint32_t LSEState;
+  uint32_t HSIState;
+  uint32_t LSIState;
+  uint32_t MSIState;
+  uint32_t MSICalibrationValue;
+  uint32_t MSIClockRange;
+  RCC_PLLInitTypeDef PLL;
+} RCC_OscInitTypeDef;
+
+typedef struct
+{
+  uint32_t ClockType;
+  uint32_t SYSCLKSource;
+  uint32_t AHBCLKDivider;
+  uint32_t APB1CLKDivider;
+  uint32_t APB2CLKDivider;
+} RCC_ClkInitTypeDef;
+
+typedef struct
+{
+  uint32_t HourFormat;
+  uint32_t AsynchPrediv;
+  uint32_t SynchPrediv;
+  uint32_t OutPut;
+  uint32_t OutPutRemap;
+  uint32_t OutPutPolarity;
+  uint32_t OutPutType;
+} RTC_InitTypeDef;
+
+typedef struct
+{
+  RTC_TypeDef *Instance;
+  RTC_InitTypeDef Init;
+} RTC_HandleTypeDef;
+
+typedef struct
+{
+  uint8_t Hours;
+  uint8_t Minutes;
+  uint8_t Seconds;
+  uint8_t TimeFormat;
+  uint32_t SubSeconds;
+  uint32_t SecondFraction;
+  uint32_t DayLightSaving;
+  uint32_t StoreOperation;
+} RTC_TimeTypeDef;
+
+typedef struct
+{
+  uint8_t WeekDay;
+  uint8_t Month;
+  uint8_t Date;
+  uint8_t Year;
+} RTC_DateTypeDef;
+
+typedef struct
+{
+  uint8_t DefaultPolynomialUse;
+  uint8_t DefaultInitValueUse;
+  uint32_t InputDataInversionMode;
+  uint32_t OutputDataInversionMode;
+} CRC_InitTypeDef;
+
+typedef struct
+{
+  CRC_TypeDef *Instance;
+  CRC_InitTypeDef Init;
+  uint32_t InputDataFormat;
+} CRC_HandleTypeDef;
+
+typedef struct
+{
+  uint32_t TypeErase;
+  uint32_t Banks;
+  uint32_t Page;
+  uint32_t NbPages;
+} FLASH_EraseInitTypeDef;
+
+/* Nucleo BSP */
+typedef enum
+{
+  LED2 = 0,
+  LED_GREEN = LED2
+} Led_TypeDef;
+
+typedef enum
+{
+  BUTTON_USER = 0,
+  BUTTON_KEY = BUTTON_USER
+} Button_TypeDef;
+
+typedef enum
+{
+  BUTTON_MODE_GPIO = 0,
+  BUTTON_MODE_EXTI = 1
+} ButtonMode_TypeDef;
+
+/**
+ * @brief  Counters kept by the simulator, printed by SIM_Report
+ */
+typedef struct
+{
+  uint64_t Ticks;            /* TIM_ALGO period elapsed interrupts */
+  uint64_t TickLatencyMax;   /* [us] worst case from a tick to the main loop going idle */
+  uint64_t TickLatencySum;   /* [us] */
+  uint64_t TickOverruns;     /* ticks whose processing outlasted the timer period */
+  uint64_t UartTxBytes;
+  uint64_t UartTxBusy;       /* HAL_UART_Transmit refused while a DMA transfer runs */
+  uint64_t UartTxErrors;     /* DMA transfers ended by an error, SIM_UART_TX_ERRORS */
+  uint64_t UartTxDropped;    /* pty full, nobody reading the other side */
+  uint64_t UartRxBytes;
+  uint64_t UartGarbled;      /* bytes crossing the pty at a rate other than the host's */
+  uint64_t FlashPrograms;    /* double words */
+  uint64_t FlashErases;      /* pages */
+  uint64_t FlashErrors;      /* programming a double word that was not erased */
+  uint64_t FlashRows;        /* of FlashPrograms, fast programmed by row */
+  uint64_t Samples;          /* sensor samples taken from the feed */
+  uint64_t I2cReads;         /* sensor read transactions */
+  uint64_t I2cBytes;         /* data bytes they carried */
+  uint64_t Wakeups;          /* interrupts ending a SIM_Idle */
+  uint64_t I2cBusyUs;        /* [us] the bus was transferring */
+  uint64_t I2cAsync;         /* of I2cReads, by DMA in the background */
+  uint64_t IdleUs;           /* [us] the main loop spent in SIM_Idle */
+} SIM_Stats_t;
+
+/* Exported variables --------------------------------------------------------*/
+extern DMA_Channel_TypeDef SIM_DMA1_Channel2;
+extern DMA_Channel_TypeDef SIM_DMA1_Channel6;
+extern DMA_Channel_TypeDef SIM_DMA1_Channel7;
+extern I2C_TypeDef SIM_I2C1;
+extern TIM_TypeDef SIM_TIM3;
+extern USART_TypeDef SIM_USART3;
+extern GPIO_TypeDef SIM_GPIOB;
+extern GPIO_TypeDef SIM_GPIOC;
+extern RTC_TypeDef SIM_RTC;
+extern SYSCFG_TypeDef SIM_SYSCFG;
+extern CRC_TypeDef SIM_CRC;
+extern SIM_Stats_t SimStats;
+extern uint32_t SystemCoreClock;
+
+#define DMA1_Channel2   (&SIM_DMA1_Channel2)
+#define DMA1_Channel6   (&SIM_DMA1_Channel6)
+#define DMA1_Channel7   (&SIM_DMA1_Channel7)
+#define I2C1            (&SIM_I2C1)
+#define TIM3            (&SIM_TIM3)
+#define USART3          (&SIM_USART3)
+#define GPIOB           (&SIM_GPIOB)
+#define GPIOC           (&SIM_GPIOC)
+#define RTC             (&SIM_RTC)
+#define SYSCFG          (&SIM_SYSCFG)
+#define CRC             (&SIM_CRC)
+
+/* Exported functions ------------------------------------------------------- */
+/* Interrupts are only delivered inside blocking calls and SIM_Idle, so the
+   firmware's critical sections have nothing to mask */
+static inline uint32_t __get_PRIMASK(void)
+{
+  return 0U;
+}
+
+static inline void __set_PRIMASK(uint32_t priMask)
+{
+  (void)priMask;
+}
+
+static inline void __disable_irq(void)
+{
+}
+
+/* Sleep until the next interrupt, see SIM_Wfi */
+#define __WFI()  SIM_Wfi()
+
+HAL_StatusTypeDef HAL_Init(void);
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t Delay);
+uint32_t HAL_GetUIDw0(void);
+uint32_t HAL_GetUIDw1(void);
+uint32_t HAL_GetUIDw2(void);
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority);
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn);
+
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *RCC_OscInitStruct);
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t FLatency);
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init);
+void HAL_GPIO_DeInit(GPIO_TypeDef *GPIOx, uint32_t GPIO_Pin);
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin);
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma);
+HAL_StatusTypeDef HAL_DMA_DeInit(DMA_HandleTypeDef *hdma);
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef *hi2c);
+HAL_I2C_StateTypeDef HAL_I2C_GetState(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2CEx_ConfigAnalogFilter(I2C_HandleTypeDef *hi2c, uint32_t AnalogFilter);
+HAL_StatusTypeDef HAL_I2CEx_ConfigDigitalFilter(I2C_HandleTypeDef *hi2c, uint32_t DigitalFilter);
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                    uint16_t MemAddSize, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                   uint16_t MemAddSize, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                       uint16_t MemAddSize, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                       uint16_t MemAddSize, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData,
+                                          uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_I2C_Master_Receive(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData,
+                                         uint16_t Size, uint32_t Timeout);
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c);
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart);
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef *huart);
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart);
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_ConfigClockSource(TIM_HandleTypeDef *htim, TIM_ClockConfigTypeDef *sClockSourceConfig);
+HAL_StatusTypeDef HAL_TIMEx_MasterConfigSynchronization(TIM_HandleTypeDef *htim, TIM_MasterConfigTypeDef *sMasterConfig);
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef *htim);
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim);
+uint32_t SIM_TimGetCounter(TIM_HandleTypeDef *htim);
+void SIM_TimSetCounter(TIM_HandleTypeDef *htim, uint32_t Counter);
+void SIM_TimSetAutoreload(TIM_HandleTypeDef *htim, uint32_t Autoreload);
+
+HAL_StatusTypeDef HAL_RTC_Init(RTC_HandleTypeDef *hrtc);
+HAL_StatusTypeDef HAL_RTC_SetTime(RTC_HandleTypeDef *hrtc, RTC_TimeTypeDef *sTime, uint32_t Format);
+HAL_StatusTypeDef HAL_RTC_SetDate(RTC_HandleTypeDef *hrtc, RTC_DateTypeDef *sDate, uint32_t Format);
+HAL_StatusTypeDef HAL_RTC_GetTime(RTC_HandleTypeDef *hrtc, RTC_TimeTypeDef *sTime, uint32_t Format);
+HAL_StatusTypeDef HAL_RTC_GetDate(RTC_HandleTypeDef *hrtc, RTC_DateTypeDef *sDate, uint32_t Format);
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data);
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *PageError);
+HAL_StatusTypeDef HAL_FLASH_Program_IT(uint32_t TypeProgram, uint32_t Address, uint64_t Data);
+HAL_StatusTypeDef HAL_FLASHEx_Erase_IT(FLASH_EraseInitTypeDef *pEraseInit);
+void HAL_FLASH_EndOfOperationCallback(uint32_t ReturnValue);
+void HAL_FLASH_OperationErrorCallback(uint32_t ReturnValue);
+
+HAL_StatusTypeDef HAL_CRC_Init(CRC_HandleTypeDef *hcrc);
+uint32_t HAL_CRC_Calculate(CRC_HandleTypeDef *hcrc, uint32_t pBuffer[], uint32_t BufferLength);
+
+void BSP_LED_Init(Led_TypeDef Led);
+void BSP_LED_On(Led_TypeDef Led);
+void BSP_LED_Off(Led_TypeDef Led);
+void BSP_LED_Toggle(Led_TypeDef Led);
+void BSP_PB_Init(Button_TypeDef Button, ButtonMode_TypeDef ButtonMode);
+uint32_t BSP_PB_GetState(Button_TypeDef Button);
+
+/* Simulator control */
+void SIM_Init(void);
+void SIM_Idle(void);
+void SIM_Wfi(void);
+void SIM_Advance(uint64_t Us);
+uint64_t SIM_Now(void);
+void SIM_UartPoll(void);
+void SIM_Report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_HAL_H */
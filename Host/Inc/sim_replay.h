@@ -0,0 +1,28 @@
+/**
+ *******************************************************************************
+ * @file    sim_replay.h
+ * @brief   header for sim_replay.c.
+ *******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef SIM_REPLAY_H
+#define SIM_REPLAY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported functions ------------------------------------------------------- */
+void SIM_ReplayInit(const char *EventsPath);
+void SIM_ReplayTx(const uint8_t *Data, uint32_t Size);
+void SIM_ReplayReport(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_REPLAY_H */
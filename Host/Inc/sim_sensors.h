@@ -0,0 +1,43 @@
+/**
+ *******************************************************************************
+ * @file    sim_sensors.h
+ * @brief   header for sim_sensors.c.
+ *******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef SIM_SENSORS_H
+#define SIM_SENSORS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported types ------------------------------------------------------------*/
+/**
+ * @brief  One row of the sensor feed
+ */
+typedef struct
+{
+  uint32_t TimeMs;    /* [ms] since the start of the trace */
+  int32_t Acc[3];     /* [mg] */
+  int32_t Gyr[3];     /* [mdps] */
+  float Pressure;     /* [hPa] */
+} SIM_Sample_t;
+
+/* Exported functions ------------------------------------------------------- */
+int SIM_SensorOpen(const char *Path);
+uint64_t SIM_SensorEndUs(void);
+const SIM_Sample_t *SIM_SensorAt(uint64_t NowUs);
+uint64_t SIM_SensorNextEvent(void);
+void SIM_SensorFireEvent(void);
+void SIM_SensorRegRead(uint16_t Addr, uint16_t Reg, uint8_t *pData, uint16_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_SENSORS_H */
@@ -0,0 +1,72 @@
+/**
+ *******************************************************************************
+ * @file    sim_trace.h
+ * @brief   header for sim_trace.c.
+ *******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef SIM_TRACE_H
+#define SIM_TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stddef.h>
+#include <stdint.h>
+#include "sim_sensors.h"
+
+/* Exported defines ----------------------------------------------------------*/
+/* Binary trace file, little endian:
+ *  Header (32 bytes) | Record | Record | ...
+ * The record count follows from the file size, so a recorder can keep
+ * appending and a reader can mmap the file and index the records in place.
+ */
+#define SIM_TRACE_MAGIC               "NUCTRACE"
+#define SIM_TRACE_VERSION             1U
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct
+{
+  char Magic[8];
+  uint16_t Version;
+  uint16_t RecordSize;   /* sizeof(SIM_TraceRecord_t) */
+  uint32_t Flags;        /* reserved, 0 */
+  uint8_t Reserved[16];
+} SIM_TraceHeader_t;
+
+/**
+ * @brief  One sample, 20 bytes, naturally aligned after the 32 byte header
+ */
+typedef struct
+{
+  uint32_t TimeMs;       /* [ms] since the start of the recording, not decreasing */
+  int16_t Acc[3];        /* [mg] */
+  int16_t Gyr[3];        /* [0.1 dps] */
+  uint32_t Pressure;     /* [hPa / 4096], LPS22HB output format */
+} SIM_TraceRecord_t;
+
+typedef struct
+{
+  const SIM_TraceRecord_t *Records;
+  size_t Count;
+  void *Map;             /* mmap'ed file, NULL when loaded from CSV */
+  size_t MapLen;
+} SIM_Trace_t;
+
+/* Exported functions ------------------------------------------------------- */
+int SIM_TraceOpen(SIM_Trace_t *Trace, const char *Path);
+void SIM_TraceClose(SIM_Trace_t *Trace);
+size_t SIM_TraceFind(const SIM_Trace_t *Trace, uint32_t TimeMs);
+void SIM_TraceToSample(const SIM_TraceRecord_t *Record, SIM_Sample_t *Sample);
+void SIM_TraceFromSample(const SIM_Sample_t *Sample, SIM_TraceRecord_t *Record);
+void SIM_TraceSynth(uint32_t TimeMs, SIM_Sample_t *Sample);
+void SIM_TraceInitHeader(SIM_TraceHeader_t *Header);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_TRACE_H */
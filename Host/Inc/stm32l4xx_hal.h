@@ -0,0 +1,16 @@
+/**
+ *******************************************************************************
+ * @file    stm32l4xx_hal.h
+ * @brief   Host stand-in for the STM32L4 HAL header included by the BSP bus
+ *          driver, nucleo_l476rg_bus.c.
+ *******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef STM32L4XX_HAL_H
+#define STM32L4XX_HAL_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "sim_hal.h"
+
+#endif /* STM32L4XX_HAL_H */
@@ -0,0 +1,1502 @@
+/**
+ ******************************************************************************
+ * @file    sim_hal.c
+ * @brief   Deterministic host implementation of the HAL and BSP subset used
+ *          by the firmware.
+ *
+ *          Time is virtual and only moves when the firmware waits: SIM_Idle
+ *          (the main loop has nothing to do) jumps to the next event,
+ *          blocking calls such as HAL_UART_Transmit, HAL_Delay, sensor reads
+ *          and flash programming advance it by what they would take on the
+ *          target. Timer, UART DMA and flash completion interrupts that fall
+ *          inside a blocking call are delivered there, as they would preempt
+ *          it on the target.
+ *
+ *          Configuration, read once by HAL_Init:
+ *            SIM_TRACE     sensor trace (binary or CSV, see sim_trace.h), synthetic day if unset
+ *            SIM_SPEED     times real time, 0 runs as fast as possible (default 1)
+ *            SIM_DURATION  [s] to simulate, default end of trace or 60
+ *            SIM_FLASH     file backing the 1 MB flash (default sim_flash.bin)
+ *            SIM_UART      "pty" (default), "none" or a file receiving the TX bytes
+ *            SIM_UART_SPEED "check": bytes cross the pty only when the host set
+ *                          its line speed to the firmware's baud rate
+ *            SIM_EVENTS    CSV file receiving every status change (sim_replay.c)
+ *          SIGUSR1 presses the user button, SIGINT stops with the report.
+ ******************************************************************************
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cube_hal.h"
+#include "com.h"
+#include "DemoDatalog.h"
+#include "sim_replay.h"
+#include "sim_sensors.h"
+
+/** @addtogroup MOTION_APPLICATIONS MOTION APPLICATIONS
+ * @{
+ */
+
+/** @addtogroup HOST_SIMULATION HOST SIMULATION
+ * @{
+ */
+
+/* Private defines -----------------------------------------------------------*/
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE  0x100000
+#endif
+
+#define SIM_CPU_CLOCK        80000000U  /* SystemClock_Config: MSI 4 MHz * 40 / 2 */
+#define SIM_IDLE_STEP_US     1000U      /* idle step when no timer is running */
+#define SIM_DEFAULT_S        60U
+
+/* Private types -------------------------------------------------------------*/
+typedef enum
+{
+  UART_OUT_NONE,
+  UART_OUT_PTY,
+  UART_OUT_FILE
+} UartOut_t;
+
+/* Exported variables --------------------------------------------------------*/
+DMA_Channel_TypeDef SIM_DMA1_Channel2;
+DMA_Channel_TypeDef SIM_DMA1_Channel6;
+DMA_Channel_TypeDef SIM_DMA1_Channel7;
+I2C_TypeDef SIM_I2C1;
+TIM_TypeDef SIM_TIM3;
+USART_TypeDef SIM_USART3;
+GPIO_TypeDef SIM_GPIOB;
+GPIO_TypeDef SIM_GPIOC;
+RTC_TypeDef SIM_RTC;
+SYSCFG_TypeDef SIM_SYSCFG;
+CRC_TypeDef SIM_CRC;
+SIM_Stats_t SimStats;
+uint32_t SystemCoreClock = 80000000U;
+
+/* Normally in stm32l4xx_hal_msp.c, which is not part of the host build */
+int UseLSI = 0;
+
+/* Private variables ---------------------------------------------------------*/
+static uint64_t NowUs = 0;
+static uint64_t EndUs = 0;
+static double Speed = 1.0;
+static struct timespec WallStart;
+
+static TIM_HandleTypeDef *AlgoTim = NULL;
+static uint64_t TimPeriodUs = 0;
+static uint64_t TimNextUs = 0;
+static uint32_t TimStopCount = 0;         /* CNT frozen by HAL_TIM_Base_Stop_IT */
+static uint64_t TicksSinceIdle = 0;
+static uint64_t TickFiredSum = 0;
+static uint64_t TickFiredFirst = 0;
+
+static UartOut_t UartOut = UART_OUT_PTY;
+static int UartFd = -1;
+static uint32_t UartBaud = 115200;
+static int UartSpeedCheck = 0;             /* SIM_UART_SPEED=check */
+static UART_HandleTypeDef *RxUart = NULL;
+static uint16_t RxPos = 0;
+static UART_HandleTypeDef *TxUart = NULL;  /* DMA transfer in progress */
+static uint64_t TxDoneUs = 0;
+static uint32_t TxErrorEvery = 0;          /* SIM_UART_TX_ERRORS, 0 for none */
+static uint32_t TxTransfers = 0;
+static int TxFails = 0;                    /* the transfer in progress ends in an error */
+
+static I2C_HandleTypeDef *I2cXfer = NULL;  /* DMA or interrupt transfer in progress */
+static uint64_t I2cDoneUs = 0;
+
+static uint8_t *FlashMem = NULL;
+static int FlashLocked = 1;
+static int FlashBusy = 0;         /* interrupt driven program or erase in progress */
+static int FlashFailed = 0;
+static uint32_t FlashReturn = 0;  /* for the completion callback */
+static uint64_t FlashDoneUs = 0;
+
+static uint32_t RtcDays = 0;      /* days since 2000-01-01 when the RTC was set */
+static uint32_t RtcSeconds = 0;   /* time of day when the RTC was set */
+static uint64_t RtcSetUs = 0;
+
+static GPIO_PinState ButtonState = GPIO_PIN_SET;
+static volatile sig_atomic_t ButtonRequest = 0;
+static volatile sig_atomic_t StopRequest = 0;
+
+/* Private functions ---------------------------------------------------------*/
+static void Sim_Signal(int Sig)
+{
+  if (Sig == SIGUSR1)
+  {
+    ButtonRequest = 1;
+  }
+  else
+  {
+    StopRequest = 1;
+  }
+}
+
+static uint8_t Bcd2Bin(uint8_t Value, uint32_t Format)
+{
+  return (Format == RTC_FORMAT_BCD) ? (uint8_t)(((Value >> 4) * 10U) + (Value & 0x0FU)) : Value;
+}
+
+static uint8_t Bin2Bcd(uint8_t Value, uint32_t Format)
+{
+  return (Format == RTC_FORMAT_BCD) ? (uint8_t)(((Value / 10U) << 4) | (Value % 10U)) : Value;
+}
+
+/* Days since 2000-01-01 of a date and back, proleptic Gregorian calendar */
+static uint32_t Rtc_Days(uint32_t Year, uint32_t Month, uint32_t Day)
+{
+  uint32_t y = Year + 2000U - ((Month <= 2U) ? 1U : 0U);
+  uint32_t m = (Month <= 2U) ? (Month + 9U) : (Month - 3U);
+
+  return (y * 365U) + (y / 4U) - (y / 100U) + (y / 400U) + (((153U * m) + 2U) / 5U) + Day - 730426U;
+}
+
+static void Rtc_Date(uint32_t Days, RTC_DateTypeDef *Date)
+{
+  uint32_t z = Days + 730425U;
+  uint32_t era = z / 146097U;
+  uint32_t doe = z - (era * 146097U);
+  uint32_t yoe = (doe - (doe / 1460U) + (doe / 36524U) - (doe / 146096U)) / 365U;
+  uint32_t doy = doe - ((365U * yoe) + (yoe / 4U) - (yoe / 100U));
+  uint32_t mp = ((5U * doy) + 2U) / 153U;
+  uint32_t month = (mp < 10U) ? (mp + 3U) : (mp - 9U);
+
+  Date->Date = (uint8_t)(doy - (((153U * mp) + 2U) / 5U) + 1U);
+  Date->Month = (uint8_t)month;
+  Date->Year = (uint8_t)((yoe + (era * 400U) + ((month <= 2U) ? 1U : 0U)) - 2000U);
+  Date->WeekDay = (uint8_t)(((Days + 5U) % 7U) + 1U);  /* 2000-01-01 was a Saturday, Monday is 1 */
+}
+
+/* Seconds since 2000-01-01 now */
+static uint64_t Rtc_Now(void)
+{
+  return ((uint64_t)RtcDays * 86400U) + RtcSeconds + ((NowUs - RtcSetUs) / 1000000U);
+}
+
+static uint64_t Wall_Us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)(ts.tv_sec - WallStart.tv_sec) * 1000000U + (uint64_t)((ts.tv_nsec - WallStart.tv_nsec) / 1000);
+}
+
+/**
+ * @brief  Hold the simulation back to SIM_SPEED times real time
+ * @param  TargetUs simulated time about to be reached [us]
+ * @retval None
+ */
+static void Sim_Pace(uint64_t TargetUs)
+{
+  uint64_t wall;
+  uint64_t due;
+
+  if (Speed <= 0.0)
+  {
+    return;
+  }
+  due = (uint64_t)((double)TargetUs / Speed);
+  wall = Wall_Us();
+  if (due > wall)
+  {
+    usleep((useconds_t)(due - wall));
+  }
+}
+
+static void Sim_FireTimer(void)
+{
+  SimStats.Ticks++;
+  if (TicksSinceIdle == 0U)
+  {
+    TickFiredFirst = NowUs;
+  }
+  TicksSinceIdle++;
+  TickFiredSum += NowUs;
+  HAL_TIM_PeriodElapsedCallback(AlgoTim);
+}
+
+/**
+ * @brief  Time of the next interrupt, UINT64_MAX if none is pending
+ * @param  None
+ * @retval [us]
+ */
+static uint64_t Sim_NextEvent(void)
+{
+  uint64_t next = (AlgoTim != NULL) ? TimNextUs : UINT64_MAX;
+
+  if ((TxUart != NULL) && (TxDoneUs < next))
+  {
+    next = TxDoneUs;
+  }
+  if ((FlashBusy != 0) && (FlashDoneUs < next))
+  {
+    next = FlashDoneUs;
+  }
+  if ((I2cXfer != NULL) && (I2cDoneUs < next))
+  {
+    next = I2cDoneUs;
+  }
+  if (SIM_SensorNextEvent() < next)
+  {
+    next = SIM_SensorNextEvent();
+  }
+  return next;
+}
+
+static void Sim_FireEvent(void)
+{
+  if ((TxUart != NULL) && (TxDoneUs <= NowUs))
+  {
+    UART_HandleTypeDef *huart = TxUart;
+
+    TxUart = NULL;
+    huart->gState = HAL_UART_STATE_READY;
+    if (TxFails != 0)
+    {
+      /* What the HAL does on a DMA transfer error: the transfer is ended
+         and only the error callback runs */
+      huart->ErrorCode |= HAL_UART_ERROR_DMA;
+      SimStats.UartTxErrors++;
+      HAL_UART_ErrorCallback(huart);
+    }
+    else
+    {
+      HAL_UART_TxCpltCallback(huart);
+    }
+  }
+  if ((FlashBusy != 0) && (FlashDoneUs <= NowUs))
+  {
+    FlashBusy = 0;
+    if (FlashFailed != 0)
+    {
+      HAL_FLASH_OperationErrorCallback(FlashReturn);
+    }
+    else
+    {
+      HAL_FLASH_EndOfOperationCallback(FlashReturn);
+    }
+  }
+  if ((I2cXfer != NULL) && (I2cDoneUs <= NowUs))
+  {
+    I2C_HandleTypeDef *hi2c = I2cXfer;
+    HAL_I2C_StateTypeDef state = hi2c->State;
+
+    I2cXfer = NULL;
+    hi2c->State = HAL_I2C_STATE_READY;
+    if (state == HAL_I2C_STATE_BUSY_RX)
+    {
+      HAL_I2C_MemRxCpltCallback(hi2c);
+    }
+    else
+    {
+      HAL_I2C_MemTxCpltCallback(hi2c);
+    }
+  }
+  if ((AlgoTim != NULL) && (TimNextUs <= NowUs))
+  {
+    TimNextUs += TimPeriodUs;
+    Sim_FireTimer();
+  }
+  SIM_SensorFireEvent();
+}
+
+/**
+ * @brief  Run a register transfer on I2C1: the sensors see it when it starts
+ * @param  DevAddress device address
+ * @param  MemAddress first register
+ * @param  pData the bytes written or read
+ * @param  Size number of bytes
+ * @param  Write 1 for a write
+ * @retval [us] the transfer takes on the bus
+ */
+static uint64_t I2c_Transfer(uint16_t DevAddress, uint16_t MemAddress, uint8_t *pData, uint16_t Size, int Write)
+{
+  uint64_t us;
+
+  if (Write != 0)
+  {
+    us = SIM_I2C_WRITE_US((uint64_t)Size);
+  }
+  else
+  {
+    SIM_SensorRegRead(DevAddress, MemAddress, pData, Size);
+    us = SIM_I2C_READ_US((uint64_t)Size);
+    SimStats.I2cReads++;
+    SimStats.I2cBytes += Size;
+  }
+  SimStats.I2cBusyUs += us;
+  return us;
+}
+
+/**
+ * @brief  Time the UART takes to shift bytes out
+ * @param  Size number of bytes
+ * @retval [us], 10 bit times per byte (start, 8 data, stop)
+ */
+static uint64_t Uart_TxUs(uint32_t Size)
+{
+  return ((uint64_t)Size * 10U * 1000000U + UartBaud - 1U) / UartBaud;
+}
+
+/**
+ * @brief  Whether bytes on the pty are garbled, the host having set its line
+ *         speed to another rate than the firmware's
+ * @param  None
+ * @retval 1 if garbled
+ */
+static int Uart_Garbled(void)
+{
+  static const struct
+  {
+    speed_t Speed;
+    uint32_t Baud;
+  } rates[] =
+  {
+    {B9600, 9600U}, {B19200, 19200U}, {B38400, 38400U}, {B57600, 57600U}, {B115200, 115200U},
+    {B230400, 230400U}, {B460800, 460800U}, {B921600, 921600U}, {B1000000, 1000000U},
+    {B1500000, 1500000U}, {B2000000, 2000000U}, {B3000000, 3000000U}, {B4000000, 4000000U}
+  };
+  struct termios tio;
+  speed_t speed;
+  size_t i;
+
+  /* The master reads the termios of the slave, where the host sets them */
+  if ((UartSpeedCheck == 0) || (UartOut != UART_OUT_PTY) || (tcgetattr(UartFd, &tio) != 0))
+  {
+    return 0;
+  }
+  speed = cfgetospeed(&tio);
+  for (i = 0; i < (sizeof(rates) / sizeof(rates[0])); i++)
+  {
+    if (rates[i].Speed == speed)
+    {
+      return (rates[i].Baud != UartBaud) ? 1 : 0;
+    }
+  }
+  return 1;
+}
+
+/* What a byte sampled at the wrong rate turns into, here any other byte */
+static uint8_t Uart_Garble(uint8_t Byte)
+{
+  return (uint8_t)((Byte * 7U) + 0x35U);
+}
+
+static void Uart_Write(const uint8_t *pData, uint16_t Size)
+{
+  uint8_t garbled[TMsg_MaxLen * 2];
+  uint16_t i;
+
+  if ((Size <= sizeof(garbled)) && (Uart_Garbled() != 0))
+  {
+    for (i = 0; i < Size; i++)
+    {
+      garbled[i] = Uart_Garble(pData[i]);
+    }
+    SimStats.UartGarbled += Size;
+    pData = garbled;
+  }
+  if (UartFd >= 0)
+  {
+    ssize_t n = write(UartFd, pData, Size);
+    if (n < (ssize_t)Size)
+    {
+      SimStats.UartTxDropped += (uint64_t)Size - (uint64_t)((n > 0) ? n : 0);
+    }
+  }
+  SimStats.UartTxBytes += Size;
+  SIM_ReplayTx(pData, Size);
+}
+
+static void Flash_Open(const char *Path)
+{
+  struct stat st;
+  void *mem;
+  int fd = open(Path, O_RDWR | O_CREAT, 0644);
+
+  if ((fd < 0) || (fstat(fd, &st) != 0))
+  {
+    perror(Path);
+    exit(1);
+  }
+  if (st.st_size != (off_t)FLASH_SIZE)
+  {
+    /* Fresh device: everything erased */
+    static uint8_t page[FLASH_PAGE_SIZE];
+    uint32_t i;
+
+    memset(page, 0xFF, sizeof(page));
+    if (ftruncate(fd, 0) != 0)
+    {
+      perror(Path);
+      exit(1);
+    }
+    for (i = 0; i < FLASH_SIZE; i += FLASH_PAGE_SIZE)
+    {
+      if (write(fd, page, sizeof(page)) != (ssize_t)sizeof(page))
+      {
+        perror(Path);
+        exit(1);
+      }
+    }
+  }
+
+  /* The firmware reads flash through plain pointers, so map it where it lives.
+     Read-only like the real thing: only HAL_FLASH_Program may change it. */
+  mem = mmap((void *)FLASH_BASE, FLASH_SIZE, PROT_READ, MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+  if (mem != (void *)FLASH_BASE)
+  {
+    fprintf(stderr, "sim: cannot map flash at 0x%08lx: %s\n", (unsigned long)FLASH_BASE, strerror(errno));
+    exit(1);
+  }
+  close(fd);
+  FlashMem = (uint8_t *)mem;
+}
+
+static void Flash_Write(uint32_t Address, const void *Data, size_t Len)
+{
+  /* mprotect works on host pages, which can be larger than a flash page */
+  size_t host_page = (size_t)sysconf(_SC_PAGESIZE);
+  uint8_t *page = FlashMem + ((Address - FLASH_BASE) & ~(host_page - 1U));
+  size_t span = (size_t)(FlashMem + (Address - FLASH_BASE) + Len - page);
+
+  (void)mprotect(page, span, PROT_READ | PROT_WRITE);
+  memcpy(FlashMem + (Address - FLASH_BASE), Data, Len);
+  (void)mprotect(page, span, PROT_READ);
+}
+
+/**
+ * @brief  Check a program operation against the flash rules
+ * @param  TypeProgram FLASH_TYPEPROGRAM_xx
+ * @param  Address destination
+ * @param  Data double word, or address of the row for the fast modes
+ * @retval 1 if the target would program it, 0 if it sets an error flag
+ */
+static int Flash_Programmable(uint32_t TypeProgram, uint32_t Address, uint64_t Data)
+{
+  uint64_t current;
+  uint32_t i;
+
+  if ((FlashLocked != 0) || ((Address & 7U) != 0U) || (Address < FLASH_BASE)
+      || (Address > (FLASH_BASE + FLASH_SIZE - 8U)))
+  {
+    return 0;
+  }
+  if (TypeProgram == FLASH_TYPEPROGRAM_DOUBLEWORD)
+  {
+    /* PROGERR: only an erased double word, or all zeros, can be programmed */
+    memcpy(&current, FlashMem + (Address - FLASH_BASE), sizeof(current));
+    return ((current == UINT64_MAX) || (Data == 0U)) ? 1 : 0;
+  }
+
+  /* Fast programming: a whole row, all of it erased */
+  if (((Address & (FLASH_FAST_ROW_SIZE - 1U)) != 0U) || (Address > (FLASH_BASE + FLASH_SIZE - FLASH_FAST_ROW_SIZE)))
+  {
+    return 0;
+  }
+  for (i = 0; i < FLASH_FAST_ROW_SIZE; i++)
+  {
+    if (FlashMem[Address - FLASH_BASE + i] != 0xFFU)
+    {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief  Erase pages at once, the caller accounts for the time
+ * @param  pEraseInit pages to erase
+ * @param  PageError first page on error
+ * @retval Number of pages erased, 0 on error
+ */
+static uint32_t Flash_ErasePages(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *PageError)
+{
+  static uint8_t erased[FLASH_PAGE_SIZE];
+  uint32_t bank_base = (pEraseInit->Banks == FLASH_BANK_2) ? (FLASH_BASE + FLASH_BANK_SIZE) : FLASH_BASE;
+  uint32_t first = pEraseInit->Page;
+  uint32_t count = pEraseInit->NbPages;
+  uint32_t i;
+
+  if (FlashLocked != 0)
+  {
+    return 0;
+  }
+  if (pEraseInit->TypeErase == FLASH_TYPEERASE_MASSERASE)
+  {
+    first = 0;
+    count = FLASH_BANK_SIZE / FLASH_PAGE_SIZE;
+  }
+  if (first + count > (FLASH_BANK_SIZE / FLASH_PAGE_SIZE))
+  {
+    *PageError = first;
+    return 0;
+  }
+
+  memset(erased, 0xFF, sizeof(erased));
+  for (i = first; i < first + count; i++)
+  {
+    Flash_Write(bank_base + i * FLASH_PAGE_SIZE, erased, sizeof(erased));
+    SimStats.FlashErases++;
+  }
+  *PageError = 0xFFFFFFFFU;
+  return count;
+}
+
+/* A blocking operation waits for the interrupt driven one in progress */
+static void Flash_Wait(void)
+{
+  if (FlashBusy != 0)
+  {
+    SIM_Advance(FlashDoneUs - NowUs);
+  }
+}
+
+static void Uart_Open(const char *Spec, const char *Speed)
+{
+  UartSpeedCheck = ((Speed != NULL) && (strcmp(Speed, "check") == 0)) ? 1 : 0;
+  if ((Spec == NULL) || (strcmp(Spec, "pty") == 0))
+  {
+    struct termios tio;
+    int slave;
+
+    UartOut = UART_OUT_PTY;
+    UartFd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if ((UartFd < 0) || (grantpt(UartFd) != 0) || (unlockpt(UartFd) != 0))
+    {
+      perror("sim: pty");
+      exit(1);
+    }
+
+    /* Raw bytes both ways, TMsg frames are binary. Keeping the slave open
+       lets the firmware run before anything attaches to it. */
+    slave = open(ptsname(UartFd), O_RDWR | O_NOCTTY);
+    if ((slave >= 0) && (tcgetattr(slave, &tio) == 0))
+    {
+      cfmakeraw(&tio);
+      (void)tcsetattr(slave, TCSANOW, &tio);
+    }
+    fprintf(stderr, "sim: uart on %s\n", ptsname(UartFd));
+  }
+  else if (strcmp(Spec, "none") == 0)
+  {
+    UartOut = UART_OUT_NONE;
+  }
+  else
+  {
+    UartOut = UART_OUT_FILE;
+    UartFd = open(Spec, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (UartFd < 0)
+    {
+      perror(Spec);
+      exit(1);
+    }
+  }
+}
+
+/* Exported functions --------------------------------------------------------*/
+/**
+ * @brief  Read the configuration and bring up the fake peripherals
+ * @param  None
+ * @retval None
+ */
+void SIM_Init(void)
+{
+  const char *trace = getenv("SIM_TRACE");
+  const char *speed = getenv("SIM_SPEED");
+  const char *duration = getenv("SIM_DURATION");
+  const char *flash = getenv("SIM_FLASH");
+  const char *txerrors = getenv("SIM_UART_TX_ERRORS");
+
+  memset(&SimStats, 0, sizeof(SimStats));
+  clock_gettime(CLOCK_MONOTONIC, &WallStart);
+  NowUs = 0;
+
+  if (speed != NULL)
+  {
+    Speed = atof(speed);
+  }
+  if (SIM_SensorOpen(trace) == 0)
+  {
+    exit(1);
+  }
+  if (duration != NULL)
+  {
+    EndUs = (uint64_t)(atof(duration) * 1000000.0);
+  }
+  else if (trace != NULL)
+  {
+    EndUs = SIM_SensorEndUs();
+  }
+  else
+  {
+    EndUs = (uint64_t)SIM_DEFAULT_S * 1000000U;
+  }
+
+  Flash_Open((flash != NULL) ? flash : "sim_flash.bin");
+  Uart_Open(getenv("SIM_UART"), getenv("SIM_UART_SPEED"));
+  if (txerrors != NULL)
+  {
+    TxErrorEvery = (uint32_t)atoi(txerrors);
+  }
+  SIM_ReplayInit(getenv("SIM_EVENTS"));
+
+  (void)signal(SIGUSR1, Sim_Signal);
+  (void)signal(SIGINT, Sim_Signal);
+  (void)signal(SIGTERM, Sim_Signal);
+}
+
+/**
+ * @brief  Simulated time
+ * @param  None
+ * @retval [us] since HAL_Init
+ */
+uint64_t SIM_Now(void)
+{
+  return NowUs;
+}
+
+/**
+ * @brief  Let simulated time pass, delivering the timer interrupts on the way
+ * @param  Us time to pass [us]
+ * @retval None
+ */
+void SIM_Advance(uint64_t Us)
+{
+  uint64_t target = NowUs + Us;
+  uint64_t next;
+
+  while ((next = Sim_NextEvent()) <= target)
+  {
+    Sim_Pace(next);
+    NowUs = next;
+    Sim_FireEvent();
+  }
+  Sim_Pace(target);
+  NowUs = target;
+}
+
+/**
+ * @brief  The main loop has nothing to do: close the latency books for the
+ *         ticks handled since the last call and sleep until the next event
+ * @param  None
+ * @retval None
+ */
+void SIM_Idle(void)
+{
+  uint64_t from;
+
+  /* A tick is handled once its reads, queued in the background, are taken */
+  if ((TicksSinceIdle != 0U) && (I2cXfer == NULL))
+  {
+    uint64_t latency = NowUs - TickFiredFirst;
+
+    if (latency > SimStats.TickLatencyMax)
+    {
+      SimStats.TickLatencyMax = latency;
+    }
+    if (latency >= TimPeriodUs)
+    {
+      SimStats.TickOverruns += TicksSinceIdle;
+    }
+    SimStats.TickLatencySum += TicksSinceIdle * NowUs - TickFiredSum;
+    TicksSinceIdle = 0;
+    TickFiredSum = 0;
+  }
+
+  if ((NowUs >= EndUs) || (StopRequest != 0))
+  {
+    SIM_Report();
+    exit(0);
+  }
+
+  SIM_UartPoll();
+  if (ButtonRequest != 0)
+  {
+    ButtonRequest = 0;
+    ButtonState = GPIO_PIN_RESET;
+    HAL_GPIO_EXTI_Callback(KEY_BUTTON_PIN);
+    ButtonState = GPIO_PIN_SET;
+    return;
+  }
+
+  from = NowUs;
+  if (Sim_NextEvent() <= EndUs)
+  {
+    SimStats.Wakeups++;
+    SIM_Advance(Sim_NextEvent() - NowUs);
+  }
+  else
+  {
+    SIM_Advance((EndUs - NowUs < SIM_IDLE_STEP_US) ? (EndUs - NowUs) : SIM_IDLE_STEP_US);
+  }
+  SimStats.IdleUs += NowUs - from;
+}
+
+/**
+ * @brief  __WFI: the firmware waits for an interrupt in the middle of its
+ *         work, e.g. for the I2C1 queue to drain; the time counts as busy
+ * @param  None
+ * @retval None
+ */
+void SIM_Wfi(void)
+{
+  uint64_t next = Sim_NextEvent();
+
+  SIM_Advance((next != UINT64_MAX) ? (next - NowUs) : SIM_IDLE_STEP_US);
+}
+
+/**
+ * @brief  Move bytes written to the pty into the DMA receive buffer
+ * @param  None
+ * @retval None
+ */
+void SIM_UartPoll(void)
+{
+  uint8_t buf[256];
+  ssize_t n;
+  ssize_t i;
+  int garbled;
+
+  if ((UartOut != UART_OUT_PTY) || (RxUart == NULL))
+  {
+    return;
+  }
+  while ((n = read(UartFd, buf, sizeof(buf))) > 0)
+  {
+    garbled = Uart_Garbled();
+    for (i = 0; (garbled != 0) && (i < n); i++)
+    {
+      buf[i] = Uart_Garble(buf[i]);
+    }
+    if (garbled != 0)
+    {
+      SimStats.UartGarbled += (uint64_t)n;
+    }
+    for (i = 0; i < n; i++)
+    {
+      RxUart->pRxBuffPtr[RxPos] = buf[i];
+      RxPos = (uint16_t)((RxPos + 1U) % RxUart->RxXferSize);
+    }
+    SimStats.UartRxBytes += (uint64_t)n;
+
+    /* CNDTR counts down and reloads in circular mode */
+    RxUart->hdmarx->Instance->CNDTR = (uint32_t)RxUart->RxXferSize - RxPos;
+  }
+}
+
+/* Flush counters of the datalog staging buffer, DemoDatalog.c */
+static void Sim_DatalogReport(void)
+{
+  const DatalogStats_t *stats = Datalog_GetStats();
+  uint32_t b;
+
+  if (stats->Flushes == 0U)
+  {
+    return;
+  }
+  fprintf(stderr, "sim: datalog %lu flushes (%lu on deadline), %lu bytes, %.1f per flush, max %lu, staged max %lu\n",
+          (unsigned long)stats->Flushes, (unsigned long)stats->DeadlineFlushes, (unsigned long)stats->Bytes,
+          (double)stats->Bytes / (double)stats->Flushes, (unsigned long)stats->BytesMax,
+          (unsigned long)stats->StagedMax);
+  fprintf(stderr, "sim: datalog %lu fast rows, %lu single records, %lu erases, %lu errors\n",
+          (unsigned long)stats->Rows, (unsigned long)stats->DoubleWords, (unsigned long)stats->Erases,
+          (unsigned long)stats->Errors);
+  fprintf(stderr, "sim: datalog flush latency");
+  for (b = 0; b < DATALOG_LATENCY_BUCKETS; b++)
+  {
+    fprintf(stderr, "%s %s%u ms %lu", (b == 0U) ? "" : ",", (b == (DATALOG_LATENCY_BUCKETS - 1U)) ? ">=" : "<",
+            (b == (DATALOG_LATENCY_BUCKETS - 1U)) ? (1U << (b - 1U)) : (1U << b), (unsigned long)stats->Latency[b]);
+  }
+  fprintf(stderr, "\n");
+}
+
+/**
+ * @brief  Print the run summary on stderr
+ * @param  None
+ * @retval None
+ */
+void SIM_Report(void)
+{
+  double wall = (double)Wall_Us() / 1e6;
+  double sim = (double)NowUs / 1e6;
+
+  fprintf(stderr, "sim: %.3f s simulated in %.3f s wall (%.0fx real time)\n", sim, wall,
+          (wall > 0.0) ? (sim / wall) : 0.0);
+  fprintf(stderr, "sim: %llu ticks, %.2f us wall per tick\n", (unsigned long long)SimStats.Ticks,
+          (SimStats.Ticks != 0U) ? (wall * 1e6 / (double)SimStats.Ticks) : 0.0);
+  fprintf(stderr, "sim: tick latency max %.3f ms, mean %.3f ms, %llu overruns\n",
+          (double)SimStats.TickLatencyMax / 1000.0,
+          (SimStats.Ticks != 0U) ? ((double)SimStats.TickLatencySum / (double)SimStats.Ticks / 1000.0) : 0.0,
+          (unsigned long long)SimStats.TickOverruns);
+  fprintf(stderr, "sim: uart tx %llu bytes (%llu dropped, %llu refused busy, %llu transfers failed), rx %llu bytes\n",
+          (unsigned long long)SimStats.UartTxBytes, (unsigned long long)SimStats.UartTxDropped,
+          (unsigned long long)SimStats.UartTxBusy, (unsigned long long)SimStats.UartTxErrors,
+          (unsigned long long)SimStats.UartRxBytes);
+  fprintf(stderr, "sim: uart at %lu baud%s, %llu bytes garbled by a host at another rate\n", (unsigned long)UartBaud,
+          (UsartRtsCts != 0U) ? " RTS/CTS" : "",
+          (unsigned long long)SimStats.UartGarbled);
+  fprintf(stderr, "sim: uart tx queue high water %u of %u bytes, %lu messages dropped, %lu transfers dropped on error\n",
+          (unsigned)UartTxHighWater, (unsigned)UART_TxRingSize, (unsigned long)UartTxOverruns,
+          (unsigned long)UartTxErrors);
+  fprintf(stderr, "sim: flash %llu double words programmed (%llu fast rows), %llu pages erased, %llu errors\n",
+          (unsigned long long)SimStats.FlashPrograms, (unsigned long long)SimStats.FlashRows,
+          (unsigned long long)SimStats.FlashErases, (unsigned long long)SimStats.FlashErrors);
+  Sim_DatalogReport();
+  fprintf(stderr, "sim: %llu sensor samples, %llu I2C reads (%llu bytes, %llu by DMA), %llu wakeups\n",
+          (unsigned long long)SimStats.Samples, (unsigned long long)SimStats.I2cReads,
+          (unsigned long long)SimStats.I2cBytes, (unsigned long long)SimStats.I2cAsync,
+          (unsigned long long)SimStats.Wakeups);
+  fprintf(stderr, "sim: main loop busy %.3f %% of the time, I2C bus %.3f %%\n",
+          (NowUs != 0U) ? (100.0 * (double)(NowUs - SimStats.IdleUs) / (double)NowUs) : 0.0,
+          (NowUs != 0U) ? (100.0 * (double)SimStats.I2cBusyUs / (double)NowUs) : 0.0);
+  SIM_ReplayReport();
+}
+
+HAL_StatusTypeDef HAL_Init(void)
+{
+  SIM_Init();
+  return HAL_OK;
+}
+
+uint32_t HAL_GetTick(void)
+{
+  return (uint32_t)(NowUs / 1000U);
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+  SIM_Advance((uint64_t)Delay * 1000U);
+}
+
+uint32_t HAL_GetUIDw0(void)
+{
+  return 0x00350041U;
+}
+
+uint32_t HAL_GetUIDw1(void)
+{
+  return 0x3536510AU;
+}
+
+uint32_t HAL_GetUIDw2(void)
+{
+  return 0x20353550U;
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority)
+{
+  (void)IRQn;
+  (void)PreemptPriority;
+  (void)SubPriority;
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+  (void)IRQn;
+}
+
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+  (void)IRQn;
+}
+
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *RCC_OscInitStruct)
+{
+  (void)RCC_OscInitStruct;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t FLatency)
+{
+  (void)RCC_ClkInitStruct;
+  (void)FLatency;
+  return HAL_OK;
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init)
+{
+  (void)GPIOx;
+  (void)GPIO_Init;
+}
+
+void HAL_GPIO_DeInit(GPIO_TypeDef *GPIOx, uint32_t GPIO_Pin)
+{
+  (void)GPIOx;
+  (void)GPIO_Pin;
+}
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma)
+{
+  hdma->Instance->CNDTR = 0;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_DeInit(DMA_HandleTypeDef *hdma)
+{
+  (void)hdma;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c)
+{
+  hi2c->State = HAL_I2C_STATE_READY;
+  hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef *hi2c)
+{
+  hi2c->State = HAL_I2C_STATE_RESET;
+  return HAL_OK;
+}
+
+HAL_I2C_StateTypeDef HAL_I2C_GetState(I2C_HandleTypeDef *hi2c)
+{
+  return hi2c->State;
+}
+
+HAL_StatusTypeDef HAL_I2CEx_ConfigAnalogFilter(I2C_HandleTypeDef *hi2c, uint32_t AnalogFilter)
+{
+  (void)hi2c;
+  (void)AnalogFilter;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2CEx_ConfigDigitalFilter(I2C_HandleTypeDef *hi2c, uint32_t DigitalFilter)
+{
+  (void)hi2c;
+  (void)DigitalFilter;
+  return HAL_OK;
+}
+
+/* Blocking transfers are refused while one runs in the background, as the
+   HAL does with the handle busy */
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                    uint16_t MemAddSize, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+  (void)MemAddSize;
+  (void)Timeout;
+
+  if (hi2c->State != HAL_I2C_STATE_READY)
+  {
+    return HAL_BUSY;
+  }
+  SIM_Advance(I2c_Transfer(DevAddress, MemAddress, pData, Size, 1));
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                   uint16_t MemAddSize, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+  (void)MemAddSize;
+  (void)Timeout;
+
+  if (hi2c->State != HAL_I2C_STATE_READY)
+  {
+    return HAL_BUSY;
+  }
+  SIM_Advance(I2c_Transfer(DevAddress, MemAddress, pData, Size, 0));
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                       uint16_t MemAddSize, uint8_t *pData, uint16_t Size)
+{
+  (void)MemAddSize;
+
+  if (hi2c->State != HAL_I2C_STATE_READY)
+  {
+    return HAL_BUSY;
+  }
+  hi2c->State = HAL_I2C_STATE_BUSY_TX;
+  I2cXfer = hi2c;
+  I2cDoneUs = NowUs + I2c_Transfer(DevAddress, MemAddress, pData, Size, 1);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read_DMA(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                       uint16_t MemAddSize, uint8_t *pData, uint16_t Size)
+{
+  (void)MemAddSize;
+
+  if (hi2c->State != HAL_I2C_STATE_READY)
+  {
+    return HAL_BUSY;
+  }
+
+  /* The registers are latched now, the completion interrupt comes when the
+     last byte would be in memory */
+  hi2c->State = HAL_I2C_STATE_BUSY_RX;
+  I2cXfer = hi2c;
+  I2cDoneUs = NowUs + I2c_Transfer(DevAddress, MemAddress, pData, Size, 0);
+  SimStats.I2cAsync++;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData,
+                                          uint16_t Size, uint32_t Timeout)
+{
+  (void)DevAddress;
+  (void)pData;
+  (void)Timeout;
+
+  if (hi2c->State != HAL_I2C_STATE_READY)
+  {
+    return HAL_BUSY;
+  }
+  /* Device address, then the data */
+  SIM_Advance((((uint64_t)Size + 1U) * 9U * 1000000U) / 400000U);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Receive(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData,
+                                         uint16_t Size, uint32_t Timeout)
+{
+  (void)DevAddress;
+  (void)Timeout;
+
+  if (hi2c->State != HAL_I2C_STATE_READY)
+  {
+    return HAL_BUSY;
+  }
+  memset(pData, 0, Size);
+  /* Device address, then the data */
+  SIM_Advance((((uint64_t)Size + 1U) * 9U * 1000000U) / 400000U);
+  return HAL_OK;
+}
+
+/* Weak like in the HAL, the bus driver overrides them */
+__weak void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+  (void)hi2c;
+}
+
+__weak void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+  (void)hi2c;
+}
+
+__weak void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+  (void)hi2c;
+}
+
+/* RTS/CTS is accepted but not modelled, the pty never makes the firmware wait */
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart)
+{
+  UartBaud = huart->Init.BaudRate;
+  huart->gState = HAL_UART_STATE_READY;
+  huart->RxState = HAL_UART_STATE_READY;
+  huart->ErrorCode = HAL_UART_ERROR_NONE;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+  (void)huart;
+  (void)Timeout;
+
+  if (TxUart != NULL)
+  {
+    /* gState is busy until the DMA transfer completes */
+    SimStats.UartTxBusy++;
+    return HAL_BUSY;
+  }
+  Uart_Write(pData, Size);
+  SIM_Advance(Uart_TxUs(Size));
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+  if (TxUart != NULL)
+  {
+    SimStats.UartTxBusy++;
+    return HAL_BUSY;
+  }
+
+  /* The bytes leave now, the completion interrupt comes when the last one
+     would be out of the shift register; a failing transfer stops halfway */
+  TxTransfers++;
+  TxFails = ((TxErrorEvery != 0U) && ((TxTransfers % TxErrorEvery) == 0U)) ? 1 : 0;
+  huart->pTxBuffPtr = pData;
+  huart->TxXferSize = Size;
+  huart->gState = HAL_UART_STATE_BUSY_TX;
+  Uart_Write(pData, (TxFails != 0) ? (uint16_t)(Size / 2U) : Size);
+  TxUart = huart;
+  TxDoneUs = NowUs + Uart_TxUs(Size);
+  return HAL_OK;
+}
+
+/* Weak like in the HAL, the firmware overrides them when it uses them */
+__weak void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+  (void)huart;
+}
+
+__weak void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+  (void)huart;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+  if (huart->RxState == HAL_UART_STATE_BUSY_RX)
+  {
+    return HAL_BUSY;
+  }
+  huart->pRxBuffPtr = pData;
+  huart->RxXferSize = Size;
+  huart->RxState = HAL_UART_STATE_BUSY_RX;
+  huart->hdmarx->Instance->CNDTR = Size;
+  RxUart = huart;
+  RxPos = 0;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef *huart)
+{
+  huart->RxState = HAL_UART_STATE_READY;
+  RxUart = NULL;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef *htim)
+{
+  (void)htim;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_ConfigClockSource(TIM_HandleTypeDef *htim, TIM_ClockConfigTypeDef *sClockSourceConfig)
+{
+  (void)htim;
+  (void)sClockSourceConfig;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIMEx_MasterConfigSynchronization(TIM_HandleTypeDef *htim, TIM_MasterConfigTypeDef *sMasterConfig)
+{
+  (void)htim;
+  (void)sMasterConfig;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim)
+{
+  /* Update event every (PSC + 1) * (ARR + 1) timer clocks */
+  TimPeriodUs = (uint64_t)(htim->Init.Prescaler + 1U) * (htim->Init.Period + 1U) * 1000000U / SIM_CPU_CLOCK;
+  if ((AlgoTim == NULL) && (TimPeriodUs != 0U))
+  {
+    TimNextUs = NowUs + TimPeriodUs;
+  }
+  AlgoTim = htim;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef *htim)
+{
+  TimStopCount = SIM_TimGetCounter(htim);
+  AlgoTim = NULL;
+  return HAL_OK;
+}
+
+/* The counter of a running timer is the time since the period started; a
+   stopped one starts again from 0, as after __HAL_TIM_SET_COUNTER(0) */
+uint32_t SIM_TimGetCounter(TIM_HandleTypeDef *htim)
+{
+  if (AlgoTim == NULL)
+  {
+    return TimStopCount;
+  }
+  return (uint32_t)((NowUs - (TimNextUs - TimPeriodUs)) * (SIM_CPU_CLOCK / 1000000U) / (htim->Init.Prescaler + 1U));
+}
+
+void SIM_TimSetCounter(TIM_HandleTypeDef *htim, uint32_t Counter)
+{
+  TimStopCount = Counter;
+  if (AlgoTim != NULL)
+  {
+    TimNextUs = NowUs + TimPeriodUs
+                - (uint64_t)Counter * (htim->Init.Prescaler + 1U) * 1000000U / SIM_CPU_CLOCK;
+  }
+}
+
+/* Without preload the period in progress ends at the new value */
+void SIM_TimSetAutoreload(TIM_HandleTypeDef *htim, uint32_t Autoreload)
+{
+  uint64_t start = TimNextUs - TimPeriodUs;
+
+  htim->Init.Period = Autoreload;
+  TimPeriodUs = (uint64_t)(htim->Init.Prescaler + 1U) * (htim->Init.Period + 1U) * 1000000U / SIM_CPU_CLOCK;
+  if (AlgoTim != NULL)
+  {
+    TimNextUs = start + TimPeriodUs;
+  }
+}
+
+HAL_StatusTypeDef HAL_RTC_Init(RTC_HandleTypeDef *hrtc)
+{
+  (void)hrtc;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_SetTime(RTC_HandleTypeDef *hrtc, RTC_TimeTypeDef *sTime, uint32_t Format)
+{
+  uint64_t now = Rtc_Now();
+
+  (void)hrtc;
+  RtcDays = (uint32_t)(now / 86400U);
+  RtcSeconds = ((uint32_t)Bcd2Bin(sTime->Hours, Format) * 3600U) + ((uint32_t)Bcd2Bin(sTime->Minutes, Format) * 60U)
+               + Bcd2Bin(sTime->Seconds, Format);
+  RtcSetUs = NowUs;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_SetDate(RTC_HandleTypeDef *hrtc, RTC_DateTypeDef *sDate, uint32_t Format)
+{
+  uint64_t now = Rtc_Now();
+
+  (void)hrtc;
+  RtcDays = Rtc_Days(Bcd2Bin(sDate->Year, Format), Bcd2Bin(sDate->Month, Format), Bcd2Bin(sDate->Date, Format));
+  RtcSeconds = (uint32_t)(now % 86400U);
+  RtcSetUs = NowUs;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_GetTime(RTC_HandleTypeDef *hrtc, RTC_TimeTypeDef *sTime, uint32_t Format)
+{
+  uint32_t seconds = (uint32_t)(Rtc_Now() % 86400U);
+
+  (void)hrtc;
+  memset(sTime, 0, sizeof(*sTime));
+  sTime->Hours = Bin2Bcd((uint8_t)(seconds / 3600U), Format);
+  sTime->Minutes = Bin2Bcd((uint8_t)((seconds / 60U) % 60U), Format);
+  sTime->Seconds = Bin2Bcd((uint8_t)(seconds % 60U), Format);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_GetDate(RTC_HandleTypeDef *hrtc, RTC_DateTypeDef *sDate, uint32_t Format)
+{
+  (void)hrtc;
+  Rtc_Date((uint32_t)(Rtc_Now() / 86400U), sDate);
+  sDate->Year = Bin2Bcd(sDate->Year, Format);
+  sDate->Month = Bin2Bcd(sDate->Month, Format);
+  sDate->Date = Bin2Bcd(sDate->Date, Format);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void)
+{
+  FlashLocked = 0;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void)
+{
+  FlashLocked = 1;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data)
+{
+  Flash_Wait();
+  if ((TypeProgram != FLASH_TYPEPROGRAM_DOUBLEWORD) || (Flash_Programmable(TypeProgram, Address, Data) == 0))
+  {
+    SimStats.FlashErrors++;
+    return HAL_ERROR;
+  }
+
+  Flash_Write(Address, &Data, sizeof(Data));
+  SimStats.FlashPrograms++;
+  SIM_Advance(SIM_FLASH_PROGRAM_US);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *PageError)
+{
+  uint32_t count;
+
+  Flash_Wait();
+  count = Flash_ErasePages(pEraseInit, PageError);
+  if (count == 0U)
+  {
+    return HAL_ERROR;
+  }
+  SIM_Advance((uint64_t)count * SIM_FLASH_PAGE_ERASE_US);
+  return HAL_OK;
+}
+
+/**
+ * @brief  Start programming, the flash interrupt reports the end: the cells
+ *         change at once, the callback comes when the target would be done
+ * @param  TypeProgram FLASH_TYPEPROGRAM_DOUBLEWORD or one of the fast modes,
+ *         which program a whole row of 32 double words
+ * @param  Address destination
+ * @param  Data double word, or address of the row for the fast modes
+ * @retval HAL_BUSY while another operation runs, HAL_OK otherwise
+ */
+HAL_StatusTypeDef HAL_FLASH_Program_IT(uint32_t TypeProgram, uint32_t Address, uint64_t Data)
+{
+  if (FlashBusy != 0)
+  {
+    return HAL_BUSY;
+  }
+  FlashBusy = 1;
+  FlashReturn = Address;
+  FlashFailed = (Flash_Programmable(TypeProgram, Address, Data) == 0) ? 1 : 0;
+  if (FlashFailed != 0)
+  {
+    SimStats.FlashErrors++;
+  }
+
+  if (TypeProgram == FLASH_TYPEPROGRAM_DOUBLEWORD)
+  {
+    FlashDoneUs = NowUs + SIM_FLASH_PROGRAM_US;
+    if (FlashFailed == 0)
+    {
+      Flash_Write(Address, &Data, sizeof(Data));
+      SimStats.FlashPrograms++;
+    }
+  }
+  else
+  {
+    FlashDoneUs = NowUs + SIM_FLASH_FAST_ROW_US;
+    if (FlashFailed == 0)
+    {
+      Flash_Write(Address, (const void *)(uintptr_t)Data, FLASH_FAST_ROW_SIZE);
+      SimStats.FlashPrograms += FLASH_FAST_ROW_SIZE / 8U;
+      SimStats.FlashRows++;
+    }
+  }
+  return HAL_OK;
+}
+
+/**
+ * @brief  Start erasing, the flash interrupt reports the end
+ * @param  pEraseInit pages to erase
+ * @retval HAL_BUSY while another operation runs, HAL_ERROR for pages out
+ *         of the bank, HAL_OK otherwise
+ */
+HAL_StatusTypeDef HAL_FLASHEx_Erase_IT(FLASH_EraseInitTypeDef *pEraseInit)
+{
+  uint32_t page_error;
+  uint32_t count;
+
+  if (FlashBusy != 0)
+  {
+    return HAL_BUSY;
+  }
+  count = Flash_ErasePages(pEraseInit, &page_error);
+  if ((count == 0U) && (FlashLocked == 0))
+  {
+    return HAL_ERROR;
+  }
+  FlashBusy = 1;
+  FlashReturn = 0xFFFFFFFFU;
+  FlashFailed = (count == 0U) ? 1 : 0;
+  FlashDoneUs = NowUs + ((uint64_t)((count != 0U) ? count : 1U) * SIM_FLASH_PAGE_ERASE_US);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CRC_Init(CRC_HandleTypeDef *hcrc)
+{
+  hcrc->Instance->DR = 0xFFFFFFFFU;
+  return HAL_OK;
+}
+
+/**
+ * @brief  CRC-32 with the default polynomial 0x04C11DB7 and initial value,
+ *         fed MSB first like the peripheral: bytes, or words as they are
+ *         in memory read as little endian
+ * @param  hcrc the configuration, input inversion by byte or none
+ * @param  pBuffer the data
+ * @param  BufferLength number of bytes or words, as the input data format
+ * @retval CRC
+ */
+uint32_t HAL_CRC_Calculate(CRC_HandleTypeDef *hcrc, uint32_t pBuffer[], uint32_t BufferLength)
+{
+  const uint8_t *p = (const uint8_t *)pBuffer;
+  uint32_t len = (hcrc->InputDataFormat == CRC_INPUTDATA_FORMAT_BYTES) ? BufferLength : (4U * BufferLength);
+  uint32_t crc = 0xFFFFFFFFU;
+  uint32_t out = 0;
+  uint32_t i;
+  uint32_t b;
+
+  for (i = 0; i < len; i++)
+  {
+    /* Words go in most significant byte first */
+    uint8_t byte = (hcrc->InputDataFormat == CRC_INPUTDATA_FORMAT_BYTES) ? p[i] : p[(i & ~3U) + 3U - (i & 3U)];
+
+    if (hcrc->Init.InputDataInversionMode == CRC_INPUTDATA_INVERSION_BYTE)
+    {
+      byte = (uint8_t)(((byte * 0x0802U & 0x22110U) | (byte * 0x8020U & 0x88440U)) * 0x10101U >> 16);
+    }
+    crc ^= (uint32_t)byte << 24;
+    for (b = 0; b < 8U; b++)
+    {
+      crc = ((crc & 0x80000000U) != 0U) ? ((crc << 1) ^ 0x04C11DB7U) : (crc << 1);
+    }
+  }
+  if (hcrc->Init.OutputDataInversionMode == CRC_OUTPUTDATA_INVERSION_ENABLE)
+  {
+    for (b = 0; b < 32U; b++)
+    {
+      out = (out << 1) | ((crc >> b) & 1U);
+    }
+    crc = out;
+  }
+  hcrc->Instance->DR = crc;
+  return crc;
+}
+
+void BSP_LED_Init(Led_TypeDef Led)
+{
+  (void)Led;
+}
+
+void BSP_LED_On(Led_TypeDef Led)
+{
+  (void)Led;
+}
+
+void BSP_LED_Off(Led_TypeDef Led)
+{
+  (void)Led;
+}
+
+void BSP_LED_Toggle(Led_TypeDef Led)
+{
+  (void)Led;
+}
+
+void BSP_PB_Init(Button_TypeDef Button, ButtonMode_TypeDef ButtonMode)
+{
+  (void)Button;
+  (void)ButtonMode;
+}
+
+uint32_t BSP_PB_GetState(Button_TypeDef Button)
+{
+  (void)Button;
+  return (uint32_t)ButtonState;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
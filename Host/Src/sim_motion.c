@@ -0,0 +1,166 @@
+/**
+ ******************************************************************************
+ * @file    sim_motion.c
+ * @brief   Deterministic stand-ins for the MotionAW and MotionSM libraries.
+ *          They only look at how much the acceleration magnitude moves over
+ *          the last two seconds; good enough to drive every branch of the
+ *          firmware, not a replacement for the real classifiers.
+ ******************************************************************************
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "motion_aw.h"
+#include "motion_sm.h"
+
+/** @addtogroup MOTION_APPLICATIONS MOTION APPLICATIONS
+ * @{
+ */
+
+/** @addtogroup HOST_SIMULATION HOST SIMULATION
+ * @{
+ */
+
+/* Private defines -----------------------------------------------------------*/
+#define MOTION_WINDOW       32U     /* 2 s at 16 Hz */
+#define SM_STILL_SAMPLES    960U    /* 1 min without movement to fall asleep */
+#define SM_STILL_DEVIATION  0.02f   /* [g] */
+
+/* Private types -------------------------------------------------------------*/
+typedef struct
+{
+  float Norm[MOTION_WINDOW];
+  uint32_t Count;
+  uint32_t Head;
+} MotionWindow_t;
+
+/* Private variables ---------------------------------------------------------*/
+static MotionWindow_t AwWindow;
+static MotionWindow_t SmWindow;
+static uint32_t SmStill;
+
+/* Private functions ---------------------------------------------------------*/
+/**
+ * @brief  Add a sample to a window and return the deviation of the magnitude
+ * @param  Window the sliding window
+ * @param  X,Y,Z acceleration [g]
+ * @retval Standard deviation of the magnitude over the window [g]
+ */
+static float Window_Add(MotionWindow_t *Window, float X, float Y, float Z)
+{
+  float mean = 0.0f;
+  float var = 0.0f;
+  uint32_t i;
+
+  Window->Norm[Window->Head] = sqrtf(X * X + Y * Y + Z * Z);
+  Window->Head = (Window->Head + 1U) % MOTION_WINDOW;
+  if (Window->Count < MOTION_WINDOW)
+  {
+    Window->Count++;
+  }
+
+  for (i = 0; i < Window->Count; i++)
+  {
+    mean += Window->Norm[i];
+  }
+  mean /= (float)Window->Count;
+  for (i = 0; i < Window->Count; i++)
+  {
+    var += (Window->Norm[i] - mean) * (Window->Norm[i] - mean);
+  }
+  return sqrtf(var / (float)Window->Count);
+}
+
+/* Exported functions --------------------------------------------------------*/
+void MotionAW_Initialize(void)
+{
+  MotionAW_Reset();
+}
+
+void MotionAW_SetOrientation_Acc(const char *acc_orientation)
+{
+  (void)acc_orientation;
+}
+
+void MotionAW_Update(MAW_input_t *data_in, MAW_output_t *data_out, int64_t timestamp)
+{
+  float dev = Window_Add(&AwWindow, data_in->AccX, data_in->AccY, data_in->AccZ);
+
+  (void)timestamp;
+  data_out->confidence = 100;
+  if (AwWindow.Count < MOTION_WINDOW)
+  {
+    data_out->current_activity = MAW_NOACTIVITY;
+  }
+  else if (dev < SM_STILL_DEVIATION)
+  {
+    /* Still: the wrist tells lying (flat) from stationary */
+    data_out->current_activity = (fabsf(data_in->AccZ) > 0.9f) ? MAW_LYING : MAW_STATIONARY;
+  }
+  else if (dev < 0.08f)
+  {
+    data_out->current_activity = MAW_STANDING;
+  }
+  else if (dev < 0.30f)
+  {
+    data_out->current_activity = MAW_WALKING;
+  }
+  else if (dev < 0.50f)
+  {
+    data_out->current_activity = MAW_FASTWALKING;
+  }
+  else
+  {
+    data_out->current_activity = MAW_JOGGING;
+  }
+}
+
+void MotionAW_Reset(void)
+{
+  memset(&AwWindow, 0, sizeof(AwWindow));
+}
+
+uint8_t MotionAW_GetLibVersion(char *version)
+{
+  return (uint8_t)sprintf(version, "HOST MotionAW sim v1.0.0");
+}
+
+void MotionSM_Initialize(void)
+{
+  MotionSM_Reset();
+}
+
+void MotionSM_SetOrientation_Acc(const char *acc_orientation)
+{
+  (void)acc_orientation;
+}
+
+void MotionSM_Update(MSM_input_t *data_in, MSM_output_t *data_out)
+{
+  float dev = Window_Add(&SmWindow, data_in->AccX, data_in->AccY, data_in->AccZ);
+
+  SmStill = (dev < SM_STILL_DEVIATION) ? (SmStill + 1U) : 0U;
+  data_out->StillTime = SmStill;
+  data_out->SleepFlag = (SmStill >= SM_STILL_SAMPLES) ? MSM_SLEEP : MSM_NOSLEEP;
+}
+
+void MotionSM_Reset(void)
+{
+  memset(&SmWindow, 0, sizeof(SmWindow));
+  SmStill = 0;
+}
+
+uint8_t MotionSM_GetLibVersion(char *version)
+{
+  return (uint8_t)sprintf(version, "HOST MotionSM sim v1.0.0");
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
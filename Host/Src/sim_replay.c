@@ -0,0 +1,217 @@
+/**
+ ******************************************************************************
+ * @file    sim_replay.c
+ * @brief   Replay monitor: watches the bytes the firmware sends on the UART,
+ *          decodes the status frames and keeps what a tuning run needs to
+ *          compare: time spent per activity, sleep time and turn overs.
+ *          With SIM_EVENTS set every status change is also written as CSV
+ *          (t_ms,mode,activity,flags,name) so two runs can be diffed.
+ *          Sample batches are unpacked and counted as well.
+ ******************************************************************************
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include "cube_hal.h"
+#include "status_frame.h"
+#include "stream_batch.h"
+#include "sim_replay.h"
+
+/** @addtogroup MOTION_APPLICATIONS MOTION APPLICATIONS
+ * @{
+ */
+
+/** @addtogroup HOST_SIMULATION HOST SIMULATION
+ * @{
+ */
+
+/* Private defines -----------------------------------------------------------*/
+#define REPLAY_SLEEP     STATUS_ACT_COUNT          /* bucket for sleeping */
+#define REPLAY_UNKNOWN   (STATUS_ACT_COUNT + 1U)   /* bucket for unknown activity */
+#define REPLAY_BUCKETS   (STATUS_ACT_COUNT + 2U)
+#define REPLAY_WIRE_MAX  (2U * TMsg_MaxLen + 1U)    /* any TMsg after byte stuffing */
+
+/* Private variables ---------------------------------------------------------*/
+static uint8_t Wire[REPLAY_WIRE_MAX];
+static uint32_t WireLen = 0;
+static FILE *Events = NULL;
+static int HaveLast = 0;
+static TStatusFrame Last;
+static uint64_t BucketMs[REPLAY_BUCKETS];
+static uint64_t Frames = 0;
+static uint64_t BadFrames = 0;
+static uint64_t TurnOvers = 0;
+static uint64_t SeqGaps = 0;
+static uint64_t Batches = 0;
+static uint64_t BatchSamples = 0;
+static uint64_t BatchSeqGaps = 0;
+static uint16_t BatchSeq = 0;
+static uint32_t BatchTime[255];
+
+/* Private functions ---------------------------------------------------------*/
+static uint32_t Replay_Bucket(const TStatusFrame *Status)
+{
+  if ((Status->Flags & STATUS_FLAG_SLEEP) != 0U)
+  {
+    return REPLAY_SLEEP;
+  }
+  return (Status->Activity < STATUS_ACT_COUNT) ? Status->Activity : REPLAY_UNKNOWN;
+}
+
+static void Replay_Frame(const TStatusFrame *Status)
+{
+  Frames++;
+  if ((Status->Flags & STATUS_FLAG_TURNOVER) != 0U)
+  {
+    TurnOvers++;
+  }
+  if (HaveLast != 0)
+  {
+    BucketMs[Replay_Bucket(&Last)] += (uint32_t)(Status->TimeStamp - Last.TimeStamp);
+    if ((uint16_t)(Last.Seq + 1U) != Status->Seq)
+    {
+      SeqGaps++;
+    }
+  }
+
+  if ((Events != NULL) && ((HaveLast == 0) || (Status->Mode != Last.Mode) || (Status->Activity != Last.Activity)
+                           || (Status->Flags != Last.Flags)))
+  {
+    fprintf(Events, "%u,%u,%u,%u,%s\n", Status->TimeStamp, Status->Mode, Status->Activity, Status->Flags,
+            ((Status->Flags & STATUS_FLAG_SLEEP) != 0U) ? "sleeping" : StatusFrame_ActivityName(Status->Activity));
+  }
+  Last = *Status;
+  HaveLast = 1;
+}
+
+static void Replay_Batch(void)
+{
+  TStreamBatchHeader header;
+  TStreamColumns columns = {.Capacity = 255U, .Count = 0U, .TimeMs = BatchTime};
+  int n = StreamBatch_Decode(&header, &columns, Wire, WireLen);
+
+  if (n == 0)
+  {
+    BadFrames++;
+    return;
+  }
+  if ((Batches != 0U) && ((uint16_t)(BatchSeq + 1U) != header.Seq))
+  {
+    BatchSeqGaps++;
+  }
+  BatchSeq = header.Seq;
+  Batches++;
+  BatchSamples += (uint64_t)n;
+}
+
+/* Exported functions --------------------------------------------------------*/
+/**
+ * @brief  Start monitoring
+ * @param  EventsPath CSV file for the status changes, NULL for none
+ * @retval None
+ */
+void SIM_ReplayInit(const char *EventsPath)
+{
+  if (EventsPath != NULL)
+  {
+    Events = fopen(EventsPath, "w");
+    if (Events == NULL)
+    {
+      perror(EventsPath);
+    }
+    else
+    {
+      fprintf(Events, "t_ms,mode,activity,flags,name\n");
+    }
+  }
+}
+
+/**
+ * @brief  Bytes sent by the firmware on the UART
+ * @param  Data the bytes
+ * @param  Size number of bytes
+ * @retval None
+ */
+void SIM_ReplayTx(const uint8_t *Data, uint32_t Size)
+{
+  uint32_t i;
+
+  for (i = 0; i < Size; i++)
+  {
+    if (WireLen < sizeof(Wire))
+    {
+      Wire[WireLen] = Data[i];
+    }
+    WireLen++;
+    if (Data[i] != (uint8_t)TMsg_EOF)
+    {
+      continue;
+    }
+
+    if ((WireLen <= sizeof(Wire)) && (WireLen > 3U) && (Wire[2] == (uint8_t)CMD_Batch_Data))
+    {
+      Replay_Batch();
+    }
+    /* Too long for a status frame: some other reply, not ours to check */
+    else if (WireLen <= STATUS_FRAME_WIRE_MAX)
+    {
+      TStatusFrame status;
+
+      if (StatusFrame_Decode(&status, Wire) != 0)
+      {
+        Replay_Frame(&status);
+      }
+      else if ((WireLen > 3U) && (Wire[2] == (uint8_t)CMD_Status_Frame))
+      {
+        BadFrames++;
+      }
+    }
+    WireLen = 0;
+  }
+}
+
+/**
+ * @brief  Print the replay summary on stderr
+ * @param  None
+ * @retval None
+ */
+void SIM_ReplayReport(void)
+{
+  uint32_t b;
+
+  if (Events != NULL)
+  {
+    (void)fclose(Events);
+    Events = NULL;
+  }
+  if (Batches != 0U)
+  {
+    fprintf(stderr, "sim: %llu sample batches, %llu samples (%llu seq gaps)\n", (unsigned long long)Batches,
+            (unsigned long long)BatchSamples, (unsigned long long)BatchSeqGaps);
+  }
+  if (Frames == 0U)
+  {
+    return;
+  }
+  fprintf(stderr, "sim: %llu status frames (%llu bad, %llu seq gaps), %llu turn overs\n",
+          (unsigned long long)Frames, (unsigned long long)BadFrames, (unsigned long long)SeqGaps,
+          (unsigned long long)TurnOvers);
+  fprintf(stderr, "sim:");
+  for (b = 0; b < REPLAY_BUCKETS; b++)
+  {
+    if (BucketMs[b] != 0U)
+    {
+      fprintf(stderr, " %s %.2f h,", (b == REPLAY_SLEEP) ? "sleeping" : ((b == REPLAY_UNKNOWN) ? "unknown"
+              : StatusFrame_ActivityName((uint8_t)b)), (double)BucketMs[b] / 3600000.0);
+    }
+  }
+  fprintf(stderr, "\n");
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
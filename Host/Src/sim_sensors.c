@@ -0,0 +1,666 @@
+/**
+ ******************************************************************************
+ * @file    sim_sensors.c
+ * @brief   IKS01A2 sensor BSP for the host simulation. Readings come from a
+ *          recorded trace (sim_trace.c), sampled and held at the simulated
+ *          time, or from the synthetic day when no trace is given. The
+ *          LSM6DSL FIFO fills at its rate from the same feed and raises INT1
+ *          at its watermark, or on a wake-up when the slope of the feed at
+ *          the accelerometer rate goes over its threshold. Readings go through the real I2C1 bus driver,
+ *          the HAL stand-in times the transfers and reads the registers
+ *          modelled here.
+ ******************************************************************************
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <math.h>
+#include <stdio.h>
+#include "main.h"
+#include "iks01a2_motion_sensors.h"
+#include "iks01a2_motion_sensors_ex.h"
+#include "iks01a2_env_sensors.h"
+#include "iks01a2_env_sensors_ex.h"
+#include "sim_sensors.h"
+#include "sim_trace.h"
+
+/** @addtogroup MOTION_APPLICATIONS MOTION APPLICATIONS
+ * @{
+ */
+
+/** @addtogroup HOST_SIMULATION HOST SIMULATION
+ * @{
+ */
+
+/* Private defines -----------------------------------------------------------*/
+#define SIM_FIFO_WORDS        2046U   /* 4 KB of 16-bit words, whole x y z samples */
+#define SIM_FIFO_AXES         3U
+#define SIM_INT1_FTH          0x08U   /* INT1_CTRL: FIFO threshold on INT1 */
+#define SIM_INTERRUPTS_ENABLE 0x80U   /* TAP_CFG: wake-up and other functions on */
+#define SIM_INT1_WU           0x20U   /* MD1_CFG: wake-up on INT1 */
+#define SIM_WK_THS            0x3FU   /* WAKE_UP_THS: threshold, FS / 64 per LSB */
+#define SIM_WAKE_SCAN_US      600000000U  /* [us] of feed searched for a wake-up at once */
+#define SIM_ACC_SENS_2G       0.061   /* [mg/LSB] at +-2 g */
+#define SIM_PRESS_LSB         4096.0  /* [LSB/hPa] LPS22HB */
+#define SIM_LSM303AGR_MAG_ADD 0x3DU   /* LSM303AGR magnetometer, OUTX_L_REG_M */
+#define SIM_LSM303AGR_OUTX_M  0x68U
+#define SIM_HTS221_ADD        0xBFU   /* HTS221, HUMIDITY_OUT_L with auto increment */
+#define SIM_HTS221_OUT        0xA8U
+
+/* Private variables ---------------------------------------------------------*/
+static SIM_Trace_t Trace;
+static size_t Cursor = 0;
+static SIM_Sample_t Held;
+static int HeldValid = 0;
+static float MotionOdr[3] = {0.0f, 0.0f, 0.0f};
+static int32_t MotionFs[3] = {2, 2000, 50};
+static float EnvOdr[2] = {0.0f, 0.0f};
+
+/* LSM6DSL FIFO, accelerometer only */
+static uint8_t FifoMode = LSM6DSL_BYPASS_MODE;
+static uint64_t FifoOdr = 0;          /* [mHz] */
+static uint16_t FifoWatermark = 0;    /* words */
+static uint8_t FifoInt1Ctrl = 0;
+static uint64_t FifoStartUs = 0;      /* stream mode entered */
+static uint64_t FifoRead = 0;         /* words read or overwritten since then */
+static int FifoOverrun = 0;
+static int FifoInt1 = 0;              /* INT1 level */
+
+/* LSM6DSL wake-up on INT1 */
+static uint8_t WakeTapCfg = 0;
+static uint8_t WakeThs = 0;
+static uint8_t WakeMd1Cfg = 0;
+static uint64_t WakeUs = UINT64_MAX;  /* next wake-up, or end of the feed searched */
+static int WakeHit = 0;               /* WakeUs is a wake-up */
+
+/* Private functions ---------------------------------------------------------*/
+/* [unit/LSB] of the LSM6DSL at the full scale set, 0 accelerometer, 1 gyroscope */
+static double Motion_Sensitivity(int Sensor)
+{
+  if (Sensor == 0)
+  {
+    return SIM_ACC_SENS_2G * (double)MotionFs[0] / 2.0;
+  }
+  return (MotionFs[1] <= 125) ? 4.375 : (8.75 * (double)((MotionFs[1] < 500) ? 1 : (MotionFs[1] / 250)));
+}
+
+/* x y z output registers, 16-bit little endian */
+static void Raw_Axes(const int32_t *Value, double Sensitivity, uint8_t *pData, uint16_t Len)
+{
+  uint16_t i;
+  int16_t raw;
+
+  for (i = 0; (i + 1U < Len) && (i < 6U); i += 2U)
+  {
+    raw = (int16_t)lround((double)Value[i / 2U] / Sensitivity);
+    pData[i] = (uint8_t)((uint16_t)raw & 0xFFU);
+    pData[i + 1U] = (uint8_t)((uint16_t)raw >> 8);
+  }
+}
+
+/* Axes from their output registers */
+static void Axes_Raw(const uint8_t *pData, double Sensitivity, IKS01A2_MOTION_SENSOR_Axes_t *Axes)
+{
+  Axes->x = (int32_t)((double)(int16_t)((uint16_t)pData[0] | ((uint16_t)pData[1] << 8)) * Sensitivity);
+  Axes->y = (int32_t)((double)(int16_t)((uint16_t)pData[2] | ((uint16_t)pData[3] << 8)) * Sensitivity);
+  Axes->z = (int32_t)((double)(int16_t)((uint16_t)pData[4] | ((uint16_t)pData[5] << 8)) * Sensitivity);
+}
+
+/* Words the LSM6DSL has queued by a given time */
+static uint64_t Fifo_Written(uint64_t NowUs)
+{
+  if ((FifoMode != LSM6DSL_STREAM_MODE) || (FifoOdr == 0U))
+  {
+    return FifoRead;
+  }
+  return ((NowUs - FifoStartUs) * FifoOdr / 1000000000U) * SIM_FIFO_AXES;
+}
+
+/* Unread words now, the oldest samples overwritten once it is full */
+static uint32_t Fifo_Level(void)
+{
+  uint64_t written = Fifo_Written(SIM_Now());
+
+  if (written - FifoRead > SIM_FIFO_WORDS)
+  {
+    FifoRead = written - SIM_FIFO_WORDS;
+    FifoOverrun = 1;
+  }
+  return (uint32_t)(written - FifoRead);
+}
+
+/* INT1 follows the threshold flag: high from the watermark until read below it */
+static void Fifo_UpdateInt1(void)
+{
+  FifoInt1 = (((FifoInt1Ctrl & SIM_INT1_FTH) != 0U) && (FifoWatermark != 0U) && (Fifo_Level() >= FifoWatermark)) ? 1 : 0;
+}
+
+/* Sample i is taken (i + 1) / ODR after stream mode was entered */
+static uint64_t Fifo_SampleUs(uint64_t Sample)
+{
+  return FifoStartUs + (((Sample + 1U) * 1000000000U) + FifoOdr - 1U) / FifoOdr;
+}
+
+/* Sample of the feed at a time, without moving the held one */
+static void Feed_At(uint64_t Us, SIM_Sample_t *Sample)
+{
+  uint32_t ms = (uint32_t)(Us / 1000U);
+
+  if (Trace.Count == 0U)
+  {
+    SIM_TraceSynth(ms, Sample);
+    return;
+  }
+  SIM_TraceToSample(&Trace.Records[SIM_TraceFind(&Trace, ms)], Sample);
+}
+
+/* Next wake-up after FromUs: the slope filter is half the difference of
+   consecutive samples at the accelerometer rate, on any axis */
+static void Wake_Scan(uint64_t FromUs)
+{
+  SIM_Sample_t prev;
+  SIM_Sample_t cur;
+  double ths = (double)(WakeThs & SIM_WK_THS) * (double)MotionFs[0] * 1000.0 / 64.0;
+  uint64_t step;
+  uint64_t end = SIM_SensorEndUs();
+  uint64_t t;
+  int axis;
+
+  WakeUs = UINT64_MAX;
+  WakeHit = 0;
+  if (((WakeTapCfg & SIM_INTERRUPTS_ENABLE) == 0U) || ((WakeMd1Cfg & SIM_INT1_WU) == 0U)
+      || (MotionOdr[0] <= 0.0f) || (FromUs >= end))
+  {
+    return;
+  }
+  step = (uint64_t)(1000000.0 / (double)MotionOdr[0]);
+  if ((end - FromUs) > SIM_WAKE_SCAN_US)
+  {
+    end = FromUs + SIM_WAKE_SCAN_US;
+  }
+  Feed_At(FromUs, &prev);
+  for (t = FromUs + step; t <= end; t += step)
+  {
+    Feed_At(t, &cur);
+    for (axis = 0; axis < 3; axis++)
+    {
+      if (fabs((double)(cur.Acc[axis] - prev.Acc[axis]) / 2.0) > ths)
+      {
+        WakeUs = t;
+        WakeHit = 1;
+        return;
+      }
+    }
+    prev = cur;
+  }
+  if (end != SIM_SensorEndUs())
+  {
+    /* Nothing so far, search on from there */
+    WakeUs = end;
+  }
+}
+
+/* Exported functions --------------------------------------------------------*/
+/**
+ * @brief  Select the sensor feed
+ * @param  Path binary or CSV trace (see sim_trace.h), NULL for the synthetic day
+ * @retval 1 on success, 0 otherwise
+ */
+int SIM_SensorOpen(const char *Path)
+{
+  SIM_TraceClose(&Trace);
+  Cursor = 0;
+  HeldValid = 0;
+  if (Path == NULL)
+  {
+    return 1;
+  }
+  if (SIM_TraceOpen(&Trace, Path) == 0)
+  {
+    return 0;
+  }
+  if (Trace.Count == 0U)
+  {
+    fprintf(stderr, "sim: no samples in %s\n", Path);
+    return 0;
+  }
+  return 1;
+}
+
+/**
+ * @brief  Time of the last sample
+ * @param  None
+ * @retval [us], UINT64_MAX for the endless synthetic feed
+ */
+uint64_t SIM_SensorEndUs(void)
+{
+  if (Trace.Count == 0U)
+  {
+    return UINT64_MAX;
+  }
+  return (uint64_t)Trace.Records[Trace.Count - 1U].TimeMs * 1000U;
+}
+
+/**
+ * @brief  Sample held at a given time, time only moves forward
+ * @param  NowUs simulated time [us]
+ * @retval The newest sample not after NowUs
+ */
+const SIM_Sample_t *SIM_SensorAt(uint64_t NowUs)
+{
+  uint32_t now_ms = (uint32_t)(NowUs / 1000U);
+  size_t next = Cursor;
+
+  SimStats.Samples++;
+  if (Trace.Count == 0U)
+  {
+    SIM_TraceSynth(now_ms, &Held);
+    return &Held;
+  }
+
+  /* Usually one step or none; a long gap (e.g. the timer was stopped) or a
+     FIFO sample older than the last read is a search */
+  if (((next + 8U < Trace.Count) && (Trace.Records[next + 8U].TimeMs <= now_ms))
+      || (Trace.Records[next].TimeMs > now_ms))
+  {
+    next = SIM_TraceFind(&Trace, now_ms);
+  }
+  while ((next + 1U < Trace.Count) && (Trace.Records[next + 1U].TimeMs <= now_ms))
+  {
+    next++;
+  }
+  if ((HeldValid == 0) || (next != Cursor))
+  {
+    Cursor = next;
+    SIM_TraceToSample(&Trace.Records[Cursor], &Held);
+    HeldValid = 1;
+  }
+  return &Held;
+}
+
+int32_t IKS01A2_MOTION_SENSOR_Init(uint32_t Instance, uint32_t Functions)
+{
+  (void)Functions;
+  if (Instance > (uint32_t)IKS01A2_LSM303AGR_MAG_0)
+  {
+    return BSP_ERROR_WRONG_PARAM;
+  }
+  return BSP_I2C1_Init();
+}
+
+int32_t IKS01A2_MOTION_SENSOR_DeInit(uint32_t Instance)
+{
+  (void)Instance;
+  return BSP_ERROR_NONE;
+}
+
+int32_t IKS01A2_MOTION_SENSOR_Enable(uint32_t Instance, uint32_t Function)
+{
+  (void)Instance;
+  (void)Function;
+  return BSP_ERROR_NONE;
+}
+
+int32_t IKS01A2_MOTION_SENSOR_Disable(uint32_t Instance, uint32_t Function)
+{
+  (void)Instance;
+  (void)Function;
+  return BSP_ERROR_NONE;
+}
+
+int32_t IKS01A2_MOTION_SENSOR_GetAxes(uint32_t Instance, uint32_t Function, IKS01A2_MOTION_SENSOR_Axes_t *Axes)
+{
+  uint8_t raw[6];
+
+  if (Instance > (uint32_t)IKS01A2_LSM303AGR_MAG_0)
+  {
+    return BSP_ERROR_WRONG_PARAM;
+  }
+  if ((Function == MOTION_ACCELERO) || (Function == MOTION_GYRO))
+  {
+    if (BSP_I2C1_ReadReg(LSM6DSL_I2C_ADD_H, (Function == MOTION_ACCELERO) ? LSM6DSL_OUTX_L_XL : LSM6DSL_OUTX_L_G,
+                         raw, sizeof(raw)) != BSP_ERROR_NONE)
+    {
+      return BSP_ERROR_COMPONENT_FAILURE;
+    }
+    Axes_Raw(raw, Motion_Sensitivity((Function == MOTION_ACCELERO) ? 0 : 1), Axes);
+  }
+  else
+  {
+    /* No magnetometer in the feed, report the field pointing north */
+    (void)BSP_I2C1_ReadReg(SIM_LSM303AGR_MAG_ADD, SIM_LSM303AGR_OUTX_M, raw, sizeof(raw));
+    Axes->x = 400;
+    Axes->y = 0;
+    Axes->z = 0;
+  }
+  return BSP_ERROR_NONE;
+}
+
+int32_t IKS01A2_MOTION_SENSOR_GetOutputDataRate(uint32_t Instance, uint32_t Function, float *Odr)
+{
+  (void)Instance;
+  *Odr = MotionOdr[(Function == MOTION_GYRO) ? 1 : ((Function == MOTION_MAGNETO) ? 2 : 0)];
+  return BSP_ERROR_NONE;
+}
+
+int32_t IKS01A2_MOTION_SENSOR_SetOutputDataRate(uint32_t Instance, uint32_t Function, float Odr)
+{
+  (void)Instance;
+  MotionOdr[(Function == MOTION_GYRO) ? 1 : ((Function == MOTION_MAGNETO) ? 2 : 0)] = Odr;
+  Wake_Scan(SIM_Now());
+  return BSP_ERROR_NONE;
+}
+
+int32_t IKS01A2_MOTION_SENSOR_GetFullScale(uint32_t Instance, uint32_t Function, int32_t *Fullscale)
+{
+  (void)Instance;
+  *Fullscale = MotionFs[(Function == MOTION_GYRO) ? 1 : ((Function == MOTION_MAGNETO) ? 2 : 0)];
+  return BSP_ERROR_NONE;
+}
+
+int32_t IKS01A2_MOTION_SENSOR_SetFullScale(uint32_t Instance, uint32_t Function, int32_t Fullscale)
+{
+  (void)Instance;
+  MotionFs[(Function == MOTION_GYRO) ? 1 : ((Function == MOTION_MAGNETO) ? 2 : 0)] = Fullscale;
+  return BSP_ERROR_NONE;
+}
+
+int32_t IKS01A2_MOTION_SENSOR_GetSensitivity(uint32_t Instance, uint32_t Function, float *Sensitivity)
+{
+  (void)Instance;
+  *Sensitivity = (Function == MOTION_MAGNETO) ? 1.5f : (float)Motion_Sensitivity((Function == MOTION_GYRO) ? 1 : 0);
+  return BSP_ERROR_NONE;
+}
+
+int32_t IKS01A2_MOTION_SENSOR_Get_DRDY_Status(uint32_t Instance, uint32_t Function, uint8_t *Status)
+{
+  (void)Instance;
+  (void)Function;
+  *Status = 1;
+  return BSP_ERROR_NONE;
+}
+
+int32_t IKS01A2_MOTION_SENSOR_Write_Register(uint32_t Instance, uint8_t Reg, uint8_t Data)
+{
+  if (Instance != (uint32_t)IKS01A2_LSM6DSL_0)
+  {
+    return BSP_ERROR_NONE;
+  }
+  switch (Reg)
+  {
+    case LSM6DSL_INT1_CTRL:
+      FifoInt1Ctrl = Data;
+      Fifo_UpdateInt1();
+      break;
+
+    case LSM6DSL_TAP_CFG:
+      WakeTapCfg = Data;
+      Wake_Scan(SIM_Now());
+      break;
+
+    case LSM6DSL_WAKE_UP_THS:
+      WakeThs = Data;
+      Wake_Scan(SIM_Now());
+      break;
+
+    case LSM6DSL_MD1_CFG:
+      WakeMd1Cfg = Data;
+      Wake_Scan(SIM_Now());
+      break;
+
+    default:
+      break;
+  }
+  return BSP_ERROR_NONE;
+}
+
+int32_t IKS01A2_MOTION_SENSOR_FIFO_Set_ODR_Value(uint32_t Instance, float Odr)
+{
+  (void)Instance;
+  FifoOdr = (uint64_t)lround((double)Odr * 1000.0);
+  return BSP_ERROR_NONE;
+}
+
+int32_t IKS01A2_MOTION_SENSOR_FIFO_Set_Decimation(uint32_t Instance, uint32_t Function, uint8_t Decimation)
+{
+  (void)Instance;
+  (void)Function;
+  (void)Decimation;
+  return BSP_ERROR_NONE;
+}
+
+int32_t IKS01A2_MOTION_SENSOR_FIFO_Set_Watermark_Level(uint32_t Instance, uint16_t Watermark)
+{
+  (void)Instance;
+  FifoWatermark = Watermark;
+  Fifo_UpdateInt1();
+  return BSP_ERROR_NONE;
+}
+
+int32_t IKS01A2_MOTION_SENSOR_FIFO_Set_Mode(uint32_t Instance, uint8_t Mode)
+{
+  (void)Instance;
+  if ((Mode == LSM6DSL_STREAM_MODE) && (FifoMode != LSM6DSL_STREAM_MODE))
+  {
+    FifoStartUs = SIM_Now();
+  }
+  /* Bypass mode empties the FIFO */
+  FifoRead = 0;
+  FifoOverrun = 0;
+  FifoMode = Mode;
+  Fifo_UpdateInt1();
+  return BSP_ERROR_NONE;
+}
+
+/**
+ * @brief  Register read on I2C1 as it starts, called by the HAL stand-in.
+ *         The LSM6DSL FIFO and output registers and the LPS22HB pressure are
+ *         modelled, anything else reads as zeros.
+ * @param  Addr device address
+ * @param  Reg first register, the address increments except in the FIFO data
+ * @param  pData the bytes read
+ * @param  len number of bytes
+ * @retval None
+ */
+void SIM_SensorRegRead(uint16_t Addr, uint16_t Reg, uint8_t *pData, uint16_t len)
+{
+  uint32_t level = Fifo_Level();
+  uint32_t pattern = (uint32_t)(FifoRead % SIM_FIFO_AXES);
+  const SIM_Sample_t *s = NULL;
+  double sens = Motion_Sensitivity(0);
+  uint16_t i;
+
+  memset(pData, 0, len);
+  if (Addr == LPS22HB_I2C_ADD_H)
+  {
+    if (Reg == LPS22HB_PRESS_OUT_XL)
+    {
+      int32_t raw = (int32_t)lround((double)SIM_SensorAt(SIM_Now())->Pressure * SIM_PRESS_LSB);
+
+      for (i = 0; (i < len) && (i < 3U); i++)
+      {
+        pData[i] = (uint8_t)(((uint32_t)raw >> (8U * i)) & 0xFFU);
+      }
+    }
+    return;
+  }
+  if (Addr != LSM6DSL_I2C_ADD_H)
+  {
+    return;
+  }
+  if (Reg == LSM6DSL_OUTX_L_XL)
+  {
+    Raw_Axes(SIM_SensorAt(SIM_Now())->Acc, sens, pData, len);
+  }
+  else if (Reg == LSM6DSL_OUTX_L_G)
+  {
+    Raw_Axes(SIM_SensorAt(SIM_Now())->Gyr, Motion_Sensitivity(1), pData, len);
+  }
+  else if (Reg == LSM6DSL_FIFO_STATUS1)
+  {
+    /* DIFF_FIFO, WaterM, OVER_RUN, FIFO_EMPTY, then FIFO_PATTERN */
+    uint8_t status[4];
+
+    status[0] = (uint8_t)(level & 0xFFU);
+    status[1] = (uint8_t)(((level >> 8) & 0x07U) | ((level >= FifoWatermark) ? 0x80U : 0U)
+                          | ((FifoOverrun != 0) ? 0x40U : 0U) | ((level == 0U) ? 0x10U : 0U));
+    status[2] = (uint8_t)pattern;
+    status[3] = 0;
+    memcpy(pData, status, (len < sizeof(status)) ? len : sizeof(status));
+    FifoOverrun = 0;
+  }
+  else if (Reg == LSM6DSL_FIFO_DATA_OUT_L)
+  {
+    for (i = 0; (i + 1U < len) && (level > 0U); i += 2U)
+    {
+      int16_t raw;
+
+      if ((s == NULL) || ((FifoRead % SIM_FIFO_AXES) == 0U))
+      {
+        s = SIM_SensorAt(Fifo_SampleUs(FifoRead / SIM_FIFO_AXES));
+      }
+      raw = (int16_t)lround((double)s->Acc[FifoRead % SIM_FIFO_AXES] / sens);
+      pData[i] = (uint8_t)((uint16_t)raw & 0xFFU);
+      pData[i + 1U] = (uint8_t)((uint16_t)raw >> 8);
+      FifoRead++;
+      level--;
+    }
+  }
+  Fifo_UpdateInt1();
+}
+
+/**
+ * @brief  Time INT1 rises next, or the wake-up search goes on
+ * @param  None
+ * @retval [us], UINT64_MAX if it is high already or not routed
+ */
+uint64_t SIM_SensorNextEvent(void)
+{
+  uint64_t samples;
+  uint64_t fth;
+
+  if ((FifoInt1 != 0) || ((FifoInt1Ctrl & SIM_INT1_FTH) == 0U) || (FifoWatermark == 0U)
+      || (FifoMode != LSM6DSL_STREAM_MODE) || (FifoOdr == 0U))
+  {
+    return WakeUs;
+  }
+  samples = (FifoRead + FifoWatermark + SIM_FIFO_AXES - 1U) / SIM_FIFO_AXES;
+  fth = Fifo_SampleUs(samples - 1U);
+  return (fth < WakeUs) ? fth : WakeUs;
+}
+
+/**
+ * @brief  Raise INT1 if its time has come, the EXTI line sees the edge
+ * @param  None
+ * @retval None
+ */
+void SIM_SensorFireEvent(void)
+{
+  if (WakeUs <= SIM_Now())
+  {
+    /* A wake-up pulses INT1; the search starts over after it */
+    if (WakeHit != 0)
+    {
+      HAL_GPIO_EXTI_Callback(ACC_INT1_PIN);
+    }
+    Wake_Scan(WakeUs);
+  }
+  if (SIM_SensorNextEvent() <= SIM_Now())
+  {
+    Fifo_UpdateInt1();
+    if (FifoInt1 != 0)
+    {
+      HAL_GPIO_EXTI_Callback(ACC_INT1_PIN);
+    }
+  }
+}
+
+int32_t IKS01A2_ENV_SENSOR_Init(uint32_t Instance, uint32_t Functions)
+{
+  (void)Functions;
+  if (Instance > (uint32_t)IKS01A2_LPS22HB_0)
+  {
+    return BSP_ERROR_WRONG_PARAM;
+  }
+  return BSP_I2C1_Init();
+}
+
+int32_t IKS01A2_ENV_SENSOR_DeInit(uint32_t Instance)
+{
+  (void)Instance;
+  return BSP_ERROR_NONE;
+}
+
+int32_t IKS01A2_ENV_SENSOR_Enable(uint32_t Instance, uint32_t Function)
+{
+  (void)Instance;
+  (void)Function;
+  return BSP_ERROR_NONE;
+}
+
+int32_t IKS01A2_ENV_SENSOR_Disable(uint32_t Instance, uint32_t Function)
+{
+  (void)Instance;
+  (void)Function;
+  return BSP_ERROR_NONE;
+}
+
+int32_t IKS01A2_ENV_SENSOR_GetValue(uint32_t Instance, uint32_t Function, float *Value)
+{
+  uint8_t raw[3];
+
+  if (Instance > (uint32_t)IKS01A2_LPS22HB_0)
+  {
+    return BSP_ERROR_WRONG_PARAM;
+  }
+  if (Function == ENV_PRESSURE)
+  {
+    if (BSP_I2C1_ReadReg(LPS22HB_I2C_ADD_H, LPS22HB_PRESS_OUT_XL, raw, sizeof(raw)) != BSP_ERROR_NONE)
+    {
+      return BSP_ERROR_COMPONENT_FAILURE;
+    }
+    *Value = (float)((double)((int32_t)(((uint32_t)raw[2] << 24) | ((uint32_t)raw[1] << 16) | ((uint32_t)raw[0] << 8)) / 256)
+                     / SIM_PRESS_LSB);
+    return BSP_ERROR_NONE;
+  }
+  /* No temperature or humidity in the feed, report a mild room */
+  (void)BSP_I2C1_ReadReg(SIM_HTS221_ADD, SIM_HTS221_OUT, raw, 2U);
+  if (Function == ENV_TEMPERATURE)
+  {
+    *Value = 25.0f;
+  }
+  else
+  {
+    *Value = 45.0f;
+  }
+  return BSP_ERROR_NONE;
+}
+
+int32_t IKS01A2_ENV_SENSOR_GetOutputDataRate(uint32_t Instance, uint32_t Function, float *Odr)
+{
+  (void)Function;
+  *Odr = EnvOdr[(Instance == (uint32_t)IKS01A2_LPS22HB_0) ? 1 : 0];
+  return BSP_ERROR_NONE;
+}
+
+int32_t IKS01A2_ENV_SENSOR_SetOutputDataRate(uint32_t Instance, uint32_t Function, float Odr)
+{
+  (void)Function;
+  EnvOdr[(Instance == (uint32_t)IKS01A2_LPS22HB_0) ? 1 : 0] = Odr;
+  return BSP_ERROR_NONE;
+}
+
+int32_t IKS01A2_ENV_SENSOR_Get_DRDY_Status(uint32_t Instance, uint32_t Function, uint8_t *Status)
+{
+  (void)Instance;
+  (void)Function;
+  *Status = 1;
+  return BSP_ERROR_NONE;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
@@ -0,0 +1,305 @@
+/**
+ ******************************************************************************
+ * @file    sim_trace.c
+ * @brief   Recorded sensor trace: compact binary format that is mmap'ed and
+ *          read in place, CSV import, and the synthetic day used when no
+ *          recording is available. Shared by the simulator and the
+ *          trace_convert tool.
+ ******************************************************************************
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sim_trace.h"
+
+/** @addtogroup MOTION_APPLICATIONS MOTION APPLICATIONS
+ * @{
+ */
+
+/** @addtogroup HOST_SIMULATION HOST SIMULATION
+ * @{
+ */
+
+/* Private defines -----------------------------------------------------------*/
+#define SYNTH_DAY_MS      86400000U
+#define SYNTH_NIGHT_MS    (17U * 3600000U)  /* the trace starts at 07:00 */
+#define SYNTH_CYCLE_MS    60000U            /* day: still face up, walking, still face down */
+#define SYNTH_TURN_MS     (40U * 60000U)    /* night: turn over every 40 min */
+#define SYNTH_PI          3.14159265f
+
+/* Private functions ---------------------------------------------------------*/
+static int16_t Clamp16(int32_t Value)
+{
+  if (Value > INT16_MAX)
+  {
+    return INT16_MAX;
+  }
+  if (Value < INT16_MIN)
+  {
+    return INT16_MIN;
+  }
+  return (int16_t)Value;
+}
+
+/**
+ * @brief  Import a CSV trace: t_ms,acc_x,acc_y,acc_z,gyr_x,gyr_y,gyr_z,pressure
+ * @param  Trace the trace to fill
+ * @param  Path CSV file
+ * @retval 1 on success, 0 otherwise
+ */
+static int Csv_Load(SIM_Trace_t *Trace, const char *Path)
+{
+  FILE *f = fopen(Path, "r");
+  SIM_TraceRecord_t *records = NULL;
+  size_t count = 0;
+  size_t cap = 0;
+  char line[256];
+
+  if (f == NULL)
+  {
+    perror(Path);
+    return 0;
+  }
+  while (fgets(line, sizeof(line), f) != NULL)
+  {
+    SIM_Sample_t s;
+
+    if ((line[0] == '#') || (sscanf(line, "%u,%d,%d,%d,%d,%d,%d,%f", &s.TimeMs, &s.Acc[0], &s.Acc[1],
+                                    &s.Acc[2], &s.Gyr[0], &s.Gyr[1], &s.Gyr[2], &s.Pressure) != 8))
+    {
+      continue;
+    }
+    if ((count != 0U) && (s.TimeMs < records[count - 1U].TimeMs))
+    {
+      fprintf(stderr, "%s: time goes back at %u ms\n", Path, s.TimeMs);
+      free(records);
+      fclose(f);
+      return 0;
+    }
+    if (count == cap)
+    {
+      SIM_TraceRecord_t *grown;
+
+      cap = (cap == 0U) ? 4096U : (cap * 2U);
+      grown = (SIM_TraceRecord_t *)realloc(records, cap * sizeof(SIM_TraceRecord_t));
+      if (grown == NULL)
+      {
+        free(records);
+        fclose(f);
+        return 0;
+      }
+      records = grown;
+    }
+    SIM_TraceFromSample(&s, &records[count++]);
+  }
+  fclose(f);
+
+  Trace->Records = records;
+  Trace->Count = count;
+  return 1;
+}
+
+/* Exported functions --------------------------------------------------------*/
+/**
+ * @brief  Open a trace, binary files are mapped in place, anything else is
+ *         read as CSV
+ * @param  Trace the opened trace
+ * @param  Path trace file
+ * @retval 1 on success, 0 otherwise
+ */
+int SIM_TraceOpen(SIM_Trace_t *Trace, const char *Path)
+{
+  SIM_TraceHeader_t header;
+  struct stat st;
+  int fd;
+
+  memset(Trace, 0, sizeof(*Trace));
+  fd = open(Path, O_RDONLY);
+  if ((fd < 0) || (fstat(fd, &st) != 0))
+  {
+    perror(Path);
+    if (fd >= 0)
+    {
+      close(fd);
+    }
+    return 0;
+  }
+
+  if ((read(fd, &header, sizeof(header)) != (ssize_t)sizeof(header))
+      || (memcmp(header.Magic, SIM_TRACE_MAGIC, sizeof(header.Magic)) != 0))
+  {
+    close(fd);
+    return Csv_Load(Trace, Path);
+  }
+  if ((header.Version != SIM_TRACE_VERSION) || (header.RecordSize != sizeof(SIM_TraceRecord_t)))
+  {
+    fprintf(stderr, "%s: unsupported trace version %u, record size %u\n", Path, header.Version, header.RecordSize);
+    close(fd);
+    return 0;
+  }
+
+  Trace->MapLen = (size_t)st.st_size;
+  Trace->Map = mmap(NULL, Trace->MapLen, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (Trace->Map == MAP_FAILED)
+  {
+    perror(Path);
+    Trace->Map = NULL;
+    return 0;
+  }
+
+  /* Replay reads front to back */
+  (void)madvise(Trace->Map, Trace->MapLen, MADV_SEQUENTIAL);
+  Trace->Records = (const SIM_TraceRecord_t *)((const uint8_t *)Trace->Map + sizeof(SIM_TraceHeader_t));
+  Trace->Count = (Trace->MapLen - sizeof(SIM_TraceHeader_t)) / sizeof(SIM_TraceRecord_t);
+  return 1;
+}
+
+/**
+ * @brief  Release a trace
+ * @param  Trace the trace
+ * @retval None
+ */
+void SIM_TraceClose(SIM_Trace_t *Trace)
+{
+  if (Trace->Map != NULL)
+  {
+    (void)munmap(Trace->Map, Trace->MapLen);
+  }
+  else
+  {
+    free((void *)Trace->Records);
+  }
+  memset(Trace, 0, sizeof(*Trace));
+}
+
+/**
+ * @brief  Index of the newest record not after a given time
+ * @param  Trace the trace
+ * @param  TimeMs time to look for [ms]
+ * @retval Record index, 0 if the trace starts later
+ */
+size_t SIM_TraceFind(const SIM_Trace_t *Trace, uint32_t TimeMs)
+{
+  size_t lo = 0;
+  size_t hi = Trace->Count;
+
+  while (hi - lo > 1U)
+  {
+    size_t mid = lo + (hi - lo) / 2U;
+
+    if (Trace->Records[mid].TimeMs <= TimeMs)
+    {
+      lo = mid;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+/**
+ * @brief  Expand a record to the units the BSP returns
+ * @param  Record the stored record
+ * @param  Sample the expanded sample
+ * @retval None
+ */
+void SIM_TraceToSample(const SIM_TraceRecord_t *Record, SIM_Sample_t *Sample)
+{
+  uint32_t i;
+
+  Sample->TimeMs = Record->TimeMs;
+  for (i = 0; i < 3U; i++)
+  {
+    Sample->Acc[i] = Record->Acc[i];
+    Sample->Gyr[i] = (int32_t)Record->Gyr[i] * 100;
+  }
+  Sample->Pressure = (float)Record->Pressure / 4096.0f;
+}
+
+/**
+ * @brief  Pack a sample, out of range values saturate
+ * @param  Sample the sample
+ * @param  Record the packed record
+ * @retval None
+ */
+void SIM_TraceFromSample(const SIM_Sample_t *Sample, SIM_TraceRecord_t *Record)
+{
+  uint32_t i;
+
+  Record->TimeMs = Sample->TimeMs;
+  for (i = 0; i < 3U; i++)
+  {
+    Record->Acc[i] = Clamp16(Sample->Acc[i]);
+    Record->Gyr[i] = Clamp16(Sample->Gyr[i] / 100);
+  }
+  Record->Pressure = (Sample->Pressure > 0.0f) ? (uint32_t)lrintf(Sample->Pressure * 4096.0f) : 0U;
+}
+
+/**
+ * @brief  Synthetic feed: a 17 h day alternating still face up, walking and
+ *         still face down every 20 s, then a 7 h night lying still with a
+ *         turn over every 40 min
+ * @param  TimeMs time [ms]
+ * @param  Sample the sample at that time
+ * @retval None
+ */
+void SIM_TraceSynth(uint32_t TimeMs, SIM_Sample_t *Sample)
+{
+  uint32_t day = TimeMs % SYNTH_DAY_MS;
+  float t = (float)(TimeMs % SYNTH_CYCLE_MS) / 1000.0f;
+
+  memset(Sample, 0, sizeof(*Sample));
+  Sample->TimeMs = TimeMs;
+  Sample->Pressure = 1013.25f;
+
+  if (day >= SYNTH_NIGHT_MS)
+  {
+    Sample->Acc[2] = ((((day - SYNTH_NIGHT_MS) / SYNTH_TURN_MS) & 1U) == 0U) ? 1000 : -1000;
+  }
+  else if ((day % SYNTH_CYCLE_MS) < (SYNTH_CYCLE_MS / 3U))
+  {
+    Sample->Acc[2] = 1000;
+  }
+  else if ((day % SYNTH_CYCLE_MS) < (2U * SYNTH_CYCLE_MS / 3U))
+  {
+    /* 2 Hz steps */
+    Sample->Acc[0] = (int32_t)(300.0f * sinf(2.0f * SYNTH_PI * 2.0f * t));
+    Sample->Acc[2] = 1000 + (int32_t)(250.0f * sinf(2.0f * SYNTH_PI * 2.0f * t + 1.0f));
+    Sample->Gyr[1] = (int32_t)(40000.0f * sinf(2.0f * SYNTH_PI * 2.0f * t));
+  }
+  else
+  {
+    Sample->Acc[2] = -1000;
+  }
+}
+
+/**
+ * @brief  Header for a new binary trace
+ * @param  Header the header to fill
+ * @retval None
+ */
+void SIM_TraceInitHeader(SIM_TraceHeader_t *Header)
+{
+  memset(Header, 0, sizeof(*Header));
+  memcpy(Header->Magic, SIM_TRACE_MAGIC, sizeof(Header->Magic));
+  Header->Version = SIM_TRACE_VERSION;
+  Header->RecordSize = (uint16_t)sizeof(SIM_TraceRecord_t);
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
@@ -0,0 +1,760 @@
+/**
+ ******************************************************************************
+ * @file    bulk_upload.c
+ * @brief   Datalog upload over the serial link with the bulk commands.
+ *
+ *          bulk_upload [-b baud [-r]] [-w blocks] [-x n] [-n] /dev/ttyACM0 upload.bin
+ *          bulk_upload [-b baud [-r]] -L /dev/ttyACM0 upload.bin
+ *
+ *          Asks for windows of blocks (-w, default 16), checks their
+ *          sequence numbers and CRCs and asks again for the ones missing.
+ *          Blocks in order are kept in upload.bin.part, an interrupted
+ *          upload resumes there as long as the nucleo did not drop the
+ *          records since. The output is what CMD_UploadXX gives (length,
+ *          then the records) for datalog_dump -u; the records are then
+ *          dropped on the nucleo unless -n is given. -x damages every n-th
+ *          block received to exercise the retransmissions. -L times the
+ *          legacy CMD_UploadXX instead, which stops streaming first as
+ *          nothing else can share the link during it. -b switches the link
+ *          to another rate with CMD_Set_Baud for the upload, -r with RTS/CTS
+ *          flow control, and back to 115200 at the end.
+ *
+ *          Prints the effective rate against what the baud rate carries.
+ *
+ *          gcc -O2 -IInc Host/Tools/bulk_upload.c Src/bulk_upload.c Src/serial_protocol.c -o bulk_upload
+ ******************************************************************************
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include "bulk_upload.h"
+#include "link_baud.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define HOST_ADDR        2U
+#define DEV_ADDR         50U
+#define BYTE_BITS        10U                /* start, 8 data and stop bits */
+#define WIRE_MAX         (2U * TMsg_MaxLen + 1U)
+#define REPLY_MS         1000U
+#define VERIFY_MS        100U               /* between CMD_Set_Baud verifications */
+#define WINDOW_MAX       128U
+#define RECORD_LEN       8U
+#define MIN(A,B)         ((A)<(B)?(A):(B))
+
+/* Block states */
+#define BLOCK_WANTED     0U
+#define BLOCK_ASKED      1U
+#define BLOCK_HAVE       2U
+
+/* Private variables ---------------------------------------------------------*/
+static int Fd = -1;
+static uint32_t LinkBaud = LINK_BAUD_DEFAULT;
+static uint8_t LinkFlow = LINK_FLOW_NONE;
+static uint8_t Wire[WIRE_MAX];
+static uint32_t WireLen = 0;
+static uint8_t RxBuf[4096];
+static uint32_t RxLen = 0;
+static uint32_t RxPos = 0;
+
+static uint32_t Window = 16;
+static uint32_t DamageEvery = 0;
+static int KeepLog = 0;
+
+static uint32_t LogId;
+static uint32_t Total;         /* [bytes] */
+static uint32_t BlockLen;
+static uint32_t Base;          /* [bytes] resumed from the part file */
+static uint32_t Blocks;        /* from Base to Total */
+static uint8_t *Data;
+static uint8_t *State;
+static uint32_t Expected[WINDOW_MAX]; /* blocks asked for, in the order they come */
+static uint32_t ExpHead = 0;
+static uint32_t ExpCount = 0;
+static uint32_t Ranges = 0;    /* CMD_Bulk_Read not served yet, the nucleo queues BULK_RANGES */
+static uint32_t RangeLeft[BULK_RANGES];
+static uint16_t NextSeq = 0;
+
+static uint64_t Received = 0;
+static uint64_t Retransmits = 0;
+static uint64_t CrcErrors = 0;
+static uint64_t Lost = 0;
+static uint64_t Busy = 0;
+static uint64_t Timeouts = 0;
+static uint64_t WireBytes = 0;
+
+/* Private functions ---------------------------------------------------------*/
+static int Usage(void)
+{
+  fprintf(stderr, "usage: bulk_upload [-b baud [-r]] [-w blocks] [-x n] [-n] tty upload.bin\n"
+                  "       bulk_upload [-b baud [-r]] -L tty upload.bin\n");
+  return 2;
+}
+
+static double Now(void)
+{
+  struct timespec ts;
+
+  (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + ((double)ts.tv_nsec / 1e9);
+}
+
+/* Line speed of a rate, 0 if the tty cannot do it */
+static speed_t Link_Speed(uint32_t Baud)
+{
+  switch (Baud)
+  {
+    case 9600U:    return B9600;
+    case 19200U:   return B19200;
+    case 38400U:   return B38400;
+    case 57600U:   return B57600;
+    case 115200U:  return B115200;
+    case 230400U:  return B230400;
+    case 460800U:  return B460800;
+    case 921600U:  return B921600;
+    case 1000000U: return B1000000;
+    case 1500000U: return B1500000;
+    case 2000000U: return B2000000;
+    case 3000000U: return B3000000;
+    case 4000000U: return B4000000;
+    default:       return 0;
+  }
+}
+
+/* Set the local side of the link, once what was sent is out */
+static int Link_Config(uint32_t Baud, uint8_t Flow)
+{
+  struct termios tio;
+
+  (void)tcdrain(Fd);
+  if (tcgetattr(Fd, &tio) != 0)
+  {
+    return 0;
+  }
+  cfmakeraw(&tio);
+  (void)cfsetispeed(&tio, Link_Speed(Baud));
+  (void)cfsetospeed(&tio, Link_Speed(Baud));
+  if (Flow == LINK_FLOW_RTSCTS)
+  {
+    tio.c_cflag |= CRTSCTS;
+  }
+  else
+  {
+    tio.c_cflag &= ~CRTSCTS;
+  }
+  tio.c_cc[VMIN] = 0;
+  tio.c_cc[VTIME] = 0;
+  if (tcsetattr(Fd, TCSANOW, &tio) != 0)
+  {
+    return 0;
+  }
+  LinkBaud = Baud;
+  LinkFlow = Flow;
+  return 1;
+}
+
+static int Link_Open(const char *Path)
+{
+  Fd = open(Path, O_RDWR | O_NOCTTY);
+  if ((Fd < 0) || (Link_Config(LINK_BAUD_DEFAULT, LINK_FLOW_NONE) == 0))
+  {
+    perror(Path);
+    return 0;
+  }
+  (void)tcflush(Fd, TCIOFLUSH);
+  return 1;
+}
+
+/* Next received byte, -1 after Ms without one */
+static int Link_Byte(uint32_t Ms)
+{
+  if (RxPos == RxLen)
+  {
+    fd_set set;
+    struct timeval tv = {.tv_sec = (time_t)(Ms / 1000U), .tv_usec = (suseconds_t)((Ms % 1000U) * 1000U)};
+    ssize_t n;
+
+    FD_ZERO(&set);
+    FD_SET(Fd, &set);
+    if (select(Fd + 1, &set, NULL, NULL, &tv) <= 0)
+    {
+      return -1;
+    }
+    n = read(Fd, RxBuf, sizeof(RxBuf));
+    if (n <= 0)
+    {
+      return -1;
+    }
+    RxLen = (uint32_t)n;
+    RxPos = 0;
+    WireBytes += (uint64_t)n;
+  }
+  return RxBuf[RxPos++];
+}
+
+static void Link_Send(TMsg *Msg)
+{
+  uint8_t wire[WIRE_MAX];
+  int len;
+
+  CHK_ComputeAndAdd(Msg);
+  len = ByteStuffCopy(wire, Msg);
+  if (write(Fd, wire, (size_t)len) != (ssize_t)len)
+  {
+    perror("write");
+  }
+}
+
+/* Next message with a valid checksum, 0 after Ms without one: bytes at
+   another rate keep coming but never make a message */
+static int Link_Receive(TMsg *Msg, uint32_t Ms)
+{
+  double end = Now() + ((double)Ms / 1000.0);
+  int c;
+
+  while ((Now() < end) && ((c = Link_Byte(Ms)) >= 0))
+  {
+    if (WireLen < sizeof(Wire))
+    {
+      Wire[WireLen] = (uint8_t)c;
+    }
+    WireLen++;
+    if (c != (int)TMsg_EOF)
+    {
+      continue;
+    }
+    if ((WireLen <= sizeof(Wire)) && (ReverseByteStuffCopyLen(Msg, Wire, WireLen) != 0) && (CHK_CheckAndRemove(Msg) != 0)
+        && (Msg->Len >= 3U) && (Msg->Data[0] == HOST_ADDR))
+    {
+      WireLen = 0;
+      return 1;
+    }
+    WireLen = 0;
+  }
+  return 0;
+}
+
+/* Send a command and wait for its reply, other messages are skipped */
+static int Link_Command(TMsg *Msg)
+{
+  uint8_t cmd = Msg->Data[2];
+  double end = Now() + ((double)REPLY_MS / 1000.0);
+
+  Link_Send(Msg);
+  while (Now() < end)
+  {
+    if ((Link_Receive(Msg, REPLY_MS) != 0) && (Msg->Data[2] == (uint8_t)(cmd + CMD_Reply_Add)))
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void Msg_Init(TMsg *Msg, uint8_t Cmd)
+{
+  Msg->Data[0] = DEV_ADDR;
+  Msg->Data[1] = HOST_ADDR;
+  Msg->Data[2] = Cmd;
+  Msg->Len = 3;
+}
+
+static void Baud_Msg(TMsg *Msg, uint32_t Baud, uint8_t Flow)
+{
+  Msg_Init(Msg, CMD_Set_Baud);
+  Serialize(&Msg->Data[3], Baud, 4);
+  Msg->Data[7] = Flow;
+  Msg->Len = 8;
+}
+
+/**
+ * @brief  Switch both sides of the link with CMD_Set_Baud, verified at the
+ *         new settings; on failure the link is left as it was
+ */
+static int Link_SetBaud(uint32_t Baud, uint8_t Flow)
+{
+  uint32_t oldBaud = LinkBaud;
+  uint8_t oldFlow = LinkFlow;
+  TMsg msg;
+  double end;
+
+  if (Link_Speed(Baud) == 0U)
+  {
+    fprintf(stderr, "%u baud: not a tty speed\n", Baud);
+    return 0;
+  }
+  Baud_Msg(&msg, Baud, Flow);
+  if ((Link_Command(&msg) == 0) || (msg.Len != 9U))
+  {
+    fprintf(stderr, "no reply to CMD_Set_Baud\n");
+    return 0;
+  }
+  if (msg.Data[3] == LINK_BAUD_OK)
+  {
+    return 1;
+  }
+  if (msg.Data[3] != LINK_BAUD_PENDING)
+  {
+    fprintf(stderr, "%u baud%s refused\n", Baud, (Flow == LINK_FLOW_RTSCTS) ? " RTS/CTS" : "");
+    return 0;
+  }
+
+  /* The nucleo switches once its reply is out, ask again at the new rate
+     until it answers there */
+  (void)Link_Config(Baud, Flow);
+  end = Now() + ((double)LINK_BAUD_VERIFY_MS / 2000.0);
+  while (Now() < end)
+  {
+    Baud_Msg(&msg, Baud, Flow);
+    Link_Send(&msg);
+    while ((Link_Receive(&msg, VERIFY_MS) != 0) && (msg.Data[2] != (uint8_t)(CMD_Set_Baud + CMD_Reply_Add)))
+    {
+    }
+    if ((msg.Data[2] == (uint8_t)(CMD_Set_Baud + CMD_Reply_Add)) && (msg.Len == 9U) && (msg.Data[3] == LINK_BAUD_OK))
+    {
+      fprintf(stderr, "link at %u baud%s\n", Baud, (Flow == LINK_FLOW_RTSCTS) ? " RTS/CTS" : "");
+      return 1;
+    }
+  }
+
+  /* No answer: the nucleo goes back by itself */
+  fprintf(stderr, "no answer at %u baud, back to %u\n", Baud, oldBaud);
+  (void)Link_Config(oldBaud, oldFlow);
+  (void)usleep(LINK_BAUD_VERIFY_MS * 1000U);
+  (void)tcflush(Fd, TCIFLUSH);
+  RxPos = RxLen;
+  WireLen = 0;
+  return 0;
+}
+
+static void Report(const char *What, uint32_t Bytes, double Seconds)
+{
+  double rate = (Seconds > 0.0) ? ((double)Bytes / Seconds) : 0.0;
+  uint32_t ceiling = LinkBaud / BYTE_BITS;  /* [bytes/s] */
+
+  fprintf(stderr, "%s: %u bytes in %.2f s, %.0f B/s, %.1f %% of the %u B/s at %u baud (%llu bytes on the wire)\n",
+          What, Bytes, Seconds, rate, 100.0 * rate / (double)ceiling, ceiling, LinkBaud,
+          (unsigned long long)WireBytes);
+}
+
+static int Output_Write(const char *Path)
+{
+  uint8_t len[4] = {(uint8_t)(Total >> 24), (uint8_t)(Total >> 16), (uint8_t)(Total >> 8), (uint8_t)Total};
+  FILE *f = fopen(Path, "wb");
+
+  if ((f == NULL) || (fwrite(len, sizeof(len), 1, f) != 1U) || (fwrite(Data, 1, Total, f) != Total)
+      || (fclose(f) != 0))
+  {
+    perror(Path);
+    return 0;
+  }
+  return 1;
+}
+
+/**
+ * @brief  Time the legacy upload: length, then the records, sent blocking
+ */
+static int Legacy_Upload(const char *OutPath)
+{
+  TMsg msg;
+  uint8_t len[4];
+  uint32_t i;
+  double start;
+  int c;
+
+  Msg_Init(&msg, CMD_Stop_Data_Streaming);
+  (void)Link_Command(&msg);
+  while (Link_Byte(200) >= 0)
+  {
+  }
+
+  WireBytes = 0;
+  start = Now();
+  Msg_Init(&msg, CMD_UploadXX);
+  Link_Send(&msg);
+  for (i = 0; i < 4U; i++)
+  {
+    if ((c = Link_Byte(5000)) < 0)
+    {
+      fprintf(stderr, "no upload length\n");
+      return 1;
+    }
+    len[i] = (uint8_t)c;
+  }
+  Total = ((uint32_t)len[0] << 24) | ((uint32_t)len[1] << 16) | ((uint32_t)len[2] << 8) | len[3];
+  Data = malloc((Total != 0U) ? Total : 1U);
+  for (i = 0; i < Total; i++)
+  {
+    if ((c = Link_Byte(1000)) < 0)
+    {
+      fprintf(stderr, "upload cut at %u of %u bytes\n", i, Total);
+      return 1;
+    }
+    Data[i] = (uint8_t)c;
+  }
+  Report("legacy", Total, Now() - start);
+  return (Output_Write(OutPath) != 0) ? 0 : 1;
+}
+
+/* A block asked for did not come or came damaged: ask again */
+static void Block_Again(uint32_t Index)
+{
+  if (State[Index] == BLOCK_ASKED)
+  {
+    State[Index] = BLOCK_WANTED;
+    Retransmits++;
+  }
+}
+
+/* Blocks asked for but not received are wanted again */
+static void Expected_Forget(void)
+{
+  while (ExpCount != 0U)
+  {
+    Block_Again(Expected[ExpHead]);
+    ExpHead = (ExpHead + 1U) % WINDOW_MAX;
+    ExpCount--;
+  }
+  Ranges = 0;
+}
+
+/* The oldest block asked for came or will never come */
+static void Expected_Pop(void)
+{
+  uint32_t i;
+
+  ExpHead = (ExpHead + 1U) % WINDOW_MAX;
+  ExpCount--;
+  RangeLeft[0]--;
+  if (RangeLeft[0] == 0U)
+  {
+    for (i = 1; i < Ranges; i++)
+    {
+      RangeLeft[i - 1U] = RangeLeft[i];
+    }
+    Ranges--;
+  }
+}
+
+/* Ask for the next run of wanted blocks while the window has room */
+static void Bulk_Ask(void)
+{
+  static uint32_t scan = 0;
+  TMsg msg;
+  uint32_t first;
+  uint32_t n;
+
+  /* Ask once half the window is free, for fewer and longer ranges */
+  while ((Ranges < BULK_RANGES) && ((ExpCount == 0U) || ((Window - ExpCount) >= ((Window + 1U) / 2U))))
+  {
+    for (n = 0; (n < Blocks) && (State[scan] != BLOCK_WANTED); n++)
+    {
+      scan = (scan + 1U) % Blocks;
+    }
+    if (n == Blocks)
+    {
+      return;
+    }
+    first = scan;
+    for (n = 0; (first + n < Blocks) && (State[first + n] == BLOCK_WANTED) && ((ExpCount + n) < Window)
+         && (n < 255U); n++)
+    {
+      State[first + n] = BLOCK_ASKED;
+      Expected[(ExpHead + ExpCount + n) % WINDOW_MAX] = first + n;
+    }
+    ExpCount += n;
+    RangeLeft[Ranges++] = n;
+    scan = (first + n) % Blocks;
+
+    Msg_Init(&msg, CMD_Bulk_Read);
+    Serialize(&msg.Data[3], LogId, 4);
+    Serialize(&msg.Data[7], Base + (first * BlockLen), 4);
+    msg.Data[11] = (uint8_t)n;
+    msg.Len = 12;
+    Link_Send(&msg);
+  }
+}
+
+/* Account for one CMD_Bulk_Data, returns 0 if the session is gone */
+static int Bulk_Block(TMsg *Msg)
+{
+  TBulkBlock block;
+  uint32_t index;
+  uint32_t n;
+  int ret;
+
+  if ((DamageEvery != 0U) && (Msg->Len > BULK_HEADER_LEN) && (((Received + 1U) % DamageEvery) == 0U))
+  {
+    Msg->Data[BULK_HEADER_LEN] ^= 0x01U;
+  }
+  ret = BulkUpload_Parse(Msg, &block);
+  if (ret == 0)
+  {
+    return 1;
+  }
+  Received++;
+
+  /* Blocks come in the order they were asked for: a sequence gap is that
+     many blocks lost, a block that is not the next one expected too */
+  while (((uint16_t)(block.Seq - NextSeq) < 0x8000U) && (block.Seq != NextSeq) && (ExpCount != 0U))
+  {
+    Block_Again(Expected[ExpHead]);
+    Expected_Pop();
+    Lost++;
+    NextSeq++;
+  }
+  NextSeq = block.Seq + 1U;
+  if (block.Status == BULK_STALE)
+  {
+    return 0;
+  }
+  if ((block.Offset < Base) || (((block.Offset - Base) % BlockLen) != 0U)
+      || (((block.Offset - Base) / BlockLen) >= Blocks))
+  {
+    return 1;
+  }
+  index = (block.Offset - Base) / BlockLen;
+  while ((ExpCount != 0U) && (Expected[ExpHead] != index))
+  {
+    Block_Again(Expected[ExpHead]);
+    Expected_Pop();
+    Lost++;
+  }
+  if (block.Status == BULK_BUSY)
+  {
+    /* The whole range was refused, index is its first block */
+    Busy++;
+    for (n = ((ExpCount != 0U) && (Ranges != 0U)) ? RangeLeft[0] : 0U; n != 0U; n--)
+    {
+      Block_Again(Expected[ExpHead]);
+      Expected_Pop();
+    }
+    return 1;
+  }
+  if (ExpCount != 0U)
+  {
+    Expected_Pop();
+  }
+
+  if ((ret > 0) && (block.Status == BULK_OK) && (State[index] != BLOCK_HAVE)
+      && (block.Len == MIN(BlockLen, Total - block.Offset)))
+  {
+    (void)memcpy(&Data[block.Offset], block.Data, block.Len);
+    State[index] = BLOCK_HAVE;
+  }
+  else
+  {
+    if (ret < 0)
+    {
+      CrcErrors++;
+    }
+    Block_Again(index);
+  }
+  return 1;
+}
+
+/**
+ * @brief  Bulk upload, resumed from the part file when it matches the log
+ */
+static int Bulk_Upload(const char *OutPath)
+{
+  char part[4096];
+  TMsg msg;
+  FILE *f;
+  uint8_t id[4];
+  uint32_t done;
+  uint32_t saved;
+  uint32_t i;
+  double start;
+  double last;
+  long size;
+
+  Msg_Init(&msg, CMD_Bulk_Start);
+  if (Link_Command(&msg) == 0)
+  {
+    fprintf(stderr, "no reply to CMD_Bulk_Start\n");
+    return 1;
+  }
+  LogId = Deserialize(&msg.Data[3], 4);
+  Total = Deserialize(&msg.Data[7], 4);
+  BlockLen = Deserialize(&msg.Data[11], 2);
+  if ((BlockLen == 0U) || ((BlockLen % RECORD_LEN) != 0U))
+  {
+    fprintf(stderr, "bad block length %u\n", BlockLen);
+    return 1;
+  }
+  Data = malloc((Total != 0U) ? Total : 1U);
+
+  /* Part file: LogId (4), then the records received in order */
+  (void)snprintf(part, sizeof(part), "%s.part", OutPath);
+  Base = 0;
+  f = fopen(part, "rb");
+  if ((f != NULL) && (fread(id, sizeof(id), 1, f) == 1U) && (Deserialize(id, 4) == LogId)
+      && (fseek(f, 0, SEEK_END) == 0) && ((size = ftell(f) - 4) >= 0) && ((uint32_t)size <= Total))
+  {
+    Base = (uint32_t)size - ((uint32_t)size % RECORD_LEN);
+    (void)fseek(f, 4, SEEK_SET);
+    if (fread(Data, 1, Base, f) != Base)
+    {
+      Base = 0;
+    }
+  }
+  if (f != NULL)
+  {
+    (void)fclose(f);
+  }
+  f = fopen(part, (Base != 0U) ? "r+b" : "wb");
+  if (f == NULL)
+  {
+    perror(part);
+    return 1;
+  }
+  Serialize(id, LogId, 4);
+  (void)fwrite(id, sizeof(id), 1, f);
+  (void)fseek(f, (long)(4U + Base), SEEK_SET);
+  fprintf(stderr, "log %u: %u bytes, %u already in %s\n", LogId, Total, Base, part);
+
+  Blocks = ((Total - Base) + BlockLen - 1U) / BlockLen;
+  State = calloc((Blocks != 0U) ? Blocks : 1U, 1);
+  if (Window > WINDOW_MAX)
+  {
+    Window = WINDOW_MAX;
+  }
+
+  WireBytes = 0;
+  start = Now();
+  done = 0;
+  saved = 0;
+  last = start;
+  while (done < Blocks)
+  {
+    Bulk_Ask();
+    if ((ExpCount != 0U) && ((Now() - last) > ((double)REPLY_MS / 1000.0)))
+    {
+      /* No block for a while: whatever was asked for is lost */
+      Timeouts++;
+      Expected_Forget();
+      last = Now();
+      continue;
+    }
+    if ((Link_Receive(&msg, REPLY_MS) == 0) || (msg.Data[2] != (uint8_t)CMD_Bulk_Data))
+    {
+      continue;
+    }
+    last = Now();
+    if (Bulk_Block(&msg) == 0)
+    {
+      fprintf(stderr, "session lost at %u of %u bytes, run again to resume\n", Base + (saved * BlockLen), Total);
+      (void)fclose(f);
+      return 1;
+    }
+
+    /* Keep what is in order, for a resume */
+    while ((saved < Blocks) && (State[saved] == BLOCK_HAVE))
+    {
+      uint32_t offset = Base + (saved * BlockLen);
+
+      (void)fwrite(&Data[offset], 1, MIN(BlockLen, Total - offset), f);
+      saved++;
+    }
+    (void)fflush(f);
+    done = saved;
+  }
+  (void)fclose(f);
+  Report("bulk", Total - Base, Now() - start);
+  fprintf(stderr, "%llu blocks received, %llu asked again: %llu lost, %llu CRC errors, %llu busy, %llu timeouts\n",
+          (unsigned long long)Received, (unsigned long long)Retransmits, (unsigned long long)Lost,
+          (unsigned long long)CrcErrors, (unsigned long long)Busy, (unsigned long long)Timeouts);
+
+  if (Output_Write(OutPath) == 0)
+  {
+    return 1;
+  }
+  (void)remove(part);
+
+  if (KeepLog != 0)
+  {
+    return 0;
+  }
+  Msg_Init(&msg, CMD_Bulk_Done);
+  Serialize(&msg.Data[3], LogId, 4);
+  Serialize(&msg.Data[7], Total, 4);
+  msg.Len = 11;
+  for (i = 0; (i < 3U) && (Link_Command(&msg) == 0); i++)
+  {
+    Msg_Init(&msg, CMD_Bulk_Done);
+    Serialize(&msg.Data[3], LogId, 4);
+    Serialize(&msg.Data[7], Total, 4);
+    msg.Len = 11;
+  }
+  if ((i == 3U) || (msg.Data[3] != BULK_OK))
+  {
+    fprintf(stderr, "records kept on the nucleo, they come again with the next upload\n");
+    return 1;
+  }
+  fprintf(stderr, "records dropped on the nucleo\n");
+  return 0;
+}
+
+/* Main ----------------------------------------------------------------------*/
+int main(int argc, char **argv)
+{
+  int legacy = 0;
+  uint32_t baud = LINK_BAUD_DEFAULT;
+  uint8_t flow = LINK_FLOW_NONE;
+  int opt;
+  int ret;
+
+  while ((opt = getopt(argc, argv, "b:rw:x:nL")) != -1)
+  {
+    switch (opt)
+    {
+      case 'b':
+        baud = (uint32_t)strtoul(optarg, NULL, 0);
+        break;
+      case 'r':
+        flow = LINK_FLOW_RTSCTS;
+        break;
+      case 'w':
+        Window = (uint32_t)strtoul(optarg, NULL, 0);
+        break;
+      case 'x':
+        DamageEvery = (uint32_t)strtoul(optarg, NULL, 0);
+        break;
+      case 'n':
+        KeepLog = 1;
+        break;
+      case 'L':
+        legacy = 1;
+        break;
+      default:
+        return Usage();
+    }
+  }
+  if (((argc - optind) != 2) || (Window == 0U))
+  {
+    return Usage();
+  }
+  if (Link_Open(argv[optind]) == 0)
+  {
+    return 1;
+  }
+  if (((baud != LINK_BAUD_DEFAULT) || (flow != LINK_FLOW_NONE)) && (Link_SetBaud(baud, flow) == 0))
+  {
+    fprintf(stderr, "uploading at %u baud\n", LinkBaud);
+  }
+  ret = (legacy != 0) ? Legacy_Upload(argv[optind + 1]) : Bulk_Upload(argv[optind + 1]);
+
+  /* Leave the link as the relay expects it */
+  if ((LinkBaud != LINK_BAUD_DEFAULT) || (LinkFlow != LINK_FLOW_NONE))
+  {
+    (void)Link_SetBaud(LINK_BAUD_DEFAULT, LINK_FLOW_NONE);
+  }
+  return ret;
+}
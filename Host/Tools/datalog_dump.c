@@ -0,0 +1,259 @@
+/**
+ ******************************************************************************
+ * @file    datalog_dump.c
+ * @brief   Activity datalog decoder for the host.
+ *
+ *          datalog_dump sim_flash.bin     the log in a simulator flash image
+ *          datalog_dump -u upload.bin     bytes received for CMD_UploadXX
+ *                                         (length, then the records), - for stdin
+ *
+ *          Prints one CSV line per run, a summary on stderr. Words are
+ *          decoded as they are read, so an upload can be piped in while it
+ *          is received.
+ *
+ *          gcc -O2 -DUSE_HOST_SIM -DUSE_STM32L4XX_NUCLEO -IHost/Inc -IInc Host/Tools/datalog_dump.c Src/activity_log.c Src/status_frame.c Src/serial_protocol.c -o datalog_dump
+ ******************************************************************************
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "main.h"
+#include "activity_log.h"
+#include "status_frame.h"
+#include "DemoDatalog.h"
+
+/* Private variables ---------------------------------------------------------*/
+static TActivityDecoder Decoder;
+static uint64_t Words = 0;
+static uint64_t Anchors = 0;
+static uint64_t Runs = 0;
+static uint64_t TurnOvers = 0;
+static uint64_t BadWords = 0;
+static double Seconds = 0.0;
+
+/* Private functions ---------------------------------------------------------*/
+static int Usage(void)
+{
+  fprintf(stderr, "usage: datalog_dump sim_flash.bin | -u upload.bin\n");
+  return 2;
+}
+
+/* CRC-16/CCITT of a page header, as DemoDatalog.c computes it */
+static uint16_t Page_Crc(const DatalogPage_t *Header)
+{
+  const uint8_t *p = (const uint8_t *)Header;
+  uint16_t crc = 0xFFFFU;
+  uint32_t i;
+  uint32_t b;
+
+  for (i = 0; i < offsetof(DatalogPage_t, Crc); i++)
+  {
+    crc ^= (uint16_t)(p[i] << 8);
+    for (b = 0; b < 8U; b++)
+    {
+      crc = ((crc & 0x8000U) != 0U) ? (uint16_t)((crc << 1) ^ 0x1021U) : (uint16_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+static void Run_Print(const TActivityRun *Run)
+{
+  uint8_t mode = (uint8_t)(Run->Code >> ACTLOG_MODE_SHIFT);
+  uint8_t activity = Run->Code & ACTLOG_ACT_MASK;
+  double start = (double)Run->Start / (double)((Decoder.TickHz != 0U) ? Decoder.TickHz : 1U);
+  char when[32] = "+";
+
+  if (Decoder.Anchored != 0U)
+  {
+    struct tm tm;
+    time_t t;
+
+    memset(&tm, 0, sizeof(tm));
+    tm.tm_year = Decoder.DateTime[0] + 100;
+    tm.tm_mon = Decoder.DateTime[1] - 1;
+    tm.tm_mday = Decoder.DateTime[2];
+    tm.tm_hour = Decoder.DateTime[3];
+    tm.tm_min = Decoder.DateTime[4];
+    tm.tm_sec = Decoder.DateTime[5];
+    t = timegm(&tm) + (time_t)start;
+    (void)strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", gmtime(&t));
+  }
+  else
+  {
+    (void)snprintf(&when[1], sizeof(when) - 1U, "%.3f", start);
+  }
+
+  if (Run->Length == 0U)
+  {
+    TurnOvers++;
+    printf("%s,0,%u,turn over\n", when, mode);
+    return;
+  }
+  Runs++;
+  Seconds += (double)Run->Length / (double)((Decoder.TickHz != 0U) ? Decoder.TickHz : 1U);
+  printf("%s,%.3f,%u,%s\n", when, (double)Run->Length / (double)((Decoder.TickHz != 0U) ? Decoder.TickHz : 1U), mode,
+         ((Run->Code & ACTLOG_SLEEP) != 0U) ? "sleeping"
+         : StatusFrame_ActivityName((activity == ACTLOG_ACT_MASK) ? (uint8_t)STATUS_ACT_UNKNOWN : activity));
+}
+
+static void Word_Decode(const uint8_t *Word)
+{
+  TActivityRun runs[ACTLOG_RUNS_MAX];
+  int n = ActivityLog_Decode(&Decoder, Word, runs);
+  int i;
+
+  Words++;
+  if (n < 0)
+  {
+    BadWords++;
+    return;
+  }
+  if (Word[0] == (uint8_t)ACTLOG_TAG_ANCHOR)
+  {
+    Anchors++;
+  }
+  for (i = 0; i < n; i++)
+  {
+    Run_Print(&runs[i]);
+  }
+}
+
+/**
+ * @brief  Walk the page ring of a flash image from the oldest page not
+ *         uploaded to the head
+ */
+static int Dump_Flash(const char *Path)
+{
+  static uint8_t region[DATALOG_PAGES][FLASH_PAGE_SIZE];
+  DatalogPage_t header;
+  int found = 0;
+  uint32_t head = 0;
+  uint32_t start;
+  uint32_t seq;
+  uint32_t page;
+  uint32_t slot;
+  FILE *f = fopen(Path, "rb");
+
+  if (f == NULL)
+  {
+    perror(Path);
+    return 1;
+  }
+  if ((fseek(f, (long)(FLASH_ADDRESS - FLASH_BASE), SEEK_SET) != 0) || (fread(region, sizeof(region), 1, f) != 1U))
+  {
+    fprintf(stderr, "%s: not a flash image\n", Path);
+    fclose(f);
+    return 1;
+  }
+  fclose(f);
+
+  for (page = 0; page < DATALOG_PAGES; page++)
+  {
+    memcpy(&header, region[page], sizeof(header));
+    if ((header.Magic == DATALOG_PAGE_MAGIC) && (header.Crc == Page_Crc(&header))
+        && ((header.Seq % DATALOG_PAGES) == page) && ((found == 0) || ((int32_t)(header.Seq - head) > 0)))
+    {
+      head = header.Seq;
+      found = 1;
+    }
+  }
+  if (found == 0)
+  {
+    fprintf(stderr, "%s: no datalog\n", Path);
+    return 1;
+  }
+  memcpy(&header, region[head % DATALOG_PAGES], sizeof(header));
+  start = head - header.Back;
+
+  for (seq = start; seq != (head + 1U); seq++)
+  {
+    for (slot = 1; slot <= DATALOG_PAGE_RECORDS; slot++)
+    {
+      const uint8_t *word = &region[seq % DATALOG_PAGES][slot * FLASH_ITEM_SIZE];
+      static const uint8_t erased[FLASH_ITEM_SIZE] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+      if (memcmp(word, erased, sizeof(erased)) == 0)
+      {
+        break;
+      }
+      Word_Decode(word);
+    }
+  }
+  fprintf(stderr, "%s: pages %u to %u\n", Path, start, head);
+  return 0;
+}
+
+static int Dump_Upload(const char *Path)
+{
+  uint8_t word[ACTLOG_WORD_LEN];
+  uint8_t len[4];
+  uint32_t bytes;
+  uint32_t done;
+  FILE *f = (strcmp(Path, "-") == 0) ? stdin : fopen(Path, "rb");
+
+  if (f == NULL)
+  {
+    perror(Path);
+    return 1;
+  }
+  if (fread(len, sizeof(len), 1, f) != 1U)
+  {
+    fprintf(stderr, "%s: no upload header\n", Path);
+    return 1;
+  }
+  bytes = ((uint32_t)len[0] << 24) | ((uint32_t)len[1] << 16) | ((uint32_t)len[2] << 8) | len[3];
+  for (done = 0; (done < bytes) && (fread(word, sizeof(word), 1, f) == 1U); done += ACTLOG_WORD_LEN)
+  {
+    Word_Decode(word);
+  }
+  if (done < bytes)
+  {
+    fprintf(stderr, "%s: upload cut at %u of %u bytes\n", Path, done, bytes);
+  }
+  if (f != stdin)
+  {
+    fclose(f);
+  }
+  return 0;
+}
+
+/* Main ----------------------------------------------------------------------*/
+int main(int argc, char **argv)
+{
+  int ret;
+
+  ActivityLog_DecoderInit(&Decoder);
+  printf("# start,seconds,mode,activity\n");
+  if ((argc == 3) && (strcmp(argv[1], "-u") == 0))
+  {
+    ret = Dump_Upload(argv[2]);
+  }
+  else if ((argc == 2) && (argv[1][0] != '-'))
+  {
+    ret = Dump_Flash(argv[1]);
+  }
+  else
+  {
+    return Usage();
+  }
+  if (ret != 0)
+  {
+    return ret;
+  }
+
+  fprintf(stderr, "%llu words (%llu anchors, %llu bad), %llu runs over %.2f h, %llu turn overs\n",
+          (unsigned long long)Words, (unsigned long long)Anchors, (unsigned long long)BadWords,
+          (unsigned long long)Runs, Seconds / 3600.0, (unsigned long long)TurnOvers);
+  if (Seconds > 0.0)
+  {
+    double perDay = (double)Words * 86400.0 / Seconds;
+
+    fprintf(stderr, "%.0f words per day logged, %.1f days to fill the %u record log\n", perDay,
+            (double)(DATALOG_PAGES * DATALOG_PAGE_RECORDS) / perDay, (unsigned)(DATALOG_PAGES * DATALOG_PAGE_RECORDS));
+  }
+  return 0;
+}
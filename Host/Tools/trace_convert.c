@@ -0,0 +1,152 @@
+/**
+ ******************************************************************************
+ * @file    trace_convert.c
+ * @brief   Sensor trace tool for the host simulation.
+ *
+ *          trace_convert in.csv out.trc      CSV recording to binary trace
+ *          trace_convert -d in.trc           binary trace back to CSV on stdout
+ *          trace_convert -i in.trc           record count and duration
+ *          trace_convert -g seconds out.trc  synthetic trace at 16 Hz
+ *
+ *          gcc -O2 -IHost/Inc -IInc Host/Tools/trace_convert.c Host/Src/sim_trace.c -lm -o trace_convert
+ ******************************************************************************
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim_trace.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define SYNTH_PERIOD_US   62500U  /* same as the firmware acquisition timer */
+
+/* Private functions ---------------------------------------------------------*/
+static int Usage(void)
+{
+  fprintf(stderr, "usage: trace_convert in.csv out.trc | -d in.trc | -i in.trc | -g seconds out.trc\n");
+  return 2;
+}
+
+static FILE *Trace_Create(const char *Path)
+{
+  SIM_TraceHeader_t header;
+  FILE *f = fopen(Path, "wb");
+
+  if (f == NULL)
+  {
+    perror(Path);
+    return NULL;
+  }
+  SIM_TraceInitHeader(&header);
+  (void)fwrite(&header, sizeof(header), 1, f);
+  return f;
+}
+
+static int Trace_Finish(FILE *f, const char *Path, size_t Count)
+{
+  if (fclose(f) != 0)
+  {
+    perror(Path);
+    return 1;
+  }
+  fprintf(stderr, "%s: %zu records\n", Path, Count);
+  return 0;
+}
+
+static int Convert(const char *In, const char *Out)
+{
+  SIM_Trace_t trace;
+  FILE *f;
+
+  if (SIM_TraceOpen(&trace, In) == 0)
+  {
+    return 1;
+  }
+  f = Trace_Create(Out);
+  if (f == NULL)
+  {
+    SIM_TraceClose(&trace);
+    return 1;
+  }
+  (void)fwrite(trace.Records, sizeof(SIM_TraceRecord_t), trace.Count, f);
+  SIM_TraceClose(&trace);
+  return Trace_Finish(f, Out, trace.Count);
+}
+
+static int Dump(const char *In, int InfoOnly)
+{
+  SIM_Trace_t trace;
+  SIM_Sample_t s;
+  size_t i;
+
+  if (SIM_TraceOpen(&trace, In) == 0)
+  {
+    return 1;
+  }
+  if (InfoOnly != 0)
+  {
+    uint32_t span = (trace.Count != 0U) ? (trace.Records[trace.Count - 1U].TimeMs - trace.Records[0].TimeMs) : 0U;
+
+    printf("%s: %zu records, %.1f s, %s\n", In, trace.Count, (double)span / 1000.0,
+           (trace.Map != NULL) ? "binary" : "csv");
+  }
+  else
+  {
+    printf("# t_ms,acc_x,acc_y,acc_z,gyr_x,gyr_y,gyr_z,pressure\n");
+    for (i = 0; i < trace.Count; i++)
+    {
+      SIM_TraceToSample(&trace.Records[i], &s);
+      printf("%u,%d,%d,%d,%d,%d,%d,%.4f\n", s.TimeMs, s.Acc[0], s.Acc[1], s.Acc[2], s.Gyr[0], s.Gyr[1],
+             s.Gyr[2], s.Pressure);
+    }
+  }
+  SIM_TraceClose(&trace);
+  return 0;
+}
+
+static int Generate(uint32_t Seconds, const char *Out)
+{
+  uint64_t endUs = (uint64_t)Seconds * 1000000U;
+  uint64_t t;
+  size_t count = 0;
+  FILE *f = Trace_Create(Out);
+
+  if (f == NULL)
+  {
+    return 1;
+  }
+  for (t = 0; t < endUs; t += SYNTH_PERIOD_US)
+  {
+    SIM_Sample_t s;
+    SIM_TraceRecord_t r;
+
+    SIM_TraceSynth((uint32_t)(t / 1000U), &s);
+    SIM_TraceFromSample(&s, &r);
+    (void)fwrite(&r, sizeof(r), 1, f);
+    count++;
+  }
+  return Trace_Finish(f, Out, count);
+}
+
+/* Main ----------------------------------------------------------------------*/
+int main(int argc, char **argv)
+{
+  if ((argc == 3) && (strcmp(argv[1], "-d") == 0))
+  {
+    return Dump(argv[2], 0);
+  }
+  if ((argc == 3) && (strcmp(argv[1], "-i") == 0))
+  {
+    return Dump(argv[2], 1);
+  }
+  if ((argc == 4) && (strcmp(argv[1], "-g") == 0))
+  {
+    return Generate((uint32_t)strtoul(argv[2], NULL, 0), argv[3]);
+  }
+  if ((argc == 3) && (argv[1][0] != '-'))
+  {
+    return Convert(argv[1], argv[2]);
+  }
+  return Usage();
+}
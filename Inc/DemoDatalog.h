@@ -30,8 +30,8 @@ extern "C" {
 /* Public types --------------------------------------------------------------*/
 typedef struct
 {
-  uint8_t date[3];
-  uint8_t time[3];
+  uint8_t date[3];   /* year (from 2000), month, day */
+  uint8_t time[3];   /* hours, minutes, seconds */
 } DateTime_t;
 
 typedef struct
@@ -41,18 +41,21 @@ typedef struct
   uint8_t activity_type;
 } DataByte_t;
 
+/**
+ * @brief  Page header, one double word
+ */
+typedef struct
+{
+  uint32_t Seq;       /* pages opened since the log was created, the page index is Seq % DATALOG_PAGES */
+  uint8_t Back;       /* pages before this one still to be uploaded */
+  uint8_t Magic;      /* DATALOG_PAGE_MAGIC */
+  uint16_t Crc;       /* CRC-16/CCITT of the fields above */
+} DatalogPage_t;
+
 /* Private defines -----------------------------------------------------------*/
 #define DATABYTE_LEN                  ((uint8_t)20)
 
-#if (defined (USE_STM32F4XX_NUCLEO))
-#define FLASH_SECTOR                  FLASH_SECTOR_6
-#define FLASH_SECTOR_SIZE             (SIZE_FLASH_SECTOR_6)
-#define SIZE_FLASH_SECTOR_6           ((uint32_t)0x00020000)
-
-#elif (defined (USE_STM32L1XX_NUCLEO))
-#define FLASH_SECTOR_SIZE             ((uint32_t)0x00020000) /* Size of sector 64 .. 95 */
-
-#elif (defined (USE_STM32L4XX_NUCLEO))
+#if (defined (USE_STM32L4XX_NUCLEO))
 #define FLASH_SECTOR_SIZE             ((uint32_t)0x00020000)
 
 #else
@@ -62,21 +65,53 @@ typedef struct
 #define FLASH_ITEM_SIZE               8U
 
 /* Exported defines ----------------------------------------------------------*/
-#if (defined (USE_STM32F4XX_NUCLEO))
-#define FLASH_ADDRESS                 ((uint32_t)0x08040000)
-
-#elif (defined (USE_STM32L1XX_NUCLEO))
-#define FLASH_ADDRESS                 ((uint32_t)0x08040000) /* page 1024 */
-
-#elif (defined (USE_STM32L4XX_NUCLEO))
+#if (defined (USE_STM32L4XX_NUCLEO))
 #define FLASH_ADDRESS                 ((uint32_t)0x080DF800) /* page 447 */
 
 #else
 #error Not supported platform
 #endif
 
+/* The region is a ring of pages written in order. The first double word of
+ * each page is its header, the records follow one per double word. The
+ * records are activity log words, see activity_log.h.
+ */
+#define DATALOG_PAGES                 (FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE)
+#define DATALOG_PAGE_RECORDS          ((FLASH_PAGE_SIZE / FLASH_ITEM_SIZE) - 1U)
+#define DATALOG_PAGE_MAGIC            0xA5U
+
+/* Records are staged in RAM and programmed from the main loop while the
+ * algorithm keeps running: a fast programming row (32 double words) at a
+ * time once a row worth is staged, or whatever is staged DATALOG_FLUSH_MS
+ * after the buffer stopped being empty. The region is in bank 2, code runs from
+ * bank 1 and is not stalled by the programming or erase going on.
+ */
+#define DATALOG_ROW_RECORDS           32U
+#define DATALOG_STAGE_RECORDS         (2U * DATALOG_ROW_RECORDS)
+#define DATALOG_FLUSH_MS              (30U * 60U * 1000U)
+#define DATALOG_FLUSH_TIMEOUT_MS      1000U  /* Datalog_Flush gives up after that */
+#define DATALOG_LATENCY_BUCKETS       8U
+
+/**
+ * @brief  Flush counters. A flush runs from the call of Datalog_Process that
+ *         starts it to the one that finds nothing more to program, its
+ *         latency is that time.
+ */
+typedef struct
+{
+  uint32_t Flushes;
+  uint32_t DeadlineFlushes;   /* started by DATALOG_FLUSH_MS rather than a full row */
+  uint32_t Bytes;             /* record bytes programmed */
+  uint32_t BytesMax;          /* most record bytes in one flush */
+  uint32_t Rows;              /* rows programmed in fast mode */
+  uint32_t DoubleWords;       /* records programmed one at a time */
+  uint32_t Erases;            /* pages erased to open them */
+  uint32_t Errors;            /* operations failed, a failed slot or row is skipped */
+  uint32_t StagedMax;         /* most records waiting in RAM */
+  uint32_t Latency[DATALOG_LATENCY_BUCKETS]; /* flushes by duration: < 1 ms, < 2 ms, < 4 ms ... the last one open ended */
+} DatalogStats_t;
+
 /* Public variables ----------------------------------------------------------*/
-extern uint32_t Address2F;
 extern DataByte_t DataByte[];
 
 /* Exported macro ------------------------------------------------------------*/
@@ -84,8 +119,20 @@ extern DataByte_t DataByte[];
 flash_state_t Datalog_SetAddress(void);
 unsigned char Datalog_FlashErase(void);
 unsigned char Datalog_SaveData2Mem(uint8_t IndexMax);
-uint32_t Datalog_SearchNextFreeMemoryIndex(uint32_t *FlashSectorBaseAddress);
-void Datalog_FillBuffer2BSent(uint32_t AddF, uint8_t LenBuf);
+unsigned char Datalog_SaveWords(const uint8_t *Data, uint32_t Count);
+void Datalog_Process(void);
+unsigned char Datalog_Flush(void);
+void Datalog_Pause(uint8_t On);
+unsigned char Datalog_Drop(uint32_t Count);
+const DatalogStats_t *Datalog_GetStats(void);
+void Datalog_ActivityStart(uint8_t TickHz);
+unsigned char Datalog_ActivityLog(uint32_t Tick, uint32_t Ticks, uint8_t Code, uint8_t TurnOver);
+unsigned char Datalog_ActivityFlush(void);
+void Datalog_ActivityRestart(void);
+uint32_t Datalog_RecordCount(void);
+uint32_t Datalog_LogId(void);
+void Datalog_ReadRecords(uint32_t Index, uint8_t *Dest, uint32_t Count);
+void Datalog_FillBuffer2BSent(uint32_t Index, uint8_t LenBuf);
 
 #ifdef __cplusplus
 }
@@ -30,6 +30,7 @@ extern "C" {
 #include "cube_hal.h"
 #include "serial_protocol.h"
 #include "Serial_CMD.h"
+#include "stream_batch.h"
 
 /* Private defines -----------------------------------------------------------*/
 #define SENDER_UART  0x01
@@ -44,11 +45,14 @@ extern "C" {
 /* Exported variables --------------------------------------------------------*/
 extern volatile uint8_t DataLoggerActive;
 extern volatile uint32_t SensorsEnabled;
+extern TStreamBatch StreamBatch;
 extern TIM_HandleTypeDef AlgoTimHandle;
 extern UART_HandleTypeDef UartHandle;
 
 /* Exported functions ------------------------------------------------------- */
 int HandleMSG(TMsg *Msg);
+void Bulk_Process(void);
+void Baud_Process(void);
 
 /* Private functions ------------------------------------------------------- */
 void BUILD_REPLY_HEADER(TMsg *Msg);
@@ -34,14 +34,32 @@ extern "C" {
 #define CMD_NACK                       0x03
 #define CMD_CheckModeSupport           0x04
 #define CMD_UploadXX                   0x05
+#define CMD_Set_Baud                   0x06
+#define CMD_Power_Stats                0x07
 #define CMD_Start_Data_Streaming       0x08
 #define CMD_Stop_Data_Streaming        0x09
+#define CMD_Start_Batch_Streaming      0x0A
+#define CMD_Batch_Data                 0x0B
 
 #define CMD_Set_DateTime               0x0C
+#define CMD_Datalog_Stats              0x0D
 #define CMD_Enter_DFU_Mode             0x0E
 #define CMD_Reset                      0x0F
 #define CMD_Reply_Add                  0x80U
 
+/* STATUS  CMD  (0x20 - 0x2F) --------------------*/
+#define CMD_Status_Frame               0x20
+#define CMD_Relay_Hello                0x21
+#define CMD_Relay_Ack                  0x22
+#define CMD_Relay_Age                  0x23
+#define CMD_Relay_Heartbeat            0x24
+
+/* BULK  CMD  (0x30 - 0x3F) ----------------------*/
+#define CMD_Bulk_Start                 0x30
+#define CMD_Bulk_Read                  0x31
+#define CMD_Bulk_Data                  0x32
+#define CMD_Bulk_Done                  0x33
+
 /* ENVIRONMENTAL  CMD  (0x60 - 0x6F) -------------*/
 #define CMD_PRESSURE_Init              0x60
 #define CMD_HUMIDITY_TEMPERATURE_Init  0x62
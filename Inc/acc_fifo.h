@@ -0,0 +1,56 @@
+/**
+ *******************************************************************************
+ * @file    acc_fifo.h
+ * @brief   header for acc_fifo.c.
+ *******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef ACC_FIFO_H
+#define ACC_FIFO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "iks01a2_motion_sensors.h"
+#include "nucleo_l476rg_bus.h"
+
+/* Exported defines ----------------------------------------------------------*/
+#define ACC_FIFO_ODR          26U    /* [Hz] LSM6DSL rate nearest above the algorithm's */
+#define ACC_FIFO_BURST        64U    /* samples read per I2C transaction at most */
+#define ACC_FIFO_WORDS        3U     /* 16-bit FIFO words per sample, x y z */
+
+/* Exported types ------------------------------------------------------------*/
+/**
+ * @brief  Accelerometer FIFO and its resampling to the algorithm ticks
+ */
+typedef struct
+{
+  IKS01A2_MOTION_SENSOR_Axes_t Samples[ACC_FIFO_BURST];  /* [mg] last burst */
+  uint16_t Count;        /* samples in the last burst */
+  uint16_t Watermark;    /* samples, the interrupt fires at this level */
+  float Sensitivity;     /* [mg/LSB] at the full scale set */
+  uint32_t TickFreq;     /* [Hz] algorithm ticks made from the samples */
+  uint64_t Received;     /* samples read since AccFifo_Start */
+  uint64_t Ticks;        /* ticks handed out since AccFifo_Start */
+  uint32_t Bursts;       /* data reads */
+  uint32_t Overruns;     /* times samples were lost, the FIFO full */
+  uint16_t Skip;         /* words of a partial sample in front of the burst read */
+  uint16_t Reading;      /* samples in the burst read */
+} TAccFifo;
+
+/* Exported functions ------------------------------------------------------- */
+void AccFifo_Start(TAccFifo *Fifo, uint16_t Watermark, uint32_t TickFreq);
+void AccFifo_Stop(TAccFifo *Fifo);
+int32_t AccFifo_Submit(TAccFifo *Fifo, BSP_I2C1_Xfer_t *Then);
+uint16_t AccFifo_Parse(TAccFifo *Fifo);
+int AccFifo_Next(TAccFifo *Fifo, IKS01A2_MOTION_SENSOR_Axes_t *Axes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ACC_FIFO_H */
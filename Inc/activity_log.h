@@ -0,0 +1,102 @@
+/**
+ *******************************************************************************
+ * @file    activity_log.h
+ * @brief   header for activity_log.c.
+ *******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef ACTIVITY_LOG_H
+#define ACTIVITY_LOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported defines ----------------------------------------------------------*/
+/* The log is a sequence of 8 byte words, one flash double word each:
+ *  Anchor: 0xA0 | Year | Month | Day | Hours | Minutes | Seconds | TickHz
+ *  Runs:   0xB0 + n | n entries, zero padded
+ * An entry is Code | [Gap] | Length, where Gap [ticks] is the time from the
+ * end of the previous entry (or the anchor) to the start of the run, only
+ * present with ACTLOG_GAP set in the code, and Length [ticks] is how long it
+ * lasted, both LEB128 varints of at most 3 bytes (the gap of an idle entry
+ * can take 5). Entries never straddle two words and the first byte is never
+ * 0xFF, so a word can be decoded on its own and is never mistaken for erased
+ * flash.
+ */
+#define ACTLOG_WORD_LEN               8U
+#define ACTLOG_TAG_ANCHOR             0xA0U
+#define ACTLOG_TAG_RUNS               0xB0U
+#define ACTLOG_TAG_MASK               0xF0U
+#define ACTLOG_VARINT_MAX             0x1FFFFFU  /* 3 varint bytes, 36 h at 16 Hz */
+#define ACTLOG_RUNS_MAX               3U         /* entries are at least 2 bytes */
+#define ACTLOG_OUT_MAX                (5U * ACTLOG_WORD_LEN)  /* most bytes one encoder call outputs */
+
+/* Code: Mode << 6 | Sleep << 5 | Gap << 4 | Activity, STATUS_xx values of
+ * status_frame.h. Length 0 marks a turn over; mode 3 is time without status,
+ * kept only to carry gaps longer than ACTLOG_VARINT_MAX.
+ */
+#define ACTLOG_ACT_MASK               0x0FU      /* STATUS_ACT_UNKNOWN is stored as 0x0F */
+#define ACTLOG_GAP                    0x10U
+#define ACTLOG_SLEEP                  0x20U
+#define ACTLOG_MODE_SHIFT             6U
+#define ACTLOG_CODE_IDLE              0xC0U
+#define ACTLOG_CODE(Mode, Activity, Sleep) \
+  ((uint8_t)((((uint32_t)(Mode) & 0x03U) << ACTLOG_MODE_SHIFT) | (((Sleep) != 0U) ? ACTLOG_SLEEP : 0U) \
+             | ((uint32_t)(Activity) & ACTLOG_ACT_MASK)))
+
+/* Exported types ------------------------------------------------------------*/
+/**
+ * @brief  Encoder state on the device
+ */
+typedef struct
+{
+  uint8_t Word[ACTLOG_WORD_LEN];  /* word being filled */
+  uint8_t Used;          /* bytes of Word used, 0 when empty */
+  uint8_t Open;          /* 1 while a run is open */
+  uint8_t Code;          /* code of the open run */
+  uint32_t Start;        /* [ticks] start of the open run */
+  uint32_t Next;         /* [ticks] tick that would extend the open run */
+  uint32_t End;          /* [ticks] end of the last entry written, or the anchor */
+} TActivityLog;
+
+/**
+ * @brief  Decoder state on the host
+ */
+typedef struct
+{
+  uint8_t Anchored;      /* 0 until the first anchor, times are then relative to the start */
+  uint8_t DateTime[6];   /* Year (from 2000), Month, Day, Hours, Minutes, Seconds of the anchor */
+  uint8_t TickHz;
+  uint32_t Tick;         /* [ticks] since the anchor, end of the last entry */
+} TActivityDecoder;
+
+/**
+ * @brief  One decoded run
+ */
+typedef struct
+{
+  uint32_t Start;        /* [ticks] since the anchor */
+  uint32_t Length;       /* [ticks], 0 for a turn over */
+  uint8_t Code;          /* ACTLOG_GAP cleared */
+} TActivityRun;
+
+/* Exported functions ------------------------------------------------------- */
+void ActivityLog_Init(TActivityLog *Log);
+uint32_t ActivityLog_Add(TActivityLog *Log, uint32_t Tick, uint32_t Ticks, uint8_t Code, uint8_t TurnOver,
+                         uint8_t *Out);
+uint32_t ActivityLog_Flush(TActivityLog *Log, uint8_t *Out);
+uint32_t ActivityLog_Anchor(TActivityLog *Log, uint32_t Tick, const uint8_t *DateTime, uint8_t TickHz,
+                            uint8_t *Out);
+void ActivityLog_DecoderInit(TActivityDecoder *Decoder);
+int ActivityLog_Decode(TActivityDecoder *Decoder, const uint8_t *Word, TActivityRun *Runs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ACTIVITY_LOG_H */
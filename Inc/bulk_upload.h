@@ -0,0 +1,72 @@
+/**
+ *******************************************************************************
+ * @file    bulk_upload.h
+ * @brief   header for bulk_upload.c.
+ *******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef BULK_UPLOAD_H
+#define BULK_UPLOAD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "serial_protocol.h"
+#include "Serial_CMD.h"
+
+/* Exported defines ----------------------------------------------------------*/
+/* Messages (multi-byte fields LSB first, offsets in bytes of the datalog
+ * records, oldest record not uploaded first):
+ *  CMD_Bulk_Start  host:   -
+ *                  reply:  LogId (4) | Total (4) | BlockLen (2)
+ *  CMD_Bulk_Read   host:   LogId (4) | Offset (4) | Blocks (1), no reply but
+ *                          the blocks, or one CMD_Bulk_Data without data when
+ *                          the request is refused
+ *  CMD_Bulk_Data   device: Seq (2) | Offset (4) | Status (1) | Crc (4) | Data
+ *  CMD_Bulk_Done   host:   LogId (4) | Total (4)
+ *                  reply:  Status (1)
+ * Seq counts the CMD_Bulk_Data messages of the session, so a gap is a lost
+ * block. Crc is the CRC-32 (zlib) of Data. LogId only changes when uploaded
+ * records are dropped, a host that kept the blocks of an earlier session
+ * with the same LogId can resume at its offset.
+ */
+#define BULK_BLOCK_LEN                240U   /* 30 records, header and checksum fit in TMsg_MaxLen */
+#define BULK_HEADER_LEN               14U
+#define BULK_WIRE_MAX                 (2U * (BULK_HEADER_LEN + BULK_BLOCK_LEN + 1U) + 1U) /* worst case after byte stuffing */
+#define BULK_RANGES                   8U     /* CMD_Bulk_Read requests the device queues */
+#define BULK_TIMEOUT_MS               5000U  /* a session with no request for that long ends */
+
+/* Status */
+#define BULK_OK                       0U
+#define BULK_END                      1U     /* offset past the end of the log */
+#define BULK_STALE                    2U     /* no session or another LogId */
+#define BULK_BUSY                     3U     /* read queue full, request again */
+
+/* Exported types ------------------------------------------------------------*/
+/**
+ * @brief  CMD_Bulk_Data as decoded by the host
+ */
+typedef struct
+{
+  uint16_t Seq;
+  uint32_t Offset;
+  uint8_t Status;
+  uint32_t Len;          /* bytes of Data */
+  const uint8_t *Data;   /* into the message */
+} TBulkBlock;
+
+/* Exported functions ------------------------------------------------------- */
+uint32_t BulkUpload_Crc32(uint32_t Crc, const uint8_t *Data, uint32_t Len);
+void BulkUpload_Block(TMsg *Msg, uint8_t Dest, uint16_t Seq, uint32_t Offset, uint8_t Status, uint32_t Len,
+                      uint32_t Crc);
+int BulkUpload_Parse(const TMsg *Msg, TBulkBlock *Block);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BULK_UPLOAD_H */
@@ -37,11 +37,26 @@ extern "C" {
 typedef struct
 {
   uint8_t *pDMA_Buffer;
-  uint16_t StartOfMsg;
+  uint16_t StartOfMsg;  /* ring index of the first byte of the frame being decoded */
+  uint16_t Pos;         /* next ring index to decode */
+  uint16_t Len;         /* bytes decoded so far, checksum included */
+  uint8_t Chk;          /* running checksum of the decoded bytes */
+  uint8_t State;        /* UART_RX_xx */
 } TUart_Engine;
 
+/**
+ * @brief  Received message, either in place in the DMA ring or unstuffed in a
+ *         private buffer; valid until the next UART_ReceivedView call
+ */
+typedef struct
+{
+  uint8_t *Data;        /* payload, checksum removed */
+  uint32_t Len;
+} TMsgView;
+
 /* Exported defines ----------------------------------------------------------*/
 #define UART_RxBufferSize (2*TMsg_MaxLen)
+#define UART_TxRingSize   (4U*TMsg_MaxLen) /* power of two, holds at least two stuffed messages */
 
 /* User can use this section to tailor USARTx/UARTx instance used and associated resources */
 /* Definition for USARTx clock resources */
@@ -54,23 +69,46 @@ typedef struct
 #define USARTx_FORCE_RESET()             __USART3_FORCE_RESET()
 #define USARTx_RELEASE_RESET()           __USART3_RELEASE_RESET()
 
+/* Definition for USARTx's NVIC, the transmit side runs on DMA interrupts */
+#define USARTx_IRQn                      USART3_IRQn
+#define USARTx_IRQHandler                USART3_IRQHandler
+#define USARTx_DMA_TX_IRQn               DMA1_Channel2_IRQn
+#define USARTx_DMA_TX_IRQHandler         DMA1_Channel2_IRQHandler
+
 /* Definition for USARTx Pins */
 #define USARTx_TX_PIN                    GPIO_PIN_10
 #define USARTx_TX_GPIO_PORT              GPIOC
 #define USARTx_RX_PIN                    GPIO_PIN_11
 #define USARTx_RX_GPIO_PORT              GPIOC
 
+/* Hardware flow control, only driven once CMD_Set_Baud turns it on */
+#define USARTx_FLOW_GPIO_CLK_ENABLE()    __GPIOB_CLK_ENABLE()
+#define USARTx_RTS_PIN                   GPIO_PIN_14
+#define USARTx_CTS_PIN                   GPIO_PIN_13
+#define USARTx_FLOW_GPIO_PORT            GPIOB
+#define USARTx_FLOW_AF                   GPIO_AF7_USART3
+
 /* Exported variables --------------------------------------------------------*/
 extern volatile uint8_t UartRxBuffer[UART_RxBufferSize];
 extern volatile uint32_t UsartBaudRate;
+extern volatile uint8_t UsartRtsCts;
 extern TUart_Engine UartEngine;
+extern volatile uint16_t UartTxHighWater;
+extern volatile uint32_t UartTxOverruns;
+extern volatile uint32_t UartTxErrors;
 
 /* Exported macro ------------------------------------------------------------*/
 /* Private functions ---------------------------------------------------------*/
 /* Exported functions --------------------------------------------------------*/
 void USARTConfig(void);
 int UART_ReceivedMSG(TMsg *Msg);
+int UART_ReceivedView(TMsgView *View);
+int UART_RxPending(void);
 void UART_SendMsg(TMsg *Msg);
+int UART_TxEnqueue(const uint8_t *Data, uint16_t Len);
+uint16_t UART_TxRoom(void);
+void UART_TxFlush(void);
+void UART_SetBaud(uint32_t Baud, uint8_t RtsCts);
 void USART_DMA_Configuration(void);
 
 #ifdef __cplusplus
@@ -45,11 +45,15 @@
 #endif
 
 #ifdef USE_STM32L4XX_NUCLEO
+#ifdef USE_HOST_SIM
+#include "sim_hal.h"
+#else
 #include "stm32l4xx_hal.h"
 #include "stm32l4xx_nucleo.h"
 #include "stm32l4xx_hal_conf.h"
 #include "stm32l4xx_hal_def.h"
 #endif
+#endif
 
 #ifdef USE_STM32F4XX_NUCLEO
 #define USARTx_TX_AF                     GPIO_AF7_USART2
@@ -99,6 +103,7 @@ void SystemClock_Config(void);
 uint32_t Get_DMA_Flag_Status(DMA_HandleTypeDef *handle_dma);
 uint32_t Get_DMA_Counter(DMA_HandleTypeDef *handle_dma);
 void Config_DMA_Handler(DMA_HandleTypeDef *handle_dma);
+void Config_DMA_TxHandler(DMA_HandleTypeDef *handle_dma);
 
 #endif /* CUBE_HAL_H */
 
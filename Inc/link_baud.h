@@ -0,0 +1,45 @@
+/**
+ *******************************************************************************
+ * @file    link_baud.h
+ * @brief   CMD_Set_Baud: rate and flow control of the nucleo UART link.
+ *******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef LINK_BAUD_H
+#define LINK_BAUD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Exported defines ----------------------------------------------------------*/
+/* CMD_Set_Baud   host:   Baud (4) | Flow (1), LSB first
+ *                reply:  Status (1) | Baud (4) | Flow (1), the settings from then on
+ * The link starts at LINK_BAUD_DEFAULT without flow control. A request for
+ * other settings is answered LINK_BAUD_PENDING at the current ones, then the
+ * nucleo switches once the reply is out. The host switches too and sends the
+ * same request again at the new settings: the answer, LINK_BAUD_OK, shows
+ * both ways work. Without that request within LINK_BAUD_VERIFY_MS the nucleo
+ * goes back to the settings it had, so a rate the other side cannot do never
+ * loses the link.
+ */
+#define LINK_BAUD_DEFAULT             115200U
+#define LINK_BAUD_MIN                 9600U
+#define LINK_BAUD_MAX                 4000000U  /* 80 MHz PCLK1 / 16 is 5 Mbaud, rounded to a rate hosts do */
+#define LINK_BAUD_VERIFY_MS           1000U
+
+/* Flow */
+#define LINK_FLOW_NONE                0U
+#define LINK_FLOW_RTSCTS              1U
+
+/* Status */
+#define LINK_BAUD_OK                  0U     /* verified, or nothing to change */
+#define LINK_BAUD_PENDING             1U     /* switching, verify within LINK_BAUD_VERIFY_MS */
+#define LINK_BAUD_REFUSED             2U     /* rate or flow not supported, nothing changes */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LINK_BAUD_H */
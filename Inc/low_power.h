@@ -0,0 +1,39 @@
+/**
+ *******************************************************************************
+ * @file    low_power.h
+ * @brief   header for low_power.c.
+ *******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef LOW_POWER_H
+#define LOW_POWER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported types ------------------------------------------------------------*/
+/**
+ * @brief  Duty cycle of the core since LowPower_Init
+ */
+typedef struct
+{
+  uint64_t ActiveCycles;  /* [core cycles] running, counted by DWT CYCCNT */
+  uint64_t SleepCycles;   /* [core cycles] in Sleep mode, timed by SysTick */
+  uint32_t Sleeps;        /* times the core went to sleep */
+} LowPowerStats_t;
+
+/* Exported functions ------------------------------------------------------- */
+void LowPower_Init(void);
+void LowPower_Sleep(void);
+const LowPowerStats_t *LowPower_GetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LOW_POWER_H */
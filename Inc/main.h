@@ -69,6 +69,13 @@ typedef enum
 #error Not supported platform
 #endif
 
+/* LSM6DSL INT1 on the X-NUCLEO-IKS01A2 (D4) */
+#define ACC_INT1_PIN                      GPIO_PIN_5
+#define ACC_INT1_GPIO_PORT                GPIOB
+#define ACC_INT1_GPIO_CLK_ENABLE          __GPIOB_CLK_ENABLE
+#define ACC_INT1_EXTI_IRQn                EXTI9_5_IRQn
+#define ACC_INT1_IRQHandler               EXTI9_5_IRQHandler
+
 /* Enable sensor masks */
 #define PRESSURE_SENSOR                         0x00000001U
 #define TEMPERATURE_SENSOR                      0x00000002U
@@ -82,6 +89,10 @@ typedef enum
 void Error_Handler(void);
 void RTC_DateRegulate(uint8_t y, uint8_t m, uint8_t d, uint8_t dw);
 void RTC_TimeRegulate(uint8_t hh, uint8_t mm, uint8_t ss);
+void RTC_GetDateTime(uint8_t *Date, uint8_t *Time);
+uint32_t CRC_Block32(const uint8_t *Data, uint32_t Len);
+void Acquisition_Start(void);
+void Acquisition_Stop(void);
 
 #ifdef __cplusplus
 }
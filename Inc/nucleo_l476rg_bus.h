@@ -47,6 +47,29 @@ typedef struct
 
 /* Includes ------------------------------------------------------------------*/
 #include <stdint.h>
+
+/* Register sequences queued at once on I2C1 */
+#define BSP_I2C1_QUEUE_LEN  4U
+
+/**
+  * @brief  One register transfer of an I2C1 sequence, run in the background:
+  *         reads by DMA, writes by interrupt
+  */
+typedef struct BSP_I2C1_Xfer BSP_I2C1_Xfer_t;
+typedef void (*BSP_I2C1_XferCb_t)(BSP_I2C1_Xfer_t *Xfer);
+struct BSP_I2C1_Xfer
+{
+  uint16_t DevAddr;
+  uint16_t Reg;             /* 8-bit register address */
+  uint8_t *pData;
+  uint16_t Len;             /* 0 skips the transfer, Done is still called */
+  uint8_t Write;            /* 1 writes pData, 0 reads into it */
+  volatile int32_t Status;  /* BSP_ERROR_BUSY until the transfer ended */
+  BSP_I2C1_XferCb_t Done;   /* from the interrupt when it ended, may set the next Len */
+  void *Context;
+  BSP_I2C1_Xfer_t *Next;    /* started right after this one, NULL ends the sequence */
+};
+
 /* BUS IO driver over I2C Peripheral */
 int32_t BSP_I2C1_Init(void);
 int32_t BSP_I2C1_DeInit(void);
@@ -58,6 +81,9 @@ int32_t BSP_I2C1_ReadReg16(uint16_t Addr, uint16_t Reg, uint8_t *pData, uint16_t
 int32_t BSP_I2C1_Send(uint16_t DevAddr, uint8_t *pData, uint16_t Length);
 int32_t BSP_I2C1_Recv(uint16_t DevAddr, uint8_t *pData, uint16_t Length);
 int32_t BSP_I2C1_SendRecv(uint16_t DevAddr, uint8_t *pTxdata, uint8_t *pRxdata, uint16_t Length);
+int32_t BSP_I2C1_Submit(BSP_I2C1_Xfer_t *First);
+int32_t BSP_I2C1_Pending(void);
+void BSP_I2C1_Wait(void);
 
 int32_t BSP_GetTick(void);
 
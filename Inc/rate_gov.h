@@ -0,0 +1,44 @@
+/**
+ *******************************************************************************
+ * @file    rate_gov.h
+ * @brief   header for rate_gov.c.
+ *******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef RATE_GOV_H
+#define RATE_GOV_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported defines ----------------------------------------------------------*/
+#define RATE_GOV_LOW_STRIDE   8U       /* algorithm periods per tick at the low rate, 2 Hz */
+#define RATE_GOV_CALM_MS      30000U   /* [ms] of calm statuses before the rate drops */
+
+/* Exported types ------------------------------------------------------------*/
+/**
+ * @brief  Rate governor: full rate while the user moves, low rate once the
+ *         statuses stayed calm for RATE_GOV_CALM_MS, full again on motion
+ */
+typedef struct
+{
+  uint8_t Low;           /* 1 at the low rate */
+  uint8_t Calm;          /* 1 while the statuses are calm */
+  int64_t CalmSinceMs;   /* [ms] time of the first calm status in a row */
+} TRateGov;
+
+/* Exported functions ------------------------------------------------------- */
+void RateGov_Init(TRateGov *Gov);
+void RateGov_Status(TRateGov *Gov, int64_t TimeMs, uint8_t Activity, uint8_t Flags);
+void RateGov_Wake(TRateGov *Gov);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RATE_GOV_H */
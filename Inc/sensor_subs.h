@@ -0,0 +1,43 @@
+/**
+ *******************************************************************************
+ * @file    sensor_subs.h
+ * @brief   header for sensor_subs.c.
+ *******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef SENSOR_SUBS_H
+#define SENSOR_SUBS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported defines ----------------------------------------------------------*/
+#define SENSOR_SUBS_CHANNELS  7U    /* xx_SENSOR bits, PRESSURE_SENSOR to MAGNETIC_SENSOR */
+
+/* Exported types ------------------------------------------------------------*/
+/**
+ * @brief  What the acquisition reads and keeps powered for a mode, and when
+ */
+typedef struct
+{
+  uint32_t Sensors;                       /* xx_SENSOR bits to power and read */
+  uint32_t Rate[SENSOR_SUBS_CHANNELS];    /* [Hz] read rate, by bit position */
+  uint32_t Period[SENSOR_SUBS_CHANNELS];  /* algorithm periods between reads */
+  uint32_t Left[SENSOR_SUBS_CHANNELS];    /* algorithm periods to the next read */
+} TSensorPlan;
+
+/* Exported functions ------------------------------------------------------- */
+void SensorSubs_Plan(TSensorPlan *Plan, uint8_t Mode, uint32_t Extra, uint32_t Allowed, uint32_t AlgoFreq);
+uint32_t SensorSubs_Due(TSensorPlan *Plan, uint32_t Periods);
+uint32_t SensorSubs_Rate(const TSensorPlan *Plan, uint32_t Sensors);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SENSOR_SUBS_H */
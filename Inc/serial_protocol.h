@@ -22,6 +22,10 @@
 #ifndef SERIAL_PROTOCOL_H
 #define SERIAL_PROTOCOL_H
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /* Includes ------------------------------------------------------------------*/
 #include <stdint.h>
 
@@ -54,6 +58,7 @@ int ReverseByteStuffCopyByte2(uint8_t Source0, uint8_t Source1, uint8_t *Dest);
 int ByteStuffCopy(uint8_t *Dest, TMsg *Source);
 int ReverseByteStuffCopyByte(uint8_t *Source, uint8_t *Dest);
 int ReverseByteStuffCopy(TMsg *Dest, uint8_t *Source);
+int ReverseByteStuffCopyLen(TMsg *Dest, uint8_t *Source, uint32_t Len);
 void CHK_ComputeAndAdd(TMsg *Msg);
 int CHK_CheckAndRemove(TMsg *Msg);
 uint32_t Deserialize(uint8_t *Source, uint32_t Len);
@@ -62,6 +67,10 @@ void Serialize(uint8_t *Dest, uint32_t Source, uint32_t Len);
 void Serialize_s32(uint8_t *Dest, int32_t Source, uint32_t Len);
 void FloatToArray(uint8_t *Dest, float Data);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* SERIAL_PROTOCOL_H */
 
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
@@ -0,0 +1,114 @@
+/**
+ *******************************************************************************
+ * @file    status_frame.h
+ * @brief   header for status_frame.c.
+ *******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef STATUS_FRAME_H
+#define STATUS_FRAME_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "serial_protocol.h"
+#include "Serial_CMD.h"
+
+/* Exported defines ----------------------------------------------------------*/
+/* Frame layout inside TMsg.Data (multi-byte fields LSB first):
+ *  DestAddr | SrcAddr | CMD | DeviceId | Seq | TimeStamp | Mode | Activity | Flags | CHK
+ *     1         1       1       2        2        4         1        1         1      1
+ */
+#define STATUS_FRAME_DEST             0x02U  /* relay, same value as the default streaming destination */
+#define STATUS_FRAME_LEN              14U    /* header + payload, checksum excluded */
+#define STATUS_FRAME_WIRE_MAX         (2U * (STATUS_FRAME_LEN + 1U) + 1U) /* worst case after byte stuffing */
+
+/* Control frames between the relay and the server, same framing:
+ *  DestAddr | SrcAddr | CMD | Value | CHK
+ *     1         1       1      4      1
+ *  CMD_Relay_Hello  relay -> server, first frame of a connection, Value: RELAY_HELLO_xx flags
+ *  CMD_Relay_Ack    server -> relay, Value: status frames received on the connection so far
+ *  CMD_Relay_Age    relay -> server, Value: [ms] the next status frame waited in the relay
+ * A relay that sends no hello gets "Hello" back for every status frame. After
+ * a reconnect the relay sends again the frames not acknowledged, the server
+ * drops the ones it already had, and an age frame puts a batch replayed from
+ * the relay backlog back at the time it was made.
+ */
+#define STATUS_SERVER_ADDR            0x00U
+#define STATUS_CONTROL_LEN            7U
+#define STATUS_CONTROL_WIRE_MAX       (2U * (STATUS_CONTROL_LEN + 1U) + 1U)
+#define RELAY_HELLO_PIPELINE          0x01U  /* one cumulative CMD_Relay_Ack per read instead of "Hello" per frame */
+
+/* UDP datagrams from the relay, one fixed size record each, no stuffing or
+ * checksum (UDP has its own):
+ *  Kind | RelaySeq | DeviceId | Seq | TimeStamp | Mode | Activity | Flags
+ *   1        4         2        2        4         1        1         1
+ *  Kind CMD_Status_Frame     a status, RelaySeq counts them from 0
+ *  Kind CMD_Relay_Heartbeat  the last status again with its RelaySeq, sent
+ *                            every RELAY_HEARTBEAT_MS so a display whose
+ *                            datagram was lost catches up
+ */
+#define STATUS_DATAGRAM_LEN           16U
+#define RELAY_HEARTBEAT_MS            1000U
+
+/* Mode, same order as program_state_t */
+#define STATUS_MODE_AW                0x00U
+#define STATUS_MODE_SD                0x01U
+#define STATUS_MODE_SM                0x02U
+
+/* Activity, 0x00 - 0x08 match MAW_activity_t */
+#define STATUS_ACT_NOACTIVITY         0x00U
+#define STATUS_ACT_STATIONARY         0x01U
+#define STATUS_ACT_STANDING           0x02U
+#define STATUS_ACT_SITTING            0x03U
+#define STATUS_ACT_LYING              0x04U
+#define STATUS_ACT_WALKING            0x05U
+#define STATUS_ACT_FASTWALKING        0x06U
+#define STATUS_ACT_JOGGING            0x07U
+#define STATUS_ACT_BIKING             0x08U
+#define STATUS_ACT_DESK_UNKNOWN       0x09U
+#define STATUS_ACT_DESK_SITTING       0x0AU
+#define STATUS_ACT_DESK_STANDING      0x0BU
+#define STATUS_ACT_FALL               0x0CU
+#define STATUS_ACT_COUNT              0x0DU
+#define STATUS_ACT_UNKNOWN            0xFFU
+
+/* Flags */
+#define STATUS_FLAG_SLEEP             0x01U  /* SM mode only: user is asleep */
+#define STATUS_FLAG_TURNOVER          0x02U  /* a turn over happened since the previous frame */
+
+/* Exported types ------------------------------------------------------------*/
+/**
+ * @brief  Status frame sent once per algorithm tick
+ */
+typedef struct
+{
+  uint16_t DeviceId;
+  uint16_t Seq;
+  uint32_t TimeStamp;  /* [ms] since boot */
+  uint8_t Mode;
+  uint8_t Activity;
+  uint8_t Flags;
+} TStatusFrame;
+
+/* Exported functions ------------------------------------------------------- */
+void StatusFrame_Build(TMsg *Msg, const TStatusFrame *Frame);
+int StatusFrame_Parse(const TMsg *Msg, TStatusFrame *Frame);
+int StatusFrame_Encode(uint8_t *Dest, const TStatusFrame *Frame);
+int StatusFrame_Decode(TStatusFrame *Frame, uint8_t *Source);
+int StatusFrame_EncodeControl(uint8_t *Dest, uint8_t Cmd, uint32_t Value);
+int StatusFrame_DecodeControl(uint8_t *Source, uint8_t *Cmd, uint32_t *Value);
+int StatusFrame_EncodeDatagram(uint8_t *Dest, uint8_t Kind, uint32_t RelaySeq, const TStatusFrame *Frame);
+int StatusFrame_DecodeDatagram(const uint8_t *Source, uint32_t Len, uint8_t *Kind, uint32_t *RelaySeq,
+                               TStatusFrame *Frame);
+const char *StatusFrame_ActivityName(uint8_t Activity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STATUS_FRAME_H */
@@ -0,0 +1,102 @@
+/**
+ *******************************************************************************
+ * @file    stream_batch.h
+ * @brief   header for stream_batch.c.
+ *******************************************************************************
+ */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef STREAM_BATCH_H
+#define STREAM_BATCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "serial_protocol.h"
+#include "Serial_CMD.h"
+
+/* Exported defines ----------------------------------------------------------*/
+/* Batch layout inside TMsg.Data (multi-byte fields LSB first):
+ *  DestAddr | SrcAddr | CMD | Seq | BaseTime | Sensors | Count | Sample | Sample | ... | CHK
+ *     1         1       1     2       4          1        1
+ * Each sample is Dt [ms since the previous sample, 0 for the first one]
+ * followed by the enabled sensors in this order:
+ *  Acc x,y,z [mg] int16 | Gyr x,y,z [0.1 dps] int16 | Pressure [hPa / 4096] uint24
+ */
+#define STREAM_BATCH_HEADER_LEN       11U
+#define STREAM_BATCH_PAYLOAD_MAX      (TMsg_MaxLen - 1U)  /* one byte left for the checksum */
+
+/* Sensors, same values as the xx_SENSOR bits of SensorsEnabled */
+#define STREAM_BATCH_PRESSURE         0x01U
+#define STREAM_BATCH_ACC              0x10U
+#define STREAM_BATCH_GYR              0x20U
+#define STREAM_BATCH_SENSORS          (STREAM_BATCH_PRESSURE | STREAM_BATCH_ACC | STREAM_BATCH_GYR)
+
+/* Exported types ------------------------------------------------------------*/
+/**
+ * @brief  One sample as it is batched
+ */
+typedef struct
+{
+  uint32_t TimeMs;       /* [ms] since boot */
+  int16_t Acc[3];        /* [mg] */
+  int16_t Gyr[3];        /* [0.1 dps] */
+  uint32_t Pressure;     /* [hPa / 4096], LPS22HB output format */
+} TStreamSample;
+
+/**
+ * @brief  Batch being filled by the device
+ */
+typedef struct
+{
+  TMsg Msg;              /* the batch so far, ready to send once full */
+  uint32_t LastTime;     /* [ms] time of the last sample added */
+  uint16_t Seq;
+  uint8_t Dest;
+  uint8_t Sensors;       /* STREAM_BATCH_xx bits */
+  uint8_t Max;           /* samples per batch, 0 when batching is off */
+  uint8_t Count;
+} TStreamBatch;
+
+/**
+ * @brief  Batch header as decoded by the host
+ */
+typedef struct
+{
+  uint16_t Seq;
+  uint32_t BaseTime;     /* [ms] time of the first sample */
+  uint8_t Sensors;
+  uint8_t Count;
+} TStreamBatchHeader;
+
+/**
+ * @brief  Columnar buffer the host unpacks batches into; NULL columns are
+ *         skipped, columns of sensors missing from a batch are zero filled
+ */
+typedef struct
+{
+  uint32_t Capacity;     /* rows every column can hold */
+  uint32_t Count;        /* rows filled so far */
+  uint32_t *TimeMs;
+  int16_t *Acc[3];
+  int16_t *Gyr[3];
+  uint32_t *Pressure;
+} TStreamColumns;
+
+/* Exported functions ------------------------------------------------------- */
+uint32_t StreamBatch_SampleSize(uint8_t Sensors);
+uint8_t StreamBatch_MaxSamples(uint8_t Sensors);
+uint8_t StreamBatch_Start(TStreamBatch *Batch, uint8_t Dest, uint8_t Sensors, uint8_t Samples);
+int StreamBatch_Add(TStreamBatch *Batch, const TStreamSample *Sample);
+void StreamBatch_Next(TStreamBatch *Batch);
+int StreamBatch_Parse(const TMsg *Msg, TStreamBatchHeader *Header, TStreamColumns *Columns);
+int StreamBatch_Decode(TStreamBatchHeader *Header, TStreamColumns *Columns, uint8_t *Source, uint32_t Len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STREAM_BATCH_H */
@@ -1,21 +1,509 @@
 #include "mbed.h"
+#include "status_frame.h"
+#include "link_baud.h"
+#include "relay_pipe.h"
+
+#define RELAY_ADDR      2
+#define DEV_ADDR        50
+
+// Rate asked of the nucleo with CMD_Set_Baud, it stays at LINK_BAUD_DEFAULT
+// if it does not take it
+#ifndef RELAY_BAUD
+#define RELAY_BAUD      921600
+#endif
+// RTS/CTS pins wired to the nucleo, NC for no flow control
+#ifndef RELAY_RTS
+#define RELAY_RTS       NC
+#endif
+#ifndef RELAY_CTS
+#define RELAY_CTS       NC
+#endif
+#define BAD_FRAMES_MAX  32  // in a row, the nucleo was reset or fell back: negotiate again
+#define RELAY_STATS_MS  60000  // counters printed this often
+// 1: a console line per status, which holds the relay loop up at high rates
+#ifndef RELAY_VERBOSE
+#define RELAY_VERBOSE   0
+#endif
+
+// 1: frames go without waiting, coalesced, the server acks once per read.
+// 0: send one frame and wait for "Hello", for servers from before CMD_Relay_Hello
+#ifndef RELAY_PIPELINE
+#define RELAY_PIPELINE  1
+#endif
+// 1: statuses go as UDP datagrams for a live display, a lost one is not sent
+// again and nothing waits for it. 0: TCP with the backlog
+#ifndef RELAY_UDP
+#define RELAY_UDP       0
+#endif
+#define RELAY_RX_BYTES  1024  // power of two, filled by the UART interrupt
+
+#define SERVER_ADDR     "192.168.43.251"
+#define SERVER_PORT     65431
+#define CONNECT_MS      5000  // a connection attempt that takes longer has failed
 
 // Network interface
 NetworkInterface *net;
 
-//serial
+//serial, the nucleo side is read from its interrupt so Wi-Fi never holds it up
 Serial pc (USBTX, USBRX,NULL,115200);
-Serial device(D1,D0,NULL,115200);
+RawSerial device(D1,D0,LINK_BAUD_DEFAULT);
+static SpscRing<uint8_t, RELAY_RX_BYTES> rx;
+static volatile uint32_t rx_overruns = 0;
+
+// [ms] since boot, when frames came from the UART
+static Timer uptime;
+
+#if RELAY_UDP
+#elif RELAY_PIPELINE
+static RelayPipe pipe;
+#else
+static RelayPipe pipe(1, STATUS_FRAME_WIRE_MAX, RELAY_LATENCY_MS, false);
+#endif
+#if !RELAY_UDP
+static RelayBackoff backoff;
+#endif
+
+static void on_rx()
+{
+    while (device.readable()) {
+        if (!rx.push((uint8_t)device.getc()))
+            rx_overruns++;
+    }
+}
+
+// next byte from the UART, -1 if none
+static int rx_byte()
+{
+    uint8_t c;
+
+    return rx.pop(c) ? c : -1;
+}
+
+static void device_config(int baud, uint8_t flow)
+{
+    device.baud(baud);
+#if DEVICE_SERIAL_FC
+    device.set_flow_control((flow == LINK_FLOW_RTSCTS) ? SerialBase::RTSCTS : SerialBase::Disabled,
+                            RELAY_RTS, RELAY_CTS);
+#endif
+}
+
+static void link_send(TMsg *msg)
+{
+    uint8_t wire[2 * TMsg_MaxLen + 1];
+
+    CHK_ComputeAndAdd(msg);
+    int len = ByteStuffCopy(wire, msg);
+    for (int i = 0; i < len; i++)
+        device.putc(wire[i]);
+}
+
+// CMD_Set_Baud, the reply comes through next_status
+static void set_baud(int baud, uint8_t flow)
+{
+    TMsg msg;
+
+    msg.Data[0] = DEV_ADDR;
+    msg.Data[1] = RELAY_ADDR;
+    msg.Data[2] = CMD_Set_Baud;
+    Serialize(&msg.Data[3], baud, 4);
+    msg.Data[7] = flow;
+    msg.Len = 8;
+    link_send(&msg);
+}
+
+// Rate negotiation, a step at a time from the relay loop so statuses, sends
+// and acks go on meanwhile. Bytes at the other rate only make bad frames
+enum NegState {
+    NEG_DONE,
+    NEG_AT_RELAY,       // asked at RELAY_BAUD, a nucleo still there from an earlier run answers
+    NEG_AT_DEFAULT,     // asked at LINK_BAUD_DEFAULT
+    NEG_VERIFY,         // the nucleo switched once its reply was out, asked again at the new rate
+    NEG_SETTLE          // not verified, the nucleo goes back by itself
+};
+static NegState neg = NEG_DONE;
+static uint32_t neg_ms = 0;     // end of the step
+static int neg_tries = 0;
+static int link_baud = LINK_BAUD_DEFAULT;
+static const uint8_t link_flow = (RELAY_RTS != NC && RELAY_CTS != NC) ? LINK_FLOW_RTSCTS : LINK_FLOW_NONE;
+
+// Frame being collected from the nucleo, see next_status
+static uint8_t frame[STATUS_FRAME_WIRE_MAX];
+static int flen = 0;
+static int bad = 0;             // frames in a row that did not decode
+
+// Switch the UART. What came at the old rate and was not read yet is noise
+// now, as is a frame begun at it
+static void link_config(int baud, uint8_t flow)
+{
+    device_config(baud, flow);
+    while (rx_byte() >= 0) {
+    }
+    flen = 0;
+}
+
+// Ask for RELAY_BAUD with the UART at baud and flow, for ms
+static void neg_ask(NegState state, int baud, uint8_t flow, uint32_t now, uint32_t ms)
+{
+    link_config(baud, flow);
+    set_baud(RELAY_BAUD, link_flow);
+    neg = state;
+    neg_ms = now + ms;
+}
+
+static void neg_done(int baud)
+{
+    neg = NEG_DONE;
+    link_baud = baud;
+    bad = 0;
+    printf("link at %d baud\n", baud);
+}
+
+// Bring the link to RELAY_BAUD, verified both ways, or leave it at LINK_BAUD_DEFAULT
+static void link_negotiate(uint32_t now)
+{
+    neg_ask(NEG_AT_RELAY, RELAY_BAUD, link_flow, now, 200);
+}
+
+// Next step on a CMD_Set_Baud reply, status -1 when none came in time
+static void neg_next(int status, uint32_t now)
+{
+    switch (neg) {
+    case NEG_AT_RELAY:
+        if (status == LINK_BAUD_OK)
+            neg_done(RELAY_BAUD);
+        else
+            neg_ask(NEG_AT_DEFAULT, LINK_BAUD_DEFAULT, LINK_FLOW_NONE, now, 500);
+        break;
+    case NEG_AT_DEFAULT:
+        if (status == LINK_BAUD_OK) {
+            neg_done(RELAY_BAUD);
+        }
+        else if (status == LINK_BAUD_PENDING) {
+            neg_tries = 1;
+            neg_ask(NEG_VERIFY, RELAY_BAUD, link_flow, now, 100);
+        }
+        else {
+            neg_done(LINK_BAUD_DEFAULT);
+        }
+        break;
+    case NEG_VERIFY:
+        if (status == LINK_BAUD_OK) {
+            neg_done(RELAY_BAUD);
+        }
+        else if (neg_tries < 4) {
+            neg_tries++;
+            neg_ask(NEG_VERIFY, RELAY_BAUD, link_flow, now, 100);
+        }
+        else {
+            link_config(LINK_BAUD_DEFAULT, LINK_FLOW_NONE);
+            neg = NEG_SETTLE;
+            neg_ms = now + LINK_BAUD_VERIFY_MS;
+        }
+        break;
+    case NEG_SETTLE:
+        if (status < 0)
+            neg_done(LINK_BAUD_DEFAULT);
+        break;
+    default:
+        break;
+    }
+}
+
+// End the step whose time ran out, from the relay loop
+static void link_poll(uint32_t now)
+{
+    if (neg != NEG_DONE && (int32_t)(now - neg_ms) >= 0)
+        neg_next(-1, now);
+}
+
+#if RELAY_VERBOSE
+// Text shown in the log, same wording the relay used to send
+static void describe(const TStatusFrame *s, char *buf, size_t len)
+{
+    const char *act = StatusFrame_ActivityName(s->Activity);
+
+    if (s->Flags & STATUS_FLAG_TURNOVER)
+        snprintf(buf, len, "turn over");
+    else if (s->Mode != STATUS_MODE_SM)
+        snprintf(buf, len, "%s", act);
+    else if (s->Flags & STATUS_FLAG_SLEEP)
+        snprintf(buf, len, "sleeping");
+    else
+        snprintf(buf, len, "no sleeping, %s", act);
+}
+#endif
+
+// Counted rather than printed, a line per frame would hold the relay loop up
+static uint32_t bad_frames = 0;
+static uint32_t link_losses = 0;    // negotiated again after BAD_FRAMES_MAX bad frames in a row
+
+static void link_stats()
+{
+    printf("link at %d baud, %u bad frames, lost %u times, %u UART overruns\n", link_baud,
+           (unsigned)bad_frames, (unsigned)link_losses, (unsigned)rx_overruns);
+}
+
+// A frame that did not decode
+static void frame_bad(uint32_t now)
+{
+    bad++;
+    bad_frames++;
+    if (bad >= BAD_FRAMES_MAX && neg == NEG_DONE) {
+        // nothing decodes at this rate any more
+        link_losses++;
+        link_negotiate(now);
+    }
+}
+
+// Next status from the nucleo, false until the UART gave a whole frame.
+// CMD_Set_Baud replies go to the negotiation
+static bool next_status(TStatusFrame *status, uint32_t now)
+{
+    TMsg msg;
+    int c;
+
+    // collect byte stuffed frames from the nucleo, TMsg_EOF ends each
+    while ((c = rx_byte()) >= 0) {
+        if (flen == (int)sizeof(frame)) {
+            // no EOF where one must be: drop and resync on the next one
+            flen = 0;
+            frame_bad(now);
+        }
+        frame[flen++] = (uint8_t)c;
+        if (c != TMsg_EOF)
+            continue;
+
+        int len = flen;
+        flen = 0;
+        if (StatusFrame_Decode(status, frame)) {
+            bad = 0;
+            return true;
+        }
+        if (ReverseByteStuffCopyLen(&msg, frame, len) && CHK_CheckAndRemove(&msg) && msg.Len == 9
+            && msg.Data[2] == (uint8_t)(CMD_Set_Baud + CMD_Reply_Add)) {
+            if (neg != NEG_DONE)
+                neg_next(msg.Data[3], now);
+            continue;
+        }
+        frame_bad(now);
+    }
+    return false;
+}
+
+#if RELAY_UDP
+// Statuses as they come, one datagram each, and every RELAY_HEARTBEAT_MS the
+// last one again so a display that lost a datagram catches up
+static void udp_relay()
+{
+    UDPSocket socket;
+    uint8_t dgram[STATUS_DATAGRAM_LEN];
+    TStatusFrame status;
+    TStatusFrame last;
+    uint32_t seq = 0;           // status datagrams so far
+    uint32_t beat_ms = uptime.read_ms();
+    uint32_t stats_ms = uptime.read_ms();
+    uint32_t failed = 0;
+    nsapi_size_or_error_t result;
+
+    result = socket.open(net);
+    if (result != 0) {
+        printf("Error! socket.open() returned: %d\n", result);
+        return;
+    }
+    socket.set_blocking(false);
+
+    while (true) {
+        bool idle = true;
+        uint32_t now = uptime.read_ms();
+
+        while (next_status(&status, now)) {
+            idle = false;
+            result = socket.sendto(SERVER_ADDR, SERVER_PORT, dgram,
+                                   StatusFrame_EncodeDatagram(dgram, CMD_Status_Frame, seq, &status));
+            if (result < 0)
+                failed++;
+#if RELAY_VERBOSE
+            char sbuffer[40];
+            describe(&status, sbuffer, sizeof(sbuffer));
+            printf("sent [%04x #%u %s] as %u, %d\n", status.DeviceId, status.Seq, sbuffer, (unsigned)seq, result);
+#endif
+            last = status;
+            seq++;
+        }
+        // after the bytes at the current rate are read
+        link_poll(now);
 
+        if (seq != 0 && uptime.read_ms() - beat_ms >= RELAY_HEARTBEAT_MS) {
+            // Wi-Fi may be gone, that reconnect does block
+            if (net->get_connection_status() == NSAPI_STATUS_DISCONNECTED)
+                net->connect();
+            socket.sendto(SERVER_ADDR, SERVER_PORT, dgram,
+                          StatusFrame_EncodeDatagram(dgram, CMD_Relay_Heartbeat, seq - 1, &last));
+            beat_ms = uptime.read_ms();
+        }
+
+        if (now - stats_ms >= RELAY_STATS_MS) {
+            printf("%u statuses sent, %u failed\n", (unsigned)seq, (unsigned)failed);
+            link_stats();
+            stats_ms = now;
+        }
+
+        if (idle)
+            wait_ms(1);
+    }
+}
+
+#else
+enum LinkState { LINK_DOWN, LINK_CONNECTING, LINK_UP };
+
+// Statuses through the RelayPipe over TCP. The connection comes and goes,
+// the UART is read all along and what the server did not acknowledge waits
+static void tcp_relay()
+{
+    TCPSocket socket;
+    LinkState state = LINK_DOWN;
+    uint32_t retry_ms = 0;      // next attempt while down
+    uint32_t since_ms = 0;      // start of the attempt while connecting
+    uint32_t stats_ms = uptime.read_ms();
+    uint32_t connections = 0;
+    TStatusFrame status;
+    char buffer[256];
+    nsapi_size_or_error_t result;
+
+    while (true) {
+        bool idle = true;
+        bool lost = false;
+        uint32_t now = uptime.read_ms();
+
+        while (next_status(&status, now)) {
+            idle = false;
+
+            // kept with its own time stamp until the server has it, however
+            // long the connection is down; a full queue counts it dropped
+            bool queued = pipe.push(status, uptime.read_ms());
+#if RELAY_VERBOSE
+            char sbuffer[40];
+            describe(&status, sbuffer, sizeof(sbuffer));
+            printf("%s [%04x #%u %s], %u waiting\n", queued ? "queued" : "dropped", status.DeviceId, status.Seq,
+                   sbuffer, (unsigned)pipe.backlog());
+#else
+            (void)queued;
+#endif
+        }
+        // after the bytes at the current rate are read
+        link_poll(now);
+
+        if (state == LINK_DOWN && (int32_t)(now - retry_ms) >= 0) {
+            // Wi-Fi itself may be gone, that reconnect does block
+            if (net->get_connection_status() == NSAPI_STATUS_DISCONNECTED) {
+                result = net->connect();
+                if (result != 0)
+                    printf("Error! net->connect() returned: %d\n", result);
+            }
+            result = socket.open(net);
+            if (result != 0) {
+                printf("Error! socket.open() returned: %d\n", result);
+                retry_ms = now + backoff.failed(rand());
+                continue;
+            }
+            // from here on nothing waits on the network
+            socket.set_blocking(false);
+            state = LINK_CONNECTING;
+            since_ms = now;
+        }
+
+        if (state == LINK_CONNECTING) {
+            result = socket.connect(SERVER_ADDR, SERVER_PORT);
+            if (result == 0 || result == NSAPI_ERROR_IS_CONNECTED) {
+                // the server gets the frames it did not acknowledge again,
+                // then the backlog in full batches
+                printf("connected, %u frames to send\n", (unsigned)(pipe.backlog() + pipe.unacked()));
+                pipe.reconnect();
+                connections++;
+                state = LINK_UP;
+            }
+            else if (result != NSAPI_ERROR_IN_PROGRESS && result != NSAPI_ERROR_ALREADY
+                     && result != NSAPI_ERROR_WOULD_BLOCK) {
+                printf("Error! socket.connect() returned: %d\n", result);
+                lost = true;
+            }
+            else if (now - since_ms >= CONNECT_MS) {
+                printf("Error! socket.connect() timed out\n");
+                lost = true;
+            }
+        }
+
+        if (state == LINK_UP) {
+            // as much of the batch due now as the socket takes
+            const uint8_t *data;
+            size_t n = pipe.ready(now, &data);
+            if (n != 0) {
+                result = socket.send(data, n);
+                if (0 < result) {
+                    pipe.sent(result);
+                    idle = false;
+                }
+                else if (result != NSAPI_ERROR_WOULD_BLOCK) {
+                    printf("Error! socket.send() returned: %d\n", result);
+                    lost = true;
+                }
+            }
+        }
+
+        if (state == LINK_UP && !lost) {
+            result = socket.recv(buffer, sizeof(buffer));
+            if (0 < result) {
+                // cumulative CMD_Relay_Ack frames, or one "Hello" per frame
+                uint32_t fallbacks = pipe.fallbacks;
+                pipe.received((const uint8_t *)buffer, result);
+                if (pipe.fallbacks != fallbacks)
+                    printf("server answers \"Hello\", sending one frame at a time\n");
+                // the server is there, a later loss starts the backoff over
+                backoff.reset();
+                idle = false;
+            }
+            else if (result == 0) {
+                printf("server closed the connection\n");
+                lost = true;
+            }
+            else if (result != NSAPI_ERROR_WOULD_BLOCK) {
+                printf("Error! socket.recv() returned: %d\n", result);
+                lost = true;
+            }
+        }
+
+        if (lost) {
+            socket.close();
+            state = LINK_DOWN;
+            uint32_t wait = backoff.failed(rand());
+            retry_ms = now + wait;
+            printf("retry in %u ms, %u frames waiting\n", (unsigned)wait, (unsigned)(pipe.backlog() + pipe.unacked()));
+        }
+
+        if (lost || now - stats_ms >= RELAY_STATS_MS) {
+            printf("%u frames sent in %u batches, %u again, %u acked, %u dropped, most held %u, "
+                   "longest wait %u ms, %u connections\n",
+                   (unsigned)pipe.frames, (unsigned)pipe.batches, (unsigned)pipe.resent, (unsigned)pipe.acks,
+                   (unsigned)pipe.dropped, (unsigned)pipe.backlog_max, (unsigned)pipe.wait_max,
+                   (unsigned)connections);
+            link_stats();
+            stats_ms = now;
+        }
+
+        if (idle)
+            wait_ms(1);
+    }
+}
+#endif
 
 // Socket demo
 int main() {
-    int remaining;
-    int rcount;
-    char *p;
-    char *buffer = new char[256];
     nsapi_size_or_error_t result;
 
+    uptime.start();
+    device.attach(callback(on_rx), SerialBase::RxIrq);
+
     // Bring up the ethernet interface
     printf("Mbed OS Socket example\n");
 
@@ -44,153 +532,13 @@ int main() {
     printf("Netmask: %s\n", netmask ? netmask : "None");
     printf("Gateway: %s\n", gateway ? gateway : "None");
 
-    // Open a socket on the network interface, and create a TCP connection to ifconfig.io
-    TCPSocket socket;
-
-    result = socket.open(net);
-    if (result != 0) {
-        printf("Error! socket.open() returned: %d\n", result);
-    }
-
-    result = socket.connect("192.168.43.251", 65431);
-    if (result != 0) {
-        printf("Error! socket.connect() returned: %d\n", result);
-        goto DISCONNECT;
-    }
-
-   char msg;
-   char sbuffer[30];
-   bool concat; concat = false;
-
-   while (true) {
-         
-        msg = device.getc();
-        //pc.printf("%c\n",msg);
-        //isValid=1;
-            
-       switch(msg){
-            case 'a':
-                if(concat) { 
-                    strcat(sbuffer,", no activity");
-                    concat = false;
-                }
-                else strcpy(sbuffer,"no activity");
-                
-                break;
-            case 'b':
-                if(concat) { 
-                    strcat(sbuffer,", stationary");
-                    concat = false;
-                }
-                else strcpy(sbuffer,"stationary");
-                 break;
-            case 'c':
-                if(concat) { 
-                    strcat(sbuffer,", standing");
-                    concat = false;
-                }
-                else strcpy(sbuffer,"standing");
-                break;
-            case 'd':
-                if(concat) { 
-                    strcat(sbuffer,", sitting");
-                    concat = false;
-                }
-                else strcpy(sbuffer,"sitting");
-                break;
-            case 'e':
-                if(concat) { 
-                    strcat(sbuffer,", lying");
-                    concat = false;
-                }
-                else strcpy(sbuffer,"lying");
-                break;
-            case 'f':
-                if(concat) { 
-                    strcat(sbuffer,", walking");
-                    concat = false;
-                }
-                else strcpy(sbuffer,"walking");
-                break;
-            case 'g':
-                if(concat) { 
-                    strcat(sbuffer,", fast walking");
-                    concat = false;
-                }
-                else strcpy(sbuffer,"fast walking");
-                break;
-            case 'h':
-                if(concat) { 
-                    strcat(sbuffer,", jogging");
-                    concat = false;
-                }
-                else strcpy(sbuffer,"jogging");
-                break;
-            case 'i':
-                if(concat) { 
-                    strcat(sbuffer,", biking");
-                    concat = false;
-                }
-                else strcpy(sbuffer,"biking");
-                break;
-            case 'k':
-                strcpy(sbuffer,"unknown desk");
-                break;
-            case 'l':
-                strcpy(sbuffer,"sitting desk");
-                break;
-            case 'm':
-                strcpy(sbuffer,"standing desk");
-                break;
-            case 'n':
-                strcpy(sbuffer,"no sleeping");
-                concat = true;
-                break;
-            case 'o':
-                strcpy(sbuffer,"sleeping");
-                break;
-            case 'p':
-                strcpy(sbuffer,"fall down");
-                break;
-            case 'q':
-                strcpy(sbuffer,"turn over");
-                break;
-
-            default:
-                break;
-       }
-       //if concat = true, wait for concat complete to send sbuffer
-       if(!concat){
-            nsapi_size_t size = strlen(sbuffer);
-            // Loop until whole request sent
-            result=0;
-            if(0<(result = socket.send(sbuffer, size))){
-                printf("sent %d [%s]\n", result, sbuffer);
-            }
-            if (result < 0) {
-                printf("Error! socket.send() returned: %d\n", result);
-                goto DISCONNECT;
-            } 
-            // Receieve an HTTP response and print out the response line
-            remaining = 256;
-            result=0;
-            if( 0 < (result = socket.recv(buffer, remaining))) {
-                buffer[result] = '\0';
-                printf("recv %d [%s]\n", result, buffer);      
-            }
-            if (result < 0) {
-                printf("Error! socket.recv() returned: %d\n", result);
-                goto DISCONNECT;
-            }   
-       }  
-    }               
-
-    delete[] buffer;
-
-DISCONNECT:
-    // Close the socket to return its memory and bring down the network interface
-    socket.close();
-    // Bring down the ethernet interface
+    // finished from the relay loop, statuses at the default rate go meanwhile
+    link_negotiate(uptime.read_ms());
+#if RELAY_UDP
+    udp_relay();
+#else
+    tcp_relay();
+#endif
     net->disconnect();
     printf("Done\n");
 }
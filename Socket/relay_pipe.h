@@ -0,0 +1,277 @@
+//Outbound side of the relay: a bounded queue of status frames between the
+//UART and the socket, Nagle-like coalescing of the queued frames into one
+//send, and a window of frames sent but not acknowledged by the server. Frames
+//stay queued until acknowledged, so after a reconnect the ones the server may
+//not have are sent again, and the queue is the backlog kept while the server
+//is out of reach.
+//No I/O here, the relay and the host benches drive it.
+#ifndef RELAY_PIPE_H
+#define RELAY_PIPE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "spsc_ring.h"
+#include "status_frame.h"
+
+#define RELAY_QUEUE_FRAMES   2048   // power of two, 2 min of statuses at 16 Hz in 32 KB
+#define RELAY_BATCH_BYTES    1024   // of status frames in one send
+#define RELAY_LATENCY_MS     50     // a frame waits no longer for others to join it
+#define RELAY_WINDOW_FRAMES  128    // sent and not acknowledged yet
+#define RELAY_AGE_MS         1000   // a batch this late tells the server its age
+#define RELAY_AGE_PERIOD_MS  60000  // and one does at least this often, against clock drift
+
+#define RELAY_BACKOFF_MIN_MS 250    // first retry after a lost connection
+#define RELAY_BACKOFF_MAX_MS 16000  // the wait doubles up to this
+
+//A status from the UART and when it came
+struct RelayFrame
+{
+    uint32_t ms;
+    TStatusFrame status;
+};
+
+class RelayPipe
+{
+public:
+    //window 1 with room for one frame per batch and no control frames is the
+    //old send and wait for "Hello"
+    RelayPipe(uint32_t window_frames = RELAY_WINDOW_FRAMES, size_t batch_bytes = RELAY_BATCH_BYTES,
+              uint32_t latency_ms = RELAY_LATENCY_MS, bool pipelined = true)
+        : pipelined_window(window_frames),
+          pipelined_cap(batch_bytes < RELAY_BATCH_BYTES ? batch_bytes : RELAY_BATCH_BYTES),
+          pipelined(pipelined), window(pipelined_window), cap(pipelined_cap),
+          latency(latency_ms), control(pipelined),
+          len(0), off(0), nframes(0), taken(0), first_ms(0), going(false),
+          hello_due(pipelined), age_ms(0), conn_frames(0), conn_acks(0),
+          hellos(!pipelined), hello_bytes(0), alen(0),
+          queued(0), dropped(0), frames(0), resent(0), batches(0), acks(0), wait_max(0), backlog_max(0),
+          fallbacks(0)
+    {
+    }
+
+    //UART side, never waits: false when the queue is full, the frame is
+    //dropped and counted
+    bool push(const TStatusFrame &status, uint32_t now_ms)
+    {
+        RelayFrame f;
+
+        f.ms = now_ms;
+        f.status = status;
+        if (!queue.push(f)) {
+            dropped++;
+            return false;
+        }
+        queued++;
+        if (queue.size() > backlog_max)
+            backlog_max = queue.size();
+        return true;
+    }
+
+    //Socket side: the bytes to send now, 0 while the batch waits for more
+    //frames, for the window or for the latency cap. Once a batch is handed
+    //out it is handed out again until sent() took all of it.
+    size_t ready(uint32_t now_ms, const uint8_t **data)
+    {
+        if (!going) {
+            RelayFrame f;
+
+            while (len + STATUS_FRAME_WIRE_MAX <= cap && queue.peek(taken, f)) {
+                if (nframes == 0)
+                    first_ms = f.ms;
+                len += StatusFrame_Encode(&buf[CONTROL_BYTES + len], &f.status);
+                nframes++;
+                taken++;
+            }
+            if (nframes == 0 || unacked() >= window)
+                return 0;
+
+            //like Nagle: alone on the link a frame goes at once, behind
+            //unacknowledged ones it waits for company until the batch is
+            //full or it is too old
+            uint32_t age = now_ms - first_ms;
+            if (len + STATUS_FRAME_WIRE_MAX <= cap && unacked() != 0 && age < latency)
+                return 0;
+            if (age > wait_max)
+                wait_max = age;
+
+            //control frames go in front: the hello once per connection, the
+            //age when the batch comes from the backlog
+            size_t start = CONTROL_BYTES;
+            if (control && (age >= RELAY_AGE_MS || (uint32_t)(now_ms - age_ms) >= RELAY_AGE_PERIOD_MS || hello_due)) {
+                uint8_t wire[STATUS_CONTROL_WIRE_MAX];
+                size_t n = StatusFrame_EncodeControl(wire, CMD_Relay_Age, age);
+                start -= n;
+                memcpy(&buf[start], wire, n);
+                age_ms = now_ms;
+            }
+            if (hello_due) {
+                uint8_t wire[STATUS_CONTROL_WIRE_MAX];
+                size_t n = StatusFrame_EncodeControl(wire, CMD_Relay_Hello, RELAY_HELLO_PIPELINE);
+                start -= n;
+                memcpy(&buf[start], wire, n);
+                hello_due = false;
+            }
+            off = start;
+            going = true;
+            batches++;
+        }
+        *data = &buf[off];
+        return CONTROL_BYTES + len - off;
+    }
+
+    //n bytes of what ready() gave were taken by the socket
+    void sent(size_t n)
+    {
+        off += n;
+        if (off < CONTROL_BYTES + len)
+            return;
+        frames += nframes;
+        conn_frames += nframes;
+        len = 0;
+        nframes = 0;
+        going = false;
+    }
+
+    //Cumulative count of frames the server received on this connection,
+    //modulo 2^32. The frames it covers leave the queue.
+    void acked(uint32_t count)
+    {
+        if ((uint32_t)(conn_frames - count) >= (uint32_t)(conn_frames - conn_acks))
+            return;
+        uint32_t n = count - conn_acks;
+        queue.drop(n);
+        taken -= n;
+        acks += n;
+        conn_acks = count;
+    }
+
+    //Bytes from the server: CMD_Relay_Ack frames, or "Hello" for every frame
+    //from a server that does not know the hello. A pipelined relay that gets
+    //"Hello" falls back to one frame at a time until the next connection
+    //(the batch under way still goes whole), the server acknowledges every
+    //frame it gets but never asks for more.
+    void received(const uint8_t *data, size_t n)
+    {
+        for (size_t i = 0; i < n; i++) {
+            if (!hellos && alen == 0 && data[i] == 'H') {
+                hellos = true;
+                window = 1;
+                cap = STATUS_FRAME_WIRE_MAX;
+                control = false;
+                hello_due = false;
+                fallbacks++;
+            }
+            if (hellos) {
+                hello_bytes++;
+                acked(hello_bytes / 5);
+                continue;
+            }
+            if (alen == sizeof(ack))
+                alen = 0;
+            ack[alen++] = data[i];
+            if (data[i] != TMsg_EOF)
+                continue;
+
+            uint8_t cmd;
+            uint32_t count;
+            if (StatusFrame_DecodeControl(ack, &cmd, &count) && cmd == CMD_Relay_Ack)
+                acked(count);
+            alen = 0;
+        }
+    }
+
+    //A new connection: the server counts from 0 and gets again whatever it
+    //did not acknowledge on the one before, starting with the hello
+    void reconnect()
+    {
+        resent += taken - nframes;
+        taken = 0;
+        len = 0;
+        nframes = 0;
+        going = false;
+        window = pipelined_window;
+        cap = pipelined_cap;
+        control = pipelined;
+        hello_due = pipelined;
+        conn_frames = 0;
+        conn_acks = 0;
+        hellos = !pipelined;
+        hello_bytes = 0;
+        alen = 0;
+    }
+
+    //Frames sent and not acknowledged yet
+    uint32_t unacked() const { return conn_frames - conn_acks; }
+
+    //Frames waiting in the queue or the batch
+    size_t backlog() const { return queue.size() - unacked(); }
+
+private:
+    static const size_t CONTROL_BYTES = 2 * STATUS_CONTROL_WIRE_MAX;   // room for hello and age
+
+    SpscRing<RelayFrame, RELAY_QUEUE_FRAMES> queue;
+    uint8_t buf[CONTROL_BYTES + RELAY_BATCH_BYTES];
+    uint32_t pipelined_window;  // as configured, window and cap fall back to
+    size_t pipelined_cap;       // one frame for a server from before the hello
+    bool pipelined;
+    uint32_t window;
+    size_t cap;
+    uint32_t latency;
+    bool control;               // hello and age frames, not for servers from before them
+    size_t len;                 // of the status frames, from CONTROL_BYTES
+    size_t off;                 // of the batch, taken by the socket
+    uint32_t nframes;           // in the batch
+    uint32_t taken;             // from the front of the queue, in the batch or not acknowledged
+    uint32_t first_ms;          // oldest frame in the batch
+    bool going;                 // batch handed out, not fully sent
+    bool hello_due;
+    uint32_t age_ms;            // last age frame sent
+    uint32_t conn_frames;       // sent on this connection
+    uint32_t conn_acks;         // acknowledged on this connection
+    bool hellos;                // the server answers "Hello" per frame
+    uint32_t hello_bytes;       // of them on this connection
+    uint8_t ack[STATUS_CONTROL_WIRE_MAX];
+    size_t alen;                // of the ack frame so far
+
+public:
+    uint32_t queued;            // frames from the UART
+    uint32_t dropped;           // queue full
+    uint32_t frames;            // sent, the ones sent again included
+    uint32_t resent;            // sent again after a reconnect
+    uint32_t batches;           // sends, partial ones counted once
+    uint32_t acks;              // frames acknowledged
+    uint32_t wait_max;          // [ms] longest a frame waited in the relay
+    size_t backlog_max;         // most frames held, waiting or not acknowledged
+    uint32_t fallbacks;         // connections to a server that answered "Hello"
+};
+
+//Exponential backoff between connection attempts, with jitter so relays cut
+//off together do not all come back at once
+class RelayBackoff
+{
+public:
+    RelayBackoff() : next(RELAY_BACKOFF_MIN_MS), failures(0) {}
+
+    //[ms] to wait after a failed attempt or a lost connection, half the
+    //current step plus up to as much again from rnd
+    uint32_t failed(uint32_t rnd)
+    {
+        uint32_t ms = next / 2 + rnd % (next / 2 + 1);
+        if (next < RELAY_BACKOFF_MAX_MS)
+            next = (2 * next < RELAY_BACKOFF_MAX_MS) ? 2 * next : RELAY_BACKOFF_MAX_MS;
+        failures++;
+        return ms;
+    }
+
+    //The server answered, the next loss starts over from the shortest wait
+    void reset() { next = RELAY_BACKOFF_MIN_MS; }
+
+private:
+    uint32_t next;
+
+public:
+    uint32_t failures;          // attempts failed and connections lost
+};
+
+#endif
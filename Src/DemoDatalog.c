@@ -19,7 +19,10 @@
  */
 
 /* Includes ------------------------------------------------------------------*/
+#include <stddef.h>
+#include <string.h>
 #include "main.h"
+#include "activity_log.h"
 #include "DemoDatalog.h"
 
 /** @addtogroup MOTION_APPLICATIONS MOTION APPLICATIONS
@@ -31,380 +34,879 @@
  */
 
 /* Private defines -----------------------------------------------------------*/
-#if (defined (USE_STM32F4XX_NUCLEO))
-#define FLASH_LESSTHAN2HH            ((uint32_t)0x0805FA5F)
-
-#elif (defined (USE_STM32L1XX_NUCLEO))
-#define FLASH_LESSTHAN2HH            ((uint32_t)0x0805FA5F)
-
-#elif (defined (USE_STM32L4XX_NUCLEO))
-#define FLASH_LESSTHAN2HH            ((uint32_t)0x080FF25F)
-
-#else
-#error Not supported platform
-#endif
+#define DATALOG_ERASED  0xFFFFFFFFFFFFFFFFU
 
 /* Private types -------------------------------------------------------------*/
+typedef enum
+{
+  DATALOG_OP_NONE = 0,
+  DATALOG_OP_ERASE,     /* next page, before its header */
+  DATALOG_OP_HEADER,    /* next page header */
+  DATALOG_OP_RECORD,    /* one staged record */
+  DATALOG_OP_ROW        /* DATALOG_ROW_RECORDS staged records, fast programming */
+} DatalogOp_t;
+
 /* Extern variables ----------------------------------------------------------*/
-uint32_t Address2F = FLASH_ADDRESS;
 DataByte_t DataByte[DATABYTE_LEN];
 
-/* Private function prototypes -----------------------------------------------*/
-#if ((defined (USE_STM32F4XX_NUCLEO)) || (defined (USE_STM32L1XX_NUCLEO)))
-static void ReadIntFlash(uint32_t NStartAddress, uint32_t *ReadBuffer, uint32_t NBytesToRead);
+/* Private variables ---------------------------------------------------------*/
+static uint32_t HeadSeq = 0;   /* page being written */
+static uint32_t HeadSlot = 0;  /* next free record slot in it, 0 until a page is open */
+static uint32_t StartSeq = 0;  /* oldest page not uploaded yet */
+static TActivityLog ActivityLog;
+static uint8_t ActivityTickHz = 0;   /* 0 until Datalog_ActivityStart */
+static uint8_t ActivityAnchored = 0; /* 0 when the next word must be an anchor */
+
+static uint64_t Stage[DATALOG_STAGE_RECORDS];  /* records not programmed yet, a ring */
+static uint32_t StageHead = 0;     /* oldest staged record */
+static uint32_t StageCount = 0;
+static uint32_t StageTick = 0;     /* [ms] since the buffer is not empty */
+static uint64_t Row[DATALOG_ROW_RECORDS];      /* source of a fast row program */
+static DatalogOp_t Op = DATALOG_OP_NONE;       /* flash operation in progress */
+static volatile uint8_t OpDone = 0;   /* set by the flash interrupt */
+static volatile uint8_t OpError = 0;
+static uint8_t Flushing = 0;       /* 1 while a flush runs, the flash is unlocked */
+static uint8_t FlushAll = 0;       /* 1 when the flush drains the buffer, 0 when it stops at a row */
+static uint32_t FlushTick = 0;     /* [ms] start of the flush */
+static uint32_t FlushBytes = 0;
+static uint8_t Hold = 0;           /* 1 after an erase or header failed, flushes wait for HoldTick + DATALOG_FLUSH_MS */
+static uint32_t HoldTick = 0;
+static uint8_t Paused = 0;         /* 1 while an upload reads the log, flushes wait for a full buffer */
+static DatalogStats_t Stats;
 
-#elif (defined (USE_STM32L4XX_NUCLEO))
+/* Private function prototypes -----------------------------------------------*/
 static uint32_t GetPage(uint32_t Address);
 static uint32_t GetBank(uint32_t Address);
-static void ReadIntFlash(uint32_t NStartAddress, uint64_t *ReadBuffer, uint32_t NBytesToRead);
-
-#else
-#error Not supported platform
-#endif
+static uint64_t ReadIntFlash(uint32_t Address);
+static uint32_t Page_Address(uint32_t Seq);
+static uint16_t Page_Crc(const DatalogPage_t *Header);
+static uint64_t Page_Header(uint32_t Seq, uint8_t Back);
+static int Page_Blank(uint32_t Address);
+static int Page_Read(uint32_t Page, DatalogPage_t *Header);
+static uint32_t Stage_Room(void);
+static uint32_t Stage_RowLeft(void);
+static void Stage_Drop(uint32_t Count);
+static void Op_Start(void);
+static void Op_Complete(void);
+static void Flush_End(void);
+static int Page_OpenUnlocked(uint32_t Seq, uint8_t Back);
+static int Page_Open(uint32_t Seq, uint8_t Back);
 
 /* Private functions ---------------------------------------------------------*/
 /**
- * @brief  Set current data storage address to the first free address in flash memory
+ * @brief  Find the head of the page ring and the first free record slot in it
  * @param  None
  * @retval Flash memory state (FLASH_FULL/FLASH_READY)
+ * @details Pages are opened in ring order and the page index is the sequence
+ *          number modulo DATALOG_PAGES, so from the first valid page on the
+ *          sequence numbers go up by one up to the head, and the head is
+ *          found with a binary search over the page headers. Only the page
+ *          being opened when the power went can be invalid. Records are
+ *          programmed in order and never read all ones (see activity_log.h),
+ *          so the free slot is a binary search too.
  */
 flash_state_t Datalog_SetAddress(void)
 {
-  uint32_t flash_sector = FLASH_ADDRESS;
+  DatalogPage_t header;
+  uint32_t first = 0;
+  uint32_t base;
+  uint32_t lo;
+  uint32_t hi;
+  uint32_t mid;
+
+  /* Completion of the programs and erases run by Datalog_Process */
+  HAL_NVIC_SetPriority(FLASH_IRQn, 0x0F, 0);
+  HAL_NVIC_EnableIRQ(FLASH_IRQn);
+
+  /* What was staged before a reset is gone */
+  StageHead = 0;
+  StageCount = 0;
+  Op = DATALOG_OP_NONE;
+  Flushing = 0;
+  FlushAll = 0;
+  Hold = 0;
+  Paused = 0;
+
+  if (Page_Read(0, &header) == 0)
+  {
+    first = 1;
+    if (Page_Read(1, &header) == 0)
+    {
+      /* Blank or foreign region: start a new log */
+      HeadSlot = 0;
+      StartSeq = 0;
+      return (Page_Open(0, 0) != 0) ? FLASH_READY : FLASH_FULL;
+    }
+  }
+  base = header.Seq - first;
 
-  Address2F += Datalog_SearchNextFreeMemoryIndex(&flash_sector);
+  lo = first;
+  hi = DATALOG_PAGES;
+  while ((hi - lo) > 1U)
+  {
+    mid = lo + ((hi - lo) / 2U);
+    if ((Page_Read(mid, &header) != 0) && (header.Seq == (base + mid)))
+    {
+      lo = mid;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+  (void)Page_Read(lo, &header);
+  HeadSeq = header.Seq;
+  StartSeq = header.Seq - header.Back;
 
-  if (Address2F > FLASH_LESSTHAN2HH)
+  lo = 0;
+  hi = DATALOG_PAGE_RECORDS + 1U;
+  while ((hi - lo) > 1U)
   {
-    return FLASH_FULL;
+    mid = lo + ((hi - lo) / 2U);
+    if (ReadIntFlash(Page_Address(HeadSeq) + (mid * FLASH_ITEM_SIZE)) != DATALOG_ERASED)
+    {
+      lo = mid;
+    }
+    else
+    {
+      hi = mid;
+    }
   }
-  else
+  HeadSlot = hi;
+
+  if ((HeadSlot > DATALOG_PAGE_RECORDS) && ((HeadSeq + 1U - StartSeq) >= DATALOG_PAGES))
   {
-    return FLASH_READY;
+    return FLASH_FULL;
   }
+  return FLASH_READY;
 }
 
 /**
  * @brief  Save the data to memory
  * @param  IndexMax  Index to last data record in buffer
- * @retval 1 in case of success, 0 otherwise
+ * @retval 1 in case of success, 0 if the log is full (records not saved are lost)
  */
 unsigned char Datalog_SaveData2Mem(uint8_t IndexMax)
 {
-#if (defined (USE_STM32F4XX_NUCLEO))
-  uint32_t address = 0x8060000;
+  return Datalog_SaveWords((const uint8_t *)DataByte, IndexMax); /* MISRA C-2012 rule 11.5 violation for purpose */
+}
 
-#elif (defined (USE_STM32L1XX_NUCLEO))
-  uint32_t address = 0x8060000;
+/**
+ * @brief  Append records to the log, they are staged in RAM and programmed
+ *         later by Datalog_Process
+ * @param  Data the records, FLASH_ITEM_SIZE bytes each, none of them all ones
+ * @param  Count number of records
+ * @retval 1 in case of success, 0 if the log or the staging buffer is full
+ *         (records not saved are lost)
+ */
+unsigned char Datalog_SaveWords(const uint8_t *Data, uint32_t Count)
+{
+  uint32_t idx;
 
-#elif (defined (USE_STM32L4XX_NUCLEO))
-  uint32_t address = 0x80FF800;
+  for (idx = 0; idx < Count; idx++)
+  {
+    /* Never overwrite what was not uploaded yet */
+    if ((Stage_Room() == 0U) || (StageCount == DATALOG_STAGE_RECORDS))
+    {
+      return 0;
+    }
+    if (StageCount == 0U)
+    {
+      StageTick = HAL_GetTick();
+    }
+    (void)memcpy(&Stage[(StageHead + StageCount) % DATALOG_STAGE_RECORDS], &Data[idx * FLASH_ITEM_SIZE],
+                 FLASH_ITEM_SIZE);
+    StageCount++;
+  }
+  if (StageCount > Stats.StagedMax)
+  {
+    Stats.StagedMax = StageCount;
+  }
+  return 1;
+}
 
-#else
-#error Not supported platform
-#endif
+/**
+ * @brief  Move the staged records to flash, one operation at a time, to be
+ *         called from the main loop
+ * @param  None
+ * @retval None
+ * @details A flush starts once the staged records fill the rest of the row
+ *          being written, or DATALOG_FLUSH_MS after the buffer stopped being
+ *          empty. Rows are programmed whole in fast mode, the records before
+ *          the first row boundary one double word at a time; a full page
+ *          opens the next one with an erase unless it is blank. Each
+ *          operation is started with the interrupt API and returns at once,
+ *          its end is picked up on a later call.
+ */
+void Datalog_Process(void)
+{
+  if (Op != DATALOG_OP_NONE)
+  {
+    if (OpDone == 0U)
+    {
+      return;
+    }
+    Op_Complete();
+  }
 
-  unsigned char success = 1;
-  uint8_t idx;
-  uint8_t nword;
+  if (Flushing == 0U)
+  {
+    if ((StageCount == 0U) || ((Hold != 0U) && ((HAL_GetTick() - HoldTick) < DATALOG_FLUSH_MS)))
+    {
+      return;
+    }
+    if ((Paused != 0U) && (FlushAll == 0U) && (StageCount < DATALOG_STAGE_RECORDS))
+    {
+      return;
+    }
+    if ((FlushAll == 0U) && (StageCount < Stage_RowLeft()))
+    {
+      if ((HAL_GetTick() - StageTick) < DATALOG_FLUSH_MS)
+      {
+        return;
+      }
+      FlushAll = 1;
+      Stats.DeadlineFlushes++;
+    }
+    Hold = 0;
+    Flushing = 1;
+    FlushTick = HAL_GetTick();
+    FlushBytes = 0;
 
-#if ((defined (USE_STM32F4XX_NUCLEO)) || (defined (USE_STM32L1XX_NUCLEO)))
-  uint32_t *lpdata; /* MISRA C-2012 rule 11.9 only seemingly violated */
+    /* Unlock the Flash to enable the flash control register access */
+    (void)HAL_FLASH_Unlock();
 
-#elif (defined (USE_STM32L4XX_NUCLEO))
-  uint64_t *lpdata; /* MISRA C-2012 rule 11.9 only seemingly violated */
+    /* Clear pending flags (if any) */
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+  }
 
-#else
-#error Not supported platform
-#endif
+  if ((Hold == 0U) && (StageCount != 0U) && ((FlushAll != 0U) || (StageCount >= Stage_RowLeft())))
+  {
+    Op_Start();
+  }
+  else
+  {
+    Flush_End();
+  }
+}
 
-  (void)HAL_FLASH_Unlock();
+/**
+ * @brief  Program everything staged now, waiting for the flash
+ * @param  None
+ * @retval 1 in case of success, 0 if records are still staged
+ */
+unsigned char Datalog_Flush(void)
+{
+  uint32_t start = HAL_GetTick();
 
-  /* Clear pending flags (if any) */
-#if (defined (USE_STM32F4XX_NUCLEO))
-  __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_OPERR | FLASH_FLAG_WRPERR | FLASH_FLAG_PGAERR | FLASH_FLAG_PGPERR |
-                         FLASH_FLAG_PGSERR);
+  if (StageCount != 0U)
+  {
+    FlushAll = 1;
+    Hold = 0;
+  }
+  Datalog_Process();
+  while ((Op != DATALOG_OP_NONE) || (Flushing != 0U))
+  {
+    if ((HAL_GetTick() - start) >= DATALOG_FLUSH_TIMEOUT_MS)
+    {
+      break;
+    }
+    if (OpDone == 0U)
+    {
+      HAL_Delay(1);
+    }
+    Datalog_Process();
+  }
+  return (StageCount == 0U) ? 1U : 0U;
+}
 
-#elif (defined (USE_STM32L1XX_NUCLEO))
-  __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_PGAERR | FLASH_FLAG_SIZERR | FLASH_FLAG_OPTVERR |
-                         FLASH_FLAG_OPTVERRUSR | FLASH_FLAG_WRPERR);
+/**
+ * @brief  Keep the programmed records as they are while an upload reads
+ *         them: new records stay staged unless the buffer fills up
+ * @param  On 1 to pause, 0 to resume
+ * @retval None
+ */
+void Datalog_Pause(uint8_t On)
+{
+  Paused = On;
+}
 
-#elif (defined (USE_STM32L4XX_NUCLEO))
-  __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+/**
+ * @brief  Flush counters since boot
+ * @param  None
+ * @retval The counters
+ */
+const DatalogStats_t *Datalog_GetStats(void)
+{
+  return &Stats;
+}
+
+/**
+ * @brief  End of a flash operation started by Datalog_Process
+ * @param  ReturnValue page or address done, unused
+ * @retval None
+ */
+void HAL_FLASH_EndOfOperationCallback(uint32_t ReturnValue)
+{
+  (void)ReturnValue;
+  OpDone = 1;
+}
 
-#else
-#error Not supported platform
-#endif
+/**
+ * @brief  Failure of a flash operation started by Datalog_Process
+ * @param  ReturnValue page or address that failed, unused
+ * @retval None
+ */
+void HAL_FLASH_OperationErrorCallback(uint32_t ReturnValue)
+{
+  (void)ReturnValue;
+  OpError = 1;
+  OpDone = 1;
+}
+
+/**
+ * @brief  Drop the records uploaded so far
+ * @param  None
+ * @retval 1 in case of success, 0 otherwise
+ * @details Nothing is erased here: the next page is opened with nothing
+ *          before it to upload, which costs one page erase at most.
+ */
+unsigned char Datalog_FlashErase(void)
+{
+  /* The anchor the runs refer to may be gone */
+  ActivityAnchored = 0;
 
-  for (idx = 0; idx < IndexMax; idx++)
+  /* Staged records were counted in the upload */
+  if (Datalog_Flush() == 0U)
   {
-#if ((defined (USE_STM32F4XX_NUCLEO)) || (defined (USE_STM32L1XX_NUCLEO)))
-    lpdata = (uint32_t *)&DataByte[idx]; /* MISRA C-2012 rule 11.3 only seemingly violated */
+    return 0;
+  }
 
-#elif (defined (USE_STM32L4XX_NUCLEO))
-    lpdata = (uint64_t *)&DataByte[idx]; /* MISRA C-2012 rule 11.3 only seemingly violated */
+  if ((HeadSlot == 1U) && (HeadSeq == StartSeq))
+  {
+    return 1;
+  }
+  return (unsigned char)Page_Open(HeadSeq + 1U, 0);
+}
 
-#else
-#error Not supported platform
-#endif
+/**
+ * @brief  Drop the records of an upload, the ones logged since stay
+ * @param  Count records uploaded, all of those programmed
+ * @retval 1 in case of success, 0 if records were programmed since the
+ *         upload started (nothing is dropped then) or the flash failed
+ * @details Like Datalog_FlashErase the next page is opened with nothing
+ *          before it to upload, the staged records go there. They start
+ *          with an anchor when the upload began with Datalog_ActivityFlush
+ *          and Datalog_ActivityRestart.
+ */
+unsigned char Datalog_Drop(uint32_t Count)
+{
+  uint32_t start = HAL_GetTick();
 
-    if (Address2F < (uint32_t)(address - IndexMax * sizeof(DataByte_t)))
+  /* A flush can only be running if the buffer filled up, let it end */
+  while (((Op != DATALOG_OP_NONE) || (Flushing != 0U)) && ((HAL_GetTick() - start) < DATALOG_FLUSH_TIMEOUT_MS))
+  {
+    if (OpDone == 0U)
     {
-#if ((defined (USE_STM32F4XX_NUCLEO)) || (defined (USE_STM32L1XX_NUCLEO)))
-      for (nword = 0; nword < (sizeof(DataByte_t) / 4); nword++)
-      {
-        /* MISRA C-2012 rule 18.4 violation for purpose */
-        if (HAL_FLASH_Program(TYPEPROGRAM_WORD, Address2F, *(lpdata + nword)) == HAL_OK)
-        {
-          Address2F += 4;
-        }
-        else
-        {
-          /* Error occurred while writing data in Flash memory */
-          Error_Handler();
-        }
-      }
+      HAL_Delay(1);
+    }
+    Datalog_Process();
+  }
+  if ((Op != DATALOG_OP_NONE) || (Flushing != 0U) || (Count != (Datalog_RecordCount() - StageCount)))
+  {
+    return 0;
+  }
+  if (Count == 0U)
+  {
+    return 1;
+  }
+  return (unsigned char)Page_Open(HeadSeq + 1U, 0);
+}
 
-#elif (defined (USE_STM32L4XX_NUCLEO))
-      for (nword = 0; nword < (sizeof(DataByte_t) / 8U); nword++)
-      {
-        /* MISRA C-2012 rule 18.4 violation for purpose */
-        if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, Address2F, *(lpdata + nword)) == HAL_OK)
-        {
-          Address2F += 8U;
-        }
-        else
-        {
-          /* Error occurred while writing data in Flash memory */
-          Error_Handler();
-        }
-      }
+/**
+ * @brief  Start logging activity runs
+ * @param  TickHz ticks per second of the Datalog_ActivityLog calls
+ * @retval None
+ */
+void Datalog_ActivityStart(uint8_t TickHz)
+{
+  ActivityLog_Init(&ActivityLog);
+  ActivityTickHz = TickHz;
+  ActivityAnchored = 0;
+}
 
-#else
-#error Not supported platform
-#endif
+/**
+ * @brief  Log the status of one tick, or of several at a reduced rate, only
+ *         transitions reach the flash
+ * @param  Tick ticks since boot, the first the status covers
+ * @param  Ticks ticks the status covers
+ * @param  Code ACTLOG_CODE() of the status
+ * @param  TurnOver 1 if a turn over happened since the previous status
+ * @retval 1 in case of success, 0 if the log is full
+ * @details The first tick after a start, an upload or a date/time change
+ *          writes an anchor with the RTC date and time, later runs are
+ *          ticks after it. A word is staged once no more entries fit in
+ *          it, so up to one word of runs waits in the encoder.
+ */
+unsigned char Datalog_ActivityLog(uint32_t Tick, uint32_t Ticks, uint8_t Code, uint8_t TurnOver)
+{
+  uint8_t out[2U * ACTLOG_OUT_MAX];
+  DateTime_t now;
+  uint32_t n = 0;
 
-    }
-    else
-    {
-      success = 0;
-    }
+  if (ActivityTickHz == 0U)
+  {
+    return 1;
+  }
+  if (ActivityAnchored == 0U)
+  {
+    RTC_GetDateTime(now.date, now.time);
+    n = ActivityLog_Anchor(&ActivityLog, Tick, (const uint8_t *)&now, ActivityTickHz, out); /* MISRA C-2012 rule 11.5 violation for purpose */
+    ActivityAnchored = 1;
   }
+  n += ActivityLog_Add(&ActivityLog, Tick, Ticks, Code, TurnOver, &out[n]);
 
-  (void)HAL_FLASH_Lock();
-  return success;
+  return (n != 0U) ? Datalog_SaveWords(out, n / FLASH_ITEM_SIZE) : 1U;
 }
 
 /**
- * @brief  Reset flash (block 6)
+ * @brief  Write the open run and the word being filled, then program all
+ *         that is staged, before an upload
  * @param  None
- * @retval 1 in case of success, 0 otherwise
+ * @retval 1 in case of success, 0 if the log is full or the flash failed
  */
-unsigned char Datalog_FlashErase(void)
+unsigned char Datalog_ActivityFlush(void)
 {
-  /* Reset data in FLASH */
-  unsigned char success = 1;
+  uint8_t out[ACTLOG_OUT_MAX];
+  uint32_t n = ActivityLog_Flush(&ActivityLog, out);
+  unsigned char success = (n != 0U) ? Datalog_SaveWords(out, n / FLASH_ITEM_SIZE) : 1U;
 
-  /* Erase First Flash sector */
-  FLASH_EraseInitTypeDef erase_init_struct;
-  uint32_t sector_error = 0;
+  return ((Datalog_Flush() != 0U) && (success != 0U)) ? 1U : 0U;
+}
 
-#if (defined (USE_STM32F4XX_NUCLEO))
-  erase_init_struct.TypeErase = TYPEERASE_SECTORS;
-  erase_init_struct.VoltageRange = VOLTAGE_RANGE_3;
-  erase_init_struct.Sector = FLASH_SECTOR;
-  erase_init_struct.NbSectors = 1;
+/**
+ * @brief  Anchor again on the next tick, after the RTC was set
+ * @param  None
+ * @retval None
+ */
+void Datalog_ActivityRestart(void)
+{
+  ActivityAnchored = 0;
+}
 
-#elif (defined (USE_STM32L1XX_NUCLEO))
-  erase_init_struct.TypeErase   = FLASH_TYPEERASE_PAGES;
-  erase_init_struct.PageAddress = FLASH_ADDRESS;
-  erase_init_struct.NbPages     = 512; /* page 1024 .. 1535 */
+/**
+ * @brief  Number of records logged and not uploaded yet, staged ones
+ *         included: Datalog_Flush them before reading
+ * @param  None
+ * @retval Record count
+ */
+uint32_t Datalog_RecordCount(void)
+{
+  if (HeadSlot == 0U)
+  {
+    return 0;
+  }
+  return ((HeadSeq - StartSeq) * DATALOG_PAGE_RECORDS) + HeadSlot - 1U + StageCount;
+}
 
-#elif (defined (USE_STM32L4XX_NUCLEO))
-  erase_init_struct.TypeErase   = FLASH_TYPEERASE_PAGES;
-  erase_init_struct.Banks       = GetBank(FLASH_ADDRESS);
-  erase_init_struct.Page        = GetPage(FLASH_ADDRESS);
-  erase_init_struct.NbPages     = 64;
+/**
+ * @brief  Identify the records not uploaded yet: it changes when uploaded
+ *         records are dropped, not when records are added
+ * @param  None
+ * @retval Sequence number of the oldest page not uploaded
+ */
+uint32_t Datalog_LogId(void)
+{
+  return StartSeq;
+}
 
-#else
-#error Not supported platform
-#endif
+/**
+ * @brief  Read programmed records from FLASH
+ * @param  Index first record to read, 0 is the oldest one not uploaded
+ * @param  Dest FLASH_ITEM_SIZE bytes per record
+ * @param  Count number of records
+ * @retval None
+ */
+void Datalog_ReadRecords(uint32_t Index, uint8_t *Dest, uint32_t Count)
+{
+  uint32_t i;
+  uint64_t value;
 
-  /* Unlock the Flash to enable the flash control register access */
-  (void)HAL_FLASH_Unlock();
+  for (i = 0; i < Count; i++)
+  {
+    value = ReadIntFlash(Page_Address(StartSeq + (Index / DATALOG_PAGE_RECORDS))
+                         + ((1U + (Index % DATALOG_PAGE_RECORDS)) * FLASH_ITEM_SIZE));
+    (void)memcpy(&Dest[i * FLASH_ITEM_SIZE], &value, FLASH_ITEM_SIZE);
+    Index++;
+  }
+}
 
-  /* Clear pending flags (if any) */
-#if (defined (USE_STM32F4XX_NUCLEO))
-  __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_OPERR | FLASH_FLAG_WRPERR | FLASH_FLAG_PGAERR | FLASH_FLAG_PGPERR |
-                         FLASH_FLAG_PGSERR);
+/**
+ * @brief  Read from FLASH and fill the buffer to be sent via USART
+ * @param  Index first record to read, 0 is the oldest one not uploaded
+ * @param  LenBuf number of records
+ * @retval None
+ */
+void Datalog_FillBuffer2BSent(uint32_t Index, uint8_t LenBuf)
+{
+  Datalog_ReadRecords(Index, (uint8_t *)DataByte, LenBuf); /* MISRA C-2012 rule 11.5 violation for purpose */
+}
 
-#elif (defined (USE_STM32L1XX_NUCLEO))
-  __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_EOP | FLASH_FLAG_PGAERR | FLASH_FLAG_SIZERR | FLASH_FLAG_OPTVERR |
-                         FLASH_FLAG_OPTVERRUSR | FLASH_FLAG_WRPERR);
+/**
+ * @brief  Read one double word of FLASH
+ * @param  Address FLASH address, double word aligned
+ * @retval The double word
+ */
+static uint64_t ReadIntFlash(uint32_t Address)
+{
+  return *(__IO uint64_t *)(uintptr_t)Address;
+}
 
-#elif (defined (USE_STM32L4XX_NUCLEO))
-  __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+/**
+ * @brief  Address of the page holding a given sequence number
+ * @param  Seq page sequence number
+ * @retval Page address
+ */
+static uint32_t Page_Address(uint32_t Seq)
+{
+  return FLASH_ADDRESS + ((Seq % DATALOG_PAGES) * FLASH_PAGE_SIZE);
+}
 
-#else
-#error Not supported platform
-#endif
+/**
+ * @brief  CRC-16/CCITT of a page header, CRC field excluded
+ * @param  Header the page header
+ * @retval CRC
+ */
+static uint16_t Page_Crc(const DatalogPage_t *Header)
+{
+  /* One nibble at a time, boot checks a handful of headers */
+  static const uint16_t nibble[16] =
+  {
+    0x0000U, 0x1021U, 0x2042U, 0x3063U, 0x4084U, 0x50A5U, 0x60C6U, 0x70E7U,
+    0x8108U, 0x9129U, 0xA14AU, 0xB16BU, 0xC18CU, 0xD1ADU, 0xE1CEU, 0xF1EFU
+  };
+  const uint8_t *p = (const uint8_t *)Header; /* MISRA C-2012 rule 11.5 violation for purpose */
+  uint16_t crc = 0xFFFFU;
+  uint32_t i;
 
-  if (HAL_FLASHEx_Erase(&erase_init_struct, &sector_error) != HAL_OK)
+  for (i = 0; i < offsetof(DatalogPage_t, Crc); i++)
   {
-    success = 0;
-    Error_Handler();
+    crc = (uint16_t)((crc << 4) ^ nibble[(crc >> 12) ^ ((uint32_t)p[i] >> 4)]);
+    crc = (uint16_t)((crc << 4) ^ nibble[(crc >> 12) ^ ((uint32_t)p[i] & 0x0FU)]);
   }
+  return crc;
+}
 
-  /* Lock the Flash to disable the flash control register access */
-  (void)HAL_FLASH_Lock();
+/**
+ * @brief  Header double word of a page
+ * @param  Seq page sequence number
+ * @param  Back pages before it still to be uploaded
+ * @retval The header
+ */
+static uint64_t Page_Header(uint32_t Seq, uint8_t Back)
+{
+  DatalogPage_t header;
+  uint64_t value;
+
+  header.Seq = Seq;
+  header.Back = Back;
+  header.Magic = DATALOG_PAGE_MAGIC;
+  header.Crc = Page_Crc(&header);
+  (void)memcpy(&value, &header, sizeof(value));
+  return value;
+}
 
-  Address2F = FLASH_ADDRESS;
+/**
+ * @brief  Check that a page is erased
+ * @param  Address page address
+ * @retval 1 if it is, 0 otherwise
+ */
+static int Page_Blank(uint32_t Address)
+{
+  uint32_t i;
 
-  return success;
+  for (i = 0; i < FLASH_PAGE_SIZE; i += FLASH_ITEM_SIZE)
+  {
+    if (ReadIntFlash(Address + i) != DATALOG_ERASED)
+    {
+      return 0;
+    }
+  }
+  return 1;
 }
 
 /**
- * @brief  Search the next free Flash memory
- * @param  FlashSectorBaseAddress start address of related Flash sector
- * @retval sector_offset value to add to next Flash address to write
+ * @brief  Read and check a page header
+ * @param  Page page index in the region
+ * @param  Header the header read
+ * @retval 1 if the page belongs to the log, 0 if it is erased or corrupted
  */
-uint32_t Datalog_SearchNextFreeMemoryIndex(uint32_t *FlashSectorBaseAddress)
+static int Page_Read(uint32_t Page, DatalogPage_t *Header)
 {
-  uint32_t i;
+  uint64_t value = ReadIntFlash(FLASH_ADDRESS + (Page * FLASH_PAGE_SIZE));
 
-#if ((defined (USE_STM32F4XX_NUCLEO)) || (defined (USE_STM32L1XX_NUCLEO)))
-  uint32_t tmp_read_buffer = 0x00;
+  (void)memcpy(Header, &value, sizeof(*Header));
+  return ((Header->Magic == DATALOG_PAGE_MAGIC) && (Header->Crc == Page_Crc(Header))
+          && ((Header->Seq % DATALOG_PAGES) == Page) && (Header->Back < DATALOG_PAGES)) ? 1 : 0;
+}
 
-#elif (defined (USE_STM32L4XX_NUCLEO))
-  uint64_t tmp_read_buffer = 0x00;
+/**
+ * @brief  Make a page the head of the ring: erase it unless it is blank,
+ *         then write its header. The flash must be unlocked.
+ * @param  Seq sequence number of the new head
+ * @param  Back pages before it still to be uploaded
+ * @retval 1 in case of success, 0 otherwise
+ */
+static int Page_OpenUnlocked(uint32_t Seq, uint8_t Back)
+{
+  FLASH_EraseInitTypeDef erase_init_struct;
+  uint32_t address = Page_Address(Seq);
+  uint32_t page_error = 0;
 
-#else
-#error Not supported platform
-#endif
+  if (Page_Blank(address) == 0)
+  {
+    erase_init_struct.TypeErase = FLASH_TYPEERASE_PAGES;
+    erase_init_struct.Banks     = GetBank(address);
+    erase_init_struct.Page      = GetPage(address);
+    erase_init_struct.NbPages   = 1;
+    if (HAL_FLASHEx_Erase(&erase_init_struct, &page_error) != HAL_OK)
+    {
+      Error_Handler();
+      return 0;
+    }
+  }
 
-  uint32_t sector_offset = 0;
-  uint32_t delta = 0;
+  if (HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, address, Page_Header(Seq, Back)) != HAL_OK)
+  {
+    Error_Handler();
+    return 0;
+  }
 
-  ReadIntFlash(*FlashSectorBaseAddress + (FLASH_SECTOR_SIZE / 2U), &tmp_read_buffer, 4);
+  HeadSeq = Seq;
+  HeadSlot = 1;
+  StartSeq = Seq - Back;
+  return 1;
+}
 
-#if (defined (USE_STM32F4XX_NUCLEO))
-  if (tmp_read_buffer != 0xFFFFFFFFU)
+/**
+ * @brief  Page_OpenUnlocked, unlocking the flash around it
+ * @param  Seq sequence number of the new head
+ * @param  Back pages before it still to be uploaded
+ * @retval 1 in case of success, 0 otherwise
+ */
+static int Page_Open(uint32_t Seq, uint8_t Back)
+{
+  int ret;
 
-#elif (defined (USE_STM32L1XX_NUCLEO))
-  if (tmp_read_buffer != 0x00000000U)
+  /* Unlock the Flash to enable the flash control register access */
+  (void)HAL_FLASH_Unlock();
 
-#elif (defined (USE_STM32L4XX_NUCLEO))
-  if (tmp_read_buffer != 0xFFFFFFFFFFFFFFFFU)
+  /* Clear pending flags (if any) */
+  __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
 
-#else
-#error Not supported platform
-#endif
+  ret = Page_OpenUnlocked(Seq, Back);
 
-  {
-    *FlashSectorBaseAddress = *FlashSectorBaseAddress + (FLASH_SECTOR_SIZE / 2U);
-    delta = (FLASH_SECTOR_SIZE >> 1);
-  }
+  /* Lock the Flash to disable the flash control register access */
+  (void)HAL_FLASH_Lock();
+  return ret;
+}
+
+/**
+ * @brief  Record slots left for staging
+ * @param  None
+ * @retval Number of records that can still be staged
+ */
+static uint32_t Stage_Room(void)
+{
+  uint32_t room;
 
-  for (i = 0; i < (FLASH_SECTOR_SIZE >> 1); i = i + FLASH_ITEM_SIZE)
+  if (HeadSlot == 0U)
   {
-    ReadIntFlash(*FlashSectorBaseAddress + i, &tmp_read_buffer, 4);
+    return 0;
+  }
+  room = ((DATALOG_PAGES - 1U - (HeadSeq - StartSeq)) * DATALOG_PAGE_RECORDS) + (DATALOG_PAGE_RECORDS + 1U - HeadSlot);
+  return (room > StageCount) ? (room - StageCount) : 0U;
+}
 
-#if (defined (USE_STM32F4XX_NUCLEO))
-    if (tmp_read_buffer == 0xFFFFFFFFU)
+/**
+ * @brief  Records that fill the row being written
+ * @param  None
+ * @retval Number of records up to the next row boundary
+ */
+static uint32_t Stage_RowLeft(void)
+{
+  /* A full page goes on at slot 1 of the next one */
+  uint32_t slot = (HeadSlot > DATALOG_PAGE_RECORDS) ? 1U : HeadSlot;
 
-#elif (defined (USE_STM32L1XX_NUCLEO))
-    if (tmp_read_buffer == 0x00000000U)
+  return DATALOG_ROW_RECORDS - (slot % DATALOG_ROW_RECORDS);
+}
 
-#elif (defined (USE_STM32L4XX_NUCLEO))
-    if (tmp_read_buffer == 0xFFFFFFFFFFFFFFFFU)
+/**
+ * @brief  Remove programmed records from the staging buffer
+ * @param  Count number of records
+ * @retval None
+ */
+static void Stage_Drop(uint32_t Count)
+{
+  StageHead = (StageHead + Count) % DATALOG_STAGE_RECORDS;
+  StageCount -= Count;
+  FlushBytes += Count * FLASH_ITEM_SIZE;
+}
 
-#else
-#error Not supported platform
-#endif
+/**
+ * @brief  Start the next flash operation of a flush
+ * @param  None
+ * @retval None
+ * @details The first row of a page holds the header and is never fast
+ *          programmed. Fast programming needs the whole row erased, which
+ *          holds at a row boundary as records are programmed in order.
+ */
+static void Op_Start(void)
+{
+  FLASH_EraseInitTypeDef erase_init_struct;
+  HAL_StatusTypeDef status;
+  uint32_t address;
+  uint32_t i;
 
+  OpDone = 0;
+  OpError = 0;
+  if (HeadSlot > DATALOG_PAGE_RECORDS)
+  {
+    if ((HeadSeq + 1U - StartSeq) >= DATALOG_PAGES)
     {
-      sector_offset = i;
-      break;
+      /* Only after failed slots were skipped: the staged records are lost */
+      StageCount = 0;
+      return;
+    }
+    address = Page_Address(HeadSeq + 1U);
+    if (Page_Blank(address) == 0)
+    {
+      erase_init_struct.TypeErase = FLASH_TYPEERASE_PAGES;
+      erase_init_struct.Banks     = GetBank(address);
+      erase_init_struct.Page      = GetPage(address);
+      erase_init_struct.NbPages   = 1;
+      Op = DATALOG_OP_ERASE;
+      status = HAL_FLASHEx_Erase_IT(&erase_init_struct);
     }
     else
     {
-      sector_offset = FLASH_SECTOR_SIZE / 2U;
+      Op = DATALOG_OP_HEADER;
+      status = HAL_FLASH_Program_IT(FLASH_TYPEPROGRAM_DOUBLEWORD, address,
+                                    Page_Header(HeadSeq + 1U, (uint8_t)(HeadSeq + 1U - StartSeq)));
+    }
+  }
+  else if (((HeadSlot % DATALOG_ROW_RECORDS) == 0U) && (StageCount >= DATALOG_ROW_RECORDS))
+  {
+    for (i = 0; i < DATALOG_ROW_RECORDS; i++)
+    {
+      Row[i] = Stage[(StageHead + i) % DATALOG_STAGE_RECORDS];
     }
+    Op = DATALOG_OP_ROW;
+    status = HAL_FLASH_Program_IT(FLASH_TYPEPROGRAM_FAST_AND_LAST, Page_Address(HeadSeq) + (HeadSlot * FLASH_ITEM_SIZE),
+                                  (uint64_t)(uintptr_t)Row);
+  }
+  else
+  {
+    Op = DATALOG_OP_RECORD;
+    status = HAL_FLASH_Program_IT(FLASH_TYPEPROGRAM_DOUBLEWORD, Page_Address(HeadSeq) + (HeadSlot * FLASH_ITEM_SIZE),
+                                  Stage[StageHead]);
+  }
+
+  if (status != HAL_OK)
+  {
+    OpError = 1;
+    OpDone = 1;
   }
-  return (sector_offset + delta);
 }
 
 /**
- * @brief  Read of FLASH
- * @param  NStartAddress FLASH address where start to read
- * @param  NBytesToRead number of bytes to read in  FLASH
+ * @brief  Account for the flash operation that just ended
+ * @param  None
  * @retval None
  */
-#if ((defined (USE_STM32F4XX_NUCLEO)) || (defined (USE_STM32L1XX_NUCLEO)))
-void ReadIntFlash(uint32_t NStartAddress, uint32_t *ReadBuffer, uint32_t NBytesToRead)
+static void Op_Complete(void)
 {
-  uint32_t addr = NStartAddress;
-  while (addr < NStartAddress + NBytesToRead)
+  DatalogOp_t op = Op;
+
+  Op = DATALOG_OP_NONE;
+  if (OpError != 0U)
+  {
+    Stats.Errors++;
+  }
+  switch (op)
   {
-    *(ReadBuffer) = *(__IO uint32_t *)addr;
+    case DATALOG_OP_ERASE:
+      if (OpError == 0U)
+      {
+        Stats.Erases++;
+      }
+      break;
+
+    case DATALOG_OP_HEADER:
+      if (OpError == 0U)
+      {
+        HeadSeq++;
+        HeadSlot = 1;
+      }
+      break;
+
+    case DATALOG_OP_RECORD:
+      /* A slot that failed is skipped, its record goes to the next one */
+      HeadSlot++;
+      if (OpError == 0U)
+      {
+        Stage_Drop(1);
+        Stats.DoubleWords++;
+      }
+      break;
 
-    addr += 4;
-    ReadBuffer += 1; /* MISRA C-2012 rule 18.4 violation for purpose */
+    case DATALOG_OP_ROW:
+      HeadSlot += DATALOG_ROW_RECORDS;
+      if (OpError == 0U)
+      {
+        Stage_Drop(DATALOG_ROW_RECORDS);
+        Stats.Rows++;
+      }
+      break;
+
+    default:
+      break;
   }
-}
 
-#elif (defined (USE_STM32L4XX_NUCLEO))
-void ReadIntFlash(uint32_t NStartAddress, uint64_t *ReadBuffer, uint32_t NBytesToRead)
-{
-  uint32_t addr = NStartAddress;
-  while (addr < NStartAddress + NBytesToRead)
+  /* The page cannot be opened now, try again later rather than on every call */
+  if ((OpError != 0U) && ((op == DATALOG_OP_ERASE) || (op == DATALOG_OP_HEADER)))
   {
-    *(ReadBuffer) = *(__IO uint64_t *)addr;
-    addr += 8U;
-
-    ReadBuffer += 1; /* MISRA C-2012 rule 18.4 violation for purpose */
+    Hold = 1;
+    HoldTick = HAL_GetTick();
   }
 }
 
-#else
-#error Not supported platform
-#endif
-
 /**
- * @brief  Read from FLASH and fill the buffer to be sent via USART
- * @param  AddF FLASH address where start to read
- * @param  LenBuf length buffer
+ * @brief  Lock the flash and account for the flush that just ended
+ * @param  None
  * @retval None
  */
-void Datalog_FillBuffer2BSent(uint32_t AddF, uint8_t LenBuf)
+static void Flush_End(void)
 {
-  uint32_t i;
-
-#if ((defined (USE_STM32F4XX_NUCLEO)) || (defined (USE_STM32L1XX_NUCLEO)))
-  uint32_t *pdata;
+  uint32_t ms = HAL_GetTick() - FlushTick;
+  uint32_t bucket = 0;
 
-#elif (defined (USE_STM32L4XX_NUCLEO))
-  uint64_t *pdata;
-
-#else
-#error Not supported platform
-#endif
+  /* Lock the Flash to disable the flash control register access */
+  (void)HAL_FLASH_Lock();
 
-  for (i = 0; i < LenBuf; i++)
+  Flushing = 0;
+  FlushAll = 0;
+  while ((ms != 0U) && (bucket < (DATALOG_LATENCY_BUCKETS - 1U)))
   {
-
-#if ((defined (USE_STM32F4XX_NUCLEO)) || (defined (USE_STM32L1XX_NUCLEO)))
-    pdata = (uint32_t *)&DataByte[i]; /* MISRA C-2012 rule 11.3 violation for purpose */
-
-#elif (defined (USE_STM32L4XX_NUCLEO))
-    pdata = (uint64_t *)&DataByte[i]; /* MISRA C-2012 rule 11.3 violation for purpose */
-
-#else
-#error Not supported platform
-#endif
-
-    ReadIntFlash(AddF, pdata, sizeof(DataByte_t));
-    AddF += sizeof(DataByte_t);
+    ms >>= 1;
+    bucket++;
+  }
+  Stats.Latency[bucket]++;
+  Stats.Flushes++;
+  Stats.Bytes += FlushBytes;
+  if (FlushBytes > Stats.BytesMax)
+  {
+    Stats.BytesMax = FlushBytes;
   }
 }
 
@@ -21,8 +21,12 @@
 /* Includes ------------------------------------------------------------------*/
 #include <stdint.h>
 #include "com.h"
+#include "bulk_upload.h"
+#include "link_baud.h"
+#include "status_frame.h"
 #include "DemoDatalog.h"
 #include "DemoSerial.h"
+#include "low_power.h"
 
 /** @addtogroup MOTION_APPLICATIONS MOTION APPLICATIONS
  * @{
@@ -55,10 +59,37 @@
 
 #define DATA_TX_LEN  MIN(4, DATABYTE_LEN)
 
+/* Bulk blocks leave room in the transmit queue for a status frame */
+#define BULK_TX_ROOM  (BULK_WIRE_MAX + STATUS_FRAME_WIRE_MAX)
+
 /* Private variables ---------------------------------------------------------*/
 static uint8_t PresentationString[] = {"MEMS shield demo,"FW_ID","FW_VERSION","LIB_VERSION","EXPANSION_BOARD};
 static volatile uint8_t DataStreamingDest = 2;
 
+/* Bulk upload session: the records programmed when it started, read in the
+   ranges the host asked for, oldest request first */
+static uint8_t BulkActive = 0;
+static uint8_t BulkDest = 0;
+static uint32_t BulkLogId = 0;
+static uint32_t BulkTotal = 0;    /* [bytes] */
+static uint16_t BulkSeq = 0;      /* CMD_Bulk_Data sent in the session */
+static uint32_t BulkTick = 0;     /* [ms] last request from the host */
+static uint32_t BulkOffset[BULK_RANGES];
+static uint8_t BulkBlocks[BULK_RANGES];
+static uint32_t BulkHead = 0;
+static uint32_t BulkCount = 0;
+static TMsg BulkMsg;
+
+/* CMD_Set_Baud switch waiting for the host to verify it, and what to go
+   back to otherwise */
+static uint8_t BaudPending = 0;
+static uint32_t BaudTick = 0;     /* [ms] switch */
+static uint32_t BaudFallback = LINK_BAUD_DEFAULT;
+static uint8_t FlowFallback = LINK_FLOW_NONE;
+
+/* Exported variables --------------------------------------------------------*/
+TStreamBatch StreamBatch;
+
 /**
  * @brief  Build the reply header
  * @param  Msg the pointer to the message to be built
@@ -103,6 +134,99 @@ void INIT_STREAMING_MSG(TMsg *Msg)
   Msg->Len = 3;
 }
 
+/**
+ * @brief  Send the samples batched so far, if any, and stop batching
+ * @param  None
+ * @retval None
+ */
+static void Batch_Stop(void)
+{
+  if (StreamBatch.Count != 0U)
+  {
+    UART_SendMsg(&StreamBatch.Msg);
+  }
+  (void)StreamBatch_Start(&StreamBatch, DataStreamingDest, 0, 0);
+}
+
+/**
+ * @brief  End the bulk upload session, the datalog is flushed again
+ * @param  None
+ * @retval None
+ */
+static void Bulk_End(void)
+{
+  BulkActive = 0;
+  BulkCount = 0;
+  Datalog_Pause(0);
+}
+
+/**
+ * @brief  Send the blocks requested so far while the transmit queue has
+ *         room, to be called from the main loop
+ * @param  None
+ * @retval None
+ * @details Blocks are read from flash straight into the message and their
+ *          CRC computed on the CRC peripheral; the UART DMA sends them
+ *          while the main loop goes on. A session the host stopped talking
+ *          to ends after BULK_TIMEOUT_MS.
+ */
+void Bulk_Process(void)
+{
+  uint32_t offset;
+  uint32_t len;
+  uint8_t status;
+
+  if (BulkActive == 0U)
+  {
+    return;
+  }
+  if ((HAL_GetTick() - BulkTick) >= BULK_TIMEOUT_MS)
+  {
+    Bulk_End();
+    return;
+  }
+
+  while ((BulkCount != 0U) && (UART_TxRoom() >= BULK_TX_ROOM))
+  {
+    offset = BulkOffset[BulkHead];
+    len = 0;
+    status = BULK_END;
+    if (offset < BulkTotal)
+    {
+      len = MIN(BulkTotal - offset, BULK_BLOCK_LEN);
+      status = BULK_OK;
+      Datalog_ReadRecords(offset / FLASH_ITEM_SIZE, &BulkMsg.Data[BULK_HEADER_LEN], len / FLASH_ITEM_SIZE);
+    }
+    BulkUpload_Block(&BulkMsg, BulkDest, BulkSeq, offset, status,
+                     len, (len != 0U) ? CRC_Block32(&BulkMsg.Data[BULK_HEADER_LEN], len) : 0U);
+    BulkSeq++;
+    UART_SendMsg(&BulkMsg);
+
+    BulkOffset[BulkHead] += len;
+    BulkBlocks[BulkHead]--;
+    if ((BulkBlocks[BulkHead] == 0U) || (status == BULK_END))
+    {
+      BulkHead = (BulkHead + 1U) % BULK_RANGES;
+      BulkCount--;
+    }
+  }
+}
+
+/**
+ * @brief  Go back to the previous rate and flow control when the host did
+ *         not verify a switch in time, to be called from the main loop
+ * @param  None
+ * @retval None
+ */
+void Baud_Process(void)
+{
+  if ((BaudPending != 0U) && ((HAL_GetTick() - BaudTick) >= LINK_BAUD_VERIFY_MS))
+  {
+    BaudPending = 0;
+    UART_SetBaud(BaudFallback, FlowFallback);
+  }
+}
+
 /**
  * @brief  Handle a message
  * @param  Msg the pointer to the message to be handled
@@ -117,6 +241,14 @@ int HandleMSG(TMsg *Msg)
   uint32_t i;
   uint32_t addf;
   uint32_t countb = 0;
+  uint32_t sensors;
+  uint8_t samples;
+  const uint32_t *stats;
+  const LowPowerStats_t *power;
+  uint32_t offset;
+  uint32_t baud;
+  uint8_t status;
+  uint8_t flow;
 
   if (Msg->Len < 2U)
   {
@@ -212,40 +344,39 @@ int HandleMSG(TMsg *Msg)
       {
         return 0;
       }
+      /* The sensors allowed; the acquisition powers those the mode subscribes to */
       SensorsEnabled = Deserialize(&Msg->Data[3], 4);
 
-      /* Start enabled sensors */
-      if ((SensorsEnabled & PRESSURE_SENSOR) == PRESSURE_SENSOR)
-      {
-        (void)IKS01A2_ENV_SENSOR_Enable(IKS01A2_LPS22HB_0, ENV_PRESSURE);
-      }
-      if ((SensorsEnabled & TEMPERATURE_SENSOR) == TEMPERATURE_SENSOR)
-      {
-        (void)IKS01A2_ENV_SENSOR_Enable(IKS01A2_HTS221_0, ENV_TEMPERATURE);
-      }
-      if ((SensorsEnabled & HUMIDITY_SENSOR) == HUMIDITY_SENSOR)
-      {
-        (void)IKS01A2_ENV_SENSOR_Enable(IKS01A2_HTS221_0, ENV_HUMIDITY);
-      }
-      if ((SensorsEnabled & ACCELEROMETER_SENSOR) == ACCELEROMETER_SENSOR)
-      {
-        (void)IKS01A2_MOTION_SENSOR_Enable(IKS01A2_LSM6DSL_0, MOTION_ACCELERO);
-      }
-      if ((SensorsEnabled & GYROSCOPE_SENSOR) == GYROSCOPE_SENSOR)
-      {
-        (void)IKS01A2_MOTION_SENSOR_Enable(IKS01A2_LSM6DSL_0, MOTION_GYRO);
-      }
-      if ((SensorsEnabled & MAGNETIC_SENSOR) == MAGNETIC_SENSOR)
+      Acquisition_Start();
+      DataLoggerActive = 1;
+
+      DataStreamingDest = Msg->Data[1];
+      BUILD_REPLY_HEADER(Msg);
+      Msg->Len = 3;
+      UART_SendMsg(Msg);
+      break;
+
+    case CMD_Start_Batch_Streaming:
+      /* Payload: SensorsEnabled bits (4) | samples per batch (1), 0 samples stops batching */
+      if (Msg->Len != 8U)
       {
-        (void)IKS01A2_MOTION_SENSOR_Enable(IKS01A2_LSM303AGR_MAG_0, MOTION_MAGNETO);
+        return 0;
       }
+      Batch_Stop();
+      sensors = Deserialize(&Msg->Data[3], 4) & STREAM_BATCH_SENSORS;
 
-      (void)HAL_TIM_Base_Start_IT(&AlgoTimHandle);
-      DataLoggerActive = 1;
+      /* Batching adds to what the algorithms already use, it never turns a
+         sensor off; the acquisition powers them once the command is handled */
+      SensorsEnabled |= sensors;
 
       DataStreamingDest = Msg->Data[1];
+      samples = StreamBatch_Start(&StreamBatch, DataStreamingDest, (uint8_t)sensors, Msg->Data[7]);
+
+      /* Reply with what was granted: sensors (1) | samples per batch (1) */
       BUILD_REPLY_HEADER(Msg);
-      Msg->Len = 3;
+      Msg->Data[3] = StreamBatch.Sensors;
+      Msg->Data[4] = samples;
+      Msg->Len = 5;
       UART_SendMsg(Msg);
       break;
 
@@ -254,17 +385,11 @@ int HandleMSG(TMsg *Msg)
       {
         return 0;
       }
+      Batch_Stop();
       DataLoggerActive = 0;
-      (void)HAL_TIM_Base_Stop_IT(&AlgoTimHandle);
-
-      /* Disable all sensors */
-      (void)IKS01A2_ENV_SENSOR_Disable(IKS01A2_LPS22HB_0, ENV_PRESSURE);
-      (void)IKS01A2_ENV_SENSOR_Disable(IKS01A2_HTS221_0, ENV_TEMPERATURE);
-      (void)IKS01A2_ENV_SENSOR_Disable(IKS01A2_HTS221_0, ENV_HUMIDITY);
-      (void)IKS01A2_MOTION_SENSOR_Disable(IKS01A2_LSM6DSL_0, MOTION_ACCELERO);
-      (void)IKS01A2_MOTION_SENSOR_Disable(IKS01A2_LSM6DSL_0, MOTION_GYRO);
-      (void)IKS01A2_MOTION_SENSOR_Disable(IKS01A2_LSM303AGR_MAG_0, MOTION_MAGNETO);
+      Acquisition_Stop();
 
+      /* All sensors are powered down with the acquisition */
       SensorsEnabled = 0;
 
       BUILD_REPLY_HEADER(Msg);
@@ -280,6 +405,169 @@ int HandleMSG(TMsg *Msg)
       Msg->Len = 3;
       RTC_TimeRegulate(Msg->Data[3], Msg->Data[4], Msg->Data[5]);
       RTC_DateRegulate(Msg->Data[6], Msg->Data[7], Msg->Data[8], Msg->Data[9]);
+      Datalog_ActivityRestart();
+      UART_SendMsg(Msg);
+      break;
+
+    case CMD_Datalog_Stats:
+      if (Msg->Len != 3U)
+      {
+        return 0;
+      }
+      /* Reply: the DatalogStats_t fields in order, 4 bytes each */
+      BUILD_REPLY_HEADER(Msg);
+      stats = (const uint32_t *)Datalog_GetStats(); /* MISRA C-2012 rule 11.5 violation for purpose */
+      for (i = 0; i < (sizeof(DatalogStats_t) / sizeof(uint32_t)); i++)
+      {
+        Serialize(&Msg->Data[3U + (4U * i)], stats[i], 4);
+      }
+      Msg->Len = 3U + (4U * i);
+      UART_SendMsg(Msg);
+      break;
+
+    case CMD_Power_Stats:
+      if (Msg->Len != 3U)
+      {
+        return 0;
+      }
+      /* Reply: sleeps (4), core cycles running and asleep (8 each), core clock [Hz] (4) */
+      BUILD_REPLY_HEADER(Msg);
+      power = LowPower_GetStats();
+      Serialize(&Msg->Data[3], power->Sleeps, 4);
+      Serialize(&Msg->Data[7], (uint32_t)power->ActiveCycles, 4);
+      Serialize(&Msg->Data[11], (uint32_t)(power->ActiveCycles >> 32), 4);
+      Serialize(&Msg->Data[15], (uint32_t)power->SleepCycles, 4);
+      Serialize(&Msg->Data[19], (uint32_t)(power->SleepCycles >> 32), 4);
+      Serialize(&Msg->Data[23], SystemCoreClock, 4);
+      Msg->Len = 27;
+      UART_SendMsg(Msg);
+      break;
+
+    case CMD_Set_Baud:
+      if (Msg->Len != 8U)
+      {
+        return 0;
+      }
+      baud = Deserialize(&Msg->Data[3], 4);
+      flow = Msg->Data[7];
+      status = LINK_BAUD_PENDING;
+      if ((baud == UsartBaudRate) && (flow == UsartRtsCts))
+      {
+        /* Nothing to change, or the host verifying the switch */
+        status = LINK_BAUD_OK;
+        BaudPending = 0;
+      }
+      else if ((baud < LINK_BAUD_MIN) || (baud > LINK_BAUD_MAX) || (flow > LINK_FLOW_RTSCTS))
+      {
+        status = LINK_BAUD_REFUSED;
+      }
+      else
+      {
+        /* Switched once the reply is out */
+      }
+
+      /* Reply: status (1) | baud (4) | flow (1) in use from now on */
+      BUILD_REPLY_HEADER(Msg);
+      Msg->Data[3] = status;
+      Serialize(&Msg->Data[4], (status == LINK_BAUD_PENDING) ? baud : UsartBaudRate, 4);
+      Msg->Data[8] = (status == LINK_BAUD_PENDING) ? flow : UsartRtsCts;
+      Msg->Len = 9;
+      UART_SendMsg(Msg);
+      if (status == LINK_BAUD_PENDING)
+      {
+        if (BaudPending == 0U)
+        {
+          BaudFallback = UsartBaudRate;
+          FlowFallback = UsartRtsCts;
+        }
+        BaudPending = 1;
+        BaudTick = HAL_GetTick();
+        UART_SetBaud(baud, flow);
+      }
+      break;
+
+    case CMD_Bulk_Start:
+      if (Msg->Len != 3U)
+      {
+        return 0;
+      }
+      /* The run in progress goes too, later records start with an anchor
+         and stay staged until the upload is done */
+      (void)Datalog_ActivityFlush();
+      Datalog_ActivityRestart();
+      Datalog_Pause(1);
+      BulkActive = 1;
+      BulkDest = Msg->Data[1];
+      BulkLogId = Datalog_LogId();
+      BulkTotal = Datalog_RecordCount() * FLASH_ITEM_SIZE;
+      BulkSeq = 0;
+      BulkCount = 0;
+      BulkTick = HAL_GetTick();
+
+      BUILD_REPLY_HEADER(Msg);
+      Serialize(&Msg->Data[3], BulkLogId, 4);
+      Serialize(&Msg->Data[7], BulkTotal, 4);
+      Serialize(&Msg->Data[11], BULK_BLOCK_LEN, 2);
+      Msg->Len = 13;
+      UART_SendMsg(Msg);
+      break;
+
+    case CMD_Bulk_Read:
+      if (Msg->Len != 12U)
+      {
+        return 0;
+      }
+      offset = Deserialize(&Msg->Data[7], 4);
+      offset -= offset % FLASH_ITEM_SIZE;
+      status = BULK_OK;
+      if ((BulkActive == 0U) || (Deserialize(&Msg->Data[3], 4) != BulkLogId))
+      {
+        status = BULK_STALE;
+      }
+      else if (BulkCount == BULK_RANGES)
+      {
+        status = BULK_BUSY;
+      }
+      else
+      {
+        /* Queued */
+      }
+      if (status != BULK_OK)
+      {
+        /* Refused: one block without data says why */
+        BulkUpload_Block(Msg, Msg->Data[1], BulkSeq, offset, status, 0, 0);
+        BulkSeq++;
+        UART_SendMsg(Msg);
+        break;
+      }
+      BulkTick = HAL_GetTick();
+      if (Msg->Data[11] != 0U)
+      {
+        i = (BulkHead + BulkCount) % BULK_RANGES;
+        BulkOffset[i] = offset;
+        BulkBlocks[i] = Msg->Data[11];
+        BulkCount++;
+      }
+      break;
+
+    case CMD_Bulk_Done:
+      if (Msg->Len != 11U)
+      {
+        return 0;
+      }
+      /* Drop what was uploaded, reply with a status (1) */
+      status = BULK_STALE;
+      if ((BulkActive != 0U) && (Deserialize(&Msg->Data[3], 4) == BulkLogId)
+          && (Deserialize(&Msg->Data[7], 4) == BulkTotal)
+          && (Datalog_Drop(BulkTotal / FLASH_ITEM_SIZE) != 0U))
+      {
+        status = BULK_OK;
+        BSP_LED_Off(LED2);
+      }
+      Bulk_End();
+      BUILD_REPLY_HEADER(Msg);
+      Msg->Data[3] = status;
+      Msg->Len = 4;
       UART_SendMsg(Msg);
       break;
 
@@ -288,26 +576,26 @@ int HandleMSG(TMsg *Msg)
       {
         return 0;
       }
-      addf = (Address2F - FLASH_ADDRESS);
+      /* The run in progress goes too */
+      (void)Datalog_ActivityFlush();
+      countb = Datalog_RecordCount();
+      addf = countb * sizeof(DataByte_t);
       Msg->Len = 4;
       Msg->Data[0] = (uint8_t)((addf >> 24) & 0xFFU);
       Msg->Data[1] = (uint8_t)((addf >> 16) & 0xFFU);
       Msg->Data[2] = (uint8_t)((addf >>  8) & 0xFFU);
       Msg->Data[3] = (uint8_t)((addf) & 0xFFU);
+      /* The upload is sent blocking, let the queued messages go first */
+      UART_TxFlush();
       (void)HAL_UART_Transmit(&UartHandle, (uint8_t *)Msg->Data, 4, 5000);
 
-      /* Read buffer from flash */
-      /* MISRA C-2012 rule 10.1r3 only seemingly violated */
-      for (addf = FLASH_ADDRESS; addf < Address2F; addf += ((uint32_t)DATA_TX_LEN * sizeof(DataByte_t)))
+      /* Read buffer from flash, oldest record first */
+      for (addf = 0; addf < countb; addf += (uint32_t)DATA_TX_LEN)
       {
-        Datalog_FillBuffer2BSent(addf, DATA_TX_LEN);
-        /* MISRA C-2012 rule 10.1r3 only seemingly violated */
-        (void)memcpy(&Msg->Data[0], DataByte, ((uint32_t)DATA_TX_LEN * sizeof(DataByte_t)));
-        /* MISRA C-2012 rule 10.1r3 only seemingly violated */
-        i = MIN((Address2F - FLASH_ADDRESS - countb), ((uint32_t)DATA_TX_LEN * sizeof(DataByte_t)));
         /* MISRA C-2012 rule 10.1r3 only seemingly violated */
-        countb += (uint32_t)DATA_TX_LEN * sizeof(DataByte_t);
-        (void)HAL_UART_Transmit(&UartHandle, (uint8_t *)DataByte, (uint16_t)i, 5000);
+        i = MIN((countb - addf), (uint32_t)DATA_TX_LEN);
+        Datalog_FillBuffer2BSent(addf, (uint8_t)i);
+        (void)HAL_UART_Transmit(&UartHandle, (uint8_t *)DataByte, (uint16_t)(i * sizeof(DataByte_t)), 5000);
         HAL_Delay(10);
       }
       (void)Datalog_FlashErase();
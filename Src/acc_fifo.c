@@ -0,0 +1,218 @@
+/**
+ ******************************************************************************
+ * @file    acc_fifo.c
+ * @brief   LSM6DSL accelerometer read through its FIFO: the sensor queues
+ *          samples at ACC_FIFO_ODR and raises INT1 at a watermark, the
+ *          firmware then reads the queue in one I2C burst instead of one
+ *          transaction per algorithm tick, and hands the samples out tick by
+ *          tick the way polling the output registers would have seen them.
+ *          The reads run on the I2C1 transfer queue, the main loop parses
+ *          the burst once the sequence ended.
+ ******************************************************************************
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "acc_fifo.h"
+
+/** @addtogroup MOTION_APPLICATIONS MOTION APPLICATIONS
+ * @{
+ */
+
+/** @addtogroup ACTIVITY_RECOGNITION_WRIST ACTIVITY RECOGNITION WRIST
+ * @{
+ */
+
+/* Private defines -----------------------------------------------------------*/
+#define ACC_FIFO_STATUS2_OVER_RUN   0x40U   /* FIFO_STATUS2: samples overwritten */
+#define ACC_FIFO_STATUS2_DIFF_HIGH  0x07U   /* FIFO_STATUS2: DIFF_FIFO[10:8] */
+#define ACC_FIFO_STATUS4_PATTERN    0x03U   /* FIFO_STATUS4: FIFO_PATTERN[9:8] */
+#define ACC_FIFO_INT1_FTH           0x08U   /* INT1_CTRL: FIFO threshold on INT1 */
+#define ACC_FIFO_SENSITIVITY_2G     0.061f  /* [mg/LSB] at +-2 g, doubling with the full scale */
+
+/* Private variables ---------------------------------------------------------*/
+/* One burst, plus the words of a partial sample skipped in front of it */
+static uint8_t Burst[(ACC_FIFO_BURST + 1U) * ACC_FIFO_WORDS * 2U];
+static uint8_t Status[4];
+static BSP_I2C1_Xfer_t StatusXfer;
+static BSP_I2C1_Xfer_t DataXfer;
+
+/* Private functions ---------------------------------------------------------*/
+/**
+ * @brief  Size the data read from the four status registers
+ * @param  Xfer the status read, its Context the FIFO state
+ * @retval None
+ * @details From the I2C1 interrupt, before the data read starts.
+ */
+static void AccFifo_StatusDone(BSP_I2C1_Xfer_t *Xfer)
+{
+  TAccFifo *fifo = (TAccFifo *)Xfer->Context;
+  uint32_t words;
+  uint32_t skip;
+  uint32_t n = 0;
+
+  words = (((uint32_t)Status[1] & ACC_FIFO_STATUS2_DIFF_HIGH) << 8) | Status[0];
+  if ((Xfer->Status == BSP_ERROR_NONE) && ((Status[1] & ACC_FIFO_STATUS2_OVER_RUN) != 0U))
+  {
+    /* Samples were lost, the ticks made from the rest run late from here */
+    fifo->Overruns++;
+  }
+
+  /* FIFO_PATTERN is the axis read next, a sample starts at 0 */
+  skip = (((uint32_t)Status[3] & ACC_FIFO_STATUS4_PATTERN) << 8) | Status[2];
+  skip = (skip != 0U) ? (ACC_FIFO_WORDS - (skip % ACC_FIFO_WORDS)) : 0U;
+  if ((Xfer->Status == BSP_ERROR_NONE) && (words >= skip + ACC_FIFO_WORDS))
+  {
+    n = (words - skip) / ACC_FIFO_WORDS;
+    if (n > ACC_FIFO_BURST)
+    {
+      n = ACC_FIFO_BURST;
+    }
+  }
+  fifo->Skip = (uint16_t)skip;
+  fifo->Reading = (uint16_t)n;
+  DataXfer.Len = (n != 0U) ? (uint16_t)((skip + (n * ACC_FIFO_WORDS)) * 2U) : 0U;
+}
+
+/* Exported functions ------------------------------------------------------- */
+/**
+ * @brief  Empty the FIFO and start queueing accelerometer samples
+ * @param  Fifo the FIFO state
+ * @param  Watermark samples queued before INT1 rises
+ * @param  TickFreq [Hz] rate AccFifo_Next hands the samples out at
+ * @retval None
+ * @details INT1 goes high at the watermark and low once the FIFO is read
+ *          below it; the EXTI line is expected on its rising edge.
+ */
+void AccFifo_Start(TAccFifo *Fifo, uint16_t Watermark, uint32_t TickFreq)
+{
+  int32_t fs = 4;
+
+  (void)IKS01A2_MOTION_SENSOR_GetFullScale(IKS01A2_LSM6DSL_0, MOTION_ACCELERO, &fs);
+  Fifo->Sensitivity = ACC_FIFO_SENSITIVITY_2G * (float)fs / 2.0f;
+  Fifo->Count = 0;
+  Fifo->Watermark = Watermark;
+  Fifo->TickFreq = TickFreq;
+  Fifo->Received = 0;
+  Fifo->Ticks = 0;
+
+  /* Bypass mode empties the FIFO, the first sample queued is the first tick's */
+  (void)IKS01A2_MOTION_SENSOR_FIFO_Set_Mode(IKS01A2_LSM6DSL_0, LSM6DSL_BYPASS_MODE);
+  (void)IKS01A2_MOTION_SENSOR_FIFO_Set_Decimation(IKS01A2_LSM6DSL_0, MOTION_ACCELERO, LSM6DSL_FIFO_XL_NO_DEC);
+  (void)IKS01A2_MOTION_SENSOR_FIFO_Set_ODR_Value(IKS01A2_LSM6DSL_0, (float)ACC_FIFO_ODR);
+  (void)IKS01A2_MOTION_SENSOR_FIFO_Set_Watermark_Level(IKS01A2_LSM6DSL_0, (uint16_t)(Watermark * ACC_FIFO_WORDS));
+  (void)IKS01A2_MOTION_SENSOR_Write_Register(IKS01A2_LSM6DSL_0, LSM6DSL_INT1_CTRL, ACC_FIFO_INT1_FTH);
+  (void)IKS01A2_MOTION_SENSOR_FIFO_Set_Mode(IKS01A2_LSM6DSL_0, LSM6DSL_STREAM_MODE);
+}
+
+/**
+ * @brief  Stop queueing, the output registers are polled again
+ * @param  Fifo the FIFO state
+ * @retval None
+ */
+void AccFifo_Stop(TAccFifo *Fifo)
+{
+  (void)IKS01A2_MOTION_SENSOR_Write_Register(IKS01A2_LSM6DSL_0, LSM6DSL_INT1_CTRL, 0U);
+  (void)IKS01A2_MOTION_SENSOR_FIFO_Set_Mode(IKS01A2_LSM6DSL_0, LSM6DSL_BYPASS_MODE);
+  Fifo->Count = 0;
+}
+
+/**
+ * @brief  Queue the read of the samples waiting, up to ACC_FIFO_BURST, on I2C1
+ * @param  Fifo the FIFO state
+ * @param  Then transfers run right after in the same sequence, NULL if none;
+ *         the last Done call of the sequence is where AccFifo_Parse can go
+ * @retval BSP status of BSP_I2C1_Submit
+ * @details Two transactions whatever the count: the four status registers,
+ *          then the data, sized from them. FIFO_DATA_OUT_H rolls back to
+ *          FIFO_DATA_OUT_L, so one burst from FIFO_DATA_OUT_L reads
+ *          consecutive words.
+ */
+int32_t AccFifo_Submit(TAccFifo *Fifo, BSP_I2C1_Xfer_t *Then)
+{
+  StatusXfer.DevAddr = LSM6DSL_I2C_ADD_H;
+  StatusXfer.Reg = LSM6DSL_FIFO_STATUS1;
+  StatusXfer.pData = Status;
+  StatusXfer.Len = (uint16_t)sizeof(Status);
+  StatusXfer.Write = 0;
+  StatusXfer.Done = AccFifo_StatusDone;
+  StatusXfer.Context = Fifo;
+  StatusXfer.Next = &DataXfer;
+
+  DataXfer.DevAddr = LSM6DSL_I2C_ADD_H;
+  DataXfer.Reg = LSM6DSL_FIFO_DATA_OUT_L;
+  DataXfer.pData = Burst;
+  DataXfer.Len = 0;
+  DataXfer.Write = 0;
+  DataXfer.Done = NULL;
+  DataXfer.Context = Fifo;
+  DataXfer.Next = Then;
+
+  Fifo->Reading = 0;
+  return BSP_I2C1_Submit(&StatusXfer);
+}
+
+/**
+ * @brief  Take the samples of the read queued by AccFifo_Submit
+ * @param  Fifo the FIFO state, Samples and Count are replaced
+ * @retval Samples read; ACC_FIFO_BURST means more may be waiting
+ */
+uint16_t AccFifo_Parse(TAccFifo *Fifo)
+{
+  uint32_t n = Fifo->Reading;
+  uint32_t i;
+  const uint8_t *raw;
+
+  Fifo->Count = 0;
+  if ((n == 0U) || (DataXfer.Status != BSP_ERROR_NONE))
+  {
+    return 0;
+  }
+  raw = &Burst[(uint32_t)Fifo->Skip * 2U];
+  for (i = 0; i < n; i++)
+  {
+    Fifo->Samples[i].x = (int32_t)((float)(int16_t)((uint16_t)raw[0] | ((uint16_t)raw[1] << 8)) * Fifo->Sensitivity);
+    Fifo->Samples[i].y = (int32_t)((float)(int16_t)((uint16_t)raw[2] | ((uint16_t)raw[3] << 8)) * Fifo->Sensitivity);
+    Fifo->Samples[i].z = (int32_t)((float)(int16_t)((uint16_t)raw[4] | ((uint16_t)raw[5] << 8)) * Fifo->Sensitivity);
+    raw = &raw[ACC_FIFO_WORDS * 2U];
+  }
+  Fifo->Count = (uint16_t)n;
+  Fifo->Received += n;
+  Fifo->Bursts++;
+  return (uint16_t)n;
+}
+
+/**
+ * @brief  Sample of the next algorithm tick
+ * @param  Fifo the FIFO state
+ * @param  Axes [mg] the newest sample at the tick's time, left as it is when
+ *         that sample came with the previous burst
+ * @retval 1 for a tick, 0 when the samples read do not reach it yet
+ * @details Sample i is taken (i + 1) / ACC_FIFO_ODR after the start and tick
+ *          k at k / TickFreq; a tick gets the newest sample at its time, what
+ *          reading the output registers at the tick would have returned.
+ */
+int AccFifo_Next(TAccFifo *Fifo, IKS01A2_MOTION_SENSOR_Axes_t *Axes)
+{
+  uint64_t due = ((Fifo->Ticks + 1U) * ACC_FIFO_ODR) / Fifo->TickFreq;
+  uint64_t first = Fifo->Received - Fifo->Count;
+
+  if (due > Fifo->Received)
+  {
+    return 0;
+  }
+  Fifo->Ticks++;
+  if (due > first)
+  {
+    *Axes = Fifo->Samples[due - 1U - first];
+  }
+  return 1;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
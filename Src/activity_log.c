@@ -0,0 +1,325 @@
+/**
+ ******************************************************************************
+ * @file    activity_log.c
+ * @brief   Activity run-length log: the nucleo turns the per-tick status
+ *          into runs of the same activity and packs them into double words
+ *          for the flash datalog, the host decodes them one word at a time
+ *          as they are uploaded. No dependencies, so it builds for the
+ *          firmware and for the host.
+ ******************************************************************************
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "activity_log.h"
+
+/** @addtogroup MOTION_APPLICATIONS MOTION APPLICATIONS
+ * @{
+ */
+
+/** @addtogroup ACTIVITY_RECOGNITION_WRIST ACTIVITY RECOGNITION WRIST
+ * @{
+ */
+
+/* Private defines -----------------------------------------------------------*/
+#define ACTLOG_ENTRY_MAX   7U   /* a full word but the tag */
+#define ACTLOG_ENTRY_MIN   2U   /* code, one byte length */
+
+/* Private functions ---------------------------------------------------------*/
+static uint32_t Varint_Put(uint8_t *Dest, uint32_t Value)
+{
+  uint32_t n = 0;
+
+  while (Value >= 0x80U)
+  {
+    Dest[n++] = (uint8_t)(Value | 0x80U);
+    Value >>= 7;
+  }
+  Dest[n++] = (uint8_t)Value;
+  return n;
+}
+
+static int Varint_Get(const uint8_t *Word, uint32_t *Pos, uint32_t MaxBytes, uint32_t *Value)
+{
+  uint32_t shift = 0;
+  uint32_t i;
+
+  *Value = 0;
+  for (i = 0; (i < MaxBytes) && (*Pos < ACTLOG_WORD_LEN); i++)
+  {
+    uint8_t b = Word[(*Pos)++];
+
+    *Value |= (uint32_t)(b & 0x7FU) << shift;
+    if ((b & 0x80U) == 0U)
+    {
+      return 1;
+    }
+    shift += 7U;
+  }
+  return 0;
+}
+
+/**
+ * @brief  Pad the word being filled and hand it out
+ * @param  Log the encoder
+ * @param  Out where the word goes
+ * @retval Bytes output, 0 or ACTLOG_WORD_LEN
+ */
+static uint32_t Word_Flush(TActivityLog *Log, uint8_t *Out)
+{
+  if (Log->Used == 0U)
+  {
+    return 0;
+  }
+  (void)memset(&Log->Word[Log->Used], 0, ACTLOG_WORD_LEN - Log->Used);
+  (void)memcpy(Out, Log->Word, ACTLOG_WORD_LEN);
+  Log->Used = 0;
+  return ACTLOG_WORD_LEN;
+}
+
+/**
+ * @brief  Append one entry, words are handed out as soon as no entry fits
+ * @param  Log the encoder
+ * @param  Code entry code, ACTLOG_GAP is set here when Gap is not 0
+ * @param  Gap [ticks] since the end of the previous entry
+ * @param  Length [ticks], at most ACTLOG_VARINT_MAX
+ * @param  Out where the completed words go
+ * @retval Bytes output
+ */
+static uint32_t Entry_Put(TActivityLog *Log, uint8_t Code, uint32_t Gap, uint32_t Length, uint8_t *Out)
+{
+  uint8_t entry[ACTLOG_ENTRY_MAX + 2U];
+  uint32_t len = 0;
+  uint32_t n = 0;
+
+  entry[len++] = Code;
+  if (Gap != 0U)
+  {
+    entry[0] |= (uint8_t)ACTLOG_GAP;
+    len += Varint_Put(&entry[len], Gap);
+  }
+  len += Varint_Put(&entry[len], Length);
+
+  if ((Log->Used + len) > ACTLOG_WORD_LEN)
+  {
+    n += Word_Flush(Log, Out);
+  }
+  if (Log->Used == 0U)
+  {
+    Log->Word[0] = (uint8_t)ACTLOG_TAG_RUNS;
+    Log->Used = 1;
+  }
+  (void)memcpy(&Log->Word[Log->Used], entry, len);
+  Log->Used += (uint8_t)len;
+  Log->Word[0]++;
+
+  if ((Log->Used + ACTLOG_ENTRY_MIN) > ACTLOG_WORD_LEN)
+  {
+    n += Word_Flush(Log, &Out[n]);
+  }
+  return n;
+}
+
+/**
+ * @brief  Append an entry starting at a given tick, preceded by an idle
+ *         entry when the gap does not fit in 3 varint bytes
+ * @param  Log the encoder
+ * @param  Code entry code
+ * @param  Start [ticks] start of the entry
+ * @param  Length [ticks], at most ACTLOG_VARINT_MAX
+ * @param  Out where the completed words go
+ * @retval Bytes output
+ */
+static uint32_t Entry_PutAt(TActivityLog *Log, uint8_t Code, uint32_t Start, uint32_t Length, uint8_t *Out)
+{
+  uint32_t gap = Start - Log->End;
+  uint32_t n = 0;
+
+  if (gap > ACTLOG_VARINT_MAX)
+  {
+    n += Entry_Put(Log, (uint8_t)ACTLOG_CODE_IDLE, gap, 0, Out);
+    gap = 0;
+  }
+  n += Entry_Put(Log, Code, gap, Length, &Out[n]);
+  Log->End = Start + Length;
+  return n;
+}
+
+/**
+ * @brief  Write the open run
+ * @param  Log the encoder
+ * @param  Out where the completed words go
+ * @retval Bytes output
+ */
+static uint32_t Run_Close(TActivityLog *Log, uint8_t *Out)
+{
+  if (Log->Open == 0U)
+  {
+    return 0;
+  }
+  Log->Open = 0;
+  return Entry_PutAt(Log, Log->Code, Log->Start, Log->Next - Log->Start, Out);
+}
+
+/* Exported functions ------------------------------------------------------- */
+/**
+ * @brief  Reset the encoder, runs only have a date after the first anchor
+ * @param  Log the encoder
+ * @retval None
+ */
+void ActivityLog_Init(TActivityLog *Log)
+{
+  (void)memset(Log, 0, sizeof(*Log));
+}
+
+/**
+ * @brief  Log the status of one or more ticks
+ * @param  Log the encoder
+ * @param  Tick [ticks] since boot, the first the status covers
+ * @param  Ticks ticks the status covers, more than 1 at a reduced rate
+ * @param  Code ACTLOG_CODE() of the status
+ * @param  TurnOver 1 if a turn over happened since the previous status
+ * @param  Out at least ACTLOG_OUT_MAX bytes, receives the completed words
+ * @retval Bytes output, a multiple of ACTLOG_WORD_LEN
+ * @details A run goes on while the code stays the same on consecutive
+ *          ticks; a turn over, a missed tick or ACTLOG_VARINT_MAX ticks
+ *          close it.
+ */
+uint32_t ActivityLog_Add(TActivityLog *Log, uint32_t Tick, uint32_t Ticks, uint8_t Code, uint8_t TurnOver,
+                         uint8_t *Out)
+{
+  uint32_t n = 0;
+
+  if ((Log->Open != 0U) && ((Code != Log->Code) || (Tick != Log->Next) || (TurnOver != 0U)
+                            || (((Log->Next - Log->Start) + Ticks) > ACTLOG_VARINT_MAX)))
+  {
+    n += Run_Close(Log, Out);
+  }
+  if (TurnOver != 0U)
+  {
+    n += Entry_PutAt(Log, Code, Tick, 0, &Out[n]);
+  }
+  if (Log->Open == 0U)
+  {
+    Log->Open = 1;
+    Log->Code = Code;
+    Log->Start = Tick;
+  }
+  Log->Next = Tick + Ticks;
+  return n;
+}
+
+/**
+ * @brief  Close the open run and hand out the word being filled
+ * @param  Log the encoder
+ * @param  Out at least ACTLOG_OUT_MAX bytes, receives the completed words
+ * @retval Bytes output, a multiple of ACTLOG_WORD_LEN
+ */
+uint32_t ActivityLog_Flush(TActivityLog *Log, uint8_t *Out)
+{
+  uint32_t n = Run_Close(Log, Out);
+
+  return n + Word_Flush(Log, &Out[n]);
+}
+
+/**
+ * @brief  Flush, then start a new time base
+ * @param  Log the encoder
+ * @param  Tick [ticks] since boot matching DateTime
+ * @param  DateTime Year (from 2000), Month, Day, Hours, Minutes, Seconds
+ * @param  TickHz ticks per second
+ * @param  Out at least ACTLOG_OUT_MAX bytes, receives the completed words
+ * @retval Bytes output, a multiple of ACTLOG_WORD_LEN
+ */
+uint32_t ActivityLog_Anchor(TActivityLog *Log, uint32_t Tick, const uint8_t *DateTime, uint8_t TickHz,
+                            uint8_t *Out)
+{
+  uint32_t n = ActivityLog_Flush(Log, Out);
+
+  Out[n] = (uint8_t)ACTLOG_TAG_ANCHOR;
+  (void)memcpy(&Out[n + 1U], DateTime, 6);
+  Out[n + 7U] = TickHz;
+  Log->End = Tick;
+  return n + ACTLOG_WORD_LEN;
+}
+
+/**
+ * @brief  Reset the decoder
+ * @param  Decoder the decoder
+ * @retval None
+ */
+void ActivityLog_DecoderInit(TActivityDecoder *Decoder)
+{
+  (void)memset(Decoder, 0, sizeof(*Decoder));
+}
+
+/**
+ * @brief  Decode one word
+ * @param  Decoder the decoder
+ * @param  Word ACTLOG_WORD_LEN bytes
+ * @param  Runs receives up to ACTLOG_RUNS_MAX runs, idle entries are skipped
+ * @retval Number of runs, -1 if the word is not a log word
+ */
+int ActivityLog_Decode(TActivityDecoder *Decoder, const uint8_t *Word, TActivityRun *Runs)
+{
+  uint32_t count = (uint32_t)Word[0] & ~ACTLOG_TAG_MASK;
+  uint32_t pos = 1;
+  uint32_t gap;
+  uint32_t length;
+  uint32_t i;
+  int n = 0;
+
+  if (Word[0] == (uint8_t)ACTLOG_TAG_ANCHOR)
+  {
+    if (Word[7] == 0U)
+    {
+      return -1;
+    }
+    (void)memcpy(Decoder->DateTime, &Word[1], sizeof(Decoder->DateTime));
+    Decoder->TickHz = Word[7];
+    Decoder->Tick = 0;
+    Decoder->Anchored = 1;
+    return 0;
+  }
+  if (((Word[0] & ACTLOG_TAG_MASK) != ACTLOG_TAG_RUNS) || (count == 0U) || (count > ACTLOG_RUNS_MAX))
+  {
+    return -1;
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    uint8_t code;
+
+    if (pos >= ACTLOG_WORD_LEN)
+    {
+      return -1;
+    }
+    code = Word[pos++];
+    gap = 0;
+    if ((((code & ACTLOG_GAP) != 0U)
+         && (Varint_Get(Word, &pos, ((code & ~ACTLOG_GAP) == ACTLOG_CODE_IDLE) ? 5U : 3U, &gap) == 0))
+        || (Varint_Get(Word, &pos, 3U, &length) == 0))
+    {
+      return -1;
+    }
+    code &= (uint8_t)~ACTLOG_GAP;
+    Decoder->Tick += gap;
+    if (code != (uint8_t)ACTLOG_CODE_IDLE)
+    {
+      Runs[n].Start = Decoder->Tick;
+      Runs[n].Length = length;
+      Runs[n].Code = code;
+      n++;
+    }
+    Decoder->Tick += length;
+  }
+  return n;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
@@ -0,0 +1,110 @@
+/**
+ ******************************************************************************
+ * @file    bulk_upload.c
+ * @brief   Bulk datalog upload: the nucleo sends the flash log as blocks
+ *          with a sequence number and a CRC-32, the host asks for windows of
+ *          blocks and again for the ones lost or damaged. Only depends on
+ *          serial_protocol.c so it builds for the firmware and for the host.
+ ******************************************************************************
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stddef.h>
+#include "bulk_upload.h"
+
+/** @addtogroup MOTION_APPLICATIONS MOTION APPLICATIONS
+ * @{
+ */
+
+/** @addtogroup ACTIVITY_RECOGNITION_WRIST ACTIVITY RECOGNITION WRIST
+ * @{
+ */
+
+/* Private defines -----------------------------------------------------------*/
+#define BULK_UPLOAD_SRC  50U    /* DEV_ADDR of the nucleo */
+
+/* Exported functions ------------------------------------------------------- */
+/**
+ * @brief  CRC-32 as zlib computes it, what the CRC peripheral gives with
+ *         bytes and output reversed and the result inverted
+ * @param  Crc 0 to start, or the CRC of the bytes before
+ * @param  Data the bytes
+ * @param  Len number of bytes
+ * @retval CRC
+ */
+uint32_t BulkUpload_Crc32(uint32_t Crc, const uint8_t *Data, uint32_t Len)
+{
+  /* One nibble at a time, reflected polynomial 0xEDB88320 */
+  static const uint32_t nibble[16] =
+  {
+    0x00000000U, 0x1DB71064U, 0x3B6E20C8U, 0x26D930ACU, 0x76DC4190U, 0x6B6B51F4U, 0x4DB26158U, 0x5005713CU,
+    0xEDB88320U, 0xF00F9344U, 0xD6D6A3E8U, 0xCB61B38CU, 0x9B64C2B0U, 0x86D3D2D4U, 0xA00AE278U, 0xBDBDF21CU
+  };
+  uint32_t crc = ~Crc;
+  uint32_t i;
+
+  for (i = 0; i < Len; i++)
+  {
+    crc ^= Data[i];
+    crc = (crc >> 4) ^ nibble[crc & 0x0FU];
+    crc = (crc >> 4) ^ nibble[crc & 0x0FU];
+  }
+  return ~crc;
+}
+
+/**
+ * @brief  Fill in the header of a block whose data is already in place
+ * @param  Msg the message, Len bytes of data at Data[BULK_HEADER_LEN]
+ * @param  Dest address the block is sent to
+ * @param  Seq CMD_Bulk_Data sent so far in the session
+ * @param  Offset [bytes] of the data in the log
+ * @param  Status BULK_xx
+ * @param  Len bytes of data, at most BULK_BLOCK_LEN
+ * @param  Crc CRC-32 of the data
+ * @retval None
+ */
+void BulkUpload_Block(TMsg *Msg, uint8_t Dest, uint16_t Seq, uint32_t Offset, uint8_t Status, uint32_t Len,
+                      uint32_t Crc)
+{
+  Msg->Data[0] = Dest;
+  Msg->Data[1] = BULK_UPLOAD_SRC;
+  Msg->Data[2] = CMD_Bulk_Data;
+  Serialize(&Msg->Data[3], Seq, 2);
+  Serialize(&Msg->Data[5], Offset, 4);
+  Msg->Data[9] = Status;
+  Serialize(&Msg->Data[10], Crc, 4);
+  Msg->Len = BULK_HEADER_LEN + Len;
+}
+
+/**
+ * @brief  Decode a block whose checksum was already removed
+ * @param  Msg the received message
+ * @param  Block the decoded block, Data points into Msg
+ * @retval 1 if valid, -1 if the data does not match its CRC, 0 if the
+ *         message is not a block
+ */
+int BulkUpload_Parse(const TMsg *Msg, TBulkBlock *Block)
+{
+  /* MISRA C-2012 rule 11.8 violation for purpose */
+  uint8_t *p = (uint8_t *)Msg->Data;
+
+  if ((Msg->Len < BULK_HEADER_LEN) || (Msg->Len > (BULK_HEADER_LEN + BULK_BLOCK_LEN))
+      || (Msg->Data[2] != (uint8_t)CMD_Bulk_Data))
+  {
+    return 0;
+  }
+  Block->Seq    = (uint16_t)Deserialize(&p[3], 2);
+  Block->Offset = Deserialize(&p[5], 4);
+  Block->Status = p[9];
+  Block->Len    = Msg->Len - BULK_HEADER_LEN;
+  Block->Data   = &Msg->Data[BULK_HEADER_LEN];
+  return (BulkUpload_Crc32(0, Block->Data, Block->Len) == Deserialize(&p[10], 4)) ? 1 : -1;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
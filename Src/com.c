@@ -19,6 +19,7 @@
  */
 
 /* Includes ------------------------------------------------------------------*/
+#include <string.h>
 #include "cube_hal.h"
 #include "com.h"
 
@@ -31,102 +32,312 @@
  */
 
 /* Private types -------------------------------------------------------------*/
+/* Receive decoder states */
+#define UART_RX_INPLACE   0U  /* no escape so far, the frame is read in place from the ring */
+#define UART_RX_COPY      1U  /* an escape was seen, the frame is unstuffed into RxFrame */
+#define UART_RX_ESCAPE    2U  /* last byte was TMsg_BS */
+#define UART_RX_SKIP      3U  /* bad or too long frame, wait for the next TMsg_EOF */
+
 /* Private defines -----------------------------------------------------------*/
-#define Uart_Msg_Max_Size TMsg_MaxLen
+#define UART_TX_MASK      ((uint16_t)(UART_TxRingSize - 1U))
+#define UART_IRQ_PRIORITY 0x0EU /* above TIM_ALGO, so a long algorithm run does not stall the queue */
 
 /* Private macro -------------------------------------------------------------*/
 /* Exported variables --------------------------------------------------------*/
 volatile uint8_t UartRxBuffer[UART_RxBufferSize];
 volatile uint32_t UsartBaudRate = 115200;
+volatile uint8_t UsartRtsCts = 0;       /* RTS/CTS flow control on */
 
 extern UART_HandleTypeDef UartHandle; /* This "redundant" line is here to fulfil MISRA C-2012 rule 8.4 */
 UART_HandleTypeDef UartHandle;
 TUart_Engine UartEngine;
+volatile uint16_t UartTxHighWater = 0; /* most bytes ever waiting in the transmit queue */
+volatile uint32_t UartTxOverruns = 0;  /* messages dropped because the queue was full */
+volatile uint32_t UartTxErrors = 0;    /* transfers ended by an error, their bytes dropped */
 
 /* Private variables ---------------------------------------------------------*/
 static DMA_HandleTypeDef HdmaRx;
+static DMA_HandleTypeDef HdmaTx;
 static volatile uint8_t UartTxBuffer[TMsg_MaxLen * 2];
+static uint8_t RxFrame[TMsg_MaxLen]; /* frames that needed unstuffing or wrap around the ring */
+
+/* Transmit queue: the main loop appends at TxHead, the DMA drains from TxTail.
+   Both indexes run freely and are masked on access, so TxHead - TxTail is the
+   number of queued bytes. TxInFlight is the length handed to the DMA, 0 when
+   it is idle. */
+static uint8_t UartTxRing[UART_TxRingSize];
+static volatile uint16_t TxHead = 0;
+static volatile uint16_t TxTail = 0;
+static volatile uint16_t TxInFlight = 0;
 
 /* Private function prototypes -----------------------------------------------*/
+static void UART_TxStart(void);
+static void UART_RxStart(void);
+
 /* Private functions ---------------------------------------------------------*/
 /**
- * @brief  Check if a message is received via UART
- * @param  Msg the pointer to the message to be received
+ * @brief  Hand the oldest contiguous run of queued bytes to the DMA if it is idle
+ * @note   Called with interrupts masked or from the transfer complete interrupt
+ * @param  None
+ * @retval None
+ */
+static void UART_TxStart(void)
+{
+  uint16_t queued = (uint16_t)(TxHead - TxTail);
+  uint16_t offset = (uint16_t)(TxTail & UART_TX_MASK);
+  uint16_t len;
+
+  if ((TxInFlight != 0U) || (queued == 0U))
+  {
+    return;
+  }
+
+  /* Stop at the end of the ring, the rest goes with the next transfer */
+  len = (uint16_t)(UART_TxRingSize - offset);
+  if (queued < len)
+  {
+    len = queued;
+  }
+  TxInFlight = len;
+  if (HAL_UART_Transmit_DMA(&UartHandle, &UartTxRing[offset], len) != HAL_OK)
+  {
+    /* A blocking transfer owns the UART, retry on the next enqueue */
+    TxInFlight = 0;
+  }
+}
+
+/**
+ * @brief  Start the circular reception; the line going idle after the bytes
+ *         of a message raises the USART interrupt, which wakes the main loop
+ * @param  None
+ * @retval None
+ */
+static void UART_RxStart(void)
+{
+  /* MISRA C-2012 rule 11.8 violation for purpose */
+  (void)HAL_UART_Receive_DMA(&UartHandle, (uint8_t *)UartRxBuffer, UART_RxBufferSize);
+  __HAL_UART_ENABLE_IT(&UartHandle, UART_IT_IDLE);
+}
+
+/**
+ * @brief  Start decoding a new frame
+ * @param  Pos ring index of its first byte
+ * @retval None
+ */
+static void UART_RxRestart(uint16_t Pos)
+{
+  UartEngine.StartOfMsg = Pos;
+  UartEngine.Pos = Pos;
+  UartEngine.Len = 0;
+  UartEngine.Chk = 0;
+  UartEngine.State = UART_RX_INPLACE;
+}
+
+/**
+ * @brief  Copy bytes out of the DMA ring
+ * @param  Dest destination
+ * @param  Start ring index of the first byte
+ * @param  Len number of bytes
+ * @retval None
+ */
+static void UART_RxCopyRing(uint8_t *Dest, uint16_t Start, uint16_t Len)
+{
+  uint16_t first = (uint16_t)UART_RxBufferSize - Start;
+
+  if (Len < first)
+  {
+    first = Len;
+  }
+  /* MISRA C-2012 rule 11.8 violation for purpose */
+  (void)memcpy(Dest, (uint8_t *)&UartRxBuffer[Start], first);
+  /* MISRA C-2012 rule 11.8 violation for purpose */
+  (void)memcpy(&Dest[first], (uint8_t *)&UartRxBuffer[0], (size_t)Len - first);
+}
+
+/**
+ * @brief  Decode the bytes the DMA wrote since the last call, each one once
+ * @note   A frame without escapes is handed out in place: View->Data points
+ *         into UartRxBuffer and stays valid until the DMA comes round to it
+ *         again, so it must be consumed before polling again
+ * @param  View the received message
  * @retval 1 if a complete message is found, 0 otherwise
  */
-int UART_ReceivedMSG(TMsg *Msg)
+int UART_ReceivedView(TMsgView *View)
 {
-  uint16_t i, j, k, j2;
-  uint16_t dma_counter, length;
+  uint16_t pos = UartEngine.Pos;
+  uint16_t end;
   uint8_t data;
-  uint16_t source = 0;
-  uint8_t inc;
 
-  if (Get_DMA_Flag_Status(&HdmaRx) == (uint32_t)RESET)
+  if (Get_DMA_Flag_Status(&HdmaRx) != (uint32_t)RESET)
+  {
+    return 0;
+  }
+  end = (uint16_t)UART_RxBufferSize - (uint16_t)Get_DMA_Counter(&HdmaRx);
+  if (end >= (uint16_t)UART_RxBufferSize)
   {
-    dma_counter = (uint16_t)UART_RxBufferSize - (uint16_t)Get_DMA_Counter(&HdmaRx);
+    end = 0;
+  }
 
-    if (dma_counter >= UartEngine.StartOfMsg)
-    {
-      length = dma_counter - UartEngine.StartOfMsg;
-    }
-    else
+  while (pos != end)
+  {
+    if (UartEngine.State == UART_RX_INPLACE)
     {
-      length = (uint16_t)UART_RxBufferSize + dma_counter - UartEngine.StartOfMsg;
+      /* Literal run: only the checksum to update, stop at TMsg_EOF/TMsg_BS,
+         the end of the received bytes, the end of the ring or TMsg_MaxLen */
+      /* MISRA C-2012 rule 11.8 violation for purpose */
+      const uint8_t *ring = (const uint8_t *)UartRxBuffer;
+      uint16_t stop = (end > pos) ? end : (uint16_t)UART_RxBufferSize;
+      uint16_t start = pos;
+      uint8_t chk = UartEngine.Chk;
+
+      if ((uint32_t)(stop - pos) > ((uint32_t)TMsg_MaxLen - UartEngine.Len))
+      {
+        stop = pos + (uint16_t)TMsg_MaxLen - UartEngine.Len;
+      }
+      while ((pos < stop) && ((ring[pos] & 0xFEU) != (uint8_t)TMsg_EOF))
+      {
+        chk += ring[pos];
+        pos++;
+      }
+      UartEngine.Chk = chk;
+      UartEngine.Len += pos - start;
+      if (pos == (uint16_t)UART_RxBufferSize)
+      {
+        pos = 0;
+        continue;
+      }
+      if (pos == end)
+      {
+        continue;
+      }
+      /* The byte at pos is TMsg_EOF, TMsg_BS or one too many */
     }
-    j = UartEngine.StartOfMsg;
 
-    for (k = 0; k < length; k++)
+    data = UartRxBuffer[pos];
+    pos = (pos == ((uint16_t)UART_RxBufferSize - 1U)) ? 0U : (pos + 1U);
+
+    if (data == (uint8_t)TMsg_EOF)
     {
-      data = UartRxBuffer[j];
-      j++;
-      if (j >= (uint16_t)UART_RxBufferSize)
-      {
-        j = 0;
-      }
-      if (data == (uint8_t)TMsg_EOF)
+      if (((UartEngine.State == UART_RX_INPLACE) || (UartEngine.State == UART_RX_COPY))
+          && (UartEngine.Len != 0U) && (UartEngine.Chk == 0U))
       {
-        j = UartEngine.StartOfMsg;
-        for (i = 0; i < k; i += inc)
+        View->Len = (uint32_t)UartEngine.Len - 1U; /* drop the checksum */
+        if (UartEngine.State == UART_RX_COPY)
         {
-          uint8_t  Source0;
-          uint8_t  Source1;
-          uint8_t *Dest;
-
-          j2 = (j + 1U) % (uint16_t)UART_RxBufferSize;
-
-          Source0 = UartRxBuffer[j];
-          Source1 = UartRxBuffer[j2];
-          Dest    = &Msg->Data[source];
-
-          inc = (uint8_t)ReverseByteStuffCopyByte2(Source0, Source1, Dest);
-          if (inc == 0U)
-          {
-            UartEngine.StartOfMsg = j2;
-            return 0;
-          }
-          j = (j + inc) % (uint16_t)UART_RxBufferSize;
-          source++;
+          View->Data = RxFrame;
         }
-        Msg->Len = source;
-        j = (j + 1U) % (uint16_t)UART_RxBufferSize; /* skip TMsg_EOF */
-        UartEngine.StartOfMsg = j;
-        if (CHK_CheckAndRemove(Msg) != 0) /* check message integrity */
+        else if (((uint32_t)UartEngine.StartOfMsg + UartEngine.Len) <= (uint32_t)UART_RxBufferSize)
         {
-          return 1;
+          /* MISRA C-2012 rule 11.8 violation for purpose */
+          View->Data = (uint8_t *)&UartRxBuffer[UartEngine.StartOfMsg];
         }
+        else
+        {
+          /* Wraps around the end of the ring */
+          UART_RxCopyRing(RxFrame, UartEngine.StartOfMsg, UartEngine.Len);
+          View->Data = RxFrame;
+        }
+        UART_RxRestart(pos);
+        return 1;
       }
+      UART_RxRestart(pos);
+      continue;
+    }
+
+    switch (UartEngine.State)
+    {
+      case UART_RX_INPLACE:
+        if (data == (uint8_t)TMsg_BS)
+        {
+          /* First escape: from here on the frame is unstuffed aside */
+          UART_RxCopyRing(RxFrame, UartEngine.StartOfMsg, UartEngine.Len);
+          UartEngine.State = UART_RX_ESCAPE;
+          continue;
+        }
+        break;
+
+      case UART_RX_COPY:
+        if (data == (uint8_t)TMsg_BS)
+        {
+          UartEngine.State = UART_RX_ESCAPE;
+          continue;
+        }
+        break;
+
+      case UART_RX_ESCAPE:
+        if (data == (uint8_t)TMsg_BS_EOF)
+        {
+          data = TMsg_EOF;
+        }
+        else if (data != (uint8_t)TMsg_BS)
+        {
+          UartEngine.State = UART_RX_SKIP; /* invalid sequence */
+          continue;
+        }
+        else
+        {
+          /* TMsg_BS TMsg_BS stands for TMsg_BS */
+        }
+        UartEngine.State = UART_RX_COPY;
+        break;
+
+      default:
+        continue;
+    }
+
+    if (UartEngine.Len >= (uint16_t)TMsg_MaxLen)
+    {
+      UartEngine.State = UART_RX_SKIP;
+      continue;
     }
-    if (length > (uint16_t)Uart_Msg_Max_Size)
+    if (UartEngine.State == UART_RX_COPY)
     {
-      UartEngine.StartOfMsg = dma_counter;
+      RxFrame[UartEngine.Len] = data;
     }
+    UartEngine.Len++;
+    UartEngine.Chk += data;
   }
+
+  UartEngine.Pos = pos;
   return 0;
 }
 
 /**
- * @brief  Send a message via UART
+ * @brief  Check for received bytes UART_ReceivedView has not decoded yet
+ * @param  None
+ * @retval 1 if there are, 0 otherwise
+ */
+int UART_RxPending(void)
+{
+  uint16_t end = (uint16_t)UART_RxBufferSize - (uint16_t)Get_DMA_Counter(&HdmaRx);
+
+  if (end >= (uint16_t)UART_RxBufferSize)
+  {
+    end = 0;
+  }
+  return (end != UartEngine.Pos) ? 1 : 0;
+}
+
+/**
+ * @brief  Check if a message is received via UART
+ * @param  Msg the pointer to the message to be received
+ * @retval 1 if a complete message is found, 0 otherwise
+ */
+int UART_ReceivedMSG(TMsg *Msg)
+{
+  TMsgView view;
+
+  if (UART_ReceivedView(&view) == 0)
+  {
+    return 0;
+  }
+  (void)memcpy(Msg->Data, view.Data, view.Len);
+  Msg->Len = view.Len;
+  return 1;
+}
+
+/**
+ * @brief  Send a message via UART, without waiting for it to go out
  * @param  Msg the pointer to the message to be sent
  * @retval None
  */
@@ -140,7 +351,170 @@ void UART_SendMsg(TMsg *Msg)
   count_out = (uint16_t)ByteStuffCopy((uint8_t *)UartTxBuffer, Msg);
 
   /* MISRA C-2012 rule 11.8 violation for purpose */
-  (void)HAL_UART_Transmit(&UartHandle, (uint8_t *)UartTxBuffer, count_out, 5000);
+  (void)UART_TxEnqueue((uint8_t *)UartTxBuffer, count_out);
+}
+
+/**
+ * @brief  Queue bytes for transmission, never blocks
+ * @param  Data the bytes to be sent
+ * @param  Len number of bytes
+ * @retval 1 if queued, 0 if the queue had no room and the bytes were dropped
+ */
+int UART_TxEnqueue(const uint8_t *Data, uint16_t Len)
+{
+  uint16_t queued = (uint16_t)(TxHead - TxTail);
+  uint16_t offset = (uint16_t)(TxHead & UART_TX_MASK);
+  uint16_t first;
+  uint32_t primask;
+
+  /* All or nothing: a partial message would only make the receiver resync */
+  if (Len > (uint16_t)(UART_TxRingSize - queued))
+  {
+    UartTxOverruns++;
+    return 0;
+  }
+
+  first = (uint16_t)(UART_TxRingSize - offset);
+  if (Len < first)
+  {
+    first = Len;
+  }
+  (void)memcpy(&UartTxRing[offset], Data, first);
+  (void)memcpy(&UartTxRing[0], &Data[first], (size_t)Len - first);
+
+  queued += Len;
+  if (queued > UartTxHighWater)
+  {
+    UartTxHighWater = queued;
+  }
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  TxHead += Len;
+  UART_TxStart();
+  __set_PRIMASK(primask);
+  return 1;
+}
+
+/**
+ * @brief  Room left in the transmit queue
+ * @param  None
+ * @retval Number of bytes UART_TxEnqueue takes now
+ */
+uint16_t UART_TxRoom(void)
+{
+  return (uint16_t)(UART_TxRingSize - (uint16_t)(TxHead - TxTail));
+}
+
+/**
+ * @brief  Wait until the transmit queue is empty, before a blocking transfer
+ * @param  None
+ * @retval None
+ */
+void UART_TxFlush(void)
+{
+  uint32_t primask;
+
+  while (TxHead != TxTail)
+  {
+    primask = __get_PRIMASK();
+    __disable_irq();
+    UART_TxStart();
+    __set_PRIMASK(primask);
+    HAL_Delay(1);
+  }
+}
+
+/**
+ * @brief  Change the rate and flow control of the link
+ * @param  Baud rate
+ * @param  RtsCts 1 for RTS/CTS flow control, 0 for none
+ * @retval None
+ * @details The queued messages go out at the old rate first. Bytes received
+ *          meanwhile are dropped with the receive ring, the decoder starts
+ *          on a fresh frame.
+ */
+void UART_SetBaud(uint32_t Baud, uint8_t RtsCts)
+{
+  GPIO_InitTypeDef gpio_init_struct;
+
+  UART_TxFlush();
+  (void)HAL_UART_AbortReceive(&UartHandle);
+
+  if (RtsCts != 0U)
+  {
+    USARTx_FLOW_GPIO_CLK_ENABLE();
+    gpio_init_struct.Pin       = USARTx_RTS_PIN | USARTx_CTS_PIN;
+    gpio_init_struct.Mode      = GPIO_MODE_AF_PP;
+    gpio_init_struct.Pull      = GPIO_NOPULL;
+    gpio_init_struct.Speed     = GPIO_SPEED_FREQ_HIGH;
+    gpio_init_struct.Alternate = USARTx_FLOW_AF;
+    HAL_GPIO_Init(USARTx_FLOW_GPIO_PORT, &gpio_init_struct);
+  }
+  else if (UsartRtsCts != 0U)
+  {
+    HAL_GPIO_DeInit(USARTx_FLOW_GPIO_PORT, USARTx_RTS_PIN | USARTx_CTS_PIN);
+  }
+  else
+  {
+    /* Pins never used */
+  }
+
+  UsartBaudRate = Baud;
+  UsartRtsCts = RtsCts;
+  UartHandle.Init.BaudRate  = Baud;
+  UartHandle.Init.HwFlowCtl = (RtsCts != 0U) ? UART_HWCONTROL_RTS_CTS : UART_HWCONTROL_NONE;
+  if (HAL_UART_Init(&UartHandle) != HAL_OK)
+  {
+    for (;;)
+    {}
+  }
+
+  UART_RxRestart(0);
+  UART_RxStart();
+}
+
+/**
+ * @brief  Transfer complete: drop the bytes just sent and start on the next ones
+ * @param  huart UART handle
+ * @retval None
+ */
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+  if (huart == &UartHandle)
+  {
+    TxTail += TxInFlight;
+    TxInFlight = 0;
+    UART_TxStart();
+  }
+}
+
+/**
+ * @brief  UART error: restart whichever side the HAL aborted. A transmit
+ *         ended by a DMA error never completes, its bytes are dropped and
+ *         the queue goes on with the next ones, the receiver resyncs on the
+ *         next TMsg_EOF; the HAL aborts the circular reception on receive
+ *         errors now that the USART interrupt is enabled
+ * @param  huart UART handle
+ * @retval None
+ */
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+  if (huart == &UartHandle)
+  {
+    if ((TxInFlight != 0U) && (huart->gState != HAL_UART_STATE_BUSY_TX))
+    {
+      TxTail += TxInFlight;
+      TxInFlight = 0;
+      UartTxErrors++;
+      UART_TxStart();
+    }
+    if (huart->RxState != HAL_UART_STATE_BUSY_RX)
+    {
+      UART_RxRestart(0);
+      UART_RxStart();
+    }
+  }
 }
 
 /**
@@ -156,6 +530,16 @@ void USART_DMA_Configuration(void)
 
   /* Associate the initialized DMA handle to the the UART handle */
   __HAL_LINKDMA(&UartHandle, hdmarx, HdmaRx);
+
+  /* Same for transmission, completion is signalled by the DMA and USART interrupts */
+  Config_DMA_TxHandler(&HdmaTx);
+  (void)HAL_DMA_Init(&HdmaTx);
+  __HAL_LINKDMA(&UartHandle, hdmatx, HdmaTx);
+
+  HAL_NVIC_SetPriority(USARTx_DMA_TX_IRQn, UART_IRQ_PRIORITY, 0);
+  HAL_NVIC_EnableIRQ(USARTx_DMA_TX_IRQn);
+  HAL_NVIC_SetPriority(USARTx_IRQn, UART_IRQ_PRIORITY, 0);
+  HAL_NVIC_EnableIRQ(USARTx_IRQn);
 }
 
 /**
@@ -213,11 +597,11 @@ void USARTConfig(void)
   UartHandle.pRxBuffPtr = (uint8_t *)UartRxBuffer; /* MISRA C-2012 rule 11.8 violation for purpose */
   UartHandle.RxXferSize = UART_RxBufferSize;
   UartHandle.ErrorCode = (uint32_t)HAL_UART_ERROR_NONE;
+  UART_RxRestart(0);
 
   /* Enable the DMA transfer for the receiver request by setting the DMAR bit
   in the UART CR3 register */
-  /* MISRA C-2012 rule 11.8 violation for purpose */
-  (void)HAL_UART_Receive_DMA(&UartHandle, (uint8_t *)UartRxBuffer, UART_RxBufferSize);
+  UART_RxStart();
 }
 
 /**
@@ -110,6 +110,24 @@ void Config_DMA_Handler(DMA_HandleTypeDef *handle_dma)
   handle_dma->Init.Request             = DMA_REQUEST_2;
 }
 
+/**
+ * @brief  Configure the DMA handler for the USART transmit queue
+ * @param  handle_dma DMA handle
+ * @retval None
+ */
+void Config_DMA_TxHandler(DMA_HandleTypeDef *handle_dma)
+{
+  handle_dma->Instance                 = DMA1_Channel2;
+  handle_dma->Init.Direction           = DMA_MEMORY_TO_PERIPH;
+  handle_dma->Init.PeriphInc           = DMA_PINC_DISABLE;
+  handle_dma->Init.MemInc              = DMA_MINC_ENABLE;
+  handle_dma->Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  handle_dma->Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+  handle_dma->Init.Mode                = DMA_NORMAL;
+  handle_dma->Init.Priority            = DMA_PRIORITY_LOW;
+  handle_dma->Init.Request             = DMA_REQUEST_2;
+}
+
 /**
  * @}
  */
@@ -0,0 +1,147 @@
+/**
+ ******************************************************************************
+ * @file    low_power.c
+ * @brief   Sleep between interrupts: the main loop calls LowPower_Sleep when
+ *          it has nothing pending and the core stops in Sleep mode until the
+ *          next interrupt, with the 1 ms HAL tick stopped meanwhile. Counts
+ *          the core cycles spent running and asleep, for the duty cycle.
+ ******************************************************************************
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "low_power.h"
+
+/** @addtogroup MOTION_APPLICATIONS MOTION APPLICATIONS
+ * @{
+ */
+
+/** @addtogroup ACTIVITY_RECOGNITION_WRIST ACTIVITY RECOGNITION WRIST
+ * @{
+ */
+
+/* Private defines -----------------------------------------------------------*/
+#ifdef USE_HOST_SIM
+#define LOW_POWER_CYCCNT()   ((uint32_t)(SIM_Now() * (SystemCoreClock / 1000000U)))
+#else
+#define LOW_POWER_CYCCNT()   (DWT->CYCCNT)
+#define LOW_POWER_SLEEP_MAX  SysTick_LOAD_RELOAD_Msk  /* [core cycles] SysTick reload while asleep, 210 ms at 80 MHz */
+#endif
+
+/* Private variables ---------------------------------------------------------*/
+static LowPowerStats_t Stats;
+static uint32_t WokeCycles;   /* CYCCNT when the core last woke */
+#ifndef USE_HOST_SIM
+static uint32_t TickResidue;  /* [core cycles] slept short of a whole HAL tick, carried */
+#endif
+
+/* Private functions ---------------------------------------------------------*/
+/**
+ * @brief  Stop in Sleep mode until an interrupt is pending
+ * @param  None
+ * @retval [core cycles] slept
+ * @details SysTick counts the sleep down from its longest reload instead of
+ *          waking the core every millisecond, and the HAL tick is advanced by
+ *          the time slept once it wakes; a longer sleep is cut by the reload.
+ *          CYCCNT stops with the core clock, it cannot time the sleep.
+ */
+static uint32_t LowPower_Wfi(void)
+{
+#ifdef USE_HOST_SIM
+  uint64_t from = SIM_Now();
+
+  SIM_Idle();
+  return (uint32_t)((SIM_Now() - from) * (SystemCoreClock / 1000000U));
+#else
+  uint32_t load = SysTick->LOAD;
+  uint32_t total;
+  uint32_t slept;
+
+  SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+  if ((SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) != 0U)
+  {
+    /* A millisecond ended meanwhile, its interrupt counts it first */
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    return 0;
+  }
+  /* The millisecond in progress is counted with the sleep */
+  total = TickResidue + (load - SysTick->VAL);
+  SysTick->LOAD = LOW_POWER_SLEEP_MAX;
+  SysTick->VAL = 0;
+  SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+
+  /* Sleep, not Stop: TIM3, the USART3 and I2C1 DMA need their clocks */
+  HAL_PWR_EnterSLEEPMode(PWR_MAINREGULATOR_ON, PWR_SLEEPENTRY_WFI);
+
+  SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+  slept = LOW_POWER_SLEEP_MAX - SysTick->VAL;
+  if ((SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) != 0U)
+  {
+    /* Woken by the reload, or it came right after */
+    slept += LOW_POWER_SLEEP_MAX + 1U;
+    SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk;
+  }
+  SysTick->LOAD = load;
+  SysTick->VAL = 0;
+  SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+
+  total += slept;
+  while (total > load)
+  {
+    total -= load + 1U;
+    HAL_IncTick();
+  }
+  TickResidue = total;
+  return slept;
+#endif
+}
+
+/* Exported functions ------------------------------------------------------- */
+/**
+ * @brief  Start the DWT cycle counter
+ * @param  None
+ * @retval None
+ */
+void LowPower_Init(void)
+{
+#ifndef USE_HOST_SIM
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+  WokeCycles = LOW_POWER_CYCCNT();
+}
+
+/**
+ * @brief  Sleep until the next interrupt
+ * @param  None
+ * @retval None
+ * @note   Called with interrupts masked, after finding no work pending: an
+ *         interrupt raised since still ends the sleep at once, and runs when
+ *         the caller unmasks them.
+ */
+void LowPower_Sleep(void)
+{
+  Stats.ActiveCycles += LOW_POWER_CYCCNT() - WokeCycles;
+  Stats.SleepCycles += LowPower_Wfi();
+  Stats.Sleeps++;
+  WokeCycles = LOW_POWER_CYCCNT();
+}
+
+/**
+ * @brief  Duty cycle counters since LowPower_Init
+ * @param  None
+ * @retval The counters
+ */
+const LowPowerStats_t *LowPower_GetStats(void)
+{
+  return &Stats;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
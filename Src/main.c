@@ -39,6 +39,12 @@
 #include "DemoSerial.h"
 #include "MotionAW_Manager.h"
 #include "MotionSM_Manager.h"
+#include "activity_log.h"
+#include "status_frame.h"
+#include "acc_fifo.h"
+#include "low_power.h"
+#include "rate_gov.h"
+#include "sensor_subs.h"
 
 
 /** @addtogroup MOTION_APPLICATIONS MOTION APPLICATIONS
@@ -53,6 +59,18 @@
 /* Private define ------------------------------------------------------------*/
 #define ALGO_FREQ  16U /* Algorithm frequency [Hz] */
 #define ALGO_PERIOD  (1000U / ALGO_FREQ)  /* Algorithm period [ms] */
+#ifndef ACC_FIFO_WATERMARK
+#define ACC_FIFO_WATERMARK  ACC_FIFO_ODR  /* Samples per FIFO read (1 s), 0 to poll every tick */
+#endif
+#define TIM_CLOCK  2000U  /* TIM_ALGO counter clock [Hz] */
+#define TIM_TICK  (TIM_CLOCK / ALGO_FREQ)  /* TIM_ALGO counts per algorithm period */
+
+/* Accelerometer at the low rate of the governor, wake-up on INT1 */
+#define ACC_LOW_ODR  12.5f            /* [Hz] in low power mode */
+#define ACC_WAKE_THS  2U              /* slope threshold, FS / 64 per LSB: 125 mg at 4 g */
+#define ACC_CTRL6_XL_HM_OFF  0x10U    /* CTRL6_C: high performance mode off */
+#define ACC_TAP_CFG_INT_EN  0x80U     /* TAP_CFG: INTERRUPTS_ENABLE */
+#define ACC_MD1_INT1_WU  0x20U        /* MD1_CFG: wake-up on INT1 */
 
 /* Extern variables ----------------------------------------------------------*/
 volatile uint8_t DataLoggerActive = 0;
@@ -72,6 +90,7 @@ flash_state_t FlashState = FLASH_READY;
 /* Private variables ---------------------------------------------------------*/
 static int RtcSynchPrediv;
 static RTC_HandleTypeDef RtcHandle;
+static CRC_HandleTypeDef CrcHandle;
 static volatile int64_t TimeStamp = 0;
 static volatile uint8_t SensorReadRequest = 0;
 static IKS01A2_MOTION_SENSOR_Axes_t AccValue;
@@ -80,6 +99,35 @@ static float PresValue;
 static int TurnOver=0;
 static volatile uint8_t GuiModeRequest = 0;
 static volatile uint8_t StandaloneModeRequest = 0;
+static uint16_t DeviceId;
+static uint16_t StatusSeq = 0;
+static TAccFifo AccFifo;
+static volatile uint8_t FifoReadRequest = 0;
+static volatile uint8_t FifoBusy = 0;   /* a FIFO read is on the bus or waits for the main loop */
+static volatile uint8_t FifoAgain = 0;  /* INT1 rose meanwhile */
+static uint8_t AcqRunning = 0;
+static uint8_t AcqFifo = 0;
+static uint8_t AcqTimer = 0;
+static uint8_t AcqLow = 0;              /* at the low rate of the governor */
+static TRateGov RateGov;
+static volatile uint8_t WakeRequest = 0;  /* INT1 wake-up at the low rate */
+static volatile uint32_t TickStride = 1;  /* algorithm periods per TIM_ALGO period */
+static volatile uint32_t TickStrideNext = 1;
+static uint32_t StatusTick = 0;         /* algorithm periods logged up to the last status */
+static TSensorPlan SensorPlan;          /* channels read, from the subscriptions of the mode */
+static program_state_t AcqMode = AW_MODE;  /* mode SensorPlan was made for */
+static uint32_t SensorsPowered = 0;     /* xx_SENSOR bits enabled on the board */
+
+/* Output registers read on the I2C1 queue, in the background of the main loop */
+static uint8_t AccRaw[6];
+static uint8_t GyrRaw[6];
+static uint8_t PresRaw[3];
+static BSP_I2C1_Xfer_t AccXfer = {.DevAddr = LSM6DSL_I2C_ADD_H, .Reg = LSM6DSL_OUTX_L_XL, .pData = AccRaw};
+static BSP_I2C1_Xfer_t GyrXfer = {.DevAddr = LSM6DSL_I2C_ADD_H, .Reg = LSM6DSL_OUTX_L_G, .pData = GyrRaw};
+static BSP_I2C1_Xfer_t PresXfer = {.DevAddr = LPS22HB_I2C_ADD_H, .Reg = LPS22HB_PRESS_OUT_XL, .pData = PresRaw};
+static volatile uint8_t TickBusy = 0;   /* the reads of a tick are on the bus or wait for the main loop */
+static float AccSensitivity = 0.122f;   /* [mg/LSB] */
+static float GyrSensitivity = 70.0f;    /* [mdps/LSB] */
 
 
 /* Private function prototypes -----------------------------------------------*/
@@ -89,14 +137,28 @@ static void Init_Sensors(void);
 static void MX_GPIO_Init(void);
 static void MX_CRC_Init(void);
 static void MX_TIM_ALGO_Init(void);
+static void Acquisition_Select(TMsg *Msg);
+static void Accelero_Rate(uint8_t Low);
+static void Sensors_Power(uint32_t Sensors);
+static void Tick_Submit(uint32_t Periods);
+static void Tick_ReadDone(BSP_I2C1_Xfer_t *Xfer);
+static void Fifo_Submit(void);
+static void Fifo_ReadDone(BSP_I2C1_Xfer_t *Xfer);
+static void Fifo_ReadEnd(uint8_t More);
+static void Fifo_Drain(TMsg *Msg);
+static int Xfer_Read(const BSP_I2C1_Xfer_t *Xfer);
+static void Raw_Axes(const uint8_t *Raw, float Sensitivity, IKS01A2_MOTION_SENSOR_Axes_t *Axes);
+static void Status_Send(TMsg *Msg, uint8_t Activity, uint8_t Flags);
+static int AW_Run(uint8_t *Activity);
 static void AW_Data_Handler(TMsg *Msg);
 static void SM_Data_Handler(TMsg *Msg);
+static void Algo_Data_Handler(TMsg *Msg);
+static void Fifo_Data_Handler(TMsg *Msg);
+static void Batch_Data_Handler(void);
+static void Accelero_Sample(const IKS01A2_MOTION_SENSOR_Axes_t *Sample);
 static void Accelero_Sensor_Handler(TMsg *Msg, uint32_t Instance);
 static void Gyro_Sensor_Handler(TMsg *Msg, uint32_t Instance);
-static void Magneto_Sensor_Handler(TMsg *Msg, uint32_t Instance);
 static void Pressure_Sensor_Handler(TMsg *Msg, uint32_t Instance);
-static void Humidity_Sensor_Handler(TMsg *Msg, uint32_t Instance);
-static void Temperature_Sensor_Handler(TMsg *Msg, uint32_t Instance);
 
 /* Public functions ----------------------------------------------------------*/
 /**
@@ -117,7 +179,10 @@ int main(void)
 
   char lib_version[35];
   int lib_version_len;
+  uint32_t uid;
   TMsg msg_dat;
+  TMsg msg_cmd;
+  uint32_t primask;
 
   /* STM32xxxx HAL library initialization:
   - Configure the Flash prefetch, instruction and Data caches
@@ -133,6 +198,13 @@ int main(void)
   /* Configure the SysTick IRQ priority - set the second lowest priority */
   HAL_NVIC_SetPriority(SysTick_IRQn, 0x0E, 0);
 
+  /* Cycle counter for the duty cycle */
+  LowPower_Init();
+
+  /* Device id carried by every status frame, folded from the 96-bit unique id */
+  uid = HAL_GetUIDw0() ^ HAL_GetUIDw1() ^ HAL_GetUIDw2();
+  DeviceId = (uint16_t)(uid ^ (uid >> 16));
+
   /* Initialize GPIOs */
   MX_GPIO_Init();
 
@@ -158,48 +230,96 @@ int main(void)
   RTC_Config();
   RTC_TimeStampConfig();
 
+  /* Find the end of the datalog, activity runs are logged from the first tick */
+  FlashState = Datalog_SetAddress();
+  Datalog_ActivityStart(ALGO_FREQ);
+
   /* Timer for algorithm synchronization initialization */
   MX_TIM_ALGO_Init();
 
-  (void)IKS01A2_MOTION_SENSOR_Enable(IKS01A2_LSM6DSL_0, MOTION_ACCELERO);
-  (void)IKS01A2_MOTION_SENSOR_Enable(IKS01A2_LSM6DSL_0, MOTION_GYRO);
-  (void)IKS01A2_ENV_SENSOR_Enable(IKS01A2_LPS22HB_0, ENV_PRESSURE);
+  /* Powered as the mode subscribes to them */
   SensorsEnabled |= (ACCELEROMETER_SENSOR | GYROSCOPE_SENSOR | PRESSURE_SENSOR);
-  (void)HAL_TIM_Base_Start_IT(&AlgoTimHandle);
+  RateGov_Init(&RateGov);
+  Acquisition_Start();
+  Acquisition_Select(&msg_dat);
 
 
   for (;;)
   {
+    /* Nothing to do until the next interrupt: the tick, the FIFO, a byte
+       received, the end of a UART, I2C or flash transfer, the button, a
+       wake-up */
+    primask = __get_PRIMASK();
+    __disable_irq();
+    if ((SensorReadRequest == 0U) && (FifoReadRequest == 0U) && (WakeRequest == 0U) && (UART_RxPending() == 0))
+    {
+      LowPower_Sleep();
+    }
+    __set_PRIMASK(primask);
+
+    if (UART_ReceivedMSG(&msg_cmd) != 0)
+    {
+      (void)HandleMSG(&msg_cmd);
+
+      /* Streaming may have started or stopped */
+      Acquisition_Select(&msg_dat);
+    }
+
+    if (FifoReadRequest == 1U)
+    {
+      FifoReadRequest = 0;
+      Fifo_Data_Handler(&msg_dat);
+    }
+
     if (SensorReadRequest == 1U){
 
       SensorReadRequest = 0;
       Accelero_Sensor_Handler(&msg_dat, IKS01A2_LSM6DSL_0);
       Pressure_Sensor_Handler(&msg_dat, IKS01A2_LPS22HB_0);
-      switch(ProgramState){
-		  case AW_MODE:	
-			AW_Data_Handler(&msg_dat);
-			break;
-
-		   case SM_MODE:
-		    SM_Data_Handler(&msg_dat);
-		    break;
+      if (StreamBatch.Max != 0U)
+      {
+        Batch_Data_Handler();
       }
+
+      /* The reads are taken, the next tick's go on while the algorithm runs */
+      TickBusy = 0;
+      Algo_Data_Handler(&msg_dat);
 	} 
+
+    /* Motion ends the low rate at once, the statuses pick when it starts;
+       a mode reads what it subscribes to */
+    if (WakeRequest == 1U)
+    {
+      WakeRequest = 0;
+      RateGov_Wake(&RateGov);
+    }
+    if ((RateGov.Low != AcqLow) || (ProgramState != AcqMode))
+    {
+      Acquisition_Select(&msg_dat);
+    }
+
+    /* Bulk upload blocks go out as the transmit queue drains */
+    Bulk_Process();
+
+    /* A rate switch the host did not verify is undone */
+    Baud_Process();
+
+    /* Staged datalog records go to flash in the background */
+    Datalog_Process();
   }
 }
 
 
 /* Private functions ---------------------------------------------------------*/
 /**
- * @brief  Initialize all sensors
+ * @brief  Initialize the sensors a mode or a batch can subscribe to; the
+ *         LSM303AGR magnetometer and the HTS221 are left in power down
  * @param  None
  * @retval None
  */
 static void Init_Sensors(void)
 {
   (void)IKS01A2_MOTION_SENSOR_Init(IKS01A2_LSM6DSL_0, MOTION_ACCELERO | MOTION_GYRO);
-  (void)IKS01A2_MOTION_SENSOR_Init(IKS01A2_LSM303AGR_MAG_0, MOTION_MAGNETO);
-  (void)IKS01A2_ENV_SENSOR_Init(IKS01A2_HTS221_0, ENV_TEMPERATURE | ENV_HUMIDITY);
   (void)IKS01A2_ENV_SENSOR_Init(IKS01A2_LPS22HB_0, ENV_PRESSURE);
 
   /* Set accelerometer:
@@ -208,6 +328,10 @@ static void Init_Sensors(void)
    */
   (void)IKS01A2_MOTION_SENSOR_SetOutputDataRate(IKS01A2_LSM6DSL_0, MOTION_ACCELERO, 16.0f);
   (void)IKS01A2_MOTION_SENSOR_SetFullScale(IKS01A2_LSM6DSL_0, MOTION_ACCELERO, 4);
+
+  /* The output registers are read raw on the I2C1 queue */
+  (void)IKS01A2_MOTION_SENSOR_GetSensitivity(IKS01A2_LSM6DSL_0, MOTION_ACCELERO, &AccSensitivity);
+  (void)IKS01A2_MOTION_SENSOR_GetSensitivity(IKS01A2_LSM6DSL_0, MOTION_GYRO, &GyrSensitivity);
 }
 
 /**
@@ -218,11 +342,23 @@ static void Init_Sensors(void)
  */
 static void MX_GPIO_Init(void)
 {
+  GPIO_InitTypeDef gpio_init;
+
   /* Initialize LED */
   BSP_LED_Init(LED2);
 
   /* Initialize push button */
   BSP_PB_Init(BUTTON_KEY, BUTTON_MODE_EXTI);
+
+  /* LSM6DSL INT1, raised at the FIFO watermark, or on a wake-up at the low rate */
+  ACC_INT1_GPIO_CLK_ENABLE();
+  gpio_init.Pin = ACC_INT1_PIN;
+  gpio_init.Mode = GPIO_MODE_IT_RISING;
+  gpio_init.Pull = GPIO_NOPULL;
+  gpio_init.Speed = GPIO_SPEED_FREQ_LOW;
+  HAL_GPIO_Init(ACC_INT1_GPIO_PORT, &gpio_init);
+  HAL_NVIC_SetPriority(ACC_INT1_EXTI_IRQn, 0x0F, 0);
+  HAL_NVIC_EnableIRQ(ACC_INT1_EXTI_IRQn);
 }
 
 /**
@@ -256,10 +392,8 @@ static void MX_TIM_ALGO_Init(void)
 #error Not supported platform
 #endif
 
-#define TIM_CLOCK  2000U
-
   const uint32_t prescaler = CPU_CLOCK / TIM_CLOCK - 1U;
-  const uint32_t tim_period = TIM_CLOCK / ALGO_FREQ - 1U;
+  const uint32_t tim_period = TIM_TICK - 1U;
 
   TIM_ClockConfigTypeDef s_clock_source_config;
   TIM_MasterConfigTypeDef s_master_config;
@@ -281,83 +415,412 @@ static void MX_TIM_ALGO_Init(void)
 
 
 /**
- * @brief  Activity Recognition Wrist data handler
- * @param  Msg the Activity Recognition Wrist data part of the stream
+ * @brief  Start the algorithm ticks, with the next pass of the main loop
+ * @param  None
  * @retval None
  */
-static void AW_Data_Handler(TMsg *Msg)
+void Acquisition_Start(void)
 {
-  MAW_input_t data_aw_in = {.AccX = 0.0f, .AccY = 0.0f, .AccZ = 0.0f};
-  static MAW_activity_t activity;
+  AcqRunning = 1;
+}
 
+/**
+ * @brief  Stop the algorithm ticks, with the next pass of the main loop
+ * @param  None
+ * @retval None
+ */
+void Acquisition_Stop(void)
+{
+  AcqRunning = 0;
+}
 
-  if ((SensorsEnabled & ACCELEROMETER_SENSOR) == ACCELEROMETER_SENSOR
-  	  &&(SensorsEnabled & PRESSURE_SENSOR) == PRESSURE_SENSOR)
+/**
+ * @brief  Set the accelerometer up for the rate of the governor
+ * @param  Low 1 for the low rate: ODR ACC_LOW_ODR in low power mode and
+ *         wake-up on INT1, 0 for the full rate
+ * @retval None
+ * @details The wake-up is set by register: the BSP's wake-up detection
+ *          forces 416 Hz and 2 g, which would undo the low rate.
+ */
+static void Accelero_Rate(uint8_t Low)
+{
+  if (Low != 0U)
   {
-	/* Convert acceleration from [mg] to [g] */
-	data_aw_in.AccX = (float)AccValue.x / 1000.0f;
-	data_aw_in.AccY = (float)AccValue.y / 1000.0f;
-	data_aw_in.AccZ = (float)AccValue.z / 1000.0f;
+    (void)IKS01A2_MOTION_SENSOR_SetOutputDataRate(IKS01A2_LSM6DSL_0, MOTION_ACCELERO, ACC_LOW_ODR);
+    (void)IKS01A2_MOTION_SENSOR_Write_Register(IKS01A2_LSM6DSL_0, LSM6DSL_CTRL6_C, ACC_CTRL6_XL_HM_OFF);
+    (void)IKS01A2_MOTION_SENSOR_Write_Register(IKS01A2_LSM6DSL_0, LSM6DSL_WAKE_UP_DUR, 0U);
+    (void)IKS01A2_MOTION_SENSOR_Write_Register(IKS01A2_LSM6DSL_0, LSM6DSL_WAKE_UP_THS, ACC_WAKE_THS);
+    (void)IKS01A2_MOTION_SENSOR_Write_Register(IKS01A2_LSM6DSL_0, LSM6DSL_TAP_CFG, ACC_TAP_CFG_INT_EN);
+    (void)IKS01A2_MOTION_SENSOR_Write_Register(IKS01A2_LSM6DSL_0, LSM6DSL_MD1_CFG, ACC_MD1_INT1_WU);
+  }
+  else
+  {
+    (void)IKS01A2_MOTION_SENSOR_Write_Register(IKS01A2_LSM6DSL_0, LSM6DSL_MD1_CFG, 0U);
+    (void)IKS01A2_MOTION_SENSOR_Write_Register(IKS01A2_LSM6DSL_0, LSM6DSL_TAP_CFG, 0U);
+    (void)IKS01A2_MOTION_SENSOR_Write_Register(IKS01A2_LSM6DSL_0, LSM6DSL_CTRL6_C, 0U);
+    (void)IKS01A2_MOTION_SENSOR_SetOutputDataRate(IKS01A2_LSM6DSL_0, MOTION_ACCELERO, (float)ALGO_FREQ);
+  }
+}
 
+/**
+ * @brief  Power the sensors read, and only them
+ * @param  Sensors xx_SENSOR bits, of the LSM6DSL and the LPS22HB
+ * @retval None
+ */
+static void Sensors_Power(uint32_t Sensors)
+{
+  uint32_t change = Sensors ^ SensorsPowered;
 
-	/* Run Activity Recognition algorithm */
-	BSP_LED_On(LED2);
-	MotionAW_manager_run(&data_aw_in, &activity, TimeStamp);
-	BSP_LED_Off(LED2);
+  if ((change & ACCELEROMETER_SENSOR) != 0U)
+  {
+    if ((Sensors & ACCELEROMETER_SENSOR) != 0U)
+    {
+      (void)IKS01A2_MOTION_SENSOR_Enable(IKS01A2_LSM6DSL_0, MOTION_ACCELERO);
+    }
+    else
+    {
+      (void)IKS01A2_MOTION_SENSOR_Disable(IKS01A2_LSM6DSL_0, MOTION_ACCELERO);
+    }
+  }
+  if ((change & GYROSCOPE_SENSOR) != 0U)
+  {
+    if ((Sensors & GYROSCOPE_SENSOR) != 0U)
+    {
+      (void)IKS01A2_MOTION_SENSOR_Enable(IKS01A2_LSM6DSL_0, MOTION_GYRO);
+    }
+    else
+    {
+      (void)IKS01A2_MOTION_SENSOR_Disable(IKS01A2_LSM6DSL_0, MOTION_GYRO);
+    }
+  }
+  if ((change & PRESSURE_SENSOR) != 0U)
+  {
+    if ((Sensors & PRESSURE_SENSOR) != 0U)
+    {
+      (void)IKS01A2_ENV_SENSOR_Enable(IKS01A2_LPS22HB_0, ENV_PRESSURE);
+    }
+    else
+    {
+      (void)IKS01A2_ENV_SENSOR_Disable(IKS01A2_LPS22HB_0, ENV_PRESSURE);
+    }
+  }
+  SensorsPowered = Sensors;
+}
 
-	uint8_t sendMSG[20];
+/**
+ * @brief  Pick what is read and how: the channels the mode subscribes to
+ *         (Src/sensor_subs.c) and those batches stream, the rest powered
+ *         down; the accelerometer through its FIFO, one burst per
+ *         ACC_FIFO_WATERMARK samples, or polled on every TIM_ALGO tick when
+ *         another channel is wanted faster than once a burst, as batches
+ *         want theirs on each tick; at the low rate of the governor it is
+ *         polled every RATE_GOV_LOW_STRIDE ticks and wakes the board on
+ *         motion
+ * @param  Msg the message used to send the statuses of the samples left in
+ *         the FIFO when it is stopped
+ * @retval None
+ */
+static void Acquisition_Select(TMsg *Msg)
+{
+  program_state_t mode = ProgramState;
+  TSensorPlan plan;
+  uint32_t primask;
+  uint8_t low;
+  uint8_t fifo;
+  uint8_t timer;
+
+  if ((RateGov.Low != 0U) && ((AcqRunning == 0U) || (StreamBatch.Max != 0U)))
+  {
+    /* Batches want every tick */
+    RateGov_Wake(&RateGov);
+  }
+  SensorSubs_Plan(&plan, (uint8_t)mode, (StreamBatch.Max != 0U) ? StreamBatch.Sensors : 0U,
+                  (AcqRunning != 0U) ? SensorsEnabled : 0U, ALGO_FREQ);
+  low = RateGov.Low;
+  fifo = ((AcqRunning != 0U) && (StreamBatch.Max == 0U) && (ACC_FIFO_WATERMARK != 0U) && (low == 0U)
+          && ((SensorSubs_Rate(&plan, ~ACCELEROMETER_SENSOR) * ACC_FIFO_WATERMARK) <= ACC_FIFO_ODR)) ? 1U : 0U;
+  timer = ((AcqRunning != 0U) && (fifo == 0U)) ? 1U : 0U;
+
+  if ((fifo == 0U) && (AcqFifo != 0U))
+  {
+    /* The ticks go on where the FIFO left them; a read INT1 started before
+       it was stopped is over once AccFifo_Stop got the bus, and dropped */
+    Fifo_Drain(Msg);
+    AccFifo_Stop(&AccFifo);
+    FifoReadRequest = 0;
+    FifoBusy = 0;
+    FifoAgain = 0;
+  }
+  if ((timer == 0U) && (AcqTimer != 0U))
+  {
+    (void)HAL_TIM_Base_Stop_IT(&AlgoTimHandle);
+    /* The algorithm periods of the TIM_ALGO period cut short, to the nearest */
+    TimeStamp += (int64_t)((__HAL_TIM_GET_COUNTER(&AlgoTimHandle) + (TIM_TICK / 2U)) / TIM_TICK) * ALGO_PERIOD;
+    BSP_I2C1_Wait();
+    SensorReadRequest = 0;
+    TickBusy = 0;
+  }
 
-	switch(activity){
-			case MAW_NOACTIVITY:
-			  strcpy(sendMSG,"a");
-			  HAL_UART_Transmit(&UartHandle, (uint8_t *)sendMSG, strlen(sendMSG), 0xFF);
-			  break;
+  /* The ticks still running read the new channels from the next one */
+  primask = __get_PRIMASK();
+  __disable_irq();
+  SensorPlan = plan;
+  __set_PRIMASK(primask);
+  AcqMode = mode;
+  Sensors_Power(plan.Sensors);
 
-			case MAW_STATIONARY:
-			  strcpy(sendMSG,"b");
-			  HAL_UART_Transmit(&UartHandle, (uint8_t *)sendMSG, strlen(sendMSG), 0xFF);
-			  break;
+  if (low != AcqLow)
+  {
+    /* INT1 is taken for a wake-up from before it can be one until after */
+    if (low != 0U)
+    {
+      AcqLow = 1;
+    }
+    Accelero_Rate(low);
+    AcqLow = low;
+    WakeRequest = 0;
+
+    /* A running timer takes the new period at its next update */
+    TickStrideNext = (low != 0U) ? RATE_GOV_LOW_STRIDE : 1U;
+  }
+  if ((fifo != 0U) && (AcqFifo == 0U))
+  {
+    AccFifo_Start(&AccFifo, ACC_FIFO_WATERMARK, ALGO_FREQ);
+  }
+  if ((timer != 0U) && (AcqTimer == 0U))
+  {
+    TickStride = TickStrideNext;
+    __HAL_TIM_SET_AUTORELOAD(&AlgoTimHandle, (TickStride * TIM_TICK) - 1U);
+    __HAL_TIM_SET_COUNTER(&AlgoTimHandle, 0U);
+    (void)HAL_TIM_Base_Start_IT(&AlgoTimHandle);
+  }
+  AcqFifo = fifo;
+  AcqTimer = timer;
+}
 
-			case  MAW_STANDING:
-			  strcpy(sendMSG,"c");
-			  HAL_UART_Transmit(&UartHandle, (uint8_t *)sendMSG, strlen(sendMSG), 0xFF);
-			  break;
+/**
+ * @brief  Queue the reads of a tick: accelerometer, gyroscope, then
+ *         pressure, those due in SensorPlan, in one I2C1 sequence
+ * @param  Periods algorithm periods the tick covers
+ * @retval None
+ * @details From the TIM_ALGO interrupt. A tick whose reads find the ones of
+ *          the tick before still queued, or not yet taken by the main loop,
+ *          is handled with them, as when the main loop falls behind.
+ */
+static void Tick_Submit(uint32_t Periods)
+{
+  uint32_t due;
 
-			case MAW_SITTING:
-			  strcpy(sendMSG,"d");
-			  HAL_UART_Transmit(&UartHandle, (uint8_t *)sendMSG, strlen(sendMSG), 0xFF);
-			  break;
+  if (TickBusy != 0U)
+  {
+    return;
+  }
+  TickBusy = 1;
+
+  due = SensorSubs_Due(&SensorPlan, Periods);
+  AccXfer.Len = ((due & ACCELEROMETER_SENSOR) != 0U) ? (uint16_t)sizeof(AccRaw) : 0U;
+  GyrXfer.Len = ((due & GYROSCOPE_SENSOR) != 0U) ? (uint16_t)sizeof(GyrRaw) : 0U;
+  PresXfer.Len = ((due & PRESSURE_SENSOR) != 0U) ? (uint16_t)sizeof(PresRaw) : 0U;
+  AccXfer.Next = &GyrXfer;
+  GyrXfer.Next = &PresXfer;
+  PresXfer.Next = NULL;
+  PresXfer.Done = Tick_ReadDone;
+  if (BSP_I2C1_Submit(&AccXfer) != BSP_ERROR_NONE)
+  {
+    TickBusy = 0;
+  }
+}
 
-			case MAW_LYING :
-			  strcpy(sendMSG,"e");
-			  HAL_UART_Transmit(&UartHandle, (uint8_t *)sendMSG, strlen(sendMSG), 0xFF);
-			  break;
+/**
+ * @brief  Last read of a tick ended, from the I2C1 interrupt
+ * @param  Xfer the pressure read
+ * @retval None
+ */
+static void Tick_ReadDone(BSP_I2C1_Xfer_t *Xfer)
+{
+  (void)Xfer;
+  SensorReadRequest = 1;
+}
 
-			case MAW_WALKING :
-			  strcpy(sendMSG,"f");
-			  HAL_UART_Transmit(&UartHandle, (uint8_t *)sendMSG, strlen(sendMSG), 0xFF);
-			  break;
+/**
+ * @brief  Queue a FIFO read followed by the pressure, or have it follow the
+ *         one in progress
+ * @param  None
+ * @retval None
+ * @details From the INT1 interrupt and the main loop.
+ */
+static void Fifo_Submit(void)
+{
+  uint32_t primask = __get_PRIMASK();
 
-			case MAW_FASTWALKING:
-			  strcpy(sendMSG,"g");
-			  HAL_UART_Transmit(&UartHandle, (uint8_t *)sendMSG, strlen(sendMSG), 0xFF);
-			  break;
+  __disable_irq();
+  if (FifoBusy != 0U)
+  {
+    FifoAgain = 1;
+  }
+  else
+  {
+    FifoBusy = 1;
+    FifoAgain = 0;
+    PresXfer.Len = ((SensorPlan.Sensors & PRESSURE_SENSOR) != 0U) ? (uint16_t)sizeof(PresRaw) : 0U;
+    PresXfer.Next = NULL;
+    PresXfer.Done = Fifo_ReadDone;
+    if (AccFifo_Submit(&AccFifo, &PresXfer) != BSP_ERROR_NONE)
+    {
+      FifoBusy = 0;
+    }
+  }
+  __set_PRIMASK(primask);
+}
 
-			case MAW_JOGGING:
-			  strcpy(sendMSG,"h");
-			  HAL_UART_Transmit(&UartHandle, (uint8_t *)sendMSG, strlen(sendMSG), 0xFF);
-			  break;
+/**
+ * @brief  Last read of a FIFO sequence ended, from the I2C1 interrupt
+ * @param  Xfer the pressure read
+ * @retval None
+ */
+static void Fifo_ReadDone(BSP_I2C1_Xfer_t *Xfer)
+{
+  (void)Xfer;
+  FifoReadRequest = 1;
+}
 
-			case MAW_BIKING:
-				strcpy(sendMSG,"i");
-				HAL_UART_Transmit(&UartHandle, (uint8_t *)sendMSG, strlen(sendMSG), 0xFF);
-				break;
+/**
+ * @brief  The main loop took the samples of a FIFO read, the bus may read
+ *         the next burst while they are run
+ * @param  More 1 if the burst was full and more samples wait
+ * @retval None
+ */
+static void Fifo_ReadEnd(uint8_t More)
+{
+  uint32_t primask = __get_PRIMASK();
 
-			default:
-			  strcpy(sendMSG,"j");
-			  HAL_UART_Transmit(&UartHandle, (uint8_t *)sendMSG, strlen(sendMSG), 0xFF);
-			  break;
-		}
+  __disable_irq();
+  FifoBusy = 0;
+  if ((More != 0U) || (FifoAgain != 0U))
+  {
+    Fifo_Submit();
+  }
+  __set_PRIMASK(primask);
+}
+
+/**
+ * @brief  Run the samples the FIFO holds, before it is stopped
+ * @param  Msg the message used to send the statuses
+ * @retval None
+ */
+static void Fifo_Drain(TMsg *Msg)
+{
+  Fifo_Submit();
+  while (FifoBusy != 0U)
+  {
+    BSP_I2C1_Wait();
+    if (FifoReadRequest != 0U)
+    {
+      FifoReadRequest = 0;
+      Fifo_Data_Handler(Msg);
+    }
+  }
+}
+
+/**
+ * @brief  Tell whether a transfer of the last sequence read its registers
+ * @param  Xfer the transfer
+ * @retval 1 if it did, 0 if it was skipped or failed
+ */
+static int Xfer_Read(const BSP_I2C1_Xfer_t *Xfer)
+{
+  return ((Xfer->Len != 0U) && (Xfer->Status == BSP_ERROR_NONE)) ? 1 : 0;
+}
+
+/**
+ * @brief  Scale x y z output registers, 16-bit little endian
+ * @param  Raw the six bytes read
+ * @param  Sensitivity the unit per LSB
+ * @param  Axes the scaled axes
+ * @retval None
+ */
+static void Raw_Axes(const uint8_t *Raw, float Sensitivity, IKS01A2_MOTION_SENSOR_Axes_t *Axes)
+{
+  Axes->x = (int32_t)((float)(int16_t)((uint16_t)Raw[0] | ((uint16_t)Raw[1] << 8)) * Sensitivity);
+  Axes->y = (int32_t)((float)(int16_t)((uint16_t)Raw[2] | ((uint16_t)Raw[3] << 8)) * Sensitivity);
+  Axes->z = (int32_t)((float)(int16_t)((uint16_t)Raw[4] | ((uint16_t)Raw[5] << 8)) * Sensitivity);
+}
+
+/**
+ * @brief  Send the current status as a binary frame and log it to flash
+ * @param  Msg the message used to build the frame
+ * @param  Activity the STATUS_ACT_xx code
+ * @param  Flags the STATUS_FLAG_xx bits
+ * @retval None
+ */
+static void Status_Send(TMsg *Msg, uint8_t Activity, uint8_t Flags)
+{
+  TStatusFrame frame;
+  uint32_t tick = (uint32_t)(TimeStamp / ALGO_PERIOD);
+
+  frame.DeviceId  = DeviceId;
+  frame.Seq       = StatusSeq;
+  frame.TimeStamp = (uint32_t)TimeStamp;
+  frame.Mode      = (uint8_t)ProgramState;
+  frame.Activity  = Activity;
+  frame.Flags     = Flags;
+  StatusSeq++;
+
+  StatusFrame_Build(Msg, &frame);
+  UART_SendMsg(Msg);
+
+  /* TimeStamp goes up by ALGO_PERIOD per tick; the status covers the ticks
+     since the one before, more than one at the low rate */
+  FlashState = (Datalog_ActivityLog(StatusTick + 1U, tick - StatusTick,
+                                    ACTLOG_CODE(frame.Mode, Activity, Flags & STATUS_FLAG_SLEEP),
+                                    ((Flags & STATUS_FLAG_TURNOVER) != 0U) ? 1U : 0U) != 0U) ? FLASH_READY : FLASH_FULL;
+  StatusTick = tick;
+
+  RateGov_Status(&RateGov, TimeStamp, Activity, Flags);
+}
+
+/**
+ * @brief  Run the Activity Recognition Wrist algorithm on the latest sample
+ * @param  Activity the recognized STATUS_ACT_xx code
+ * @retval 1 if the algorithm ran, 0 if the accelerometer is disabled
+ */
+static int AW_Run(uint8_t *Activity)
+{
+  MAW_input_t data_aw_in = {.AccX = 0.0f, .AccY = 0.0f, .AccZ = 0.0f};
+  MAW_activity_t activity;
+
+  if ((SensorsEnabled & ACCELEROMETER_SENSOR) != ACCELEROMETER_SENSOR)
+  {
+    return 0;
+  }
+
+  /* Convert acceleration from [mg] to [g] */
+  data_aw_in.AccX = (float)AccValue.x / 1000.0f;
+  data_aw_in.AccY = (float)AccValue.y / 1000.0f;
+  data_aw_in.AccZ = (float)AccValue.z / 1000.0f;
+
+  /* Run Activity Recognition algorithm */
+  BSP_LED_On(LED2);
+  MotionAW_manager_run(&data_aw_in, &activity, TimeStamp);
+  BSP_LED_Off(LED2);
+
+  /* MAW_activity_t values are the STATUS_ACT_xx codes */
+  *Activity = ((uint32_t)activity <= (uint32_t)MAW_BIKING) ? (uint8_t)activity : STATUS_ACT_UNKNOWN;
+  return 1;
+}
+
+/**
+ * @brief  Activity Recognition Wrist data handler
+ * @param  Msg the Activity Recognition Wrist data part of the stream
+ * @retval None
+ */
+static void AW_Data_Handler(TMsg *Msg)
+{
+  uint8_t activity;
+
+  if (AW_Run(&activity) != 0)
+  {
+    Status_Send(Msg, activity, 0);
   }
 }
 
@@ -370,6 +833,8 @@ static void SM_Data_Handler(TMsg *Msg)
 {
   MSM_input_t data_in = {.AccX = 0.0f, .AccY = 0.0f, .AccZ = 0.0f};
   static MSM_output_t data_out;
+  uint8_t activity = STATUS_ACT_UNKNOWN;
+  uint8_t flags = 0;
 
   if ((SensorsEnabled & ACCELEROMETER_SENSOR) == ACCELEROMETER_SENSOR)
   {
@@ -383,131 +848,174 @@ static void SM_Data_Handler(TMsg *Msg)
 	MotionSM_manager_run(&data_in, &data_out);
 	BSP_LED_Off(LED2);
 
-	uint8_t sendMSG[20];
-
 	switch(data_out.SleepFlag){
 			case MSM_NOSLEEP:
-			  strcpy(sendMSG,"n");
-			  HAL_UART_Transmit(&UartHandle, (uint8_t *)sendMSG, strlen(sendMSG), 0xFF);
-			  AW_Data_Handler(Msg);
-			  if(TurnOver==1){
-			  	TurnOver=0;
-			  	for(int i=0;i<10;i++){
-			  		strcpy(sendMSG,"q");
-			  		HAL_UART_Transmit(&UartHandle, (uint8_t *)sendMSG, strlen(sendMSG), 0xFF);
-			  	}
-			  }
+			  /* awake: report what the user is doing */
+			  (void)AW_Run(&activity);
 			  break;
 
 			case MSM_SLEEP:
-			  strcpy(sendMSG,"o");
-			  HAL_UART_Transmit(&UartHandle, (uint8_t *)sendMSG, strlen(sendMSG), 0xFF);
-			  //case: turn over
-			  if(TurnOver==1){
-			  	TurnOver=0;
-			  	for(int i=0;i<10;i++){
-			  		strcpy(sendMSG,"q");
-			  		HAL_UART_Transmit(&UartHandle, (uint8_t *)sendMSG, strlen(sendMSG), 0xFF);
-			  	}
-			  }
+			  flags |= STATUS_FLAG_SLEEP;
 			  break;
+
 			default:
-			  strcpy(sendMSG,"j");
-			  HAL_UART_Transmit(&UartHandle, (uint8_t *)sendMSG, strlen(sendMSG), 0xFF);
 			  break;
 	}
+
+	if(TurnOver==1){
+		TurnOver=0;
+		flags |= STATUS_FLAG_TURNOVER;
+	}
+
+	Status_Send(Msg, activity, flags);
   }
 }
 
 /**
- * @brief  Handles the ACC axes data getting/sending
- * @param  Msg the ACC part of the stream
- * @param  Instance the device instance
+ * @brief  Run the algorithm of the current mode on the latest sample
+ * @param  Msg the message used to send the status
  * @retval None
  */
-static void Accelero_Sensor_Handler(TMsg *Msg, uint32_t Instance)
+static void Algo_Data_Handler(TMsg *Msg)
 {
-  if ((SensorsEnabled & ACCELEROMETER_SENSOR) == ACCELEROMETER_SENSOR)
-  {
-	float AccZ_prev = (float)AccValue.z;
-	(void)IKS01A2_MOTION_SENSOR_GetAxes(Instance, MOTION_ACCELERO, &AccValue);
-	if(AccZ_prev*(float)AccValue.z<0)
-		TurnOver=1;
+  switch(ProgramState){
+	case AW_MODE:
+	  AW_Data_Handler(Msg);
+	  break;
+
+	case SM_MODE:
+	  SM_Data_Handler(Msg);
+	  break;
+
+	default:
+	  break;
   }
 }
+
 /**
- * @brief  Handles the GYR axes data getting/sending
- * @param  Msg the GYR part of the stream
- * @param  Instance the device instance
+ * @brief  FIFO read handler: takes the samples of the burst read and runs
+ *         the algorithm once per tick they cover
+ * @param  Msg the message used to send the statuses
  * @retval None
+ * @details The pressure, when subscribed to, is read once per burst; a
+ *          faster subscription, or a batch, is polled per tick instead. When
+ *          the burst was full the next one is read while these ticks run.
  */
-static void Gyro_Sensor_Handler(TMsg *Msg, uint32_t Instance)
+static void Fifo_Data_Handler(TMsg *Msg)
 {
-  if ((SensorsEnabled & GYROSCOPE_SENSOR) == GYROSCOPE_SENSOR)
+  IKS01A2_MOTION_SENSOR_Axes_t sample = AccValue;
+  uint16_t n;
+
+  Pressure_Sensor_Handler(Msg, IKS01A2_LPS22HB_0);
+  n = AccFifo_Parse(&AccFifo);
+  Fifo_ReadEnd((n == ACC_FIFO_BURST) ? 1U : 0U);
+  while (AccFifo_Next(&AccFifo, &sample) != 0)
   {
-    (void)IKS01A2_MOTION_SENSOR_GetAxes(Instance, MOTION_GYRO, &GyrValue);
+    TimeStamp += ALGO_PERIOD;
+    if ((SensorPlan.Sensors & ACCELEROMETER_SENSOR) != 0U)
+    {
+      Accelero_Sample(&sample);
+    }
+    Algo_Data_Handler(Msg);
   }
 }
 
 /**
- * @brief  Handles the MAG axes data getting/sending
- * @param  Msg the MAG part of the stream
- * @param  Instance the device instance
+ * @brief  Batched streaming data handler, sends the batch once it is full
+ * @param  None
  * @retval None
  */
-static void Magneto_Sensor_Handler(TMsg *Msg, uint32_t Instance)
+static void Batch_Data_Handler(void)
 {
-  IKS01A2_MOTION_SENSOR_Axes_t mag_value;
+  TStreamSample sample;
+
+  if ((StreamBatch.Sensors & STREAM_BATCH_GYR) != 0U)
+  {
+    Gyro_Sensor_Handler(NULL, IKS01A2_LSM6DSL_0);
+  }
 
-  if ((SensorsEnabled & MAGNETIC_SENSOR) == MAGNETIC_SENSOR)
+  sample.TimeMs = (uint32_t)TimeStamp;
+  sample.Acc[0] = (int16_t)AccValue.x;
+  sample.Acc[1] = (int16_t)AccValue.y;
+  sample.Acc[2] = (int16_t)AccValue.z;
+  /* [mdps] to [0.1 dps], +-2000 dps fits */
+  sample.Gyr[0] = (int16_t)(GyrValue.x / 100);
+  sample.Gyr[1] = (int16_t)(GyrValue.y / 100);
+  sample.Gyr[2] = (int16_t)(GyrValue.z / 100);
+  sample.Pressure = (uint32_t)(PresValue * 4096.0f);
+
+  /* A long gap (stream restarted, timer stopped) cannot be a delta: close the batch first */
+  if (StreamBatch_Add(&StreamBatch, &sample) == 0)
   {
-    (void)IKS01A2_MOTION_SENSOR_GetAxes(Instance, MOTION_MAGNETO, &mag_value);
+    UART_SendMsg(&StreamBatch.Msg);
+    StreamBatch_Next(&StreamBatch);
+    (void)StreamBatch_Add(&StreamBatch, &sample);
+  }
+  if (StreamBatch.Count == StreamBatch.Max)
+  {
+    UART_SendMsg(&StreamBatch.Msg);
+    StreamBatch_Next(&StreamBatch);
   }
 }
 
 /**
- * @brief  Handles the PRESS sensor data getting/sending.
- * @param  Msg the PRESS part of the stream
+ * @brief  Handles the ACC axes data getting/sending
+ * @param  Msg the ACC part of the stream
  * @param  Instance the device instance
  * @retval None
  */
-static void Pressure_Sensor_Handler(TMsg *Msg, uint32_t Instance)
+static void Accelero_Sensor_Handler(TMsg *Msg, uint32_t Instance)
 {
-  if ((SensorsEnabled & PRESSURE_SENSOR) == PRESSURE_SENSOR)
+  IKS01A2_MOTION_SENSOR_Axes_t sample;
+
+  if (((SensorsEnabled & ACCELEROMETER_SENSOR) == ACCELEROMETER_SENSOR) && (Xfer_Read(&AccXfer) != 0))
   {
-    (void)IKS01A2_ENV_SENSOR_GetValue(Instance, ENV_PRESSURE, &PresValue);
+	Raw_Axes(AccRaw, AccSensitivity, &sample);
+	Accelero_Sample(&sample);
   }
 }
 
 /**
- * @brief  Handles the TEMP axes data getting/sending
- * @param  Msg the TEMP part of the stream
- * @param  Instance the device instance
+ * @brief  Take the accelerometer sample of a tick
+ * @param  Sample [mg]
  * @retval None
  */
-static void Temperature_Sensor_Handler(TMsg *Msg, uint32_t Instance)
+static void Accelero_Sample(const IKS01A2_MOTION_SENSOR_Axes_t *Sample)
 {
-  float temp_value;
+  float AccZ_prev = (float)AccValue.z;
 
-  if ((SensorsEnabled & TEMPERATURE_SENSOR) == TEMPERATURE_SENSOR)
+  AccValue = *Sample;
+  if(AccZ_prev*(float)AccValue.z<0)
+	TurnOver=1;
+}
+/**
+ * @brief  Handles the GYR axes data getting/sending
+ * @param  Msg the GYR part of the stream
+ * @param  Instance the device instance
+ * @retval None
+ */
+static void Gyro_Sensor_Handler(TMsg *Msg, uint32_t Instance)
+{
+  if (((SensorsEnabled & GYROSCOPE_SENSOR) == GYROSCOPE_SENSOR) && (Xfer_Read(&GyrXfer) != 0))
   {
-    (void)IKS01A2_ENV_SENSOR_GetValue(Instance, ENV_TEMPERATURE, &temp_value);
+    Raw_Axes(GyrRaw, GyrSensitivity, &GyrValue);
   }
 }
 
 /**
- * @brief  Handles the HUM axes data getting/sending
- * @param  Msg the HUM part of the stream
+ * @brief  Handles the PRESS sensor data getting/sending.
+ * @param  Msg the PRESS part of the stream
  * @param  Instance the device instance
  * @retval None
  */
-static void Humidity_Sensor_Handler(TMsg *Msg, uint32_t Instance)
+static void Pressure_Sensor_Handler(TMsg *Msg, uint32_t Instance)
 {
-  float hum_value;
-
-  if ((SensorsEnabled & HUMIDITY_SENSOR) == HUMIDITY_SENSOR)
+  if (((SensorsEnabled & PRESSURE_SENSOR) == PRESSURE_SENSOR) && (Xfer_Read(&PresXfer) != 0))
   {
-    (void)IKS01A2_ENV_SENSOR_GetValue(Instance, ENV_HUMIDITY, &hum_value);
+    /* 24-bit two's complement, 4096 LSB/hPa */
+    int32_t raw = (int32_t)(((uint32_t)PresRaw[2] << 24) | ((uint32_t)PresRaw[1] << 16) | ((uint32_t)PresRaw[0] << 8)) / 256;
+
+    PresValue = (float)raw / 4096.0f;
   }
 }
 
@@ -656,6 +1164,61 @@ void RTC_TimeRegulate(uint8_t hh, uint8_t mm, uint8_t ss)
   }
 }
 
+/**
+ * @brief  Gets the current date and time
+ * @param  Date year (from 2000), month, day
+ * @param  Time hours, minutes, seconds
+ * @retval None
+ */
+void RTC_GetDateTime(uint8_t *Date, uint8_t *Time)
+{
+  RTC_DateTypeDef sdatestructure;
+  RTC_TimeTypeDef stimestructure;
+
+  /* Reading the time locks the date until it is read, so time first */
+  (void)HAL_RTC_GetTime(&RtcHandle, &stimestructure, FORMAT_BIN);
+  (void)HAL_RTC_GetDate(&RtcHandle, &sdatestructure, FORMAT_BIN);
+
+  Date[0] = sdatestructure.Year;
+  Date[1] = sdatestructure.Month;
+  Date[2] = sdatestructure.Date;
+  Time[0] = stimestructure.Hours;
+  Time[1] = stimestructure.Minutes;
+  Time[2] = stimestructure.Seconds;
+}
+
+/**
+ * @brief  CRC-32 (zlib) of a block on the CRC peripheral
+ * @param  Data the bytes
+ * @param  Len number of bytes
+ * @retval CRC
+ * @details Input bytes and output bit reversed, result inverted. The
+ *          reset configuration is put back for the motion libraries.
+ */
+uint32_t CRC_Block32(const uint8_t *Data, uint32_t Len)
+{
+  uint32_t crc;
+
+  CrcHandle.Instance = CRC;
+  CrcHandle.Init.DefaultPolynomialUse = DEFAULT_POLYNOMIAL_ENABLE;
+  CrcHandle.Init.DefaultInitValueUse = DEFAULT_INIT_VALUE_ENABLE;
+  CrcHandle.Init.InputDataInversionMode = CRC_INPUTDATA_INVERSION_BYTE;
+  CrcHandle.Init.OutputDataInversionMode = CRC_OUTPUTDATA_INVERSION_ENABLE;
+  CrcHandle.InputDataFormat = CRC_INPUTDATA_FORMAT_BYTES;
+  if (HAL_CRC_Init(&CrcHandle) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  /* MISRA C-2012 rule 11.8 violation for purpose */
+  crc = ~HAL_CRC_Calculate(&CrcHandle, (uint32_t *)Data, Len);
+
+  CrcHandle.Init.InputDataInversionMode = CRC_INPUTDATA_INVERSION_NONE;
+  CrcHandle.Init.OutputDataInversionMode = CRC_OUTPUTDATA_INVERSION_DISABLE;
+  CrcHandle.InputDataFormat = CRC_INPUTDATA_FORMAT_WORDS;
+  (void)HAL_CRC_Init(&CrcHandle);
+  return crc;
+}
+
 /**
  * @brief  This function is executed in case of error occurrence
  * @param  None
@@ -686,6 +1249,17 @@ void HAL_GPIO_EXTI_Callback(uint16_t GPIOPin)
 	  ProgramState = (ProgramState+1)%2;
 	}
   }
+  else if (GPIOPin == ACC_INT1_PIN)
+  {
+	if (AcqLow != 0U)
+	{
+	  WakeRequest = 1;
+	}
+	else
+	{
+	  Fifo_Submit();
+	}
+  }
 }
 
 /**
@@ -698,8 +1272,16 @@ void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
 {
   if (htim->Instance == TIM_ALGO)
   {
-	SensorReadRequest = 1;
-	TimeStamp += ALGO_PERIOD;
+	uint32_t periods = TickStride;
+
+	/* The period that elapsed counted, the next one takes a new stride */
+	TimeStamp += (int64_t)periods * ALGO_PERIOD;
+	if (TickStrideNext != TickStride)
+	{
+	  TickStride = TickStrideNext;
+	  __HAL_TIM_SET_AUTORELOAD(&AlgoTimHandle, (TickStride * TIM_TICK) - 1U);
+	}
+	Tick_Submit(periods);
   }
 }
 
@@ -23,6 +23,11 @@
 #include "stm32l4xx_hal.h"
 
 #define TIMEOUT_DURATION 1000
+
+/* I2C1 RX on DMA1 channel 7; channel 6, the TX one, receives USART3 */
+#define BUS_I2C1_DMA_RX_CHANNEL   DMA1_Channel7
+#define BUS_I2C1_DMA_RX_REQUEST   DMA_REQUEST_3
+#define BUS_I2C1_DMA_RX_IRQn      DMA1_Channel7_IRQn
 /** @addtogroup BSP
   * @{
   */
@@ -40,9 +45,17 @@ __weak HAL_StatusTypeDef MX_I2C1_Init(I2C_HandleTypeDef *hi2c);
   * @{
   */
 I2C_HandleTypeDef hbusi2c1;
+static DMA_HandleTypeDef hdmai2c1rx;
 #if (USE_HAL_I2C_REGISTER_CALLBACKS == 1)
 static uint32_t IsI2C1MspCbValid = 0;
 #endif /* USE_HAL_I2C_REGISTER_CALLBACKS */
+
+/* Sequences submitted, run one after the other by the completion interrupts */
+static BSP_I2C1_Xfer_t *XferQueue[BSP_I2C1_QUEUE_LEN];
+static volatile uint32_t XferHead = 0;
+static volatile uint32_t XferCount = 0;
+static BSP_I2C1_Xfer_t *volatile XferActive = NULL;
+static volatile uint8_t BusHeld = 0;  /* a blocking transfer has the bus */
 /**
   * @}
   */
@@ -53,6 +66,11 @@ static uint32_t IsI2C1MspCbValid = 0;
 
 static void I2C1_MspInit(I2C_HandleTypeDef *i2cHandle);
 static void I2C1_MspDeInit(I2C_HandleTypeDef *i2cHandle);
+static void I2C1_Hold(void);
+static void I2C1_Release(void);
+static void I2C1_Run(void);
+static void I2C1_Step(BSP_I2C1_Xfer_t *Xfer);
+static void I2C1_XferEnd(int32_t Status);
 
 /**
   * @}
@@ -156,6 +174,7 @@ int32_t BSP_I2C1_WriteReg(uint16_t DevAddr, uint16_t Reg, uint8_t *pData, uint16
 {
   int32_t ret = BSP_ERROR_BUS_FAILURE;
 
+  I2C1_Hold();
   if (HAL_I2C_Mem_Write(&hbusi2c1, (uint8_t)DevAddr,
                         (uint16_t)Reg, I2C_MEMADD_SIZE_8BIT,
                         (uint8_t *)pData, len, TIMEOUT_DURATION) == HAL_OK)
@@ -163,6 +182,7 @@ int32_t BSP_I2C1_WriteReg(uint16_t DevAddr, uint16_t Reg, uint8_t *pData, uint16
     ret = BSP_ERROR_NONE;
   }
 
+  I2C1_Release();
   return ret;
 }
 
@@ -176,6 +196,7 @@ int32_t  BSP_I2C1_ReadReg(uint16_t DevAddr, uint16_t Reg, uint8_t *pData, uint16
 {
   int32_t ret = BSP_ERROR_BUS_FAILURE;
 
+  I2C1_Hold();
   if (HAL_I2C_Mem_Read(&hbusi2c1, DevAddr, (uint16_t)Reg,
                        I2C_MEMADD_SIZE_8BIT, pData,
                        len, TIMEOUT_DURATION) == HAL_OK)
@@ -183,6 +204,7 @@ int32_t  BSP_I2C1_ReadReg(uint16_t DevAddr, uint16_t Reg, uint8_t *pData, uint16
     ret = HAL_OK;
   }
 
+  I2C1_Release();
   return ret;
 }
 
@@ -197,6 +219,7 @@ int32_t BSP_I2C1_WriteReg16(uint16_t DevAddr, uint16_t Reg, uint8_t *pData, uint
 {
   int32_t ret = BSP_ERROR_BUS_FAILURE;
 
+  I2C1_Hold();
   if (HAL_I2C_Mem_Write(&hbusi2c1, (uint8_t)DevAddr,
                         (uint16_t)Reg, I2C_MEMADD_SIZE_16BIT,
                         (uint8_t *)pData, len, TIMEOUT_DURATION) == HAL_OK)
@@ -204,6 +227,7 @@ int32_t BSP_I2C1_WriteReg16(uint16_t DevAddr, uint16_t Reg, uint8_t *pData, uint
     ret = BSP_ERROR_NONE;
   }
 
+  I2C1_Release();
   return ret;
 }
 
@@ -217,6 +241,7 @@ int32_t  BSP_I2C1_ReadReg16(uint16_t DevAddr, uint16_t Reg, uint8_t *pData, uint
 {
   int32_t ret = BSP_ERROR_BUS_FAILURE;
 
+  I2C1_Hold();
   if (HAL_I2C_Mem_Read(&hbusi2c1, DevAddr, (uint16_t)Reg,
                        I2C_MEMADD_SIZE_16BIT, pData,
                        len, TIMEOUT_DURATION) == HAL_OK)
@@ -224,6 +249,7 @@ int32_t  BSP_I2C1_ReadReg16(uint16_t DevAddr, uint16_t Reg, uint8_t *pData, uint
     ret = BSP_ERROR_NONE;
   }
 
+  I2C1_Release();
   return ret;
 }
 
@@ -238,11 +264,13 @@ int32_t BSP_I2C1_Send(uint16_t DevAddr, uint8_t *pData, uint16_t len)
 {
   int32_t ret = BSP_ERROR_BUS_FAILURE;
 
+  I2C1_Hold();
   if (HAL_I2C_Master_Transmit(&hbusi2c1, DevAddr, pData, len, TIMEOUT_DURATION) == HAL_OK)
   {
     ret = len;
   }
 
+  I2C1_Release();
   return ret;
 }
 
@@ -257,11 +285,13 @@ int32_t BSP_I2C1_Recv(uint16_t DevAddr, uint8_t *pData, uint16_t len)
 {
   int32_t ret = BSP_ERROR_BUS_FAILURE;
 
+  I2C1_Hold();
   if (HAL_I2C_Master_Receive(&hbusi2c1, DevAddr, pData, len, TIMEOUT_DURATION) == HAL_OK)
   {
     ret = len;
   }
 
+  I2C1_Release();
   return ret;
 }
 
@@ -290,6 +320,93 @@ int32_t BSP_I2C1_SendRecv(uint16_t DevAddr, uint8_t *pTxdata, uint8_t *pRxdata,
   return ret;
 }
 
+/**
+  * @brief  Queue a sequence of register transfers, linked by Next
+  * @param  First: first transfer of the sequence
+  * @retval BSP status, BSP_ERROR_BUSY when BSP_I2C1_QUEUE_LEN sequences wait
+  * @note   Callable from interrupts. The transfers run back to back in the
+  *         background once the ones queued before are done; each gets its
+  *         Status and Done call as it ends. A failed transfer fails the rest
+  *         of its sequence. The transfers and their buffers belong to the bus
+  *         until the last Done call.
+  */
+int32_t BSP_I2C1_Submit(BSP_I2C1_Xfer_t *First)
+{
+  BSP_I2C1_Xfer_t *xfer;
+  uint32_t primask;
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  if (XferCount == BSP_I2C1_QUEUE_LEN)
+  {
+    __set_PRIMASK(primask);
+    return BSP_ERROR_BUSY;
+  }
+  for (xfer = First; xfer != NULL; xfer = xfer->Next)
+  {
+    xfer->Status = BSP_ERROR_BUSY;
+  }
+  XferQueue[(XferHead + XferCount) % BSP_I2C1_QUEUE_LEN] = First;
+  XferCount++;
+  I2C1_Run();
+  __set_PRIMASK(primask);
+
+  return BSP_ERROR_NONE;
+}
+
+/**
+  * @brief  Tell whether submitted transfers are still queued or running
+  * @retval 1 if so, 0 if the bus is idle
+  */
+int32_t BSP_I2C1_Pending(void)
+{
+  return ((XferActive != NULL) || (XferCount != 0U)) ? 1 : 0;
+}
+
+/**
+  * @brief  Wait for the sequences submitted so far to end
+  * @retval None
+  * @note   Not from an interrupt of the same or higher priority than I2C1's
+  */
+void BSP_I2C1_Wait(void)
+{
+  I2C1_Hold();
+  I2C1_Release();
+}
+
+/**
+  * @brief  Memory read by DMA complete
+  * @param  hi2c: I2C handle
+  * @retval None
+  */
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+  (void)hi2c;
+  I2C1_XferEnd(BSP_ERROR_NONE);
+}
+
+/**
+  * @brief  Memory write by interrupt complete
+  * @param  hi2c: I2C handle
+  * @retval None
+  */
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+  (void)hi2c;
+  I2C1_XferEnd(BSP_ERROR_NONE);
+}
+
+/**
+  * @brief  Transfer error (NACK, arbitration lost, bus error)
+  * @param  hi2c: I2C handle
+  * @retval None
+  */
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+  (void)hi2c;
+  I2C1_XferEnd(BSP_ERROR_BUS_FAILURE);
+}
+
 #if (USE_HAL_I2C_REGISTER_CALLBACKS == 1)
 /**
   * @brief Register Default BSP I2C1 Bus Msp Callbacks
@@ -353,6 +470,139 @@ int32_t BSP_GetTick(void)
   return HAL_GetTick();
 }
 
+/**
+  * @brief  Take the bus for a blocking transfer, once the queued sequences
+  *         are done; those submitted meanwhile wait for I2C1_Release
+  * @retval None
+  */
+static void I2C1_Hold(void)
+{
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  while (XferActive != NULL)
+  {
+    /* Wakes on the pending completion interrupt even though it is masked */
+    __WFI();
+    __set_PRIMASK(primask);
+    __disable_irq();
+  }
+  BusHeld = 1;
+  __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  Give the bus back to the queue after a blocking transfer
+  * @retval None
+  */
+static void I2C1_Release(void)
+{
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  BusHeld = 0;
+  I2C1_Run();
+  __set_PRIMASK(primask);
+}
+
+/**
+  * @brief  Start the active transfer, taking the next sequence if there is
+  *         none, and go past the ones that are empty or fail to start
+  * @retval None
+  * @note   Called with the interrupts masked or from the I2C1 interrupts
+  */
+static void I2C1_Run(void)
+{
+  BSP_I2C1_Xfer_t *xfer;
+  HAL_StatusTypeDef status;
+
+  for (;;)
+  {
+    if (XferActive == NULL)
+    {
+      if ((BusHeld != 0U) || (XferCount == 0U))
+      {
+        return;
+      }
+      XferActive = XferQueue[XferHead];
+      XferHead = (XferHead + 1U) % BSP_I2C1_QUEUE_LEN;
+      XferCount--;
+    }
+
+    xfer = XferActive;
+    if (xfer->Len == 0U)
+    {
+      xfer->Status = BSP_ERROR_NONE;
+    }
+    else
+    {
+      if (xfer->Write != 0U)
+      {
+        status = HAL_I2C_Mem_Write_IT(&hbusi2c1, xfer->DevAddr, xfer->Reg, I2C_MEMADD_SIZE_8BIT,
+                                      xfer->pData, xfer->Len);
+      }
+      else
+      {
+        status = HAL_I2C_Mem_Read_DMA(&hbusi2c1, xfer->DevAddr, xfer->Reg, I2C_MEMADD_SIZE_8BIT,
+                                      xfer->pData, xfer->Len);
+      }
+      if (status == HAL_OK)
+      {
+        /* Goes on in I2C1_XferEnd */
+        return;
+      }
+      xfer->Status = BSP_ERROR_BUS_FAILURE;
+    }
+    I2C1_Step(xfer);
+  }
+}
+
+/**
+  * @brief  Hand an ended transfer to its owner and make the next one of its
+  *         sequence active, or fail the rest of it
+  * @param  Xfer: the transfer, its Status set
+  * @retval None
+  */
+static void I2C1_Step(BSP_I2C1_Xfer_t *Xfer)
+{
+  BSP_I2C1_Xfer_t *next;
+
+  if (Xfer->Done != NULL)
+  {
+    Xfer->Done(Xfer);
+  }
+  next = Xfer->Next;
+  while ((Xfer->Status != BSP_ERROR_NONE) && (next != NULL))
+  {
+    next->Status = Xfer->Status;
+    if (next->Done != NULL)
+    {
+      next->Done(next);
+    }
+    next = next->Next;
+  }
+  XferActive = next;
+}
+
+/**
+  * @brief  The active transfer ended, start the one after it
+  * @param  Status: BSP status of the transfer
+  * @retval None
+  */
+static void I2C1_XferEnd(int32_t Status)
+{
+  BSP_I2C1_Xfer_t *xfer = XferActive;
+
+  if (xfer == NULL)
+  {
+    /* A blocking transfer, nothing queued */
+    return;
+  }
+  xfer->Status = Status;
+  I2C1_Step(xfer);
+  I2C1_Run();
+}
+
 /* I2C1 init function */
 
 __weak HAL_StatusTypeDef MX_I2C1_Init(I2C_HandleTypeDef *hi2c)
@@ -405,6 +655,28 @@ static void I2C1_MspInit(I2C_HandleTypeDef *i2cHandle)
 
   /* Peripheral clock enable */
   __HAL_RCC_I2C1_CLK_ENABLE();
+
+  /* Reads of the transfer queue by DMA, writes by interrupt */
+  __HAL_RCC_DMA1_CLK_ENABLE();
+  hdmai2c1rx.Instance                 = BUS_I2C1_DMA_RX_CHANNEL;
+  hdmai2c1rx.Init.Request             = BUS_I2C1_DMA_RX_REQUEST;
+  hdmai2c1rx.Init.Direction           = DMA_PERIPH_TO_MEMORY;
+  hdmai2c1rx.Init.PeriphInc           = DMA_PINC_DISABLE;
+  hdmai2c1rx.Init.MemInc              = DMA_MINC_ENABLE;
+  hdmai2c1rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  hdmai2c1rx.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+  hdmai2c1rx.Init.Mode                = DMA_NORMAL;
+  hdmai2c1rx.Init.Priority            = DMA_PRIORITY_HIGH;
+  (void)HAL_DMA_Init(&hdmai2c1rx);
+  __HAL_LINKDMA(i2cHandle, hdmarx, hdmai2c1rx);
+
+  /* Same priority as TIM_ALGO and the INT1 line, which submit sequences */
+  HAL_NVIC_SetPriority(BUS_I2C1_DMA_RX_IRQn, 0x0F, 0);
+  HAL_NVIC_EnableIRQ(BUS_I2C1_DMA_RX_IRQn);
+  HAL_NVIC_SetPriority(I2C1_EV_IRQn, 0x0F, 0);
+  HAL_NVIC_EnableIRQ(I2C1_EV_IRQn);
+  HAL_NVIC_SetPriority(I2C1_ER_IRQn, 0x0F, 0);
+  HAL_NVIC_EnableIRQ(I2C1_ER_IRQn);
   /* USER CODE BEGIN I2C1_MspInit 1 */
 
   /* USER CODE END I2C1_MspInit 1 */
@@ -424,6 +696,11 @@ static void I2C1_MspDeInit(I2C_HandleTypeDef *i2cHandle)
   */
   HAL_GPIO_DeInit(GPIOB, GPIO_PIN_8 | GPIO_PIN_9);
 
+  HAL_NVIC_DisableIRQ(I2C1_EV_IRQn);
+  HAL_NVIC_DisableIRQ(I2C1_ER_IRQn);
+  HAL_NVIC_DisableIRQ(BUS_I2C1_DMA_RX_IRQn);
+  (void)HAL_DMA_DeInit(i2cHandle->hdmarx);
+
   /* USER CODE BEGIN I2C1_MspDeInit 1 */
 
   /* USER CODE END I2C1_MspDeInit 1 */
@@ -0,0 +1,102 @@
+/**
+ ******************************************************************************
+ * @file    rate_gov.c
+ * @brief   Sampling rate picked from the statuses: asleep, or still in the
+ *          same posture, for RATE_GOV_CALM_MS and the rate drops; any other
+ *          status, or the accelerometer's wake-up interrupt, brings it back
+ *          at once. Dropping takes a long calm run and returning a single
+ *          sign of motion, so the rate does not flap at the boundary.
+ ******************************************************************************
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "rate_gov.h"
+#include "status_frame.h"
+
+/** @addtogroup MOTION_APPLICATIONS MOTION APPLICATIONS
+ * @{
+ */
+
+/** @addtogroup ACTIVITY_RECOGNITION_WRIST ACTIVITY RECOGNITION WRIST
+ * @{
+ */
+
+/* Private functions ---------------------------------------------------------*/
+/**
+ * @brief  Tell whether a status shows the user at rest
+ * @param  Activity the STATUS_ACT_xx code
+ * @param  Flags the STATUS_FLAG_xx bits
+ * @retval 1 if it does, 0 otherwise
+ */
+static int RateGov_IsCalm(uint8_t Activity, uint8_t Flags)
+{
+  if ((Flags & STATUS_FLAG_SLEEP) != 0U)
+  {
+    return 1;
+  }
+  return ((Activity == STATUS_ACT_STATIONARY) || (Activity == STATUS_ACT_SITTING)
+          || (Activity == STATUS_ACT_LYING)) ? 1 : 0;
+}
+
+/* Exported functions ------------------------------------------------------- */
+/**
+ * @brief  Start at full rate
+ * @param  Gov the governor
+ * @retval None
+ */
+void RateGov_Init(TRateGov *Gov)
+{
+  Gov->Low = 0;
+  Gov->Calm = 0;
+  Gov->CalmSinceMs = 0;
+}
+
+/**
+ * @brief  Take the status of a tick
+ * @param  Gov the governor
+ * @param  TimeMs [ms] time of the tick
+ * @param  Activity the STATUS_ACT_xx code
+ * @param  Flags the STATUS_FLAG_xx bits
+ * @retval None
+ */
+void RateGov_Status(TRateGov *Gov, int64_t TimeMs, uint8_t Activity, uint8_t Flags)
+{
+  if (RateGov_IsCalm(Activity, Flags) == 0)
+  {
+    Gov->Low = 0;
+    Gov->Calm = 0;
+  }
+  else if (Gov->Calm == 0U)
+  {
+    Gov->Calm = 1;
+    Gov->CalmSinceMs = TimeMs;
+  }
+  else if ((TimeMs - Gov->CalmSinceMs) >= (int64_t)RATE_GOV_CALM_MS)
+  {
+    Gov->Low = 1;
+  }
+  else
+  {
+    /* Not calm for long enough yet */
+  }
+}
+
+/**
+ * @brief  Back to full rate: the accelerometer saw motion, or every tick is
+ *         wanted; the calm run starts over
+ * @param  Gov the governor
+ * @retval None
+ */
+void RateGov_Wake(TRateGov *Gov)
+{
+  Gov->Low = 0;
+  Gov->Calm = 0;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
@@ -0,0 +1,188 @@
+/**
+ ******************************************************************************
+ * @file    sensor_subs.c
+ * @brief   Sensor subscriptions: each algorithm declares the channels it
+ *          reads and at what rate, each mode the algorithms it runs. The
+ *          acquisition reads and powers only what the mode in use, and the
+ *          batches streamed, subscribe to.
+ ******************************************************************************
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "main.h"
+#include "sensor_subs.h"
+
+/** @addtogroup MOTION_APPLICATIONS MOTION APPLICATIONS
+ * @{
+ */
+
+/** @addtogroup ACTIVITY_RECOGNITION_WRIST ACTIVITY RECOGNITION WRIST
+ * @{
+ */
+
+/* Private defines -----------------------------------------------------------*/
+/* Algorithms, bits of the ModeAlgos entries */
+#define SUBS_AW  0x01U   /* MotionAW, activity recognition wrist */
+#define SUBS_SM  0x02U   /* MotionSM, sleep monitor */
+#define SUBS_FD  0x04U   /* MotionFD, fall detection */
+#define SUBS_SD  0x08U   /* MotionSD, standing vs sitting desk */
+
+/* Private typedef -----------------------------------------------------------*/
+typedef struct
+{
+  uint8_t Algo;          /* SUBS_xx */
+  uint32_t Sensor;       /* xx_SENSOR bit */
+  uint32_t Rate;         /* [Hz] */
+} TSensorSub;
+
+/* Private variables ---------------------------------------------------------*/
+/* Channels each algorithm reads, and at what rate */
+static const TSensorSub SensorSubs[] =
+{
+  /* Algorithm  Channel               Rate [Hz] */
+  {SUBS_AW,     ACCELEROMETER_SENSOR, 16U},
+  {SUBS_SM,     ACCELEROMETER_SENSOR, 16U},
+  {SUBS_FD,     ACCELEROMETER_SENSOR, 16U},
+  {SUBS_FD,     PRESSURE_SENSOR,      16U},
+  {SUBS_SD,     ACCELEROMETER_SENSOR, 16U},
+};
+
+/* Algorithms each mode runs, by program_state_t; none runs MotionFD yet */
+static const uint8_t ModeAlgos[] =
+{
+  SUBS_AW,               /* AW_MODE */
+  SUBS_SD,               /* SD_MODE */
+  SUBS_SM | SUBS_AW,     /* SM_MODE, MotionAW tells what the user does awake */
+};
+
+/* Private functions ---------------------------------------------------------*/
+/**
+ * @brief  Subscribe to a channel, at the highest rate asked
+ * @param  Plan the plan
+ * @param  Sensor one xx_SENSOR bit
+ * @param  Rate [Hz]
+ * @retval None
+ */
+static void Plan_Add(TSensorPlan *Plan, uint32_t Sensor, uint32_t Rate)
+{
+  uint32_t ch;
+
+  for (ch = 0; ch < SENSOR_SUBS_CHANNELS; ch++)
+  {
+    if (Sensor == (1UL << ch))
+    {
+      Plan->Sensors |= Sensor;
+      if (Rate > Plan->Rate[ch])
+      {
+        Plan->Rate[ch] = Rate;
+      }
+    }
+  }
+}
+
+/* Exported functions ------------------------------------------------------- */
+/**
+ * @brief  Work out what to read for a mode
+ * @param  Plan the plan
+ * @param  Mode the program_state_t
+ * @param  Extra xx_SENSOR bits read on every tick besides, for the batches
+ * @param  Allowed xx_SENSOR bits the host left enabled
+ * @param  AlgoFreq [Hz] rate of the algorithm ticks
+ * @retval None
+ * @details Every channel is read on the first tick after.
+ */
+void SensorSubs_Plan(TSensorPlan *Plan, uint8_t Mode, uint32_t Extra, uint32_t Allowed, uint32_t AlgoFreq)
+{
+  uint8_t algos = (Mode < sizeof(ModeAlgos)) ? ModeAlgos[Mode] : 0U;
+  uint32_t i;
+  uint32_t ch;
+
+  (void)memset(Plan, 0, sizeof(*Plan));
+  for (i = 0; i < (sizeof(SensorSubs) / sizeof(SensorSubs[0])); i++)
+  {
+    if ((SensorSubs[i].Algo & algos) != 0U)
+    {
+      Plan_Add(Plan, SensorSubs[i].Sensor, SensorSubs[i].Rate);
+    }
+  }
+  for (ch = 0; ch < SENSOR_SUBS_CHANNELS; ch++)
+  {
+    if ((Extra & (1UL << ch)) != 0U)
+    {
+      Plan_Add(Plan, 1UL << ch, AlgoFreq);
+    }
+  }
+
+  Plan->Sensors &= Allowed;
+  for (ch = 0; ch < SENSOR_SUBS_CHANNELS; ch++)
+  {
+    if ((Plan->Sensors & (1UL << ch)) == 0U)
+    {
+      Plan->Rate[ch] = 0;
+    }
+    else
+    {
+      Plan->Period[ch] = (Plan->Rate[ch] >= AlgoFreq) ? 1U : (AlgoFreq / Plan->Rate[ch]);
+    }
+  }
+}
+
+/**
+ * @brief  Channels to read on a tick
+ * @param  Plan the plan
+ * @param  Periods algorithm periods since the tick before
+ * @retval xx_SENSOR bits
+ */
+uint32_t SensorSubs_Due(TSensorPlan *Plan, uint32_t Periods)
+{
+  uint32_t due = 0;
+  uint32_t ch;
+
+  for (ch = 0; ch < SENSOR_SUBS_CHANNELS; ch++)
+  {
+    if ((Plan->Sensors & (1UL << ch)) == 0U)
+    {
+      /* Not subscribed */
+    }
+    else if (Plan->Left[ch] <= Periods)
+    {
+      due |= 1UL << ch;
+      Plan->Left[ch] = Plan->Period[ch];
+    }
+    else
+    {
+      Plan->Left[ch] -= Periods;
+    }
+  }
+  return due;
+}
+
+/**
+ * @brief  Highest read rate among some channels
+ * @param  Plan the plan
+ * @param  Sensors xx_SENSOR bits
+ * @retval [Hz], 0 if none of them is read
+ */
+uint32_t SensorSubs_Rate(const TSensorPlan *Plan, uint32_t Sensors)
+{
+  uint32_t rate = 0;
+  uint32_t ch;
+
+  for (ch = 0; ch < SENSOR_SUBS_CHANNELS; ch++)
+  {
+    if (((Plan->Sensors & Sensors & (1UL << ch)) != 0U) && (Plan->Rate[ch] > rate))
+    {
+      rate = Plan->Rate[ch];
+    }
+  }
+  return rate;
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
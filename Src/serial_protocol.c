@@ -31,11 +31,183 @@
  */
 
 /* Private typedef -----------------------------------------------------------*/
+/* Word-at-a-time scanning: 4 bytes on the Cortex-M4, 8 on a 64 bit host */
+typedef uintptr_t TMsg_Word;
+
 /* Private define ------------------------------------------------------------*/
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define TMSG_SWAR               1
+#else
+#define TMSG_SWAR               0  /* the first-match lookup below assumes little endian */
+#endif
+
+#define TMSG_WORD_SIZE          sizeof(TMsg_Word)
+#define TMSG_WORD_ONES          ((TMsg_Word)~(TMsg_Word)0 / 0xFFU)  /* 0x01 in every byte */
+#define TMSG_WORD_HIGHS         (TMSG_WORD_ONES * 0x80U)
+#define TMSG_WORD_EOF           (TMSG_WORD_ONES * (uint8_t)TMsg_EOF)
+#define TMSG_WORD_NOT_LSB       (TMSG_WORD_ONES * 0xFEU)
+
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
 /* Private function prototypes -----------------------------------------------*/
 /* Private functions ---------------------------------------------------------*/
+#if (TMSG_SWAR != 0)
+/**
+ * @brief  Flag the bytes of a word that are TMsg_EOF or TMsg_BS
+ * @note   TMsg_EOF and TMsg_BS only differ in bit 0, so both become 0 once
+ *         XORed with TMsg_EOF and masked; the classic zero byte test then sets
+ *         bit 7 of the first such byte. Bytes above it may be flagged too
+ *         (borrow), so only the lowest flag is meaningful.
+ * @param  Word the bytes, little endian
+ * @retval 0 if there is none
+ */
+static inline TMsg_Word TMsg_WordSpecial(TMsg_Word Word)
+{
+  TMsg_Word v = (Word ^ TMSG_WORD_EOF) & TMSG_WORD_NOT_LSB;
+
+  return (v - TMSG_WORD_ONES) & ~v & TMSG_WORD_HIGHS;
+}
+
+/**
+ * @brief  Index of the first flagged byte
+ * @param  Flags non zero result of TMsg_WordSpecial
+ * @retval Byte index
+ */
+static inline uint32_t TMsg_WordFirst(TMsg_Word Flags)
+{
+  return (uint32_t)__builtin_ctzll((unsigned long long)Flags) >> 3;
+}
+#endif
+
+/**
+ * @brief  Reverse Byte stuffing process for one byte of a Msg
+ * @param  Dest destination
+ * @param  Source input data
+ * @param  Count bytes of Dest written so far
+ * @param  State 1 after TMsg_BS
+ * @retval 1 if the operation succeeds, 0 if an error occurs
+ */
+static inline int ReverseByteStuffStep(TMsg *Dest, uint8_t Source, uint32_t *Count, int32_t *State)
+{
+  if (*Count >= (uint32_t)TMsg_MaxLen)
+  {
+    return 0; // too long for a TMsg
+  }
+  if (*State == 0)
+  {
+    if (Source == (uint8_t)TMsg_BS)
+    {
+      *State = 1;
+    }
+    else
+    {
+      Dest->Data[*Count] = Source;
+      (*Count)++;
+    }
+  }
+  else
+  {
+    if (Source == (uint8_t)TMsg_BS)
+    {
+      Dest->Data[*Count] = TMsg_BS;
+      (*Count)++;
+    }
+    else
+    {
+      if (Source == (uint8_t)TMsg_BS_EOF)
+      {
+        Dest->Data[*Count] = TMsg_EOF;
+        (*Count)++;
+      }
+      else
+      {
+        return 0; // invalid sequence
+      }
+    }
+    *State = 0;
+  }
+  return 1;
+}
+
+/**
+ * @brief  Reverse Byte stuffing process for a Msg, a byte at a time
+ * @param  Dest destination
+ * @param  Source source
+ * @param  End first byte past the source, NULL if unknown
+ * @retval 1 if the operation succeeds, 0 if an error occurs
+ */
+static int ReverseByteStuffBytes(TMsg *Dest, uint8_t *Source, uint8_t *End)
+{
+  uint32_t count = 0;
+  int32_t state = 0;
+
+  while ((Source != End) && ((*Source) != (uint8_t)TMsg_EOF))
+  {
+    if (ReverseByteStuffStep(Dest, *Source, &count, &state) == 0)
+    {
+      return 0;
+    }
+    Source++;
+  }
+  if ((Source == End) || (state != 0))
+  {
+    return 0;
+  }
+  Dest->Len = count;
+  return 1;
+}
+
+#if (TMSG_SWAR != 0)
+/**
+ * @brief  Reverse Byte stuffing process for a Msg, literal bytes a word at a
+ *         time
+ * @param  Dest destination
+ * @param  Source source
+ * @param  Len number of bytes at Source
+ * @retval 1 if the operation succeeds, 0 if an error occurs
+ */
+static int ReverseByteStuffWords(TMsg *Dest, uint8_t *Source, uint32_t Len)
+{
+  uint32_t count = 0;
+  uint32_t i = 0;
+  int32_t state = 0;
+
+  while ((i < Len) && (Source[i] != (uint8_t)TMsg_EOF))
+  {
+    /* Copy the literal bytes up to the first TMsg_EOF or TMsg_BS of a word
+       lying within Len */
+    if ((state == 0) && ((Len - i) >= TMSG_WORD_SIZE))
+    {
+      TMsg_Word word;
+      TMsg_Word flags;
+      uint32_t run;
+
+      (void)memcpy(&word, &Source[i], TMSG_WORD_SIZE);
+      flags = TMsg_WordSpecial(word);
+      run = (flags == 0U) ? (uint32_t)TMSG_WORD_SIZE : TMsg_WordFirst(flags);
+      if ((run != 0U) && ((count + run) <= (uint32_t)TMsg_MaxLen))
+      {
+        (void)memcpy(&Dest->Data[count], &word, run);
+        count += run;
+        i += run;
+        continue;
+      }
+    }
+    if (ReverseByteStuffStep(Dest, Source[i], &count, &state) == 0)
+    {
+      return 0;
+    }
+    i++;
+  }
+  if ((i == Len) || (state != 0))
+  {
+    return 0;
+  }
+  Dest->Len = count;
+  return 1;
+}
+#endif
+
 /* Exported functions ------------------------------------------------------- */
 /**
  * @brief  Byte stuffing process for one byte
@@ -76,10 +248,37 @@ int ByteStuffCopyByte(uint8_t *Dest, uint8_t Source)
  */
 int ByteStuffCopy(uint8_t *Dest, TMsg *Source)
 {
-  uint32_t i;
+  uint32_t i = 0;
   int32_t count = 0;
 
-  for (i = 0; i < Source->Len; i++)
+#if (TMSG_SWAR != 0)
+  /* Copy whole words while they hold nothing to escape, then up to and
+     including the first byte that needs it */
+  while ((Source->Len - i) >= TMSG_WORD_SIZE)
+  {
+    TMsg_Word word;
+    TMsg_Word flags;
+    uint32_t run;
+
+    (void)memcpy(&word, &Source->Data[i], TMSG_WORD_SIZE);
+    flags = TMsg_WordSpecial(word);
+    if (flags == 0U)
+    {
+      (void)memcpy(&Dest[count], &word, TMSG_WORD_SIZE);
+      i += TMSG_WORD_SIZE;
+      count += (int32_t)TMSG_WORD_SIZE;
+      continue;
+    }
+    run = TMsg_WordFirst(flags);
+    (void)memcpy(&Dest[count], &word, run);
+    count += (int32_t)run;
+    i += run;
+    count += ByteStuffCopyByte(&Dest[count], Source->Data[i]);
+    i++;
+  }
+#endif
+
+  for (; i < Source->Len; i++)
   {
     count += ByteStuffCopyByte(&Dest[count], Source->Data[i]);
   }
@@ -150,57 +349,31 @@ int ReverseByteStuffCopyByte2(uint8_t Source0, uint8_t Source1, uint8_t *Dest)
 /**
  * @brief  Reverse Byte stuffing process for a Msg
  * @param  Dest destination
- * @param  Source source
+ * @param  Source source, up to and including TMsg_EOF
  * @retval 1 if the operation succeeds, 0 if an error occurs
  */
 int ReverseByteStuffCopy(TMsg *Dest, uint8_t *Source)
 {
-  uint32_t count = 0;
-  int32_t state = 0;
+  /* Nothing past TMsg_EOF may be read, so a byte at a time */
+  return ReverseByteStuffBytes(Dest, Source, NULL);
+}
 
-  while ((*Source) != (uint8_t)TMsg_EOF)
-  {
-    if (state == 0)
-    {
-      if ((*Source) == (uint8_t)TMsg_BS)
-      {
-        state = 1;
-      }
-      else
-      {
-        Dest->Data[count] = *Source;
-        count++;
-      }
-    }
-    else
-    {
-      if ((*Source) == (uint8_t)TMsg_BS)
-      {
-        Dest->Data[count] = TMsg_BS;
-        count++;
-      }
-      else
-      {
-        if ((*Source) == (uint8_t)TMsg_BS_EOF)
-        {
-          Dest->Data[count] = TMsg_EOF;
-          count++;
-        }
-        else
-        {
-          return 0; // invalid sequence
-        }
-      }
-      state = 0;
-    }
-    Source++;
-  }
-  if (state != 0)
-  {
-    return 0;
-  }
-  Dest->Len = count;
-  return 1;
+/**
+ * @brief  Reverse Byte stuffing process for a Msg of known length
+ * @note   Literal bytes are copied a word at a time, never reading past Len.
+ * @param  Dest destination
+ * @param  Source source
+ * @param  Len number of bytes at Source, TMsg_EOF included
+ * @retval 1 if the operation succeeds, 0 if an error occurs or there is no
+ *         TMsg_EOF within Len
+ */
+int ReverseByteStuffCopyLen(TMsg *Dest, uint8_t *Source, uint32_t Len)
+{
+#if (TMSG_SWAR != 0)
+  return ReverseByteStuffWords(Dest, Source, Len);
+#else
+  return ReverseByteStuffBytes(Dest, Source, &Source[Len]);
+#endif
 }
 
 /**
@@ -0,0 +1,241 @@
+/**
+ ******************************************************************************
+ * @file    status_frame.c
+ * @brief   Fixed size binary status frame shared by the nucleo, the relay
+ *          and the PC server. Only depends on serial_protocol.c so it builds
+ *          for the firmware and for the host.
+ ******************************************************************************
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stddef.h>
+#include "status_frame.h"
+
+/** @addtogroup MOTION_APPLICATIONS MOTION APPLICATIONS
+ * @{
+ */
+
+/** @addtogroup ACTIVITY_RECOGNITION_WRIST ACTIVITY RECOGNITION WRIST
+ * @{
+ */
+
+/* Private defines -----------------------------------------------------------*/
+#define STATUS_FRAME_SRC  50U  /* DEV_ADDR of the nucleo */
+
+/* Private variables ---------------------------------------------------------*/
+static const char *const ActivityName[STATUS_ACT_COUNT] =
+{
+  "no activity",
+  "stationary",
+  "standing",
+  "sitting",
+  "lying",
+  "walking",
+  "fast walking",
+  "jogging",
+  "biking",
+  "unknown desk",
+  "sitting desk",
+  "standing desk",
+  "fall down",
+};
+
+/* Exported functions ------------------------------------------------------- */
+/**
+ * @brief  Build a status frame into a message, checksum not included
+ * @param  Msg the message to be built
+ * @param  Frame the status to be sent
+ * @retval None
+ */
+void StatusFrame_Build(TMsg *Msg, const TStatusFrame *Frame)
+{
+  Msg->Data[0] = STATUS_FRAME_DEST;
+  Msg->Data[1] = STATUS_FRAME_SRC;
+  Msg->Data[2] = CMD_Status_Frame;
+  Serialize(&Msg->Data[3], Frame->DeviceId, 2);
+  Serialize(&Msg->Data[5], Frame->Seq, 2);
+  Serialize(&Msg->Data[7], Frame->TimeStamp, 4);
+  Msg->Data[11] = Frame->Mode;
+  Msg->Data[12] = Frame->Activity;
+  Msg->Data[13] = Frame->Flags;
+  Msg->Len = STATUS_FRAME_LEN;
+}
+
+/**
+ * @brief  Extract a status frame from a message whose checksum was already removed
+ * @param  Msg the received message
+ * @param  Frame the decoded status
+ * @retval 1 if the message is a status frame, 0 otherwise
+ */
+int StatusFrame_Parse(const TMsg *Msg, TStatusFrame *Frame)
+{
+  if ((Msg->Len != STATUS_FRAME_LEN) || (Msg->Data[2] != (uint8_t)CMD_Status_Frame))
+  {
+    return 0;
+  }
+
+  /* MISRA C-2012 rule 11.8 violation for purpose */
+  Frame->DeviceId  = (uint16_t)Deserialize((uint8_t *)&Msg->Data[3], 2);
+  Frame->Seq       = (uint16_t)Deserialize((uint8_t *)&Msg->Data[5], 2);
+  Frame->TimeStamp = Deserialize((uint8_t *)&Msg->Data[7], 4);
+  Frame->Mode      = Msg->Data[11];
+  Frame->Activity  = Msg->Data[12];
+  Frame->Flags     = Msg->Data[13];
+  return 1;
+}
+
+/**
+ * @brief  Encode a status frame as it goes on the wire: checksum, byte stuffing and TMsg_EOF
+ * @param  Dest destination, at least STATUS_FRAME_WIRE_MAX bytes
+ * @param  Frame the status to be sent
+ * @retval Number of bytes written
+ */
+int StatusFrame_Encode(uint8_t *Dest, const TStatusFrame *Frame)
+{
+  TMsg msg;
+
+  StatusFrame_Build(&msg, Frame);
+  CHK_ComputeAndAdd(&msg);
+  return ByteStuffCopy(Dest, &msg);
+}
+
+/**
+ * @brief  Decode a status frame from the wire
+ * @param  Frame the decoded status
+ * @param  Source stuffed bytes terminated by TMsg_EOF
+ * @retval 1 if a valid status frame was decoded, 0 otherwise
+ */
+int StatusFrame_Decode(TStatusFrame *Frame, uint8_t *Source)
+{
+  TMsg msg;
+
+  if (ReverseByteStuffCopy(&msg, Source) == 0)
+  {
+    return 0;
+  }
+  if ((msg.Len != (STATUS_FRAME_LEN + 1U)) || (CHK_CheckAndRemove(&msg) == 0))
+  {
+    return 0;
+  }
+  return StatusFrame_Parse(&msg, Frame);
+}
+
+/**
+ * @brief  Encode a relay/server control frame as it goes on the wire
+ * @param  Dest destination, at least STATUS_CONTROL_WIRE_MAX bytes
+ * @param  Cmd CMD_Relay_Hello, CMD_Relay_Age (to the server) or CMD_Relay_Ack (to the relay)
+ * @param  Value flags, frame count or age
+ * @retval Number of bytes written
+ */
+int StatusFrame_EncodeControl(uint8_t *Dest, uint8_t Cmd, uint32_t Value)
+{
+  TMsg msg;
+
+  msg.Data[0] = (Cmd == (uint8_t)CMD_Relay_Ack) ? STATUS_FRAME_DEST : STATUS_SERVER_ADDR;
+  msg.Data[1] = (Cmd == (uint8_t)CMD_Relay_Ack) ? STATUS_SERVER_ADDR : STATUS_FRAME_DEST;
+  msg.Data[2] = Cmd;
+  Serialize(&msg.Data[3], Value, 4);
+  msg.Len = STATUS_CONTROL_LEN;
+  CHK_ComputeAndAdd(&msg);
+  return ByteStuffCopy(Dest, &msg);
+}
+
+/**
+ * @brief  Decode a relay/server control frame from the wire
+ * @param  Source stuffed bytes terminated by TMsg_EOF
+ * @param  Cmd the command
+ * @param  Value flags, frame count or age
+ * @retval 1 if a valid control frame was decoded, 0 otherwise
+ */
+int StatusFrame_DecodeControl(uint8_t *Source, uint8_t *Cmd, uint32_t *Value)
+{
+  TMsg msg;
+
+  if ((ReverseByteStuffCopy(&msg, Source) == 0) || (msg.Len != (STATUS_CONTROL_LEN + 1U))
+      || (CHK_CheckAndRemove(&msg) == 0))
+  {
+    return 0;
+  }
+  if ((msg.Data[2] != (uint8_t)CMD_Relay_Hello) && (msg.Data[2] != (uint8_t)CMD_Relay_Ack)
+      && (msg.Data[2] != (uint8_t)CMD_Relay_Age))
+  {
+    return 0;
+  }
+  *Cmd = msg.Data[2];
+  *Value = Deserialize(&msg.Data[3], 4);
+  return 1;
+}
+
+/**
+ * @brief  Encode a status as one UDP datagram
+ * @param  Dest destination, at least STATUS_DATAGRAM_LEN bytes
+ * @param  Kind CMD_Status_Frame or CMD_Relay_Heartbeat
+ * @param  RelaySeq datagram sequence number
+ * @param  Frame the status
+ * @retval Number of bytes written, STATUS_DATAGRAM_LEN
+ */
+int StatusFrame_EncodeDatagram(uint8_t *Dest, uint8_t Kind, uint32_t RelaySeq, const TStatusFrame *Frame)
+{
+  Dest[0] = Kind;
+  Serialize(&Dest[1], RelaySeq, 4);
+  Serialize(&Dest[5], Frame->DeviceId, 2);
+  Serialize(&Dest[7], Frame->Seq, 2);
+  Serialize(&Dest[9], Frame->TimeStamp, 4);
+  Dest[13] = Frame->Mode;
+  Dest[14] = Frame->Activity;
+  Dest[15] = Frame->Flags;
+  return (int)STATUS_DATAGRAM_LEN;
+}
+
+/**
+ * @brief  Decode a UDP datagram from the relay
+ * @param  Source the datagram
+ * @param  Len its length
+ * @param  Kind CMD_Status_Frame or CMD_Relay_Heartbeat
+ * @param  RelaySeq datagram sequence number
+ * @param  Frame the status
+ * @retval 1 if valid, 0 otherwise
+ */
+int StatusFrame_DecodeDatagram(const uint8_t *Source, uint32_t Len, uint8_t *Kind, uint32_t *RelaySeq,
+                               TStatusFrame *Frame)
+{
+  /* MISRA C-2012 rule 11.8 violation for purpose */
+  uint8_t *p = (uint8_t *)Source;
+
+  if ((Len != STATUS_DATAGRAM_LEN)
+      || ((p[0] != (uint8_t)CMD_Status_Frame) && (p[0] != (uint8_t)CMD_Relay_Heartbeat)))
+  {
+    return 0;
+  }
+  *Kind            = p[0];
+  *RelaySeq        = Deserialize(&p[1], 4);
+  Frame->DeviceId  = (uint16_t)Deserialize(&p[5], 2);
+  Frame->Seq       = (uint16_t)Deserialize(&p[7], 2);
+  Frame->TimeStamp = Deserialize(&p[9], 4);
+  Frame->Mode      = p[13];
+  Frame->Activity  = p[14];
+  Frame->Flags     = p[15];
+  return 1;
+}
+
+/**
+ * @brief  Human readable name of an activity, as the relay used to print it
+ * @param  Activity the STATUS_ACT_xx code
+ * @retval Activity name, "unknown" for codes out of range
+ */
+const char *StatusFrame_ActivityName(uint8_t Activity)
+{
+  if (Activity >= STATUS_ACT_COUNT)
+  {
+    return "unknown";
+  }
+  return ActivityName[Activity];
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
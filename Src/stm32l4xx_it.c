@@ -23,6 +23,7 @@
 /* Includes ------------------------------------------------------------------*/
 #include "stm32l4xx_it.h"
 #include "MotionAW_Manager.h"
+#include "com.h"
 
 /** @addtogroup MOTION_APPLICATIONS MOTION APPLICATIONS
  * @{
@@ -40,9 +41,18 @@
 extern volatile uint8_t FlashEraseRequest;
 extern flash_state_t FlashState;
 extern uint8_t DataLoggerActive;
+extern UART_HandleTypeDef UartHandle;
+extern I2C_HandleTypeDef hbusi2c1;
 
 /* Private function prototypes -----------------------------------------------*/
 void TIM_ALGO_IRQHandler(void);
+void USARTx_DMA_TX_IRQHandler(void);
+void USARTx_IRQHandler(void);
+void FLASH_IRQHandler(void);
+void ACC_INT1_IRQHandler(void);
+void I2C1_EV_IRQHandler(void);
+void I2C1_ER_IRQHandler(void);
+void DMA1_Channel7_IRQHandler(void);
 
 /* Private functions ---------------------------------------------------------*/
 
@@ -108,6 +118,42 @@ void TIM_ALGO_IRQHandler(void)
   HAL_TIM_IRQHandler(&AlgoTimHandle);
 }
 
+/**
+ * @brief  This function handles the USART transmit DMA interrupt
+ * @param  None
+ * @retval None
+ */
+void USARTx_DMA_TX_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(UartHandle.hdmatx);
+}
+
+/**
+ * @brief  This function handles the USART interrupt (transmission complete,
+ *         errors, line idle after received bytes)
+ * @param  None
+ * @retval None
+ */
+void USARTx_IRQHandler(void)
+{
+  /* The DMA has the bytes already, the interrupt only wakes the main loop */
+  if (__HAL_UART_GET_FLAG(&UartHandle, UART_FLAG_IDLE) != RESET)
+  {
+    __HAL_UART_CLEAR_IDLEFLAG(&UartHandle);
+  }
+  HAL_UART_IRQHandler(&UartHandle);
+}
+
+/**
+ * @brief  This function handles the FLASH interrupt (end of datalog program or erase, errors)
+ * @param  None
+ * @retval None
+ */
+void FLASH_IRQHandler(void)
+{
+  HAL_FLASH_IRQHandler();
+}
+
 /**
  * @brief  This function handles External line 10-15 interrupt request
  * @param  None
@@ -141,6 +187,46 @@ void EXTI15_10_IRQHandler(void)
   }
 }
 
+/**
+ * @brief  This function handles the LSM6DSL INT1 line, FIFO watermark
+ * @param  None
+ * @retval None
+ */
+void ACC_INT1_IRQHandler(void)
+{
+  HAL_GPIO_EXTI_IRQHandler(ACC_INT1_PIN);
+}
+
+/**
+ * @brief  This function handles the I2C1 event interrupt (sensor transfer queue)
+ * @param  None
+ * @retval None
+ */
+void I2C1_EV_IRQHandler(void)
+{
+  HAL_I2C_EV_IRQHandler(&hbusi2c1);
+}
+
+/**
+ * @brief  This function handles the I2C1 error interrupt
+ * @param  None
+ * @retval None
+ */
+void I2C1_ER_IRQHandler(void)
+{
+  HAL_I2C_ER_IRQHandler(&hbusi2c1);
+}
+
+/**
+ * @brief  This function handles the I2C1 receive DMA interrupt
+ * @param  None
+ * @retval None
+ */
+void DMA1_Channel7_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(hbusi2c1.hdmarx);
+}
+
 /**
  * @}
  */
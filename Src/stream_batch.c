@@ -0,0 +1,285 @@
+/**
+ ******************************************************************************
+ * @file    stream_batch.c
+ * @brief   Batched sensor streaming: the nucleo packs consecutive samples
+ *          into one TMsg with a single header and per-sample delta
+ *          timestamps, the host unpacks them into columns. Only depends on
+ *          serial_protocol.c so it builds for the firmware and for the host.
+ ******************************************************************************
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stddef.h>
+#include "stream_batch.h"
+
+/** @addtogroup MOTION_APPLICATIONS MOTION APPLICATIONS
+ * @{
+ */
+
+/** @addtogroup ACTIVITY_RECOGNITION_WRIST ACTIVITY RECOGNITION WRIST
+ * @{
+ */
+
+/* Private defines -----------------------------------------------------------*/
+#define STREAM_BATCH_SRC  50U    /* DEV_ADDR of the nucleo */
+#define STREAM_BATCH_DT_MAX  0xFFU  /* [ms] largest gap a sample can carry */
+
+/* Private functions ---------------------------------------------------------*/
+static void Column_Put16(int16_t *Column, uint32_t Row, int16_t Value)
+{
+  if (Column != NULL)
+  {
+    Column[Row] = Value;
+  }
+}
+
+/* Exported functions ------------------------------------------------------- */
+/**
+ * @brief  Size of one batched sample
+ * @param  Sensors STREAM_BATCH_xx bits
+ * @retval Bytes per sample, delta timestamp included
+ */
+uint32_t StreamBatch_SampleSize(uint8_t Sensors)
+{
+  uint32_t size = 1U;
+
+  if ((Sensors & STREAM_BATCH_ACC) != 0U)
+  {
+    size += 6U;
+  }
+  if ((Sensors & STREAM_BATCH_GYR) != 0U)
+  {
+    size += 6U;
+  }
+  if ((Sensors & STREAM_BATCH_PRESSURE) != 0U)
+  {
+    size += 3U;
+  }
+  return size;
+}
+
+/**
+ * @brief  Number of samples that fit in one TMsg
+ * @param  Sensors STREAM_BATCH_xx bits
+ * @retval Samples per batch, at most 255
+ */
+uint8_t StreamBatch_MaxSamples(uint8_t Sensors)
+{
+  uint32_t max = (STREAM_BATCH_PAYLOAD_MAX - STREAM_BATCH_HEADER_LEN) / StreamBatch_SampleSize(Sensors);
+
+  return (max > 255U) ? 255U : (uint8_t)max;
+}
+
+/**
+ * @brief  Start batching, or stop it with no sensors or no samples
+ * @param  Batch the batch to be started
+ * @param  Dest address the batches are sent to
+ * @param  Sensors requested STREAM_BATCH_xx bits, others are ignored
+ * @param  Samples requested samples per batch
+ * @retval Samples per batch actually used, 0 if batching is off
+ */
+uint8_t StreamBatch_Start(TStreamBatch *Batch, uint8_t Dest, uint8_t Sensors, uint8_t Samples)
+{
+  uint8_t max;
+
+  Batch->Dest = Dest;
+  Batch->Sensors = Sensors & (uint8_t)STREAM_BATCH_SENSORS;
+  Batch->Seq = 0xFFFFU;  /* the first batch is 0 */
+  Batch->Max = 0;
+  if ((Batch->Sensors != 0U) && (Samples != 0U))
+  {
+    max = StreamBatch_MaxSamples(Batch->Sensors);
+    Batch->Max = (Samples < max) ? Samples : max;
+  }
+  StreamBatch_Next(Batch);
+  return Batch->Max;
+}
+
+/**
+ * @brief  Append a sample to the batch
+ * @param  Batch the batch being filled
+ * @param  Sample the sample, not older than the previous one
+ * @retval 1 if added, 0 if the batch must be sent first (full, or the gap
+ *         since the previous sample is too long for a delta)
+ */
+int StreamBatch_Add(TStreamBatch *Batch, const TStreamSample *Sample)
+{
+  uint8_t *p;
+  uint32_t dt = 0;
+
+  if (Batch->Count >= Batch->Max)
+  {
+    return 0;
+  }
+  if (Batch->Count == 0U)
+  {
+    Serialize(&Batch->Msg.Data[5], Sample->TimeMs, 4);
+  }
+  else
+  {
+    dt = Sample->TimeMs - Batch->LastTime;
+    if (dt > STREAM_BATCH_DT_MAX)
+    {
+      return 0;
+    }
+  }
+
+  p = &Batch->Msg.Data[Batch->Msg.Len];
+  *p = (uint8_t)dt;
+  p++;
+  if ((Batch->Sensors & STREAM_BATCH_ACC) != 0U)
+  {
+    Serialize_s32(&p[0], Sample->Acc[0], 2);
+    Serialize_s32(&p[2], Sample->Acc[1], 2);
+    Serialize_s32(&p[4], Sample->Acc[2], 2);
+    p += 6;
+  }
+  if ((Batch->Sensors & STREAM_BATCH_GYR) != 0U)
+  {
+    Serialize_s32(&p[0], Sample->Gyr[0], 2);
+    Serialize_s32(&p[2], Sample->Gyr[1], 2);
+    Serialize_s32(&p[4], Sample->Gyr[2], 2);
+    p += 6;
+  }
+  if ((Batch->Sensors & STREAM_BATCH_PRESSURE) != 0U)
+  {
+    Serialize(p, Sample->Pressure, 3);
+    p += 3;
+  }
+
+  Batch->Msg.Len = (uint32_t)(p - Batch->Msg.Data);
+  Batch->LastTime = Sample->TimeMs;
+  Batch->Count++;
+  Batch->Msg.Data[10] = Batch->Count;
+  return 1;
+}
+
+/**
+ * @brief  Empty the batch for the next samples, once the previous one was sent
+ * @param  Batch the batch
+ * @retval None
+ */
+void StreamBatch_Next(TStreamBatch *Batch)
+{
+  Batch->Seq++;
+  Batch->Count = 0;
+  Batch->Msg.Data[0] = Batch->Dest;
+  Batch->Msg.Data[1] = STREAM_BATCH_SRC;
+  Batch->Msg.Data[2] = CMD_Batch_Data;
+  Serialize(&Batch->Msg.Data[3], Batch->Seq, 2);
+  Serialize(&Batch->Msg.Data[5], 0, 4);
+  Batch->Msg.Data[9] = Batch->Sensors;
+  Batch->Msg.Data[10] = 0;
+  Batch->Msg.Len = STREAM_BATCH_HEADER_LEN;
+}
+
+/**
+ * @brief  Unpack a batch whose checksum was already removed
+ * @param  Msg the received message
+ * @param  Header the decoded batch header
+ * @param  Columns the samples are appended here
+ * @retval Number of samples appended, 0 if the message is not a valid batch
+ *         or the columns have no room for it
+ */
+int StreamBatch_Parse(const TMsg *Msg, TStreamBatchHeader *Header, TStreamColumns *Columns)
+{
+  /* MISRA C-2012 rule 11.8 violation for purpose */
+  uint8_t *p = (uint8_t *)&Msg->Data[STREAM_BATCH_HEADER_LEN];
+  uint32_t size;
+  uint32_t row;
+  uint32_t i;
+  uint32_t t;
+
+  if ((Msg->Len < STREAM_BATCH_HEADER_LEN) || (Msg->Data[2] != (uint8_t)CMD_Batch_Data))
+  {
+    return 0;
+  }
+  /* MISRA C-2012 rule 11.8 violation for purpose */
+  Header->Seq      = (uint16_t)Deserialize((uint8_t *)&Msg->Data[3], 2);
+  Header->BaseTime = Deserialize((uint8_t *)&Msg->Data[5], 4);
+  Header->Sensors  = Msg->Data[9];
+  Header->Count    = Msg->Data[10];
+
+  size = StreamBatch_SampleSize(Header->Sensors);
+  if (((Header->Sensors & ~STREAM_BATCH_SENSORS) != 0U) || (Header->Count == 0U)
+      || (Msg->Len != (STREAM_BATCH_HEADER_LEN + (Header->Count * size)))
+      || ((Columns->Capacity - Columns->Count) < Header->Count))
+  {
+    return 0;
+  }
+
+  t = Header->BaseTime;
+  row = Columns->Count;
+  for (i = 0; i < Header->Count; i++, row++)
+  {
+    t += p[0];
+    p++;
+    if (Columns->TimeMs != NULL)
+    {
+      Columns->TimeMs[row] = t;
+    }
+    if ((Header->Sensors & STREAM_BATCH_ACC) != 0U)
+    {
+      Column_Put16(Columns->Acc[0], row, (int16_t)Deserialize(&p[0], 2));
+      Column_Put16(Columns->Acc[1], row, (int16_t)Deserialize(&p[2], 2));
+      Column_Put16(Columns->Acc[2], row, (int16_t)Deserialize(&p[4], 2));
+      p += 6;
+    }
+    else
+    {
+      Column_Put16(Columns->Acc[0], row, 0);
+      Column_Put16(Columns->Acc[1], row, 0);
+      Column_Put16(Columns->Acc[2], row, 0);
+    }
+    if ((Header->Sensors & STREAM_BATCH_GYR) != 0U)
+    {
+      Column_Put16(Columns->Gyr[0], row, (int16_t)Deserialize(&p[0], 2));
+      Column_Put16(Columns->Gyr[1], row, (int16_t)Deserialize(&p[2], 2));
+      Column_Put16(Columns->Gyr[2], row, (int16_t)Deserialize(&p[4], 2));
+      p += 6;
+    }
+    else
+    {
+      Column_Put16(Columns->Gyr[0], row, 0);
+      Column_Put16(Columns->Gyr[1], row, 0);
+      Column_Put16(Columns->Gyr[2], row, 0);
+    }
+    if (Columns->Pressure != NULL)
+    {
+      Columns->Pressure[row] = ((Header->Sensors & STREAM_BATCH_PRESSURE) != 0U) ? Deserialize(p, 3) : 0U;
+    }
+    if ((Header->Sensors & STREAM_BATCH_PRESSURE) != 0U)
+    {
+      p += 3;
+    }
+  }
+  Columns->Count = row;
+  return (int)Header->Count;
+}
+
+/**
+ * @brief  Unpack a batch from the wire
+ * @param  Header the decoded batch header
+ * @param  Columns the samples are appended here
+ * @param  Source stuffed bytes terminated by TMsg_EOF
+ * @param  Len number of bytes at Source, TMsg_EOF included
+ * @retval Number of samples appended, 0 if no valid batch was decoded
+ */
+int StreamBatch_Decode(TStreamBatchHeader *Header, TStreamColumns *Columns, uint8_t *Source, uint32_t Len)
+{
+  TMsg msg;
+
+  if ((ReverseByteStuffCopyLen(&msg, Source, Len) == 0) || (CHK_CheckAndRemove(&msg) == 0))
+  {
+    return 0;
+  }
+  return StreamBatch_Parse(&msg, Header, Columns);
+}
+
+/**
+ * @}
+ */
+
+/**
+ * @}
+ */
@@ -8,6 +8,7 @@
 #include "LTexture.h"
 ///////use for socket
 #include <stdlib.h>
+#include <ctype.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -15,6 +16,15 @@
 #include <arpa/inet.h>
 #include <iostream>
 #include <sys/time.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "reactor.h"
+#include "spsc_ring.h"
+#include "status_frame.h"
+#include "status_decoder.h"
+#include "event_log.h"
+#include "rollup.h"
 
 using namespace std;
 
@@ -22,6 +32,14 @@ using namespace std;
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 
+//Render pacing and status queue between the ingest and render threads
+const Uint32 FRAME_MS = 16;
+const Uint32 TURN_OVER_HOLD_MS = 1000;
+#define STATUS_QUEUE_SIZE 1024
+#define RELAY_LATE_MS 1000	//a frame made this long before it arrived came from a relay backlog
+#define EVENT_LOG_DIR "events"	//every status received, see event_log.h
+#define ROLLUP_DIR "rollups"	//time in each state by device and day, see rollup.h
+
 //Starts up SDL and creates window
 bool init();
 
@@ -32,9 +50,12 @@ bool loadMedia();
 void close();
 
 //use for socket
-void socket_server();
+bool socket_server();
 int recvtimeout(int s, char *buf, int len, int timeout);
 
+//print every status as it arrives, -v
+bool gVerbose = false;
+
 //check if mouse in rectangle
 bool checkmousepos(SDL_Rect &Rect);
 
@@ -377,8 +398,307 @@ int recvtimeout(int sockfd, char *buf, int len, int timeout)
 	return recv(sockfd, buf, len, 0);
 }
 
-void socket_server()
+//A status handed from the ingest thread to the render thread
+struct StatusEvent
+{
+	uint64_t seq;		//order received in, from 1
+	uint32_t conn;
+	uint8_t state;		//StatusState
+};
+
+//State shared by the ingest and render threads
+struct ServerContext
+{
+	SpscRing<StatusEvent, STATUS_QUEUE_SIZE> queue;
+	atomic<uint64_t> newest;	//seq << 8 | state of the newest status that found the queue full, 0 if none
+	atomic<bool> running;
+
+	//written by the ingest thread only
+	atomic<uint64_t> received;
+	atomic<uint64_t> dropped;
+	atomic<uint64_t> maxDepth;
+	atomic<uint64_t> duplicates;	//sent again by a relay after a reconnect
+
+	//ingest thread only, by device id
+	unordered_map<uint16_t, DeviceTrack> devices;
+	//and by relay address and port for the UDP ones
+	unordered_map<uint64_t, DatagramTrack> relays;
+	uint64_t heartbeats;
+	uint64_t badDatagrams;		//not status datagrams, anyone can send them
+	EventLog events;
+	bool logging;			//events could be opened
+	Rollups rollups;
+	bool rolling;			//rollups could be opened
+};
+
+//Picture for every state, NULL for the ones the server does not draw
+SDL_Surface** const StateSurface[ST_COUNT] =
+{
+	&gnoSurface,		//ST_NO_ACTIVITY
+	&gstationSurface,	//ST_STATIONARY
+	&gstandSurface,		//ST_STANDING
+	&gsittingSurface,	//ST_SITTING
+	&glyingSurface,		//ST_LYING
+	&gwalkSurface,		//ST_WALKING
+	&grunningSurface,	//ST_FAST_WALKING
+	&gjogSurface,		//ST_JOGGING
+	&gbikingSurface,	//ST_BIKING
+	NULL,			//ST_DESK_UNKNOWN
+	NULL,			//ST_DESK_SITTING
+	NULL,			//ST_DESK_STANDING
+	NULL,			//ST_FALL
+	&gTurnOverSurface,	//ST_TURN_OVER
+	&gsleepSurface,		//ST_SLEEPING
+	&gnoSurface2,		//ST_NS_NO_ACTIVITY
+	&gstationSurface2,	//ST_NS_STATIONARY
+	&gstandSurface2,	//ST_NS_STANDING
+	&gsittingSurface2,	//ST_NS_SITTING
+	&glyingSurface2,	//ST_NS_LYING
+	&gwalkSurface2,		//ST_NS_WALKING
+	&grunningSurface2,	//ST_NS_FAST_WALKING
+	&gjogSurface2,		//ST_NS_JOGGING
+	&gbikingSurface2,	//ST_NS_BIKING
+};
+
+//Map a state to its picture, NULL if there is none
+SDL_Surface* status_surface( uint8_t state )
+{
+	if( state >= ST_COUNT || StateSurface[state] == NULL )
+		return NULL;
+	return *StateSurface[state];
+}
+
+//Hand a status to the render thread, never waits for it.  With the queue
+//full it waits in a slot of its own instead, replacing the one there, so the
+//newest status always gets through.
+void publish( ServerContext *server, uint32_t conn, StatusState state )
+{
+	StatusEvent ev;
+	ev.seq = ++server->received;
+	ev.conn = conn;
+	ev.state = (uint8_t)state;
+
+	if(!server->queue.push(ev)) {
+		if(server->newest.exchange(ev.seq << 8 | ev.state) != 0)
+			server->dropped++;
+		return;
+	}
+	uint64_t depth = server->queue.size();
+	if(depth > server->maxDepth)
+		server->maxDepth = depth;
+}
+
+static int64_t wall_ms()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+//Store a status, made at ms, in the event log and count it in the rollups
+void record( ServerContext *server, int64_t ms, uint16_t device, uint16_t seq, StatusState state, uint8_t flags, int64_t nowMs )
+{
+	EventRecord rec;
+	rec.ms = ms;
+	rec.device = device;
+	rec.seq = seq;
+	rec.state = (uint8_t)state;
+	rec.flags = flags;
+	rec.reserved = 0;
+	if(server->logging)
+		event_log_append(server->events, rec, nowMs);
+	if(server->rolling)
+		rollup_add(server->rollups, rec);
+}
+
+//Called by the reactor on the ingest thread for every chunk a relay sends
+void on_message(Connection &conn, const char *data, size_t len, void *ctx)
+{
+	ServerContext *server = (ServerContext*)ctx;
+	string strtime;
+	time_t ticks;
+
+	int64_t nowMs = wall_ms();
+	if(gVerbose) {
+		ticks = (time_t)(nowMs / 1000);
+		strtime = ctime(&ticks);
+		strtime.erase(strtime.size()-1);
+	}
+
+	//text relays only ever send printable characters, frames start with the destination address
+	if(conn.messages == 1)
+		conn.binary = !isprint((unsigned char)data[0]);
+
+	if(!conn.binary) {
+		//several statuses can arrive in one read and one can straddle two
+		vector<StatusState> states;
+		conn.in.append(data, len);
+		conn.in.erase(0, status_split(conn.in.data(), conn.in.size(), states));
+		for(size_t i=0; i<states.size(); i++) {
+			if(gVerbose)
+				cout<<strtime<<" ["<<conn.id<<"]: "<<status_name(states[i])<<endl;
+			record(server, nowMs, EVENT_DEVICE_TEXT, 0, states[i], 0, nowMs);
+
+			//the relay waits for this before sending the next status
+			reactor_send(conn, "Hello", strlen("Hello"));
+			publish(server, conn.id, states[i]);
+		}
+		return;
+	}
+
+	//status frames end with TMsg_EOF, which never appears inside a stuffed frame
+	conn.in.append(data, len);
+	size_t pos;
+	uint32_t received = conn.frames;
+	while((pos = conn.in.find((char)TMsg_EOF)) != string::npos) {
+		uint8_t wire[STATUS_FRAME_WIRE_MAX];
+		TStatusFrame status;
+		bool valid = false;
+		uint8_t cmd;
+		uint32_t flags;
+
+		if(pos < sizeof(wire)) {
+			memcpy(wire, conn.in.data(), pos+1);
+			valid = StatusFrame_Decode(&status, wire) != 0;
+			if(!valid && StatusFrame_DecodeControl(wire, &cmd, &flags)) {
+				if(cmd == CMD_Relay_Hello)
+					conn.pipelined = (flags & RELAY_HELLO_PIPELINE) != 0;
+				else if(cmd == CMD_Relay_Age)
+					conn.age = (int32_t)flags;
+				conn.in.erase(0, pos+1);
+				continue;
+			}
+		}
+		//the relay counts the status frames it sent, bad ones included: left
+		//out of the count they would keep it waiting for an ack, or move the
+		//cumulative ack one frame behind for the rest of the connection. Only
+		//a damaged control frame, addressed to the server, is not one.
+		bool control = pos > 0 && (uint8_t)conn.in[0] == STATUS_SERVER_ADDR;
+		conn.in.erase(0, pos+1);
+		if(!valid && control)
+			continue;
+		conn.frames++;
+
+		//a pipelining relay does not wait, it gets one ack for the whole read below
+		if(!conn.pipelined)
+			reactor_send(conn, "Hello", strlen("Hello"));
+		if(!valid) {
+			if(gVerbose)
+				cout<<strtime<<" ["<<conn.id<<"]: bad frame"<<endl;
+			continue;
+		}
+
+		//a frame from the relay backlog is logged at the time it was made
+		int64_t wallMs;
+		bool fresh = status_track(server->devices[status.DeviceId], status, nowMs, conn.age, wallMs);
+		conn.age = -1;
+		if(!fresh) {
+			server->duplicates++;
+			continue;
+		}
+		vector<StatusState> states;
+		status_from_frame(status, states);
+		record(server, wallMs, status.DeviceId, status.Seq, states.empty() ? ST_UNKNOWN : states[0], status.Flags, nowMs);
+		if(gVerbose) {
+			time_t made = (time_t)(wallMs / 1000);
+			string madetime = ctime(&made);
+			madetime.erase(madetime.size()-1);
+			printf("%s [%u] %04x #%u %ums: %s%s%s\n", madetime.c_str(), conn.id, status.DeviceId, status.Seq,
+				status.TimeStamp, states.empty() ? "unknown" : status_name(states[0]),
+				(status.Flags & STATUS_FLAG_TURNOVER) ? ", turn over" : "",
+				(nowMs - wallMs >= RELAY_LATE_MS) ? ", replayed" : "");
+			fflush(stdout);
+		}
+
+		for(size_t i=0; i<states.size(); i++)
+			publish(server, conn.id, states[i]);
+	}
+	if(conn.pipelined && conn.frames != received) {
+		uint8_t ack[STATUS_CONTROL_WIRE_MAX];
+		reactor_send(conn, (const char*)ack, StatusFrame_EncodeControl(ack, CMD_Relay_Ack, conn.frames));
+	}
+
+	//a relay that never sends TMsg_EOF must not grow the buffer forever
+	if(conn.in.size() > STATUS_FRAME_WIRE_MAX)
+		conn.in.clear();
+}
+
+//Called by the reactor on the ingest thread for every datagram a relay sends
+void on_datagram(const struct sockaddr_in &from, const char *data, size_t len, void *ctx)
+{
+	ServerContext *server = (ServerContext*)ctx;
+	uint8_t kind;
+	uint32_t seq;
+	TStatusFrame status;
+
+	if(!StatusFrame_DecodeDatagram((const uint8_t*)data, len, &kind, &seq, &status)) {
+		//counted, a flood of them must not cost a console line each
+		server->badDatagrams++;
+		if(gVerbose)
+			cout<<"bad datagram from "<<inet_ntoa(from.sin_addr)<<endl;
+		return;
+	}
+	DatagramTrack &relay = server->relays[((uint64_t)from.sin_addr.s_addr << 16) | from.sin_port];
+
+	//a heartbeat only matters when the datagram of its status was lost
+	if(kind == CMD_Relay_Heartbeat) {
+		server->heartbeats++;
+		if(relay.seen && (int32_t)(seq - relay.highest) <= 0)
+			return;
+	}
+	DatagramOrder order = datagram_track(relay, seq);
+	if(order == DG_DUPLICATE || order == DG_LATE)
+		return;
+
+	int64_t nowMs = wall_ms();
+	int64_t wallMs;
+	if(!status_track(server->devices[status.DeviceId], status, nowMs, -1, wallMs))
+		return;
+
+	vector<StatusState> states;
+	status_from_frame(status, states);
+	record(server, wallMs, status.DeviceId, status.Seq, states.empty() ? ST_UNKNOWN : states[0], status.Flags, nowMs);
+	if(gVerbose) {
+		time_t made = (time_t)(wallMs / 1000);
+		string madetime = ctime(&made);
+		madetime.erase(madetime.size()-1);
+		printf("%s [udp %s] %04x #%u %ums: %s%s%s\n", madetime.c_str(), inet_ntoa(from.sin_addr), status.DeviceId,
+			status.Seq, status.TimeStamp, states.empty() ? "unknown" : status_name(states[0]),
+			(status.Flags & STATUS_FLAG_TURNOVER) ? ", turn over" : "", (order == DG_REORDERED) ? ", out of order" : "");
+		fflush(stdout);
+	}
+
+	//one that overtook it is on screen already
+	if(order != DG_NEW)
+		return;
+	for(size_t i=0; i<states.size(); i++)
+		publish(server, status.DeviceId, states[i]);
+}
+
+//Network ingest, runs until the render thread clears running
+void ingest_thread(Reactor *reactor, ServerContext *server)
+{
+	while(server->running)
+	{
+		if( reactor_poll(*reactor, 10) < 0 )
+		{
+			perror("epoll_wait");
+			break;
+		}
+		//group commit: the statuses of the last EVENT_COMMIT_MS go to the
+		//event log writer thread, the sync never holds up the sockets
+		int64_t nowMs = wall_ms();
+		if(server->logging)
+			event_log_tick(server->events, nowMs);
+		if(server->rolling)
+			rollup_tick(server->rollups, nowMs);
+	}
+}
+
+//Serve relays until the exit button is clicked, returns true if the window was closed
+bool socket_server()
 {	
+	ServerContext server;
 	SDL_Rect stretchRect;
 	stretchRect.x = 0;
 	stretchRect.y = 0;
@@ -396,114 +716,163 @@ void socket_server()
 	//Update the surface
 	SDL_UpdateWindowSurface( gWindow );
 
-	//socket 
-	int listenfd = 0, connfd = 0;
-	struct sockaddr_in serv_addr;
-	char sendBuff[1024];
-	char recvBuff[1024];
-	time_t ticks;
+	if(!status_decoder_init())
+	{
+		printf( "Failed to build the status decoder!\n" );
+		return false;
+	}
 
-	listenfd = socket(AF_INET, SOCK_STREAM, 0);
-	memset(&serv_addr, '0', sizeof(serv_addr));
-	memset(sendBuff, '0', sizeof(sendBuff));
-	serv_addr.sin_family = AF_INET;
-	serv_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-	serv_addr.sin_port = htons(65431);
-	bind(listenfd, (struct sockaddr*)&serv_addr, sizeof(serv_addr));
-	listen(listenfd, 10);
+	//socket 
+	Reactor reactor;
+	if(!reactor_open(reactor, REACTOR_PORT, on_message, &server))
+		return false;
+	//relays built with RELAY_UDP send datagrams to the same port
+	if(!reactor_open_udp(reactor, REACTOR_PORT, on_datagram))
+		cout<<"no UDP, TCP relays only"<<endl;
+
+	server.running = true;
+	server.newest = 0;
+	server.received = 0;
+	server.dropped = 0;
+	server.maxDepth = 0;
+	server.duplicates = 0;
+	server.devices.clear();
+	server.relays.clear();
+	server.heartbeats = 0;
+	server.badDatagrams = 0;
+	server.logging = event_log_open(server.events, EVENT_LOG_DIR, true);
+	if(!server.logging)
+		cout<<"no event log, statuses are not stored"<<endl;
+	else if(server.events.recovered != 0)
+		cout<<"event log: "<<server.events.recovered<<" torn bytes and index entries recovered"<<endl;
+	//days start at local midnight, DST changes included
+	server.rolling = rollup_open(server.rollups, ROLLUP_DIR);
+	thread ingest(ingest_thread, &reactor, &server);
 
-	int result=0;
-	string strtime;
-	strcpy(sendBuff, "Hello");
+	bool exit = false;
+	bool quit = false;
+	bool mouse = false;
+	SDL_Event e_2;
+	SDL_Surface *latest = NULL;		//newest status not drawn yet
+	uint64_t taken = 0;			//seq of the newest status taken
+	Uint32 holdUntil = 0;			//turn over stays on screen until then
+	uint64_t coalesced = 0;
+	while(!exit)
+	{
+		Uint32 frameStart = SDL_GetTicks();
 
+		while( SDL_PollEvent( &e_2 ) != 0 )
+		{
+			if( e_2.type == SDL_QUIT )
+			{
+				quit = true;
+				exit = true;
+			}
+			else if( e_2.type == SDL_MOUSEBUTTONDOWN )
+			{
+				mouse = true;
+			}
+			else if( e_2.type == SDL_MOUSEBUTTONUP && mouse )
+			{
+				if( !checkmousepos(exitRect) )
+					exit = true;
+				mouse = false;
+			}
+		}
 
-	bool exit = false;
-    while(!exit)
-    {
-		SDL_Event e_2;
-		bool mouse = false;
-		string msg="";
-		bool IsTurnOver=false;
-		while (1) {
-			connfd=accept(listenfd, (struct sockaddr*)NULL, NULL);
-			result=0;
-
-			while(1) {
-				ticks=time(NULL);
-				if(0< (result=read(connfd,recvBuff, sizeof(recvBuff)-1))) {
-					strtime=ctime(&ticks);
-					strtime.erase(strtime.size()-1);
-					cout<<strtime<<": ";
-					recvBuff[result]='\0';
-					cout<<recvBuff<<endl;
-					
-					msg=recvBuff;
-					
-					if(msg == "no activity")
-						SDL_BlitScaled( gnoSurface, NULL, gScreenSurface, &stretchRect );
-					else if(msg == "stationary") 
-						SDL_BlitScaled( gstationSurface, NULL, gScreenSurface, &stretchRect );
-					else if(msg == "standing")
-						SDL_BlitScaled( gstandSurface, NULL, gScreenSurface, &stretchRect );
-					else if(msg == "sitting")
-						SDL_BlitScaled( gsittingSurface, NULL, gScreenSurface, &stretchRect );
-					else if(msg == "lying")
-						SDL_BlitScaled( glyingSurface, NULL, gScreenSurface, &stretchRect );
-					else if(msg == "walking")
-						SDL_BlitScaled( gwalkSurface, NULL, gScreenSurface, &stretchRect );
-					else if(msg == "fast walking")
-						SDL_BlitScaled( grunningSurface, NULL, gScreenSurface, &stretchRect );
-					else if(msg == "jogging")
-						SDL_BlitScaled( gjogSurface, NULL, gScreenSurface, &stretchRect );
-					else if(msg == "biking")
-						SDL_BlitScaled( gbikingSurface, NULL, gScreenSurface, &stretchRect );
-
-					else if(msg == "turn over"){
-						SDL_BlitScaled( gTurnOverSurface, NULL, gScreenSurface, &stretchRect );
-						IsTurnOver=true;
-					}
+		//coalesce everything that arrived since the last frame to the newest
+		//state, the status that found the queue full last; statuses older
+		//than one already taken are skipped
+		StatusEvent ev;
+		bool more = true;
+		while( more )
+		{
+			if( !server.queue.pop(ev) )
+			{
+				uint64_t newest = server.newest.exchange(0);
+				if( newest == 0 )
+					break;
+				ev.seq = newest >> 8;
+				ev.state = (uint8_t)newest;
+				more = false;
+			}
+			if( ev.seq <= taken )
+			{
+				coalesced++;
+				continue;
+			}
+			taken = ev.seq;
+			SDL_Surface *surface = status_surface( ev.state );
+			if( surface == NULL )
+				continue;
+			if( ev.state == ST_TURN_OVER )
+			{
+				//show it right away and keep it up for a second
+				SDL_BlitScaled( surface, NULL, gScreenSurface, &stretchRect );
+				SDL_UpdateWindowSurface( gWindow );
+				holdUntil = SDL_GetTicks() + TURN_OVER_HOLD_MS;
+				continue;
+			}
+			if( latest != NULL )
+				coalesced++;
+			latest = surface;
+		}
 
-					else if(msg == "sleeping")
-						SDL_BlitScaled( gsleepSurface, NULL, gScreenSurface, &stretchRect );
+		if( latest != NULL && SDL_TICKS_PASSED( SDL_GetTicks(), holdUntil ) )
+		{
+			SDL_BlitScaled( latest, NULL, gScreenSurface, &stretchRect );
+			SDL_UpdateWindowSurface( gWindow );
+			latest = NULL;
+		}
 
-					else if(msg == "no sleeping, no activity")
-						SDL_BlitScaled( gnoSurface2, NULL, gScreenSurface, &stretchRect );
-					else if(msg == "no sleeping, stationary") {
-						SDL_BlitScaled( gstationSurface2, NULL, gScreenSurface, &stretchRect );
-					}
-					else if(msg == "no sleeping, standing")
-						SDL_BlitScaled( gstandSurface2, NULL, gScreenSurface, &stretchRect );
-					else if(msg == "no sleeping, sitting")
-						SDL_BlitScaled( gsittingSurface2, NULL, gScreenSurface, &stretchRect );
-					else if(msg == "no sleeping, lying")
-						SDL_BlitScaled( glyingSurface2, NULL, gScreenSurface, &stretchRect );
-					else if(msg == "no sleeping, walking")
-						SDL_BlitScaled( gwalkSurface2, NULL, gScreenSurface, &stretchRect );
-					else if(msg == "no sleeping, fast walking")
-						SDL_BlitScaled( grunningSurface2, NULL, gScreenSurface, &stretchRect );
-					else if(msg == "no sleeping, jogging")
-						SDL_BlitScaled( gjogSurface2, NULL, gScreenSurface, &stretchRect );
-					else if(msg == "no sleeping, biking")
-						SDL_BlitScaled( gbikingSurface2, NULL, gScreenSurface, &stretchRect );
-					SDL_UpdateWindowSurface( gWindow );
-					
-					if (IsTurnOver){
-						sleep(1);
-						IsTurnOver=false;
-					}
+		Uint32 spent = SDL_GetTicks() - frameStart;
+		if( spent < FRAME_MS )
+			SDL_Delay( FRAME_MS - spent );
+	}
 
-					write(connfd, sendBuff, strlen(sendBuff));
-				}
+	server.running = false;
+	ingest.join();
+
+	cout<<"close Socket"<<endl;
+	cout<<"ingest: "<<server.received<<" received, "<<server.dropped<<" dropped, "
+		<<coalesced<<" coalesced, max queue depth "<<server.maxDepth
+		<<"/"<<server.queue.capacity()<<", "<<server.duplicates<<" frames sent again by relays"<<endl;
+	uint64_t lost = 0, reordered = 0, late = 0;
+	for(unordered_map<uint64_t, DatagramTrack>::iterator it = server.relays.begin(); it != server.relays.end(); ++it) {
+		lost += it->second.lost;
+		reordered += it->second.reordered;
+		late += it->second.late;
+	}
+	cout<<"udp: "<<reactor.datagrams<<" datagrams in "<<reactor.datagramReads<<" reads, "<<server.heartbeats
+		<<" heartbeats, "<<lost<<" lost, "<<reordered<<" out of order, "<<late<<" too late, "
+		<<server.badDatagrams<<" bad"<<endl;
+	if(server.logging) {
+		event_log_close(server.events);
+		cout<<"event log: "<<server.events.appended<<" statuses stored in "<<server.events.commits<<" commits, "
+			<<server.events.dropped<<" dropped behind a slow disk, "<<server.events.errors<<" commits failed"<<endl;
+	}
+	if(server.rolling) {
+		//what today looks like for every device heard from, read back as a report would
+		vector<uint16_t> heard;
+		for(unordered_map<uint16_t, DeviceRollup>::iterator it = server.rollups.devices.begin(); it != server.rollups.devices.end(); ++it)
+			heard.push_back(it->first);
+		rollup_close(server.rollups);
+		RollupDay *today = new RollupDay;
+		int64_t dayMs = rollup_day(wall_ms());
+		for(size_t i=0; i<heard.size(); i++) {
+			if(!rollup_read(ROLLUP_DIR, heard[i], dayMs, *today))
+				continue;
+			printf("%04x today:", heard[i]);
+			for(int st=0; st<ST_COUNT; st++) {
+				if(today->day.stateMs[st] >= 60000)
+					printf(" %s %u min,", status_name(st), today->day.stateMs[st] / 60000);
 			}
+			printf(" %u turn overs\n", today->day.turnOvers);
 		}
-		//Update the surface
-		SDL_UpdateWindowSurface( gWindow );
-    }
-
-    //cout<<receiveMessage<<endl;
-    cout<<"close Socket"<<endl;
-    close(connfd);
-    return ;
+		delete today;
+	}
+	reactor_close(reactor);
+	return quit;
 }
 
 //set the start view
@@ -536,6 +905,12 @@ bool checkmousepos(SDL_Rect &Rect)
 
 int main( int argc, char* args[] )
 {
+	for( int i = 1; i < argc; i++ )
+	{
+		if( strcmp( args[i], "-v" ) == 0 )
+			gVerbose = true;
+	}
+
 	//Start up SDL and create window
 	if( !init() )
 	{
@@ -585,8 +960,10 @@ int main( int argc, char* args[] )
 					{
 						if( !checkmousepos(buttonRect))
 						{
-							socket_server();
-							reset_screen(buttonRect);
+							if( socket_server() )
+								quit = true;
+							else
+								reset_screen(buttonRect);
 						}
 						mouse = false;
 					}
@@ -0,0 +1,412 @@
+#include "event_log.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+using namespace std;
+
+#define MAP_BYTES	((size_t)EVENT_SEGMENT_RECORDS * sizeof(EventRecord))
+
+static void writer_thread(EventLog *log);
+
+static bool by_time(const EventRecord &a, const EventRecord &b)
+{
+	return a.ms < b.ms;
+}
+
+static void index_clear(EventIndex &e)
+{
+	e.minMs = INT64_MAX;
+	e.maxMs = INT64_MIN;
+	e.devices = 0;
+}
+
+static void index_add(EventIndex &e, const EventRecord &rec)
+{
+	e.minMs = min(e.minMs, rec.ms);
+	e.maxMs = max(e.maxMs, rec.ms);
+	e.devices |= 1ULL << (rec.device % 64);
+}
+
+static void index_merge(EventIndex &e, const EventIndex &other)
+{
+	e.minMs = min(e.minMs, other.minMs);
+	e.maxMs = max(e.maxMs, other.maxMs);
+	e.devices |= other.devices;
+}
+
+static bool index_match(const EventIndex &e, uint16_t device, int64_t fromMs, int64_t toMs)
+{
+	return e.maxMs >= fromMs && e.minMs < toMs && (e.devices & (1ULL << (device % 64)));
+}
+
+static string segment_path(const EventLog &log, uint32_t number, const char *ext)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "/%08u.%s", number, ext);
+	return log.dir + name;
+}
+
+//write all of it, short writes and EINTR included
+static bool write_at(int fd, const void *data, size_t len, off_t off)
+{
+	const char *p = (const char*)data;
+	while(len > 0) {
+		ssize_t n = pwrite(fd, p, len, off);
+		if(n < 0) {
+			if(errno == EINTR)
+				continue;
+			return false;
+		}
+		p += n;
+		len -= n;
+		off += n;
+	}
+	return true;
+}
+
+//Map a segment and load its index.  The records decide: a torn record at the
+//end is cut, index entries past the records are dropped and missing ones are
+//rebuilt from the records.  The files of the last segment of a writable log
+//stay open.
+static bool open_segment(EventLog &log, uint32_t number)
+{
+	EventSegment seg;
+	struct stat st;
+	string path = segment_path(log, number, "log");
+	int flags = log.writable ? O_RDWR | O_CREAT : O_RDONLY;
+
+	int fd = open(path.c_str(), flags | O_CLOEXEC, 0644);
+	if(fd < 0 || fstat(fd, &st) < 0) {
+		perror(path.c_str());
+		if(fd >= 0)
+			close(fd);
+		return false;
+	}
+	seg.number = number;
+	seg.count = (uint32_t)min((size_t)st.st_size / sizeof(EventRecord), (size_t)EVENT_SEGMENT_RECORDS);
+	if(log.writable && (size_t)st.st_size != seg.count * sizeof(EventRecord)) {
+		log.recovered += st.st_size - seg.count * sizeof(EventRecord);
+		if(ftruncate(fd, seg.count * sizeof(EventRecord)) < 0)
+			perror("ftruncate");
+	}
+
+	//the whole segment size up front, the active segment grows into it
+	void *map = mmap(NULL, MAP_BYTES, PROT_READ, MAP_SHARED, fd, 0);
+	if(map == MAP_FAILED) {
+		perror("mmap");
+		close(fd);
+		return false;
+	}
+	seg.map = (const EventRecord*)map;
+
+	path = segment_path(log, number, "idx");
+	int indexfd = open(path.c_str(), flags | O_CLOEXEC, 0644);
+	size_t blocks = seg.count / EVENT_INDEX_EVERY;
+	size_t stored = 0;
+	if(indexfd >= 0 && fstat(indexfd, &st) == 0)
+		stored = min((size_t)st.st_size / sizeof(EventIndex), blocks);
+	seg.index.resize(stored);
+	if(stored > 0 && pread(indexfd, &seg.index[0], stored * sizeof(EventIndex), 0) != (ssize_t)(stored * sizeof(EventIndex)))
+		stored = 0;
+	if(log.writable && indexfd >= 0 && ftruncate(indexfd, stored * sizeof(EventIndex)) < 0)
+		perror("ftruncate");
+
+	seg.index.resize((seg.count + EVENT_INDEX_EVERY - 1) / EVENT_INDEX_EVERY);
+	for(size_t b = stored; b < seg.index.size(); b++) {
+		uint32_t end = min((uint32_t)((b + 1) * EVENT_INDEX_EVERY), seg.count);
+		index_clear(seg.index[b]);
+		for(uint32_t i = b * EVENT_INDEX_EVERY; i < end; i++)
+			index_add(seg.index[b], seg.map[i]);
+		if(b < blocks) {
+			log.recovered++;
+			if(log.writable && indexfd >= 0)
+				write_at(indexfd, &seg.index[b], sizeof(EventIndex), b * sizeof(EventIndex));
+		}
+	}
+	index_clear(seg.zone);
+	for(size_t b = 0; b < seg.index.size(); b++)
+		index_merge(seg.zone, seg.index[b]);
+
+	if(log.fd >= 0) {
+		close(log.fd);
+		close(log.indexfd);
+	}
+	if(log.writable) {
+		log.fd = fd;
+		log.indexfd = indexfd;
+	}
+	else {
+		close(fd);
+		if(indexfd >= 0)
+			close(indexfd);
+	}
+	log.segments.push_back(seg);
+	return true;
+}
+
+bool event_log_open(EventLog &log, const char *dir, bool writable)
+{
+	vector<uint32_t> numbers;
+
+	log.dir = dir;
+	log.writable = writable;
+	log.segments.clear();
+	log.fd = -1;
+	log.indexfd = -1;
+	log.batches = NULL;
+	log.submitted = 0;
+	log.written = 0;
+	log.writtenSeen = 0;
+	log.stop = false;
+	log.appended = 0;
+	log.dropped = 0;
+	log.commits = 0;
+	log.errors = 0;
+	log.recovered = 0;
+	log.blocksRead = 0;
+
+	if(writable && mkdir(dir, 0755) < 0 && errno != EEXIST) {
+		perror(dir);
+		return false;
+	}
+	DIR *d = opendir(dir);
+	if(d == NULL) {
+		perror(dir);
+		return false;
+	}
+	struct dirent *ent;
+	while((ent = readdir(d)) != NULL) {
+		uint32_t number;
+		char ext[8];
+		if(strlen(ent->d_name) == 12 && sscanf(ent->d_name, "%8u.%3s", &number, ext) == 2 && strcmp(ext, "log") == 0)
+			numbers.push_back(number);
+	}
+	closedir(d);
+	sort(numbers.begin(), numbers.end());
+
+	for(size_t i = 0; i < numbers.size(); i++) {
+		if(!open_segment(log, numbers[i])) {
+			event_log_close(log);
+			return false;
+		}
+	}
+	if(writable && (log.segments.empty() || log.segments.back().count == EVENT_SEGMENT_RECORDS)) {
+		if(!open_segment(log, log.segments.empty() ? 0 : log.segments.back().number + 1)) {
+			event_log_close(log);
+			return false;
+		}
+	}
+	if(writable) {
+		log.batches = new EventBatch[EVENT_WRITER_QUEUE];
+		for(int i = 0; i < EVENT_WRITER_QUEUE; i++) {
+			log.batches[i].count = 0;
+			log.batches[i].done = 0;
+		}
+		log.writer = thread(writer_thread, &log);
+	}
+	return true;
+}
+
+//Write one group at the end of the log and sync it, on the writer thread,
+//called and returning with the lock held.  The write and the sync are done
+//without it, so queries go on meanwhile; the records written move from the
+//group to the segments under it, a query finds each of them in one place.
+static bool write_batch(EventLog &log, EventBatch &batch, unique_lock<mutex> &g)
+{
+	if(log.fd < 0)
+		return false;
+	while(batch.done < batch.count) {
+		EventSegment *seg = &log.segments.back();
+		if(seg->count == EVENT_SEGMENT_RECORDS) {
+			if(!open_segment(log, seg->number + 1))
+				return false;
+			seg = &log.segments.back();
+		}
+
+		//one write and one sync for the whole group
+		const EventRecord *recs = &batch.recs[batch.done];
+		uint32_t n = min(batch.count - batch.done, EVENT_SEGMENT_RECORDS - seg->count);
+		off_t at = (off_t)seg->count * sizeof(EventRecord);
+		g.unlock();
+		bool ok = write_at(log.fd, recs, n * sizeof(EventRecord), at) && fdatasync(log.fd) == 0;
+		g.lock();
+		if(!ok) {
+			perror("event log");
+			return false;
+		}
+
+		//the index only ever describes records on disk, a crash leaves it
+		//short, never ahead
+		for(uint32_t i = 0; i < n; i++) {
+			const EventRecord &rec = recs[i];
+			uint32_t block = seg->count / EVENT_INDEX_EVERY;
+			if(seg->count % EVENT_INDEX_EVERY == 0) {
+				seg->index.push_back(EventIndex());
+				index_clear(seg->index.back());
+			}
+			index_add(seg->index[block], rec);
+			index_add(seg->zone, rec);
+			seg->count++;
+			if(seg->count % EVENT_INDEX_EVERY == 0)
+				write_at(log.indexfd, &seg->index[block], sizeof(EventIndex), (off_t)block * sizeof(EventIndex));
+		}
+		batch.done += n;
+	}
+	return true;
+}
+
+//Write the groups queued, oldest first, until the log is closed
+static void writer_thread(EventLog *log)
+{
+	unique_lock<mutex> g(log->lock);
+	for(;;) {
+		while(log->written == log->submitted && !log->stop)
+			log->wake.wait(g);
+		if(log->written == log->submitted)
+			return;
+
+		//retired with the lock still held from publishing its last records;
+		//what could not be written is dropped, the next group starts over
+		EventBatch &batch = log->batches[log->written % EVENT_WRITER_QUEUE];
+		if(!write_batch(*log, batch, g))
+			log->errors++;
+		log->commits++;
+		batch.count = 0;
+		batch.done = 0;
+		log->written++;
+		log->wake.notify_all();
+	}
+}
+
+//Queue the group being filled for the writer, lock held
+static void hand_off(EventLog &log)
+{
+	log.submitted++;
+	log.writtenSeen = log.written;
+	log.wake.notify_all();
+}
+
+void event_log_append(EventLog &log, const EventRecord &rec, int64_t arrivalMs)
+{
+	if(log.batches == NULL)
+		return;
+	if(log.submitted - log.writtenSeen >= EVENT_WRITER_QUEUE) {
+		lock_guard<mutex> g(log.lock);
+		log.writtenSeen = log.written;
+		if(log.submitted - log.writtenSeen >= EVENT_WRITER_QUEUE) {
+			//every group is queued behind a slow disk, better lose this
+			//record than hold up the caller
+			log.dropped++;
+			return;
+		}
+	}
+	EventBatch &batch = log.batches[log.submitted % EVENT_WRITER_QUEUE];
+	if(batch.count == 0)
+		batch.firstMs = arrivalMs;
+	batch.recs[batch.count++] = rec;
+	log.appended++;
+	if(batch.count == EVENT_COMMIT_RECORDS) {
+		lock_guard<mutex> g(log.lock);
+		hand_off(log);
+	}
+}
+
+void event_log_tick(EventLog &log, int64_t nowMs)
+{
+	if(log.batches == NULL || log.submitted - log.writtenSeen >= EVENT_WRITER_QUEUE)
+		return;
+	const EventBatch &batch = log.batches[log.submitted % EVENT_WRITER_QUEUE];
+	if(batch.count == 0 || nowMs - batch.firstMs < EVENT_COMMIT_MS)
+		return;
+
+	//with all the other groups still queued this one goes on filling, the
+	//slower the disk the larger the groups
+	lock_guard<mutex> g(log.lock);
+	if(log.submitted + 1 - log.written < EVENT_WRITER_QUEUE)
+		hand_off(log);
+}
+
+bool event_log_commit(EventLog &log)
+{
+	if(log.batches == NULL)
+		return false;
+	unique_lock<mutex> g(log.lock);
+	uint64_t errors = log.errors;
+	if(log.submitted - log.written < EVENT_WRITER_QUEUE && log.batches[log.submitted % EVENT_WRITER_QUEUE].count != 0)
+		hand_off(log);
+	while(log.written != log.submitted)
+		log.wake.wait(g);
+	log.writtenSeen = log.written;
+	return log.errors == errors;
+}
+
+size_t event_log_query(EventLog &log, uint16_t device, int64_t fromMs, int64_t toMs, vector<EventRecord> &out)
+{
+	size_t first = out.size();
+
+	lock_guard<mutex> g(log.lock);
+	for(size_t s = 0; s < log.segments.size(); s++) {
+		const EventSegment &seg = log.segments[s];
+		if(!index_match(seg.zone, device, fromMs, toMs))
+			continue;
+		for(size_t b = 0; b < seg.index.size(); b++) {
+			if(!index_match(seg.index[b], device, fromMs, toMs))
+				continue;
+			log.blocksRead++;
+			uint32_t end = min((uint32_t)((b + 1) * EVENT_INDEX_EVERY), seg.count);
+			for(uint32_t i = b * EVENT_INDEX_EVERY; i < end; i++) {
+				const EventRecord &rec = seg.map[i];
+				if(rec.device == device && rec.ms >= fromMs && rec.ms < toMs)
+					out.push_back(rec);
+			}
+		}
+	}
+	//the groups queued and not written yet, then the one being filled
+	if(log.batches != NULL) {
+		uint64_t last = min(log.submitted + 1, log.written + EVENT_WRITER_QUEUE);
+		for(uint64_t b = log.written; b < last; b++) {
+			const EventBatch &batch = log.batches[b % EVENT_WRITER_QUEUE];
+			for(uint32_t i = batch.done; i < batch.count; i++) {
+				const EventRecord &rec = batch.recs[i];
+				if(rec.device == device && rec.ms >= fromMs && rec.ms < toMs)
+					out.push_back(rec);
+			}
+		}
+	}
+
+	//mostly in order already, replayed backlogs are not
+	stable_sort(out.begin() + first, out.end(), by_time);
+	return out.size() - first;
+}
+
+void event_log_close(EventLog &log)
+{
+	if(log.batches != NULL) {
+		event_log_commit(log);
+		{
+			lock_guard<mutex> g(log.lock);
+			log.stop = true;
+		}
+		log.wake.notify_all();
+		log.writer.join();
+		delete[] log.batches;
+		log.batches = NULL;
+	}
+	if(log.fd >= 0) {
+		close(log.fd);
+		if(log.indexfd >= 0)
+			close(log.indexfd);
+	}
+	for(size_t s = 0; s < log.segments.size(); s++)
+		munmap((void*)log.segments[s].map, MAP_BYTES);
+	log.segments.clear();
+	log.fd = -1;
+	log.indexfd = -1;
+}
@@ -0,0 +1,118 @@
+//Append-only store of the statuses the recorder server received
+//
+//Fixed-width records in numbered segment files, each with a sparse index of
+//one entry per block of records: the time span and the devices in the block.
+//Appends collect in memory and are written and synced together (group commit)
+//by a writer thread, so a slow disk never holds up the thread appending;
+//queries read the segments through mmap and only the blocks the index allows.
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define EVENT_SEGMENT_RECORDS	(1U << 20)	//16 MB segment files
+#define EVENT_INDEX_EVERY	256		//records per index entry, a 4 KB page
+#define EVENT_COMMIT_RECORDS	4096		//appends held before a commit is forced
+#define EVENT_COMMIT_MS		100		//nor longer than this
+#define EVENT_WRITER_QUEUE	16		//groups held for the writer thread, 1 MB
+#define EVENT_DEVICE_TEXT	0xFFFF		//statuses from text relays, which have no device id
+
+//One status as stored, 16 bytes
+struct EventRecord
+{
+	int64_t ms;		//[ms] wall time the status was made
+	uint16_t device;
+	uint16_t seq;		//status frame Seq, 0 from text relays
+	uint8_t state;		//StatusState
+	uint8_t flags;		//STATUS_FLAG_xx
+	uint16_t reserved;
+};
+
+//Index entry for a block of records, also kept for a whole segment
+struct EventIndex
+{
+	int64_t minMs;
+	int64_t maxMs;
+	uint64_t devices;	//bit device % 64 set for every device in the block
+};
+
+struct EventSegment
+{
+	uint32_t number;		//file name
+	uint32_t count;			//records written
+	const EventRecord *map;		//EVENT_SEGMENT_RECORDS long, only count are valid
+	std::vector<EventIndex> index;	//complete blocks, then the one being filled
+	EventIndex zone;		//the whole segment
+};
+
+//A group of appends, written with one write and one sync
+struct EventBatch
+{
+	EventRecord recs[EVENT_COMMIT_RECORDS];
+	uint32_t count;
+	uint32_t done;			//the first ones, already in the segments
+	int64_t firstMs;		//[ms] arrival of the oldest
+};
+
+struct EventLog
+{
+	EventLog() : writable(false), fd(-1), indexfd(-1), batches(NULL) {}
+
+	std::string dir;
+	bool writable;
+	std::vector<EventSegment> segments;	//grown by the writer thread
+	int fd;				//active segment, the last one, -1 read only
+	int indexfd;
+
+	//a ring of groups: the one being filled, behind it those queued for the
+	//writer thread, oldest first; NULL read only
+	EventBatch *batches;		//EVENT_WRITER_QUEUE of them
+	uint64_t submitted;		//groups handed to the writer, the one being filled is next
+	uint64_t written;		//groups the writer is done with
+	uint64_t writtenSeen;		//written as the appending thread last read it
+
+	std::thread writer;
+	std::mutex lock;		//submitted, written and the segments, between the threads
+	std::condition_variable wake;	//a group was queued or written, or the log closes
+	bool stop;
+
+	uint64_t appended;
+	uint64_t dropped;		//appends lost while the writer was EVENT_WRITER_QUEUE groups behind
+	uint64_t commits;		//each one write and one fdatasync
+	uint64_t errors;		//commits that could not be written
+	uint64_t recovered;		//torn bytes cut and index entries rebuilt at open
+	uint64_t blocksRead;		//by queries
+};
+
+//Open or create the log in dir.  A writable open cuts a record torn by a
+//crash and rebuilds the index entries the crash lost.
+bool event_log_open(EventLog &log, const char *dir, bool writable);
+
+//Queue one record, arrival is the wall time it came in [ms].  The group is
+//handed to the writer thread when EVENT_COMMIT_RECORDS are pending; never
+//waits for the disk, drops the record when the writer is that far behind.
+void event_log_append(EventLog &log, const EventRecord &rec, int64_t arrivalMs);
+
+//Hand the group to the writer once its oldest record waited EVENT_COMMIT_MS,
+//call it often
+void event_log_tick(EventLog &log, int64_t nowMs);
+
+//Hand the pending records to the writer and wait until all the groups queued
+//are written and synced, false on a write error
+bool event_log_commit(EventLog &log);
+
+//Records of device with fromMs <= ms < toMs, pending and queued ones
+//included, appended to out in time order.  Returns how many.  Called from the
+//thread appending.
+size_t event_log_query(EventLog &log, uint16_t device, int64_t fromMs, int64_t toMs, std::vector<EventRecord> &out);
+
+//Commit, stop the writer thread, unmap and close
+void event_log_close(EventLog &log);
+
+#endif
@@ -0,0 +1,355 @@
+#include "reactor.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <algorithm>
+
+using namespace std;
+
+static void close_connection(Reactor &r, Connection *conn)
+{
+	if(conn->overflow)
+		fprintf(stderr, "[%u]: relay does not read its acks, closed\n", conn->id);
+	if(conn->requeued)
+		r.ready.erase(find(r.ready.begin(), r.ready.end(), conn));
+	epoll_ctl(r.epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+	close(conn->fd);
+	r.conns.erase(conn->fd);
+	delete conn;
+}
+
+//write as much of the pending output as the kernel takes
+static bool flush_connection(Connection &conn)
+{
+	while(!conn.out.empty()) {
+		ssize_t n = send(conn.fd, conn.out.data(), conn.out.size(), MSG_NOSIGNAL);
+		if(n < 0) {
+			if(errno == EINTR)
+				continue;
+			return errno == EAGAIN || errno == EWOULDBLOCK;
+		}
+		conn.out.erase(0, n);
+	}
+	return true;
+}
+
+//edge triggered: accept until the backlog is empty
+static void accept_connections(Reactor &r)
+{
+	uint64_t refused = r.refused;
+
+	if(r.spare < 0)
+		r.spare = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	r.accept_again = false;
+	while(1) {
+		int fd = accept4(r.listenfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if(fd < 0) {
+			if(errno == EINTR || errno == ECONNABORTED)
+				continue;
+			if(errno == EMFILE || errno == ENFILE) {
+				//no event comes for the connections already in the backlog:
+				//refuse them with the spare descriptor, the relays retry
+				if(r.spare >= 0) {
+					close(r.spare);
+					fd = accept(r.listenfd, NULL, NULL);
+					int error = errno;
+					if(fd >= 0) {
+						close(fd);
+						r.refused++;
+					}
+					r.spare = open("/dev/null", O_RDONLY | O_CLOEXEC);
+					if(fd >= 0)
+						continue;
+					//the backlog is empty, or not even that one: then
+					//reactor_poll calls again
+					r.accept_again = error != EAGAIN && error != EWOULDBLOCK;
+				}
+				else
+					r.accept_again = true;
+			}
+			else if(errno != EAGAIN && errno != EWOULDBLOCK)
+				perror("accept");
+			if(r.refused != refused)
+				fprintf(stderr, "accept: out of descriptors, %llu connections refused\n", (unsigned long long)r.refused);
+			return;
+		}
+
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		Connection *conn = new Connection();
+		conn->fd = fd;
+		conn->id = r.next_id++;
+		conn->messages = 0;
+		conn->bytes = 0;
+		conn->binary = false;
+		conn->pipelined = false;
+		conn->frames = 0;
+		conn->age = -1;
+		conn->requeued = false;
+		conn->overflow = false;
+
+		struct epoll_event ev;
+		ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+		ev.data.ptr = conn;
+		if(epoll_ctl(r.epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+			perror("epoll_ctl");
+			close(fd);
+			delete conn;
+			continue;
+		}
+		r.conns[fd] = conn;
+	}
+}
+
+//edge triggered: as many datagrams per call as are queued, until none are
+static void read_datagrams(Reactor &r, int &count)
+{
+	char bufs[REACTOR_DATAGRAMS][REACTOR_DATAGRAM_SIZE];
+	struct mmsghdr msgs[REACTOR_DATAGRAMS];
+	struct iovec iovs[REACTOR_DATAGRAMS];
+	struct sockaddr_in from[REACTOR_DATAGRAMS];
+
+	while(1) {
+		for(int i=0; i<REACTOR_DATAGRAMS; i++) {
+			iovs[i].iov_base = bufs[i];
+			iovs[i].iov_len = REACTOR_DATAGRAM_SIZE;
+			memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			msgs[i].msg_hdr.msg_name = &from[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+		}
+		int n = recvmmsg(r.udpfd, msgs, REACTOR_DATAGRAMS, MSG_DONTWAIT, NULL);
+		if(n < 0) {
+			if(errno == EINTR)
+				continue;
+			return;
+		}
+		r.datagramReads++;
+		for(int i=0; i<n; i++) {
+			r.datagrams++;
+			count++;
+			r.on_datagram(from[i], bufs[i], msgs[i].msg_len, r.ctx);
+		}
+		if(n < REACTOR_DATAGRAMS)
+			return;
+	}
+}
+
+//edge triggered: read until the socket is drained, returns false once closed.
+//A relay sending faster than it is read gets REACTOR_READS_PER_EVENT reads,
+//then waits in r.ready for its next turn behind the other connections.
+static bool read_connection(Reactor &r, Connection &conn, int &count)
+{
+	char recvBuff[REACTOR_RECV_SIZE];
+
+	for(int reads=0; reads<REACTOR_READS_PER_EVENT; ) {
+		ssize_t n = read(conn.fd, recvBuff, sizeof(recvBuff));
+		if(n > 0) {
+			conn.messages++;
+			conn.bytes += n;
+			count++;
+			reads++;
+			r.on_message(conn, recvBuff, n, r.ctx);
+		}
+		else if(n == 0)
+			return false;
+		else if(errno == EINTR)
+			continue;
+		else
+			return errno == EAGAIN || errno == EWOULDBLOCK;
+	}
+	if(!conn.requeued) {
+		conn.requeued = true;
+		r.ready.push_back(&conn);
+	}
+	return true;
+}
+
+bool reactor_open(Reactor &r, uint16_t port, MessageHandler handler, void *ctx)
+{
+	struct sockaddr_in serv_addr;
+	int one = 1;
+
+	r.epfd = -1;
+	r.udpfd = -1;
+	r.spare = -1;
+	r.accept_again = false;
+	r.refused = 0;
+	r.datagrams = 0;
+	r.datagramReads = 0;
+	r.next_id = 0;
+	r.on_message = handler;
+	r.ctx = ctx;
+
+	r.listenfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if(r.listenfd < 0) {
+		perror("socket");
+		return false;
+	}
+	setsockopt(r.listenfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	memset(&serv_addr, 0, sizeof(serv_addr));
+	serv_addr.sin_family = AF_INET;
+	serv_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	serv_addr.sin_port = htons(port);
+	if(bind(r.listenfd, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) < 0 ||
+	   listen(r.listenfd, SOMAXCONN) < 0) {
+		perror("bind/listen");
+		close(r.listenfd);
+		return false;
+	}
+
+	r.epfd = epoll_create1(EPOLL_CLOEXEC);
+	if(r.epfd < 0) {
+		perror("epoll_create1");
+		close(r.listenfd);
+		return false;
+	}
+	r.spare = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+	//the listening socket is the only entry without a Connection
+	struct epoll_event ev;
+	ev.events = EPOLLIN | EPOLLET;
+	ev.data.ptr = NULL;
+	epoll_ctl(r.epfd, EPOLL_CTL_ADD, r.listenfd, &ev);
+
+	return true;
+}
+
+bool reactor_open_udp(Reactor &r, uint16_t port, DatagramHandler handler)
+{
+	struct sockaddr_in serv_addr;
+
+	r.on_datagram = handler;
+	r.udpfd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if(r.udpfd < 0) {
+		perror("socket");
+		return false;
+	}
+
+	memset(&serv_addr, 0, sizeof(serv_addr));
+	serv_addr.sin_family = AF_INET;
+	serv_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	serv_addr.sin_port = htons(port);
+	if(bind(r.udpfd, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) < 0) {
+		perror("bind");
+		close(r.udpfd);
+		r.udpfd = -1;
+		return false;
+	}
+
+	//told apart from the listening socket and the connections by its address
+	struct epoll_event ev;
+	ev.events = EPOLLIN | EPOLLET;
+	ev.data.ptr = &r.udpfd;
+	epoll_ctl(r.epfd, EPOLL_CTL_ADD, r.udpfd, &ev);
+	return true;
+}
+
+int reactor_poll(Reactor &r, int timeout_ms)
+{
+	struct epoll_event events[REACTOR_MAX_EVENTS];
+	int count = 0;
+
+	//no waiting while connections have more to read
+	if(!r.ready.empty())
+		timeout_ms = 0;
+	else if(r.accept_again && (timeout_ms < 0 || timeout_ms > REACTOR_ACCEPT_RETRY_MS))
+		timeout_ms = REACTOR_ACCEPT_RETRY_MS;
+	int n = epoll_wait(r.epfd, events, REACTOR_MAX_EVENTS, timeout_ms);
+	if(n < 0)
+		return errno == EINTR ? 0 : -1;
+	if(r.accept_again)
+		accept_connections(r);
+
+	//connections not drained before, by fd as the events may close them
+	vector<int> ready;
+	for(size_t i=0; i<r.ready.size(); i++) {
+		ready.push_back(r.ready[i]->fd);
+		r.ready[i]->requeued = false;
+	}
+	r.ready.clear();
+
+	for(int i=0; i<n; i++) {
+		Connection *conn = (Connection*)events[i].data.ptr;
+		if(conn == NULL) {
+			accept_connections(r);
+			continue;
+		}
+		if(events[i].data.ptr == &r.udpfd) {
+			read_datagrams(r, count);
+			continue;
+		}
+
+		//drain whatever arrived before a hangup so the last status is not lost
+		bool alive = true;
+		if(events[i].events & EPOLLIN)
+			alive = read_connection(r, *conn, count);
+		if(events[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP))
+			alive = false;
+		if(alive && (events[i].events & EPOLLOUT))
+			alive = flush_connection(*conn);
+
+		if(!alive)
+			close_connection(r, conn);
+	}
+
+	//their next turn, unless they just had it with an event
+	for(size_t i=0; i<ready.size(); i++) {
+		unordered_map<int, Connection*>::iterator it = r.conns.find(ready[i]);
+		if(it == r.conns.end() || it->second->requeued)
+			continue;
+		if(!read_connection(r, *it->second, count))
+			close_connection(r, it->second);
+	}
+	return count;
+}
+
+void reactor_send(Connection &conn, const char *data, size_t len)
+{
+	if(conn.overflow)
+		return;
+
+	//keep ordering: only write directly when nothing is queued
+	if(conn.out.empty()) {
+		ssize_t n = send(conn.fd, data, len, MSG_NOSIGNAL);
+		if(n == (ssize_t)len)
+			return;
+		if(n < 0)
+			n = 0;
+		data += n;
+		len -= n;
+	}
+
+	//a relay that stopped reading would hold its acks here forever: hang up,
+	//the hangup event closes the connection
+	if(conn.out.size() + len > REACTOR_OUT_MAX) {
+		conn.overflow = true;
+		conn.out.clear();
+		shutdown(conn.fd, SHUT_RDWR);
+		return;
+	}
+	conn.out.append(data, len);
+}
+
+void reactor_close(Reactor &r)
+{
+	while(!r.conns.empty())
+		close_connection(r, r.conns.begin()->second);
+	if(r.epfd >= 0)
+		close(r.epfd);
+	if(r.udpfd >= 0)
+		close(r.udpfd);
+	if(r.spare >= 0)
+		close(r.spare);
+	close(r.listenfd);
+}
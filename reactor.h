@@ -0,0 +1,86 @@
+//Edge-triggered epoll reactor used by the recorder server
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <netinet/in.h>
+
+#define REACTOR_PORT		65431
+#define REACTOR_MAX_EVENTS	256
+#define REACTOR_RECV_SIZE	1024
+#define REACTOR_DATAGRAMS	64	//per recvmmsg
+#define REACTOR_DATAGRAM_SIZE	512
+#define REACTOR_READS_PER_EVENT	16	//reads from one connection before the others get a turn
+#define REACTOR_OUT_MAX		65536	//bytes queued for a relay that does not read, it is closed past that
+#define REACTOR_ACCEPT_RETRY_MS	100	//out of descriptors, accept again this often
+
+//State kept for every accepted relay connection
+struct Connection
+{
+	int fd;
+	uint32_t id;		//assigned at accept time, printed in the log
+	std::string out;	//bytes the kernel did not take yet
+	std::string in;		//tail of a frame split across reads
+	bool binary;		//relay speaks status frames instead of text
+	bool pipelined;		//relay sent CMD_Relay_Hello, gets cumulative acks
+	uint32_t frames;	//status frames received, what CMD_Relay_Ack reports
+	int32_t age;		//[ms] from CMD_Relay_Age, for the next status frame, -1 none
+	bool requeued;		//more to read, in Reactor::ready
+	bool overflow;		//out reached REACTOR_OUT_MAX, shut down
+	uint64_t messages;
+	uint64_t bytes;
+};
+
+//Called once per chunk read from a connection
+typedef void (*MessageHandler)(Connection &conn, const char *data, size_t len, void *ctx);
+
+//Called once per datagram
+typedef void (*DatagramHandler)(const struct sockaddr_in &from, const char *data, size_t len, void *ctx);
+
+struct Reactor
+{
+	int epfd;
+	int listenfd;
+	uint32_t next_id;
+	std::unordered_map<int, Connection*> conns;
+	std::vector<Connection*> ready;	//read REACTOR_READS_PER_EVENT times, not drained
+	MessageHandler on_message;
+	void *ctx;
+
+	//kept open to accept and close connections with when out of descriptors
+	int spare;
+	bool accept_again;		//connections left in the backlog, no descriptor
+	uint64_t refused;
+
+	//UDP on the same port, -1 until reactor_open_udp
+	int udpfd;
+	DatagramHandler on_datagram;
+	uint64_t datagrams;
+	uint64_t datagramReads;		//recvmmsg calls that returned some
+};
+
+//Bind the listening socket and create the epoll set
+bool reactor_open(Reactor &r, uint16_t port, MessageHandler handler, void *ctx);
+
+//Also receive datagrams on the port, in batches of up to REACTOR_DATAGRAMS,
+//the handler gets the same ctx
+bool reactor_open_udp(Reactor &r, uint16_t port, DatagramHandler handler);
+
+//Wait up to timeout_ms for events and dispatch them, returns the number of
+//chunks handed to the handler or -1 on error
+int reactor_poll(Reactor &r, int timeout_ms);
+
+//Queue data on a connection, whatever does not fit in the socket buffer is
+//flushed when epoll reports the socket writable again. A connection with
+//more than REACTOR_OUT_MAX bytes queued is shut down and closed by the next
+//reactor_poll.
+void reactor_send(Connection &conn, const char *data, size_t len);
+
+//Close every connection, the listening and the UDP socket
+void reactor_close(Reactor &r);
+
+#endif
@@ -0,0 +1,287 @@
+#include "rollup.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+using namespace std;
+
+static int64_t floor_div(int64_t a, int64_t b)
+{
+	return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+//Start of the local day holding ms and the start of the next one, from the
+//zone rules at that date rather than the offset of today
+static int64_t local_day(int64_t ms, int64_t *endMs)
+{
+	time_t t = (time_t)floor_div(ms, 1000);
+	struct tm day, next;
+
+	localtime_r(&t, &day);
+	day.tm_hour = 0;
+	day.tm_min = 0;
+	day.tm_sec = 0;
+	day.tm_isdst = -1;
+	next = day;
+	next.tm_mday++;
+	if(endMs != NULL)
+		*endMs = (int64_t)mktime(&next) * 1000;
+	return (int64_t)mktime(&day) * 1000;
+}
+
+int64_t rollup_day(int64_t ms)
+{
+	return local_day(ms, NULL);
+}
+
+//dir/0001/20240131.day, the local date of the day
+static string day_path(const char *dir, uint16_t device, int64_t dayMs, bool mkdirs)
+{
+	char name[32];
+	struct tm tm;
+	time_t t = (time_t)floor_div(dayMs, 1000);
+	string path = dir;
+
+	snprintf(name, sizeof(name), "/%04x", device);
+	path += name;
+	if(mkdirs && mkdir(path.c_str(), 0755) < 0 && errno != EEXIST)
+		perror(path.c_str());
+	localtime_r(&t, &tm);
+	snprintf(name, sizeof(name), "/%04d%02d%02d.day", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+	return path + name;
+}
+
+//Map the file of a device day, created empty if there is none
+static RollupDay *open_day(const string &path)
+{
+	int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if(fd < 0) {
+		perror(path.c_str());
+		return NULL;
+	}
+	//a new file reads as zeros, empty buckets
+	struct stat st;
+	if(fstat(fd, &st) < 0 || ((size_t)st.st_size < sizeof(RollupDay) && ftruncate(fd, sizeof(RollupDay)) < 0)) {
+		perror(path.c_str());
+		close(fd);
+		return NULL;
+	}
+	void *map = mmap(NULL, sizeof(RollupDay), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED) {
+		perror("mmap");
+		return NULL;
+	}
+	return (RollupDay*)map;
+}
+
+//Whole days from one day start to a later one, 23 and 25 h days included
+static int days_between(int64_t fromMs, int64_t toMs)
+{
+	return (int)floor_div(toMs - fromMs + ROLLUP_DAY_MS / 2, ROLLUP_DAY_MS);
+}
+
+static void unmap_day(DeviceRollup &dev, int slot)
+{
+	if(dev.days[slot] != NULL) {
+		msync(dev.days[slot], sizeof(RollupDay), MS_ASYNC);
+		munmap(dev.days[slot], sizeof(RollupDay));
+	}
+	dev.days[slot] = NULL;
+}
+
+//The mapped day of a device holding ms, mapping it if it is not, NULL if the
+//file cannot be used.  A newer day moves the days open along and unmaps the
+//ones that fall out; an older day, replayed from a relay backlog, only ever
+//takes the last slot, so statuses of today and of days gone by interleaved
+//do not map today again and again.
+static RollupDay *map_day(Rollups &r, DeviceRollup &dev, uint16_t device, int64_t ms, int64_t &endMs)
+{
+	for(int i = 0; i < ROLLUP_SLOTS; i++) {
+		if(dev.days[i] != NULL && ms >= dev.days[i]->dayMs && ms < dev.endMs[i]) {
+			endMs = dev.endMs[i];
+			return dev.days[i];
+		}
+	}
+
+	int64_t dayMs = local_day(ms, &endMs);
+	int slot = 0;
+	if(dev.days[0] != NULL && dayMs > dev.days[0]->dayMs) {
+		int shift = min(days_between(dev.days[0]->dayMs, dayMs), ROLLUP_DAYS_OPEN);
+		for(int i = ROLLUP_DAYS_OPEN - 1; i >= 0; i--) {
+			if(i + shift >= ROLLUP_DAYS_OPEN) {
+				unmap_day(dev, i);
+				continue;
+			}
+			dev.days[i + shift] = dev.days[i];
+			dev.endMs[i + shift] = dev.endMs[i];
+			dev.days[i] = NULL;
+		}
+	}
+	else if(dev.days[0] != NULL) {
+		slot = min(days_between(dayMs, dev.days[0]->dayMs), ROLLUP_DAYS_OPEN);
+		unmap_day(dev, slot);
+	}
+
+	string path = day_path(r.dir.c_str(), device, dayMs, !dev.dirMade);
+	dev.dirMade = true;
+	RollupDay *day = open_day(path);
+	if(day == NULL)
+		return NULL;
+	if(day->magic != 0 && (day->magic != ROLLUP_MAGIC || day->device != device)) {
+		//not ours: kept aside for a look, the day starts over rather than
+		//losing its statuses
+		fprintf(stderr, "%s: not the rollup of device %04x, moved to .bad\n", path.c_str(), device);
+		munmap(day, sizeof(RollupDay));
+		if(rename(path.c_str(), (path + ".bad").c_str()) < 0 || (day = open_day(path)) == NULL) {
+			perror(path.c_str());
+			return NULL;
+		}
+	}
+	if(day->magic == 0) {
+		day->magic = ROLLUP_MAGIC;
+		day->device = device;
+	}
+	//the file is named by its date, the start follows the zone rules of now
+	day->dayMs = dayMs;
+
+	dev.days[slot] = day;
+	dev.endMs[slot] = endMs;
+	r.mapped++;
+	return day;
+}
+
+//The minute, hour and day buckets of ms, in a day ending at endMs
+static void buckets(RollupDay *day, int64_t endMs, int64_t ms, RollupBucket *b[3])
+{
+	int minute;
+
+	if(endMs - day->dayMs == ROLLUP_DAY_MS) {
+		minute = (int)((ms - day->dayMs) / ROLLUP_MINUTE_MS);
+	}
+	else {
+		//a DST change, by the minute on the clock: the hour repeated in the
+		//autumn adds up, the one skipped in the spring stays empty
+		time_t t = (time_t)floor_div(ms, 1000);
+		struct tm tm;
+		localtime_r(&t, &tm);
+		minute = tm.tm_hour * 60 + tm.tm_min;
+	}
+	b[0] = &day->minutes[minute];
+	b[1] = &day->hours[minute / 60];
+	b[2] = &day->day;
+}
+
+bool rollup_open(Rollups &r, const char *dir)
+{
+	r.dir = dir;
+	r.devices.clear();
+	r.syncedMs = 0;
+	r.statuses = 0;
+	r.unordered = 0;
+	r.mapped = 0;
+	if(mkdir(dir, 0755) < 0 && errno != EEXIST) {
+		perror(dir);
+		return false;
+	}
+	return true;
+}
+
+void rollup_add(Rollups &r, const EventRecord &rec)
+{
+	DeviceRollup &dev = r.devices[rec.device];
+	RollupBucket *b[3];
+	int64_t endMs;
+
+	r.statuses++;
+	if(dev.seen && rec.ms < dev.lastMs) {
+		//a status that took the slow way, the time around it is counted already
+		r.unordered++;
+	}
+	else {
+		//the state before lasted until now, split where it crosses a minute
+		if(dev.seen && dev.lastState < ST_COUNT) {
+			int64_t from = dev.lastMs;
+			int64_t left = min(rec.ms - dev.lastMs, (int64_t)ROLLUP_GAP_MS);
+			while(left > 0) {
+				RollupDay *day = map_day(r, dev, rec.device, from, endMs);
+				if(day == NULL)
+					break;
+				//zones are whole minutes off UTC, so are local minutes
+				int64_t part = min(left, ROLLUP_MINUTE_MS - (from - floor_div(from, ROLLUP_MINUTE_MS) * ROLLUP_MINUTE_MS));
+				buckets(day, endMs, from, b);
+				for(int i = 0; i < 3; i++)
+					b[i]->stateMs[dev.lastState] += (uint32_t)part;
+				from += part;
+				left -= part;
+			}
+		}
+		//a turn over from a text relay is a moment, the state goes on
+		if(rec.state != ST_TURN_OVER) {
+			dev.seen = true;
+			dev.lastMs = rec.ms;
+			dev.lastState = rec.state;
+		}
+	}
+
+	RollupDay *day = map_day(r, dev, rec.device, rec.ms, endMs);
+	if(day == NULL)
+		return;
+	bool turnOver = rec.state == ST_TURN_OVER || (rec.flags & STATUS_FLAG_TURNOVER);
+	buckets(day, endMs, rec.ms, b);
+	for(int i = 0; i < 3; i++) {
+		b[i]->statuses++;
+		b[i]->turnOvers += turnOver;
+	}
+}
+
+static void sync_days(Rollups &r, int flags)
+{
+	for(unordered_map<uint16_t, DeviceRollup>::iterator it = r.devices.begin(); it != r.devices.end(); ++it) {
+		for(int i = 0; i < ROLLUP_SLOTS; i++) {
+			if(it->second.days[i] != NULL)
+				msync(it->second.days[i], sizeof(RollupDay), flags);
+		}
+	}
+}
+
+void rollup_tick(Rollups &r, int64_t nowMs)
+{
+	if(nowMs - r.syncedMs < ROLLUP_SYNC_MS)
+		return;
+	//only starts the write back, the caller is the ingest thread and must
+	//not wait for the disk; close waits for it
+	sync_days(r, MS_ASYNC);
+	r.syncedMs = nowMs;
+}
+
+void rollup_close(Rollups &r)
+{
+	sync_days(r, MS_SYNC);
+	for(unordered_map<uint16_t, DeviceRollup>::iterator it = r.devices.begin(); it != r.devices.end(); ++it) {
+		for(int i = 0; i < ROLLUP_SLOTS; i++) {
+			if(it->second.days[i] != NULL)
+				munmap(it->second.days[i], sizeof(RollupDay));
+			it->second.days[i] = NULL;
+		}
+	}
+	r.devices.clear();
+}
+
+bool rollup_read(const char *dir, uint16_t device, int64_t dayMs, RollupDay &day)
+{
+	string path = day_path(dir, device, dayMs, false);
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+		return false;
+	bool ok = pread(fd, &day, sizeof(day), 0) == (ssize_t)sizeof(day) && day.magic == ROLLUP_MAGIC &&
+		day.device == device;
+	close(fd);
+	return ok;
+}
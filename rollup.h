@@ -0,0 +1,105 @@
+//Time in each state per device, by minute, hour and day, kept up to date as
+//statuses arrive
+//
+//Each status closes the interval of the one before it from the same device:
+//that state gets the time between the two, capped at ROLLUP_GAP_MS for a
+//device that went quiet, split at the minute boundary it crosses.  One file
+//per device and local date holds the day, its hours and its minutes, by the
+//time on the clock, so days start at local midnight across DST changes too;
+//the files are
+//mapped and updated in place, so an update is a few additions and a report
+//reads the buckets it wants without touching the event log.
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include "status_decoder.h"
+#include "event_log.h"
+
+#define ROLLUP_GAP_MS		5000		//longer between statuses and the device was away
+#define ROLLUP_DAYS_OPEN	2		//mapped per device, today and the one before
+#define ROLLUP_SLOTS		(ROLLUP_DAYS_OPEN + 1)	//and an older day replayed from a relay backlog
+#define ROLLUP_SYNC_MS		10000		//write back started at least this often
+#define ROLLUP_MAGIC		0x31505552	//"RUP1"
+
+#define ROLLUP_MINUTE_MS	((int64_t)60000)
+#define ROLLUP_HOUR_MS		((int64_t)3600000)
+#define ROLLUP_DAY_MS		((int64_t)86400000)
+
+//One bucket, 104 bytes
+struct RollupBucket
+{
+	uint32_t stateMs[ST_COUNT];	//[ms] in each StatusState
+	uint32_t statuses;
+	uint32_t turnOvers;
+};
+
+//A device day as stored, the file is exactly this
+struct RollupDay
+{
+	uint32_t magic;
+	uint16_t device;
+	uint16_t reserved;
+	int64_t dayMs;			//[ms] wall time the day starts, at local midnight
+	RollupBucket day;
+	RollupBucket hours[24];
+	RollupBucket minutes[24 * 60];
+};
+
+//What is kept of a device between its statuses
+struct DeviceRollup
+{
+	DeviceRollup() : seen(false), lastMs(0), lastState(ST_UNKNOWN), dirMade(false)
+	{
+		for(int i = 0; i < ROLLUP_SLOTS; i++) {
+			days[i] = NULL;
+			endMs[i] = 0;
+		}
+	}
+
+	bool seen;
+	int64_t lastMs;
+	uint8_t lastState;
+	//mapped, NULL if not: [0] the newest day, [i] the i-th day before it,
+	//[ROLLUP_DAYS_OPEN] any older one
+	RollupDay *days[ROLLUP_SLOTS];
+	int64_t endMs[ROLLUP_SLOTS];		//[ms] wall time each ends, 23 or 25 h on at a DST change
+	bool dirMade;
+};
+
+struct Rollups
+{
+	std::string dir;
+	std::unordered_map<uint16_t, DeviceRollup> devices;
+	int64_t syncedMs;		//[ms] last write back
+
+	uint64_t statuses;
+	uint64_t unordered;		//older than the last status of the device, not timed
+	uint64_t mapped;		//day files mapped
+};
+
+//Keep rollups under dir, days starting at local midnight in the zone of TZ
+bool rollup_open(Rollups &r, const char *dir);
+
+//Count one status, O(1) apart from mapping a day the first time: once a day
+//per device, and once per older day a relay replays
+void rollup_add(Rollups &r, const EventRecord &rec);
+
+//Start writing the mapped days back once ROLLUP_SYNC_MS passed, without
+//waiting for the disk, call it often
+void rollup_tick(Rollups &r, int64_t nowMs);
+
+//Write back, waiting for the disk, and unmap
+void rollup_close(Rollups &r);
+
+//Read a device day as stored, for reports, dayMs from rollup_day.  False if
+//there is none; a day that is still being filled can be read at any time.
+bool rollup_read(const char *dir, uint16_t device, int64_t dayMs, RollupDay &day);
+
+//Start of the local day holding ms
+int64_t rollup_day(int64_t ms);
+
+#endif
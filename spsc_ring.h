@@ -0,0 +1,75 @@
+//Bounded lock-free single producer / single consumer ring
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stddef.h>
+#include <atomic>
+
+//N must be a power of two, one slot is never used to tell full from empty
+template <typename T, size_t N>
+class SpscRing
+{
+public:
+	SpscRing() : head(0), tail(0) {}
+
+	//producer side, returns false when the ring is full
+	bool push(const T &item)
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		size_t next = (h + 1) & (N - 1);
+		if(next == tail.load(std::memory_order_acquire))
+			return false;
+		buf[h] = item;
+		head.store(next, std::memory_order_release);
+		return true;
+	}
+
+	//consumer side, returns false when the ring is empty
+	bool pop(T &item)
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		if(t == head.load(std::memory_order_acquire))
+			return false;
+		item = buf[t];
+		tail.store((t + 1) & (N - 1), std::memory_order_release);
+		return true;
+	}
+
+	//consumer side, copy of the i-th oldest item without removing it,
+	//false when the ring holds no more than i
+	bool peek(size_t i, T &item) const
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		if(i >= ((head.load(std::memory_order_acquire) - t) & (N - 1)))
+			return false;
+		item = buf[(t + i) & (N - 1)];
+		return true;
+	}
+
+	//consumer side, remove the n oldest items, at most size() of them
+	void drop(size_t n)
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		tail.store((t + n) & (N - 1), std::memory_order_release);
+	}
+
+	//approximate when called concurrently, exact from either side alone
+	size_t size() const
+	{
+		size_t h = head.load(std::memory_order_acquire);
+		size_t t = tail.load(std::memory_order_acquire);
+		return (h - t) & (N - 1);
+	}
+
+	size_t capacity() const { return N - 1; }
+
+private:
+	static_assert((N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+	//keep the indices on separate cache lines so the threads do not false share
+	alignas(64) std::atomic<size_t> head;
+	alignas(64) std::atomic<size_t> tail;
+	alignas(64) T buf[N];
+};
+
+#endif
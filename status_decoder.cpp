@@ -0,0 +1,231 @@
+//Maps relay messages and status frames to display states
+#include <string.h>
+#include <algorithm>
+#include "status_decoder.h"
+
+#define HASH_BITS	6
+#define HASH_SIZE	(1 << HASH_BITS)
+#define MAX_LENGTHS	16
+#define RESTART_GAP	1024	//a sequence number this far behind is a relay that restarted
+
+static const char *const StateName[ST_COUNT] =
+{
+	"no activity",
+	"stationary",
+	"standing",
+	"sitting",
+	"lying",
+	"walking",
+	"fast walking",
+	"jogging",
+	"biking",
+	"unknown desk",
+	"sitting desk",
+	"standing desk",
+	"fall down",
+	"turn over",
+	"sleeping",
+	"no sleeping, no activity",
+	"no sleeping, stationary",
+	"no sleeping, standing",
+	"no sleeping, sitting",
+	"no sleeping, lying",
+	"no sleeping, walking",
+	"no sleeping, fast walking",
+	"no sleeping, jogging",
+	"no sleeping, biking",
+};
+
+//Perfect hash, every slot holds one state or ST_UNKNOWN
+static uint8_t hashTable[HASH_SIZE];
+static uint8_t nameLength[ST_COUNT];
+static uint32_t hashSeed = 0;
+
+//Lengths of the names starting with each byte, longest first, so the split
+//only hashes the lengths that can match
+static uint8_t lengths[256][MAX_LENGTHS];
+static uint8_t lengthCount[256];
+static size_t maxLength = 0;
+
+//Length and four characters tell the names apart, the seed spreads them
+static inline uint32_t status_hash( const char *msg, size_t len, uint32_t seed )
+{
+	uint32_t key = (uint32_t)len;
+	key = key * 131 + (uint8_t)msg[0];
+	key = key * 131 + (uint8_t)msg[len / 2];
+	key = key * 131 + (uint8_t)msg[len - (len >= 5 ? 5 : 1)];
+	key = key * 131 + (uint8_t)msg[len - 1];
+	return (key * seed) >> (32 - HASH_BITS);
+}
+
+bool status_decoder_init()
+{
+	memset(lengthCount, 0, sizeof(lengthCount));
+	maxLength = 0;
+	for( int s = 0; s < ST_COUNT; s++ )
+	{
+		uint8_t first = (uint8_t)StateName[s][0];
+		uint8_t *l = lengths[first];
+
+		nameLength[s] = (uint8_t)strlen(StateName[s]);
+		maxLength = std::max(maxLength, (size_t)nameLength[s]);
+		if( std::find(l, l + lengthCount[first], nameLength[s]) == l + lengthCount[first] )
+			l[lengthCount[first]++] = nameLength[s];
+	}
+	for( int c = 0; c < 256; c++ )
+		std::sort(lengths[c], lengths[c] + lengthCount[c], std::greater<uint8_t>());
+
+	//Odd seeds only, the first one without a collision wins
+	for( uint32_t seed = 0x9E3779B1; seed != 0x9E3779B1 + 2 * 100000; seed += 2 )
+	{
+		bool ok = true;
+		memset(hashTable, ST_UNKNOWN, sizeof(hashTable));
+		for( int s = 0; s < ST_COUNT && ok; s++ )
+		{
+			uint32_t h = status_hash(StateName[s], nameLength[s], seed);
+			if( hashTable[h] != ST_UNKNOWN )
+				ok = false;
+			else
+				hashTable[h] = (uint8_t)s;
+		}
+		if( ok )
+		{
+			hashSeed = seed;
+			return true;
+		}
+	}
+	hashSeed = 0;
+	return false;
+}
+
+const char* status_name( int state )
+{
+	if( state < 0 || state >= ST_COUNT )
+		return "unknown";
+	return StateName[state];
+}
+
+StatusState status_lookup( const char *msg, size_t len )
+{
+	if( len == 0 || len > maxLength || hashSeed == 0 )
+		return ST_UNKNOWN;
+	uint8_t s = hashTable[status_hash(msg, len, hashSeed)];
+	if( s == ST_UNKNOWN || nameLength[s] != len || memcmp(StateName[s], msg, len) != 0 )
+		return ST_UNKNOWN;
+	return (StatusState)s;
+}
+
+//True if data could still grow into one of the names
+static bool status_prefix( const char *data, size_t len )
+{
+	for( int s = 0; s < ST_COUNT; s++ )
+		if( nameLength[s] > len && memcmp(StateName[s], data, len) == 0 )
+			return true;
+	return false;
+}
+
+size_t status_split( const char *data, size_t len, std::vector<StatusState> &out )
+{
+	size_t pos = 0;
+	while( pos < len )
+	{
+		size_t left = len - pos;
+		uint8_t first = (uint8_t)data[pos];
+		StatusState s = ST_UNKNOWN;
+		size_t used = 0;
+
+		//The text has no delimiter, take the longest name that fits
+		for( int i = 0; i < lengthCount[first] && s == ST_UNKNOWN; i++ )
+		{
+			used = lengths[first][i];
+			if( used <= left )
+				s = status_lookup(data + pos, used);
+		}
+		if( s != ST_UNKNOWN )
+		{
+			out.push_back(s);
+			pos += used;
+		}
+		else if( left < maxLength && status_prefix(data + pos, left) )
+			break;		//rest of the message is in the next read
+		else
+			pos++;		//not a status, resync on the next byte
+	}
+	return pos;
+}
+
+void status_from_frame( const TStatusFrame &status, std::vector<StatusState> &out )
+{
+	if( status.Mode == STATUS_MODE_SM )
+	{
+		if( status.Flags & STATUS_FLAG_SLEEP )
+			out.push_back(ST_SLEEPING);
+		else if( status.Activity <= STATUS_ACT_BIKING )
+			out.push_back((StatusState)(ST_NS_NO_ACTIVITY + status.Activity));
+	}
+	else if( status.Activity < STATUS_ACT_COUNT )
+	{
+		//STATUS_ACT_xx and the first states share their order
+		out.push_back((StatusState)status.Activity);
+	}
+	if( status.Flags & STATUS_FLAG_TURNOVER )
+		out.push_back(ST_TURN_OVER);
+}
+
+bool status_track( DeviceTrack &dev, const TStatusFrame &status, int64_t nowMs, int32_t age, int64_t &wallMs )
+{
+	//a resend matches a frame seen in sequence number and time stamp, a
+	//device that restarted does not
+	uint32_t &stamp = dev.stamps[status.Seq % DEVICE_RECENT];
+	if( stamp == status.TimeStamp )
+		return false;
+	stamp = status.TimeStamp;
+
+	//the device clock from the anchor on, until an age tells better, the
+	//device restarted, or it runs ahead of the wall
+	int64_t ms = dev.anchorMs + (int64_t)(status.TimeStamp - dev.anchorStamp);
+	if( age >= 0 || !dev.seen || status.TimeStamp < dev.anchorStamp || ms > nowMs )
+	{
+		dev.anchorMs = nowMs - (age >= 0 ? age : 0);
+		dev.anchorStamp = status.TimeStamp;
+		ms = dev.anchorMs;
+	}
+	dev.seen = true;
+	wallMs = ms;
+	return true;
+}
+
+DatagramOrder datagram_track( DatagramTrack &t, uint32_t seq )
+{
+	int32_t ahead = (int32_t)(seq - t.highest);
+
+	if( !t.seen || ahead < -RESTART_GAP )
+	{
+		t.seen = true;
+		t.highest = seq;
+		t.window = 1;
+		return DG_NEW;
+	}
+	if( ahead > 0 )
+	{
+		t.lost += ahead - 1;
+		t.window = (ahead < 64) ? (t.window << ahead) | 1 : 1;
+		t.highest = seq;
+		return DG_NEW;
+	}
+	if( -ahead >= 64 )
+	{
+		t.late++;
+		return DG_LATE;
+	}
+	uint64_t bit = 1ULL << -ahead;
+	if( t.window & bit )
+	{
+		t.duplicates++;
+		return DG_DUPLICATE;
+	}
+	t.window |= bit;
+	t.lost--;
+	t.reordered++;
+	return DG_REORDERED;
+}
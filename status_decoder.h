@@ -0,0 +1,104 @@
+//Maps relay messages and status frames to display states
+#ifndef STATUS_DECODER_H
+#define STATUS_DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include "status_frame.h"
+
+//Every status the server knows, the first nine follow STATUS_ACT_xx
+enum StatusState
+{
+	ST_NO_ACTIVITY,
+	ST_STATIONARY,
+	ST_STANDING,
+	ST_SITTING,
+	ST_LYING,
+	ST_WALKING,
+	ST_FAST_WALKING,
+	ST_JOGGING,
+	ST_BIKING,
+	ST_DESK_UNKNOWN,
+	ST_DESK_SITTING,
+	ST_DESK_STANDING,
+	ST_FALL,
+	ST_TURN_OVER,
+	ST_SLEEPING,
+	//SM mode while awake, same order as the first nine
+	ST_NS_NO_ACTIVITY,
+	ST_NS_STATIONARY,
+	ST_NS_STANDING,
+	ST_NS_SITTING,
+	ST_NS_LYING,
+	ST_NS_WALKING,
+	ST_NS_FAST_WALKING,
+	ST_NS_JOGGING,
+	ST_NS_BIKING,
+	ST_COUNT,
+	ST_UNKNOWN = 0xFF
+};
+
+//Build the perfect hash over the message names, false if no seed works
+bool status_decoder_init();
+
+//Text the relay sends for a state
+const char* status_name( int state );
+
+//Exact match of one message, ST_UNKNOWN if it is not a status
+StatusState status_lookup( const char *msg, size_t len );
+
+//Split a text stream holding any number of back to back messages.  Appends
+//the states to out and returns how many bytes were used; the rest is the
+//start of a message that continues in the next read.
+size_t status_split( const char *data, size_t len, std::vector<StatusState> &out );
+
+//Direct index from a status frame, turn over comes after the state it goes with
+void status_from_frame( const TStatusFrame &status, std::vector<StatusState> &out );
+
+#define DEVICE_RECENT	256	//frames remembered per device, more than a relay can send again
+
+//What the server keeps of a device across relay connections
+struct DeviceTrack
+{
+	DeviceTrack() : seen(false), anchorMs(0), anchorStamp(0) { memset(stamps, 0xFF, sizeof(stamps)); }
+
+	bool seen;
+	int64_t anchorMs;		//[ms] wall time of the device time anchorStamp
+	uint32_t anchorStamp;
+	uint32_t stamps[DEVICE_RECENT];	//time stamp of the last frames, by Seq
+};
+
+//Put a status frame at the wall time it was made and drop the ones a relay
+//sends again after a reconnect.  age is from the CMD_Relay_Age just before
+//the frame, -1 without one.  Returns false for a frame already received,
+//otherwise sets wallMs.
+bool status_track( DeviceTrack &dev, const TStatusFrame &status, int64_t nowMs, int32_t age, int64_t &wallMs );
+
+//Sequence numbers of the datagrams from one relay
+struct DatagramTrack
+{
+	DatagramTrack() : seen(false), highest(0), window(0), lost(0), reordered(0), duplicates(0), late(0) {}
+
+	bool seen;
+	uint32_t highest;
+	uint64_t window;		//bit i: highest - i arrived
+	uint64_t lost;			//skipped and not arrived since
+	uint64_t reordered;		//arrived after a later one
+	uint64_t duplicates;
+	uint64_t late;			//too far behind to tell, dropped
+};
+
+enum DatagramOrder
+{
+	DG_NEW,				//newer than any so far, the ones skipped count as lost
+	DG_REORDERED,			//fills a gap, older than the state shown
+	DG_DUPLICATE,
+	DG_LATE
+};
+
+//Where a datagram falls in the sequence; a relay that restarted starts over
+DatagramOrder datagram_track( DatagramTrack &t, uint32_t seq );
+
+#endif